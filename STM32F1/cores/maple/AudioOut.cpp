@@ -0,0 +1,207 @@
+/**
+ * @file AudioOut.cpp
+ * @brief Polyphonic sample output, on a PWM pin or the DAC.
+ */
+
+#include "AudioOut.h"
+#include "io.h"
+#include "boards.h"
+
+#define AUDIO_TIMER_HZ          (CYCLES_PER_MICROSECOND * 1000000UL)
+
+AudioOut *AudioOut::_active;
+
+/* TimerWaveform number of a timer, 0 if it has none */
+static uint8 audio_timer_num(timer_dev *dev)
+{
+    switch (dev->clk_id) {
+    case RCC_TIMER1: return 1;
+    case RCC_TIMER2: return 2;
+    case RCC_TIMER3: return 3;
+    case RCC_TIMER4: return 4;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    case RCC_TIMER5: return 5;
+#endif
+    default: return 0;
+    }
+}
+
+AudioOut::AudioOut() : _pwm(0)
+{
+    _dac = false;
+    _rate = 0;
+    _top = 0;
+    for (uint8 v = 0; v < AUDIO_VOICES; v++) {
+        _voices[v].active = 0;
+    }
+}
+
+bool AudioOut::beginPWM(uint8 pin, uint32 sampleRate)
+{
+    if (pin >= BOARD_NR_GPIO_PINS || !sampleRate) {
+        return false;
+    }
+    timer_dev *dev = PinTimerDevice(pin);
+    uint8 channel = PinTimerChannel(pin);
+    uint32 period = AUDIO_TIMER_HZ / sampleRate;
+    if (!dev || !channel || !audio_timer_num(dev) || period < 2 || period > 0xFFFF) {
+        return false;
+    }
+    if (_active) {
+        _active->end();
+    }
+
+    pinMode(pin, PWM);
+    _pwm = TimerWaveform(audio_timer_num(dev));
+    if (!_pwm.begin(AUDIO_TIMER_HZ, period, channel)) {
+        return false;
+    }
+    _dac = false;
+    _rate = AUDIO_TIMER_HZ / period;
+    _top = period;
+    start();
+    if (!_pwm.stream(_buf, 2 * AUDIO_BLOCK, refill)) {
+        end();
+        return false;
+    }
+    return true;
+}
+
+#if STM32_HAVE_DAC
+/*
+ * TIM6 update events trigger the DAC, which requests the next sample
+ * from DMA2 channel 3.
+ */
+bool AudioOut::beginDAC(uint32 sampleRate)
+{
+    uint32 period = sampleRate ? AUDIO_TIMER_HZ / sampleRate : 0;
+    if (period < 2 || period > 0x10000) {
+        return false;
+    }
+    if (_active) {
+        _active->end();
+    }
+
+    _dac = true;
+    _rate = AUDIO_TIMER_HZ / period;
+    _top = DAC_DHR12R1_DACC1DHR;
+    start();
+
+    timer_pause(TIMER6);
+    timer_set_prescaler(TIMER6, 0);
+    timer_set_reload(TIMER6, period - 1);
+    timer_set_master_mode(TIMER6, TIMER_MASTER_MODE_UPDATE);
+    timer_generate_update(TIMER6);
+
+    dac_init(DAC, DAC_CH1);
+    DAC->regs->DHR12R1 = _top / 2;
+    DAC->regs->CR |= DAC_CR_TEN1 | DAC_CR_DMAEN1;    /* TSEL1 0: TIM6 TRGO */
+
+    dma_tube tube = (dma_tube)(DMA_REQ_SRC_DAC_CH1 & 0x7);
+    dma_tube_config cfg;
+    cfg.tube_src = _buf;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = &DAC->regs->DHR12R1;
+    cfg.tube_dst_size = DMA_SIZE_32BITS;
+    cfg.tube_nr_xfers = 2 * AUDIO_BLOCK;
+    cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC |
+                     DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE;
+    cfg.tube_req_src = DMA_REQ_SRC_DAC_CH1;
+    dma_init(DMA2);
+    if (dma_tube_cfg(DMA2, tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        end();
+        return false;
+    }
+    dma_attach_interrupt(DMA2, tube, dacEvent);
+    dma_enable(DMA2, tube);
+    timer_resume(TIMER6);
+    return true;
+}
+#endif
+
+void AudioOut::end(void)
+{
+    if (_active != this) {
+        return;
+    }
+    if (_dac) {
+#if STM32_HAVE_DAC
+        dma_tube tube = (dma_tube)(DMA_REQ_SRC_DAC_CH1 & 0x7);
+        timer_pause(TIMER6);
+        dma_disable(DMA2, tube);
+        dma_detach_interrupt(DMA2, tube);
+        DAC->regs->CR &= ~(DAC_CR_TEN1 | DAC_CR_DMAEN1);
+        DAC->regs->DHR12R1 = _top / 2;
+#endif
+    } else {
+        _pwm.end();
+    }
+    stopAll();
+    _rate = 0;
+    _active = NULL;
+}
+
+int AudioOut::play(uint32 freq, uint32 durationMs, uint8 volume,
+                   const int16 *wave, uint8 waveBits)
+{
+    if (!_rate || !freq || freq >= _rate / 2) {
+        return -1;
+    }
+    uint32 samples = (uint32)(((uint64)durationMs * _rate) / 1000);
+    if (durationMs && !samples) {
+        samples = 1;
+    }
+    for (uint8 v = 0; v < AUDIO_VOICES; v++) {
+        if (!_voices[v].active) {
+            audio_voice_start(&_voices[v], freq, _rate, samples, volume,
+                              wave, waveBits);
+            return v;
+        }
+    }
+    return -1;
+}
+
+void AudioOut::stop(int voice)
+{
+    if (voice >= 0 && voice < AUDIO_VOICES) {
+        audio_voice_stop(&_voices[voice]);
+    }
+}
+
+void AudioOut::stopAll(void)
+{
+    for (uint8 v = 0; v < AUDIO_VOICES; v++) {
+        audio_voice_stop(&_voices[v]);
+    }
+}
+
+bool AudioOut::playing(int voice) const
+{
+    return voice >= 0 && voice < AUDIO_VOICES && _voices[voice].active;
+}
+
+/* Fill the whole buffer before the DMA starts */
+void AudioOut::start(void)
+{
+    _active = this;
+    audio_mix_render(_voices, AUDIO_VOICES, _buf, 2 * AUDIO_BLOCK, _top);
+}
+
+/* Called from the DMA interrupt with the half that was just sent */
+void AudioOut::refill(uint16 *samples, uint16 count)
+{
+    AudioOut *out = _active;
+    audio_mix_render(out->_voices, AUDIO_VOICES, samples, count, out->_top);
+}
+
+void AudioOut::dacEvent(void)
+{
+#if STM32_HAVE_DAC
+    dma_irq_cause cause = dma_get_irq_cause(DMA2, (dma_tube)(DMA_REQ_SRC_DAC_CH1 & 0x7));
+    if (cause == DMA_TRANSFER_HALF_COMPLETE) {
+        refill(_active->_buf, AUDIO_BLOCK);
+    } else if (cause == DMA_TRANSFER_COMPLETE) {
+        refill(_active->_buf + AUDIO_BLOCK, AUDIO_BLOCK);
+    }
+#endif
+}
@@ -0,0 +1,96 @@
+/**
+ * @file AudioOut.h
+ * @brief Polyphonic sample output, on a PWM pin or the DAC.
+ *
+ * Up to AUDIO_VOICES wavetable voices are mixed in blocks into a double
+ * buffer that DMA sends to the output at the sample rate, one sample
+ * per timer update. The mixing runs in the DMA interrupt, once per half
+ * buffer of AUDIO_BLOCK samples.
+ *
+ * PWM output uses TimerWaveform on the pin's timer: the PWM frequency
+ * is the sample rate, the resolution is timer clock / sample rate
+ * steps (2250 at 32 kHz). An RC low pass on the pin makes it a DAC.
+ * Only one AudioOut can run at a time.
+ *
+ * On devices with a DAC, beginDAC() outputs 12 bit samples on PA4,
+ * clocked by TIM6.
+ *
+ * Example:
+ *
+ *     AudioOut audio;
+ *     audio.beginPWM(PA8);
+ *     audio.play(440, 500);                // A4 for half a second
+ *     audio.play(554, 500);                // with C#5
+ */
+
+#ifndef _WIRISH_AUDIOOUT_H_
+#define _WIRISH_AUDIOOUT_H_
+
+#include <libmaple/audio_mix.h>
+#include <libmaple/dac.h>
+#include <libmaple/dma.h>
+#include "TimerWaveform.h"
+
+#ifndef AUDIO_VOICES
+#define AUDIO_VOICES            8
+#endif
+#ifndef AUDIO_BLOCK
+#define AUDIO_BLOCK             128     /* samples per half buffer */
+#endif
+#define AUDIO_DEFAULT_RATE      32000
+
+class AudioOut {
+public:
+    AudioOut();
+
+    /**
+     * Start output on a pin with a timer channel (timers 1 to 5).
+     * @param sampleRate In Hz, at least 1100.
+     * @return false if the pin can't be used.
+     */
+    bool beginPWM(uint8 pin, uint32 sampleRate = AUDIO_DEFAULT_RATE);
+
+#if STM32_HAVE_DAC
+    /** Start output on DAC channel 1 (PA4). */
+    bool beginDAC(uint32 sampleRate = AUDIO_DEFAULT_RATE);
+#endif
+
+    /** Stop the output and all voices. */
+    void end(void);
+
+    /**
+     * Play a note on a free voice.
+     * @param freq Frequency, in Hz.
+     * @param durationMs 0 plays until stop().
+     * @param volume 255 is full scale; the voices are added, so keep
+     *        the sum of the playing voices' volumes below 256 to avoid
+     *        clipping.
+     * @param wave Wavetable of 1 << waveBits samples, NULL for a
+     *        square wave.
+     * @return The voice number, or -1 if all voices are busy.
+     */
+    int play(uint32 freq, uint32 durationMs = 0, uint8 volume = 64,
+             const int16 *wave = audio_sine256, uint8 waveBits = 8);
+
+    void stop(int voice);
+    void stopAll(void);
+    bool playing(int voice) const;
+
+    uint32 sampleRate(void) const { return _rate; }
+
+private:
+    void start(void);
+    static void refill(uint16 *samples, uint16 count);
+    static void dacEvent(void);
+
+    static AudioOut *_active;
+
+    TimerWaveform _pwm;
+    bool _dac;
+    uint32 _rate;
+    uint16 _top;
+    audio_voice _voices[AUDIO_VOICES];
+    uint16 _buf[2 * AUDIO_BLOCK];
+};
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file FastPin.h
+ * @brief Compile-time pin access for bit-banged protocols.
+ *
+ * Pin numbers of the STM32F1 variants encode the port and the bit
+ * (pin = 16*port + bit, e.g. PA5 = 5, PC13 = 45), so the GPIO register
+ * address and the bit mask of a constant pin are known at compile time.
+ * FastPin<PA5>::set() compiles to a single store to GPIOA->BSRR, while
+ * digitalWrite(PA5, HIGH) is a function call with a range check and a
+ * run-time lookup of the port device and register map.
+ *
+ * Example:
+ *
+ *     typedef FastPin<PB12> Clk;
+ *     Clk::mode(OUTPUT);
+ *     Clk::set();
+ *     Clk::clear();
+ *     if (FastPin<PA0>::read()) { ... }
+ */
+
+#ifndef _WIRISH_FASTPIN_H_
+#define _WIRISH_FASTPIN_H_
+
+#include <libmaple/gpio.h>
+#include "io.h"
+
+/** GPIO register map of port 0 (A) .. 6 (G), ports are 0x400 apart */
+#define FASTPIN_GPIO_REGS(port)  ((gpio_reg_map *)(0x40010800UL + 0x400UL * (port)))
+
+template<uint8 PIN>
+struct FastPin {
+    static_assert(PIN < 7 * 16, "FastPin: invalid pin number");
+
+    static const uint8 port = PIN / 16;
+    static const uint8 bit = PIN % 16;
+    static const uint32 mask = (1UL << (PIN % 16));
+
+    static inline gpio_reg_map * regs(void) __attribute__((always_inline)) {
+        return FASTPIN_GPIO_REGS(port);
+    }
+
+    /* Same as pinMode(PIN, mode), for symmetry. Not time critical. */
+    static inline void mode(WiringPinMode m) { pinMode(PIN, m); }
+
+    static inline void set(void) __attribute__((always_inline)) {
+        regs()->BSRR = mask;
+    }
+
+    static inline void clear(void) __attribute__((always_inline)) {
+        regs()->BRR = mask;
+    }
+
+    /* Single BSRR store, val is reduced to the set or the reset half. */
+    static inline void write(uint8 val) __attribute__((always_inline)) {
+        regs()->BSRR = val ? mask : (mask << 16);
+    }
+
+    /* Not atomic with respect to other ODR writers of the same port. */
+    static inline void toggle(void) __attribute__((always_inline)) {
+        regs()->ODR ^= mask;
+    }
+
+    static inline uint8 read(void) __attribute__((always_inline)) {
+        return (regs()->IDR & mask) ? HIGH : LOW;
+    }
+
+    /* Raw, not normalized IDR bit; cheaper in tight loops. */
+    static inline uint32 readRaw(void) __attribute__((always_inline)) {
+        return regs()->IDR & mask;
+    }
+};
+
+/* digitalWrite()/digitalRead() style wrappers for constant pins */
+template<uint8 PIN>
+inline void digitalWriteFast(uint8 val) { FastPin<PIN>::write(val); }
+
+template<uint8 PIN>
+inline uint8 digitalReadFast(void) { return FastPin<PIN>::read(); }
+
+#endif
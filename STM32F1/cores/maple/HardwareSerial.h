@@ -136,6 +136,18 @@ public:
     	usart_disable(usart_device);
     }
 
+    /* Optional DMA mode, call after begin().
+     * RX: circular DMA into the RX buffer, flushed on USART IDLE line.
+     * TX: the TX buffer is sent in contiguous DMA chunks.
+     * Returns false if the port has no DMA support. */
+    bool enableDMA(uint8 flags = (USART_DMA_RX | USART_DMA_TX)) {
+        return (usart_dma_enable(usart_device, flags) == 0);
+    }
+
+    void disableDMA(void) {
+        usart_dma_disable(usart_device);
+    }
+
     virtual int available(void) {
         return usart_rx_available(usart_device);
     }
@@ -161,6 +173,15 @@ public:
     	return 1;
     }
 
+    virtual size_t write(const void *buf, uint32 len) {
+        const uint8 *ptr = (const uint8 *)buf;
+        uint32 txed = 0;
+        while (txed < len) { // blocks until all bytes are queued
+            txed += usart_tx(usart_device, ptr + txed, (len - txed) > 0xFFFF ? 0xFFFF : (len - txed));
+        }
+        return len;
+    }
+
     virtual void flush(void) {
         while(!rb_is_empty(usart_device->wb)); // wait for TX buffer empty
         while(!((usart_device->regs->SR) & (1<<USART_SR_TC_BIT))); // wait for TC (Transmission Complete) flag set
@@ -0,0 +1,44 @@
+/**
+ * @file ISRProfile.cpp
+ * @brief Print the interrupt profiler statistics.
+ */
+
+#include "ISRProfile.h"
+#include <boards.h>
+
+void isrProfileDump(Print &out)
+{
+    out.print("isr_profile f_cpu=");
+    out.println(CYCLES_PER_MICROSECOND * 1000000UL);
+
+    for (uint32 exc = ISR_PROFILE_FIRST_EXC; exc < ISR_PROFILE_NR_EXC; exc++) {
+        const isr_stats *s = isr_profile_get(exc);
+        if (!s->count) {
+            continue;
+        }
+        out.print("exc ");
+        out.print(exc);
+        out.print(' ');
+        out.print(s->count);
+        out.print(' ');
+        out.print(s->min);
+        out.print(' ');
+        out.print(s->max);
+        out.print(' ');
+        out.println(s->total);
+    }
+
+    const isr_cs_stats *cs = isr_profile_cs();
+    for (uint32 i = 0; i < ISR_PROFILE_CS_BUCKETS; i++) {
+        if (!cs->hist[i]) {
+            continue;
+        }
+        out.print("cs ");
+        out.print(i);
+        out.print(' ');
+        out.println(cs->hist[i]);
+    }
+    out.print("cs_max ");
+    out.println(cs->max);
+    out.println("end");
+}
@@ -0,0 +1,38 @@
+/**
+ * @file ISRProfile.h
+ * @brief Print the interrupt profiler statistics.
+ *
+ * Example:
+ *
+ *     #include <ISRProfile.h>
+ *
+ *     isr_profile_start();
+ *     ...
+ *     isrProfileDump(Serial);
+ *
+ * The dump is line oriented text, tools/profiling/isr_profile.py
+ * turns it into a table with names and microseconds.
+ */
+
+#ifndef _WIRISH_ISRPROFILE_H_
+#define _WIRISH_ISRPROFILE_H_
+
+#include <libmaple/isr_profile.h>
+#include "Print.h"
+
+/**
+ * Print the statistics of all exceptions that ran since the last
+ * reset, and the critical section histogram, to out:
+ *
+ *     isr_profile f_cpu=<Hz>
+ *     exc <number> <count> <min> <max> <total>
+ *     cs <bucket> <count>
+ *     cs_max <cycles>
+ *     end
+ *
+ * Times are in CPU cycles; exception numbers are 15 for SysTick and
+ * 16 + n for IRQ n.
+ */
+void isrProfileDump(Print &out);
+
+#endif
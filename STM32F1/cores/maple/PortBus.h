@@ -0,0 +1,188 @@
+/**
+ * @file PortBus.h
+ * @brief Parallel bus of pins on one GPIO port, written as a value.
+ *
+ * A PortBus maps an arbitrary set of up to 16 pins of one GPIO port to
+ * the bits of a value, e.g. the data lines of an 8 bit parallel TFT or
+ * ADC. begin() precomputes BSRR images, so write() is one store to the
+ * port's BSRR register: the pins of 1 bits are set and the pins of 0
+ * bits are reset at the same time, other pins of the port are untouched.
+ *
+ * Pins that are consecutive bits of the port, in order, are shifted
+ * into place. Any other mapping gathers the bits one by one, or, with
+ * the LUT template option, uses a lookup table of 256 BSRR images per
+ * byte of the value: one load per byte, but 1 KiB of RAM per 8 pins.
+ *
+ * Example:
+ *
+ *     const uint8 tft_data[8] = {PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15};
+ *     PortBus<8> tft(tft_data);
+ *     tft.begin(OUTPUT);
+ *     tft.write(0x5A);
+ *
+ *     const uint8 adc_data[8] = {PA0, PA1, PA3, PA2, PA8, PA9, PA10, PA15};
+ *     PortBus<8, true> adc(adc_data); // scattered pins, table lookup
+ */
+
+#ifndef _WIRISH_PORTBUS_H_
+#define _WIRISH_PORTBUS_H_
+
+#include <libmaple/gpio.h>
+#include <boards.h>
+#include "io.h"
+
+/* BSRR image tables of a PortBus, one per byte of the value */
+template<uint8 BYTES>
+struct PortBusLut {
+    uint32 image(uint8 byte, uint8 v) const { return _images[byte][v]; }
+    void set(uint8 byte, uint8 v, uint32 image) { _images[byte][v] = image; }
+    uint32 _images[BYTES][256];
+};
+
+template<>
+struct PortBusLut<0> {
+    uint32 image(uint8, uint8) const { return 0; }
+    void set(uint8, uint8, uint32) {}
+};
+
+/**
+ * @tparam WIDTH Number of pins, 1 to 16
+ * @tparam LUT Use lookup tables for pins that are not consecutive
+ *             port bits in order (1 KiB of RAM per 8 pins)
+ */
+template<uint8 WIDTH, bool LUT = false>
+class PortBus {
+    static_assert(WIDTH > 0 && WIDTH <= 16, "PortBus: 1 to 16 pins");
+
+public:
+    /**
+     * @param pins Pin numbers, pins[0] is the least significant bit.
+     *             All pins must be on the same GPIO port.
+     */
+    PortBus(const uint8 *pins) {
+        for (uint8 i = 0; i < WIDTH; i++) {
+            _pins[i] = pins[i];
+        }
+        _dev = NULL;
+        _mask = 0;
+        _shift = -1;
+    }
+
+    /**
+     * Set the pin modes and build the BSRR images.
+     * @return false if a pin is invalid or on another port than pins[0].
+     */
+    bool begin(WiringPinMode mode = OUTPUT) {
+        if (_pins[0] >= BOARD_NR_GPIO_PINS) {
+            return false;
+        }
+        uint8 port = _pins[0] / 16;
+        uint16 mask = 0;
+        for (uint8 i = 0; i < WIDTH; i++) {
+            if (_pins[i] >= BOARD_NR_GPIO_PINS || _pins[i] / 16 != port) {
+                return false;
+            }
+            mask |= 1U << (_pins[i] % 16);
+        }
+        _dev = gpio_devs[port];
+        _mask = mask;
+
+        _shift = _pins[0] % 16;
+        for (uint8 i = 1; i < WIDTH; i++) {
+            if (_pins[i] != _pins[0] + i) {
+                _shift = -1;
+                break;
+            }
+        }
+        if (_shift < 0 && LUT) {
+            buildTables();
+        }
+        this->mode(mode);
+        return true;
+    }
+
+    /** Set the mode of all pins of the bus. */
+    void mode(WiringPinMode mode) {
+        for (uint8 i = 0; i < WIDTH; i++) {
+            pinMode(_pins[i], mode);
+        }
+    }
+
+    /** Output value on the bus, a single BSRR store. */
+    inline void write(uint32 value) __attribute__((always_inline)) {
+        _dev->regs->BSRR = bsrr(value);
+    }
+
+    /**
+     * Return the BSRR image for value. Useful to prepare a buffer
+     * of images for a DMA transfer to the BSRR register.
+     */
+    inline uint32 bsrr(uint32 value) const __attribute__((always_inline)) {
+        // set has priority over reset in BSRR
+        if (_shift >= 0) {
+            return ((uint32)_mask << 16) | ((value << _shift) & _mask);
+        }
+        if (LUT) {
+            uint32 image = _lut.image(0, value & 0xFF);
+            if (WIDTH > 8) {
+                image |= _lut.image(1, (value >> 8) & 0xFF);
+            }
+            return image;
+        }
+        uint32 image = (uint32)_mask << 16;
+        for (uint8 i = 0; i < WIDTH; i++) {
+            if (value & (1U << i)) {
+                image |= 1UL << (_pins[i] % 16);
+            }
+        }
+        return image;
+    }
+
+    /** Set or reset a single line of the bus. */
+    inline void writeBit(uint8 bit, uint8 val) {
+        gpio_write_bit(_dev, _pins[bit] % 16, val);
+    }
+
+    /** Read the bus pins back into a value. */
+    uint32 read(void) const {
+        uint32 idr = _dev->regs->IDR;
+        if (_shift >= 0) {
+            return (idr & _mask) >> _shift;
+        }
+        uint32 value = 0;
+        for (uint8 i = 0; i < WIDTH; i++) {
+            value |= ((idr >> (_pins[i] % 16)) & 1) << i;
+        }
+        return value;
+    }
+
+    /** GPIO device of the bus, valid after begin(). */
+    const gpio_dev *device(void) const { return _dev; }
+
+    /** Port bits used by the bus, valid after begin(). */
+    uint16 mask(void) const { return _mask; }
+
+private:
+    /* For each byte of the value: set the pins of its 1 bits, reset the
+     * pins of its 0 bits. The images of the bytes are ORed together. */
+    void buildTables(void) {
+        for (uint8 b = 0; b < (WIDTH + 7) / 8; b++) {
+            for (uint16 v = 0; v < 256; v++) {
+                uint32 image = 0;
+                for (uint8 i = 0; i < 8 && 8 * b + i < WIDTH; i++) {
+                    uint32 bit = 1UL << (_pins[8 * b + i] % 16);
+                    image |= (v & (1U << i)) ? bit : (bit << 16);
+                }
+                _lut.set(b, v, image);
+            }
+        }
+    }
+
+    const gpio_dev *_dev;
+    uint8 _pins[WIDTH];
+    uint16 _mask;
+    int8 _shift;                /* bit of pins[0] if the pins are in order, else -1 */
+    PortBusLut<LUT ? (WIDTH + 7) / 8 : 0> _lut;
+};
+
+#endif
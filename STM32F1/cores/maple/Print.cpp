@@ -96,8 +96,8 @@ size_t Print::print(unsigned long n, int base) {
 
 size_t Print::print(long long n, int base) {
     if (n < 0) {
-        print('-');
-        n = -n;
+        // negate as unsigned, so that LLONG_MIN is printed correctly
+        return printNumber(0ULL - (unsigned long long)n, base, true);
     }
     return printNumber(n, base);
 }
@@ -122,9 +122,7 @@ size_t Print::print(const Printable& x)
 
 size_t Print::println(void) 
 {
-	size_t n =  print('\r');
-    n += print('\n');
-	return n;
+	return write("\r\n", 2);
 }
 
 size_t Print::println(const String &s)
@@ -231,26 +229,95 @@ FILE *__restrict __stream;
  * Private methods
  */
 
-size_t Print::printNumber(unsigned long long n, uint8 base) {
-    unsigned char buf[CHAR_BIT * sizeof(long long)];
-    unsigned long i = 0;
-	size_t s=0;
-    if (n == 0) {
-        print('0');
-        return 1;
+/*
+ * Number formatting helpers. They fill a buffer backwards, starting at
+ * its end, and return a pointer to the first character written.
+ */
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// Division by the constant 10 compiles to a multiply-high on Cortex-M3,
+// so this loop does not use the (slow) hardware or library divide.
+static char * format_dec32(char *str, uint32 n) {
+    do {
+        uint32 q = n / 10;
+        *--str = '0' + (char)(n - q * 10);
+        n = q;
+    } while (n);
+    return str;
+}
+
+// Formats exactly 'width' decimal digits, with leading zeros.
+static char * format_dec32_fixed(char *str, uint32 n, uint8 width) {
+    while (width--) {
+        uint32 q = n / 10;
+        *--str = '0' + (char)(n - q * 10);
+        n = q;
     }
+    return str;
+}
 
-    while (n > 0) {
-        buf[i++] = n % base;
-        n /= base;
+static char * format_dec64(char *str, unsigned long long n) {
+    // one 64 bit division per 9 digits, the rest is done in 32 bits
+    while (n > 0xFFFFFFFFULL) {
+        unsigned long long q = n / 1000000000ULL;
+        str = format_dec32_fixed(str, (uint32)(n - q * 1000000000ULL), 9);
+        n = q;
     }
+    return format_dec32(str, (uint32)n);
+}
 
-    for (; i > 0; i--) {
-        s += print((char)(buf[i - 1] < 10 ?
-                     '0' + buf[i - 1] :
-                     'A' + buf[i - 1] - 10));
+static char * format_pow2(char *str, unsigned long long n, uint8 shift) {
+    uint32 mask = (1UL << shift) - 1;
+    uint32 lo = (uint32)n;
+    uint32 hi = (uint32)(n >> 32);
+    // shift in 32 bit halves while the upper part is not empty
+    while (hi) {
+        *--str = hex_digits[lo & mask];
+        lo = (lo >> shift) | (hi << (32 - shift));
+        hi >>= shift;
     }
-	return s;
+    do {
+        *--str = hex_digits[lo & mask];
+        lo >>= shift;
+    } while (lo);
+    return str;
+}
+
+size_t Print::printNumber(unsigned long long n, uint8 base, bool negative) {
+    char buf[CHAR_BIT * sizeof(long long) + 1]; // base 2 digits and sign
+    char *end = &buf[sizeof(buf)];
+    char *str;
+
+    switch (base) {
+    case 10:
+        str = format_dec64(end, n);
+        break;
+    case 16:
+        str = format_pow2(end, n, 4);
+        break;
+    case 8:
+        str = format_pow2(end, n, 3);
+        break;
+    case 2:
+        str = format_pow2(end, n, 1);
+        break;
+    default:
+        if (base < 2) {
+            base = 10;
+        }
+        str = end;
+        do {
+            uint8 d = n % base;
+            *--str = (d < 10) ? ('0' + d) : ('A' + d - 10);
+            n /= base;
+        } while (n > 0);
+        break;
+    }
+    if (negative) {
+        *--str = '-';
+    }
+    return write(str, end - str);
 }
 
 
@@ -258,9 +325,15 @@ size_t Print::printNumber(unsigned long long n, uint8 base) {
  *
  * nextafter((double)numeric_limits<long long>::max(), 0.0) ~= 9.22337e+18
  *
- * This slightly smaller value was picked semi-arbitrarily. */
+ * Integer parts at or above this value are scaled down by powers of ten
+ * and printed with trailing zeros. */
 #define LARGE_DOUBLE_TRESHOLD (9.1e18)
 
+static const uint32 pow10_table[] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL,
+    1000000UL, 10000000UL, 100000000UL, 1000000000UL,
+};
+
 /* THIS FUNCTION SHOULDN'T BE USED IF YOU NEED ACCURATE RESULTS.
  *
  * This implementation is meant to be simple and not occupy too much
@@ -272,47 +345,87 @@ size_t Print::printNumber(unsigned long long n, uint8 base) {
  * http://kurtstephens.com/files/p372-steele.pdf
  */
 size_t Print::printFloat(double number, uint8 digits) {
-size_t s=0;
-    // Hackish fail-fast behavior for large-magnitude doubles
-    if (abs(number) >= LARGE_DOUBLE_TRESHOLD) {
-        if (number < 0.0) {
-            s=print('-');
-        }
-        s+=print("<large double>");
-        return s;
+    // sign, integer part, decimal point and the first 9 decimals
+    char buf[1 + 20 + 1 + 9];
+    char *end = &buf[sizeof(buf)];
+    char *str;
+    size_t s = 0;
+
+    if (number != number) {
+        return write("nan", 3);
     }
-
-    // Handle negative numbers
-    if (number < 0.0) {
-        s+=print('-');
+    bool negative = (number < 0.0);
+    if (negative) {
         number = -number;
     }
+    if (number > 1.79769313486231570e+308) {
+        return negative ? write("-inf", 4) : write("inf", 3);
+    }
+
+    // Large values: scale the integer part down, append the zeros later
+    uint16 zeros = 0;
+    while (number >= LARGE_DOUBLE_TRESHOLD) {
+        number /= 10.0;
+        zeros++;
+    }
+    uint8 frac_digits = (digits > 9) ? 9 : digits;
 
     // Simplistic rounding strategy so that e.g. print(1.999, 2)
     // prints as "2.00"
-    double rounding = 0.5;
-    for (uint8 i = 0; i < digits; i++) {
-        rounding /= 10.0;
+    if (zeros == 0) {
+        double rounding = 0.5;
+        for (uint8 i = 0; i < digits; i++) {
+            rounding /= 10.0;
+        }
+        number += rounding;
     }
-    number += rounding;
 
-    // Extract the integer part of the number and print it
-    long long int_part = (long long)number;
-    double remainder = number - int_part;
-    s+=print(int_part);
+    // Extract the integer part and the first (up to 9) decimals
+    unsigned long long int_part = (unsigned long long)number;
+    double remainder = number - (double)int_part;
+    if (zeros) {
+        remainder = 0.0;
+    }
+    remainder *= pow10_table[frac_digits];
+    uint32 frac = (uint32)remainder;
+    remainder -= frac;
 
-    // Print the decimal point, but only if there are digits beyond
-    if (digits > 0) {
-        s+=print(".");
+    str = end;
+    if (frac_digits > 0) {
+        str = format_dec32_fixed(str, frac, frac_digits);
+    }
+    if (zeros == 0 && digits > 0) {
+        *--str = '.';
+    }
+    str = format_dec64(str, int_part);
+    if (negative) {
+        *--str = '-';
     }
 
-    // Extract digits from the remainder one at a time
-    while (digits-- > 0) {
+    if (zeros == 0) {
+        s += write(str, end - str);
+    } else {
+        // integer digits, trailing zeros, then the (zero) decimals
+        s += write(str, end - str - frac_digits);
+        static const char zero_run[] = "0000000000000000";
+        while (zeros) {
+            uint16 n = (zeros > 16) ? 16 : zeros;
+            s += write(zero_run, n);
+            zeros -= n;
+        }
+        if (digits > 0) {
+            s += write(".", 1);
+            s += write(end - frac_digits, frac_digits);
+        }
+    }
+
+    // More than 9 decimals: extract the rest one at a time
+    for (digits -= frac_digits; digits > 0; digits--) {
         remainder *= 10.0;
         int to_print = (int)remainder;
-        s+=print(to_print);
+        char c = '0' + to_print;
+        s += write(&c, 1);
         remainder -= to_print;
     }
-	return s;
+    return s;
 }
-
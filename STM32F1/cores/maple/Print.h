@@ -81,7 +81,7 @@ public:
 
 private:
 	int write_error;
-    size_t printNumber(unsigned long long, uint8);
+    size_t printNumber(unsigned long long, uint8, bool negative = false);
     size_t printFloat(double, uint8);
 };
 
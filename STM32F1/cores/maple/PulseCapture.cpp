@@ -0,0 +1,297 @@
+/**
+ * @file PulseCapture.cpp
+ * @brief Pulse width and period measurement with timer input capture.
+ */
+
+#include "PulseCapture.h"
+#include "wiring_pulse.h"
+#include "wirish_time.h"
+#include "boards.h"
+
+#define CAPTURE_TIMER_HZ        (CYCLES_PER_MICROSECOND * 1000000UL)
+
+/*
+ * DMA request that fires on the capture of the start edge. TIM3 CH2
+ * has no capture DMA request; the update event of the slave mode
+ * counter reset is used instead.
+ */
+static int capture_req_src(timer_dev *dev, uint8 channel, dma_request_src *src)
+{
+    switch (dev->clk_id) {
+    case RCC_TIMER1:
+        *src = channel == 1 ? DMA_REQ_SRC_TIM1_CH1 : DMA_REQ_SRC_TIM1_CH2;
+        return 1;
+    case RCC_TIMER2:
+        *src = channel == 1 ? DMA_REQ_SRC_TIM2_CH1 : DMA_REQ_SRC_TIM2_CH2;
+        return 1;
+    case RCC_TIMER3:
+        *src = channel == 1 ? DMA_REQ_SRC_TIM3_CH1 : DMA_REQ_SRC_TIM3_UP;
+        return 1;
+    case RCC_TIMER4:
+        *src = channel == 1 ? DMA_REQ_SRC_TIM4_CH1 : DMA_REQ_SRC_TIM4_CH2;
+        return 1;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    case RCC_TIMER5:
+        *src = channel == 1 ? DMA_REQ_SRC_TIM5_CH1 : DMA_REQ_SRC_TIM5_CH2;
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+/*
+ * PWM input mode: the pin's channel captures the start edge and resets
+ * the counter, the other channel of the pair captures the end edge
+ * from the same input.
+ */
+static void capture_setup(timer_dev *dev, uint8 channel, uint16 prescaler, uint8 state)
+{
+    timer_gen_reg_map *regs = dev->regs.gen;
+    uint8 other = channel == 1 ? 2 : 1;
+
+    timer_pause(dev);
+    regs->CCER &= ~(TIMER_CCER_CC1E | TIMER_CCER_CC2E);
+    if (channel == 1) {
+        regs->CCMR1 = TIMER_CCMR1_CC1S_INPUT_TI1 | TIMER_CCMR1_CC2S_INPUT_TI1;
+        regs->SMCR = TIMER_SMCR_TS_TI1FP1 | TIMER_SMCR_SMS_RESET;
+    } else {
+        regs->CCMR1 = TIMER_CCMR1_CC1S_INPUT_TI2 | TIMER_CCMR1_CC2S_INPUT_TI2;
+        regs->SMCR = TIMER_SMCR_TS_TI2FP2 | TIMER_SMCR_SMS_RESET;
+    }
+    timer_cc_set_pol(dev, channel, state ? 0 : 1);
+    timer_cc_set_pol(dev, other, state ? 1 : 0);
+    regs->CCER |= TIMER_CCER_CC1E | TIMER_CCER_CC2E;
+
+    timer_set_prescaler(dev, prescaler);
+    timer_set_reload(dev, 0xFFFF);
+    timer_generate_update(dev);
+    regs->SR = 0;
+}
+
+PulseCapture::PulseCapture(uint8 pin)
+{
+    _pin = pin;
+    _timer = NULL;
+    _ring = NULL;
+    _samples = 0;
+}
+
+bool PulseCapture::begin(uint32 tickHz, uint16 *ring, uint16 samples, uint8 state)
+{
+    if (_pin >= BOARD_NR_GPIO_PINS || !tickHz || !samples) {
+        return false;
+    }
+    timer_dev *dev = PinTimerDevice(_pin);
+    uint8 channel = PinTimerChannel(_pin);
+    dma_request_src src;
+    if (!dev || channel < 1 || channel > 2 || !capture_req_src(dev, channel, &src)) {
+        return false;
+    }
+
+    end();
+    _timer = dev;
+    _channel = channel;
+    _ring = ring;
+    _samples = samples;
+    _tail = 0;
+    _skip = true;
+
+    uint32 div = (CAPTURE_TIMER_HZ + tickHz / 2) / tickHz;
+    if (div < 1) {
+        div = 1;
+    } else if (div > 0x10000) {
+        div = 0x10000;
+    }
+    _tickHz = CAPTURE_TIMER_HZ / div;
+
+    pinMode(_pin, INPUT);
+    capture_setup(dev, channel, div - 1, state);
+
+    /* Burst of CCR1, CCR2 through DMAR on every start edge */
+    timer_gen_reg_map *regs = dev->regs.gen;
+    regs->DCR = TIMER_DCR_DBL_2_XFER | TIMER_DCR_DBA_CCR1;
+
+    _dma = DMA1;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if ((rcc_clk_id)(src >> 3) == RCC_DMA2) {
+        _dma = DMA2;
+    }
+#endif
+    _tube = (dma_tube)(src & 0x7);
+
+    dma_tube_config cfg;
+    cfg.tube_src = &regs->DMAR;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = ring;
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = 2 * samples;
+    cfg.tube_flags = DMA_CFG_DST_INC | DMA_CFG_CIRC;
+    cfg.tube_req_src = src;
+    dma_init(_dma);
+    if (dma_tube_cfg(_dma, _tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        _timer = NULL;
+        return false;
+    }
+    dma_enable(_dma, _tube);
+
+    if (dev->clk_id == RCC_TIMER3 && channel == 2) {
+        regs->DIER = TIMER_DIER_UDE;
+    } else {
+        regs->DIER = channel == 1 ? TIMER_DIER_CC1DE : TIMER_DIER_CC2DE;
+    }
+    timer_resume(dev);
+    return true;
+}
+
+void PulseCapture::end(void)
+{
+    if (!_timer) {
+        return;
+    }
+    timer_pause(_timer);
+    _timer->regs.gen->DIER = 0;
+    _timer->regs.gen->SMCR = 0;
+    dma_disable(_dma, _tube);
+    _timer = NULL;
+}
+
+/* Number of complete samples the DMA has written, modulo _samples */
+uint16 PulseCapture::head(void)
+{
+    uint16 written = 2 * _samples - dma_get_count(_dma, _tube);
+    return (written / 2) % _samples;
+}
+
+/* The timer burst is CCR1, CCR2; which one is the width depends on the
+ * channel of the pin. */
+void PulseCapture::get(uint16 index, Sample &sample)
+{
+    uint16 ccr1 = _ring[2 * index];
+    uint16 ccr2 = _ring[2 * index + 1];
+    if (_channel == 1) {
+        sample.period = ccr1;
+        sample.width = ccr2;
+    } else {
+        sample.period = ccr2;
+        sample.width = ccr1;
+    }
+}
+
+uint16 PulseCapture::available(void)
+{
+    if (!_timer) {
+        return 0;
+    }
+    uint16 n = (head() + _samples - _tail) % _samples;
+    if (_skip && n) {
+        n--;
+    }
+    return n;
+}
+
+bool PulseCapture::read(Sample &sample)
+{
+    if (!_timer) {
+        return false;
+    }
+    if (_skip) {
+        if (head() == _tail) {
+            return false;
+        }
+        _tail = (_tail + 1) % _samples;
+        _skip = false;
+    }
+    if (head() == _tail) {
+        return false;
+    }
+    get(_tail, sample);
+    _tail = (_tail + 1) % _samples;
+    return true;
+}
+
+bool PulseCapture::last(Sample &sample)
+{
+    if (!available()) {
+        return false;
+    }
+    get((head() + _samples - 1) % _samples, sample);
+    return true;
+}
+
+void PulseCapture::flush(void)
+{
+    if (_timer) {
+        _tail = head();
+    }
+}
+
+/*
+ * Blocking pulseIn() on the capture hardware, 1 us resolution; the
+ * counter overflows are counted, so pulses up to the timeout work.
+ */
+uint32_t pulseInCapture(uint32_t pin, uint32_t state, uint32_t timeout)
+{
+    if (pin >= BOARD_NR_GPIO_PINS) {
+        return 0;
+    }
+    timer_dev *dev = PinTimerDevice(pin);
+    uint8 channel = PinTimerChannel(pin);
+    if (!dev || channel < 1 || channel > 2) {
+        return pulseIn(pin, state, timeout);
+    }
+
+    timer_gen_reg_map *regs = dev->regs.gen;
+    uint32 start_if = channel == 1 ? TIMER_SR_CC1IF : TIMER_SR_CC2IF;
+    uint32 end_if = channel == 1 ? TIMER_SR_CC2IF : TIMER_SR_CC1IF;
+    __IO uint32 *end_ccr = channel == 1 ? &regs->CCR2 : &regs->CCR1;
+
+    pinMode(pin, INPUT);
+    capture_setup(dev, channel, CYCLES_PER_MICROSECOND - 1, state);
+    regs->DIER = 0;
+    regs->CR1 |= TIMER_CR1_URS;     // counter resets don't set UIF
+    timer_resume(dev);
+
+    uint32 result = 0;
+    uint32 begin = micros();
+    uint32 overflows = 0;
+    bool started = false;
+
+    // a start edge that is already in progress is skipped, like pulseIn()
+    while ((gpio_read_pin(pin) != 0) == (state != 0)) {
+        if (micros() - begin >= timeout) {
+            goto done;
+        }
+    }
+    regs->SR = 0;
+
+    while (micros() - begin < timeout) {
+        uint32 sr = regs->SR;
+        if (!started) {
+            if (sr & start_if) {
+                regs->SR = ~(start_if | end_if | TIMER_SR_UIF);
+                started = true;
+            }
+            continue;
+        }
+        if (sr & end_if) {
+            uint32 width = *end_ccr;
+            // an overflow just before the capture is not counted yet
+            if ((regs->SR & TIMER_SR_UIF) && width < 0x8000) {
+                overflows++;
+            }
+            result = (overflows << 16) + width;
+            break;
+        }
+        if (sr & TIMER_SR_UIF) {
+            regs->SR = ~TIMER_SR_UIF;
+            overflows++;
+        }
+    }
+
+done:
+    timer_pause(dev);
+    regs->SMCR = 0;
+    regs->CR1 &= ~TIMER_CR1_URS;
+    return result;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file PulseCapture.h
+ * @brief Pulse width and period measurement with timer input capture.
+ *
+ * The timer of the pin runs in PWM input mode: the start edge of a
+ * pulse resets the counter and captures the period of the previous
+ * cycle, the end edge captures the pulse width. A DMA burst copies
+ * both capture registers into a ring buffer on every start edge, so
+ * pulse trains (RC receivers, echo sensors, tachometers) are measured
+ * at timer clock resolution without any CPU time per pulse.
+ *
+ * Only pins on channel 1 or 2 of timers 1 to 4 (5 on high density
+ * devices) can be used, and the other channel of the pair is taken.
+ * The whole timer is reconfigured, PWM on its other pins stops.
+ * Widths and periods must be shorter than 65536 timer ticks.
+ *
+ * Example:
+ *
+ *     PulseCapture rc(PA0);
+ *     uint16 ring[2 * 8];
+ *     rc.begin(1000000, ring, 8);          // 1 us ticks
+ *     ...
+ *     PulseCapture::Sample s;
+ *     while (rc.read(s)) {
+ *         // s.width, s.period in us
+ *     }
+ */
+
+#ifndef _WIRISH_PULSECAPTURE_H_
+#define _WIRISH_PULSECAPTURE_H_
+
+#include <libmaple/timer.h>
+#include <libmaple/dma.h>
+#include "io.h"
+
+class PulseCapture {
+public:
+    struct Sample {
+        uint16 width;           /**< Pulse length, in ticks */
+        uint16 period;          /**< Start edge to start edge, in ticks */
+    };
+
+    PulseCapture(uint8 pin);
+
+    /**
+     * Start capturing.
+     * @param tickHz Timer tick rate, e.g. 1000000 for 1 us resolution.
+     *               Rounded to a divider of the timer clock.
+     * @param ring Buffer of 2 * samples halfwords, filled by DMA.
+     * @param samples Number of samples the ring holds.
+     * @param state HIGH to measure high pulses, LOW for low pulses.
+     * @return false if the pin has no usable capture channel.
+     */
+    bool begin(uint32 tickHz, uint16 *ring, uint16 samples, uint8 state = HIGH);
+    void end(void);
+
+    /** Number of samples captured and not read yet. */
+    uint16 available(void);
+
+    /** Get the oldest unread sample. Returns false if there is none. */
+    bool read(Sample &sample);
+
+    /** Get the newest sample, without consuming it. */
+    bool last(Sample &sample);
+
+    /** Drop all unread samples. */
+    void flush(void);
+
+    /** Actual tick rate, in Hz. */
+    uint32 tickHz(void) const { return _tickHz; }
+
+    /** Convert ticks to microseconds. */
+    uint32 toMicros(uint32 ticks) const {
+        return (uint32)(((uint64)ticks * 1000000UL) / _tickHz);
+    }
+
+private:
+    uint16 head(void);
+    void get(uint16 index, Sample &sample);
+
+    uint8 _pin;
+    timer_dev *_timer;
+    uint8 _channel;             /* channel of the pin, resets the counter */
+    dma_dev *_dma;
+    dma_tube _tube;
+    uint32 _tickHz;
+    uint16 *_ring;
+    uint16 _samples;
+    uint16 _tail;
+    bool _skip;                 /* the first burst holds no valid width */
+};
+
+#endif
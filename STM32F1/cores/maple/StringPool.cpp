@@ -0,0 +1,68 @@
+/**
+ * @file StringPool.cpp
+ * @brief Fixed block allocator for String buffers.
+ */
+
+#include "StringPool.h"
+#include <stdlib.h>
+
+StringPool *StringPool::active = NULL;
+
+StringPool::StringPool(void *mem, size_t size, size_t blockSize)
+{
+    _blockSize = (blockSize + 3) & ~(size_t)3;
+    if (_blockSize < sizeof(void *)) {
+        _blockSize = sizeof(void *);
+    }
+    _mem = (char *)mem;
+    _blocks = size / _blockSize;
+    _used = _peak = _fallbacks = 0;
+
+    _free = NULL;
+    for (size_t i = _blocks; i > 0; i--) {
+        void **block = (void **)(_mem + (i - 1) * _blockSize);
+        *block = _free;
+        _free = block;
+    }
+}
+
+void StringPool::install(void)
+{
+    active = this;
+    String::setAllocator(allocActive, releaseActive);
+}
+
+void *StringPool::alloc(size_t size)
+{
+    if (size <= _blockSize && _free) {
+        void **block = (void **)_free;
+        _free = *block;
+        if (++_used > _peak) {
+            _peak = _used;
+        }
+        return block;
+    }
+    _fallbacks++;
+    return malloc(size);
+}
+
+void StringPool::release(void *ptr)
+{
+    if (owns(ptr)) {
+        *(void **)ptr = _free;
+        _free = ptr;
+        _used--;
+    } else {
+        free(ptr);
+    }
+}
+
+void *StringPool::allocActive(size_t size)
+{
+    return active->alloc(size);
+}
+
+void StringPool::releaseActive(void *ptr)
+{
+    active->release(ptr);
+}
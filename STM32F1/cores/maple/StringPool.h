@@ -0,0 +1,73 @@
+/**
+ * @file StringPool.h
+ * @brief Fixed block allocator for String buffers.
+ *
+ * Long running programs that build Strings (e.g. HTTP handlers)
+ * fragment the heap, as buffers of many sizes are allocated and freed.
+ * A StringPool hands out blocks of one size from a static array; a
+ * block is reused as soon as its String is gone, and the heap is left
+ * alone. Requests larger than the block size, or made while all blocks
+ * are in use, fall back to malloc() and are counted in fallbacks().
+ *
+ * With STRING_SSO_SIZE set, strings that fit the inline storage never
+ * allocate.
+ *
+ * Example:
+ *
+ *     static uint32 pool_mem[32 * 64 / 4];
+ *     StringPool pool(pool_mem, sizeof(pool_mem), 64);
+ *
+ *     void setup() {
+ *         pool.install();    // before any String owns a buffer
+ *     }
+ */
+
+#ifndef _WIRISH_STRINGPOOL_H_
+#define _WIRISH_STRINGPOOL_H_
+
+#include <stddef.h>
+#include "WString.h"
+
+class StringPool {
+public:
+    /**
+     * @param mem Memory for the blocks, 4 byte aligned
+     * @param size Size of mem in bytes
+     * @param blockSize Size of each block in bytes, rounded up to 4
+     */
+    StringPool(void *mem, size_t size, size_t blockSize);
+
+    /** Make this pool the allocator of all Strings. */
+    void install(void);
+
+    void *alloc(size_t size);
+    void release(void *ptr);
+
+    /** Whether ptr is a block of this pool. */
+    bool owns(const void *ptr) const {
+        return (const char *)ptr >= _mem && (const char *)ptr < _mem + _blocks * _blockSize;
+    }
+
+    size_t blockSize(void) const { return _blockSize; }
+    size_t blocks(void) const { return _blocks; }
+    /** Blocks currently in use, and the most ever in use. */
+    size_t used(void) const { return _used; }
+    size_t peak(void) const { return _peak; }
+    /** Number of allocations that went to the heap. */
+    size_t fallbacks(void) const { return _fallbacks; }
+
+private:
+    static void *allocActive(size_t size);
+    static void releaseActive(void *ptr);
+    static StringPool *active;
+
+    char *_mem;
+    void *_free;                /* free list, linked through the blocks */
+    size_t _blockSize;
+    size_t _blocks;
+    size_t _used;
+    size_t _peak;
+    size_t _fallbacks;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * @file TimerWaveform.cpp
+ * @brief DMA fed compare values on a timer, for waveforms and patterns.
+ */
+
+#include "TimerWaveform.h"
+#include "boards.h"
+
+#define WAVEFORM_TIMER_HZ       (CYCLES_PER_MICROSECOND * 1000000UL)
+
+TimerWaveform *TimerWaveform::_active[5];
+
+/* Update event DMA request of each timer */
+static const dma_request_src upd_req_src[5] = {
+    DMA_REQ_SRC_TIM1_UP,
+    DMA_REQ_SRC_TIM2_UP,
+    DMA_REQ_SRC_TIM3_UP,
+    DMA_REQ_SRC_TIM4_UP,
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    DMA_REQ_SRC_TIM5_UP,
+#endif
+};
+
+const voidFuncPtr TimerWaveform::_irqs[5] = {
+    TimerWaveform::irq<0>,
+    TimerWaveform::irq<1>,
+    TimerWaveform::irq<2>,
+    TimerWaveform::irq<3>,
+    TimerWaveform::irq<4>,
+};
+
+TimerWaveform::TimerWaveform(uint8 timerNum)
+{
+    switch (timerNum) {
+    case 1: _dev = TIMER1; break;
+    case 2: _dev = TIMER2; break;
+    case 3: _dev = TIMER3; break;
+    case 4: _dev = TIMER4; break;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    case 5: _dev = TIMER5; break;
+#endif
+    default: _dev = NULL; break;
+    }
+    _index = timerNum - 1;
+    _stepSize = 0;
+    _buf = NULL;
+    _busy = false;
+    _done = NULL;
+    _refill = NULL;
+}
+
+bool TimerWaveform::begin(uint32 tickHz, uint16 period, uint8 firstChannel,
+                          uint8 channels, bool withPeriod)
+{
+    if (!_dev || !tickHz || period < 2 || firstChannel < 1 || channels < 1 ||
+        firstChannel + channels > 5 || (withPeriod && firstChannel != 1)) {
+        return false;
+    }
+    end();
+
+    uint32 div = (WAVEFORM_TIMER_HZ + tickHz / 2) / tickHz;
+    if (div < 1) {
+        div = 1;
+    } else if (div > 0x10000) {
+        div = 0x10000;
+    }
+    _tickHz = WAVEFORM_TIMER_HZ / div;
+    _firstChannel = firstChannel;
+    _channels = channels;
+    _stepSize = channels + (withPeriod ? 2 : 0);
+    _dbaBase = withPeriod ? TIMER_DCR_DBA_ARR : TIMER_DCR_DBA_CCR1 + firstChannel - 1;
+
+    timer_gen_reg_map *regs = _dev->regs.gen;
+    timer_pause(_dev);
+    timer_set_prescaler(_dev, div - 1);
+    timer_set_reload(_dev, period - 1);
+    regs->CR1 |= TIMER_CR1_ARPE;
+    for (uint8 ch = firstChannel; ch < firstChannel + channels; ch++) {
+        timer_set_compare(_dev, ch, 0);
+        timer_set_mode(_dev, ch, TIMER_PWM);
+    }
+    if (_dev->type == TIMER_ADVANCED) {
+        _dev->regs.adv->BDTR |= TIMER_BDTR_MOE;
+    }
+    /* One burst of a whole step through DMAR per update */
+    regs->DCR = ((_stepSize - 1) << 8) | _dbaBase;
+    timer_generate_update(_dev);
+    timer_resume(_dev);
+
+    _src = upd_req_src[_index];
+    _dma = DMA1;
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if ((rcc_clk_id)(_src >> 3) == RCC_DMA2) {
+        _dma = DMA2;
+    }
+#endif
+    _tube = (dma_tube)(_src & 0x7);
+    dma_init(_dma);
+    _active[_index] = this;
+    return true;
+}
+
+void TimerWaveform::end(void)
+{
+    if (!_stepSize) {
+        return;
+    }
+    stop();
+    timer_pause(_dev);
+    _dev->regs.gen->DCR = 0;
+    _stepSize = 0;
+    _active[_index] = NULL;
+}
+
+bool TimerWaveform::start(const uint16 *buf, uint16 steps, uint32 flags)
+{
+    if (!_stepSize || !buf || !steps || (uint32)steps * _stepSize > 0xFFFF) {
+        return false;
+    }
+    stop();
+
+    timer_gen_reg_map *regs = _dev->regs.gen;
+    dma_tube_config cfg;
+    cfg.tube_src = buf;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = &regs->DMAR;
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = steps * _stepSize;
+    cfg.tube_flags = DMA_CFG_SRC_INC | flags;
+    cfg.tube_req_src = _src;
+    if (dma_tube_cfg(_dma, _tube, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        return false;
+    }
+    if (flags & (DMA_CFG_CMPLT_IE | DMA_CFG_HALF_CMPLT_IE)) {
+        dma_attach_interrupt(_dma, _tube, _irqs[_index]);
+    }
+    _buf = (uint16 *)buf;
+    _steps = steps;
+    _busy = true;
+    dma_enable(_dma, _tube);
+    regs->DIER |= TIMER_DIER_UDE;
+    return true;
+}
+
+bool TimerWaveform::play(const uint16 *buf, uint16 steps, bool loop, voidFuncPtr done)
+{
+    _loop = loop;
+    _done = done;
+    _refill = NULL;
+    return start(buf, steps, loop ? DMA_CFG_CIRC : DMA_CFG_CMPLT_IE);
+}
+
+bool TimerWaveform::stream(uint16 *buf, uint16 steps, RefillFn refill)
+{
+    if (steps & 1) {
+        return false;
+    }
+    _loop = true;
+    _done = NULL;
+    _refill = refill;
+    return start(buf, steps, DMA_CFG_CIRC | DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE);
+}
+
+void TimerWaveform::stop(void)
+{
+    if (!_stepSize) {
+        return;
+    }
+    _dev->regs.gen->DIER &= ~TIMER_DIER_UDE;
+    if (_buf) {
+        dma_disable(_dma, _tube);
+        dma_detach_interrupt(_dma, _tube);
+        _buf = NULL;
+    }
+    for (uint8 ch = _firstChannel; ch < _firstChannel + _channels; ch++) {
+        timer_set_compare(_dev, ch, 0);
+    }
+    _busy = false;
+}
+
+void TimerWaveform::dmaEvent(void)
+{
+    dma_irq_cause cause = dma_get_irq_cause(_dma, _tube);
+    if (_refill) {
+        uint16 half = _steps / 2;
+        if (cause == DMA_TRANSFER_HALF_COMPLETE) {
+            _refill(_buf, half);
+        } else if (cause == DMA_TRANSFER_COMPLETE) {
+            _refill(_buf + half * _stepSize, half);
+        }
+        return;
+    }
+    if (cause == DMA_TRANSFER_COMPLETE && !_loop) {
+        /* the last step is loaded, it stays on the outputs */
+        _dev->regs.gen->DIER &= ~TIMER_DIER_UDE;
+        _busy = false;
+        if (_done) {
+            _done();
+        }
+    }
+}
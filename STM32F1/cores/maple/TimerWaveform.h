@@ -0,0 +1,121 @@
+/**
+ * @file TimerWaveform.h
+ * @brief DMA fed compare values on a timer, for waveforms and patterns.
+ *
+ * On every update event of the timer a DMA burst through DMAR writes
+ * the next step of a buffer into the compare registers of one or more
+ * consecutive channels, optionally with the period (ARR) of the step.
+ * The CPU is not involved per step, which is what bit banged protocols
+ * like WS2812 and DShot, PWM envelopes and stepper ramps need.
+ *
+ * The compare registers are preloaded: the values written at an update
+ * are output during the period after it. The last step stays on the
+ * outputs after a single shot, so a pattern should end with its idle
+ * value (e.g. 0 for WS2812 reset).
+ *
+ * Timers 1 to 5. The channel pins must be set to PWM with pinMode().
+ *
+ * Example, WS2812 bits at 800 kHz on PA8 (TIM1 CH1):
+ *
+ *     TimerWaveform ws(1);
+ *     uint16 bits[24 * NLEDS + 1];        // 58 or 29 ticks per bit, last 0
+ *     pinMode(PA8, PWM);
+ *     ws.begin(72000000, 90, 1);
+ *     ws.play(bits, 24 * NLEDS + 1);
+ */
+
+#ifndef _WIRISH_TIMERWAVEFORM_H_
+#define _WIRISH_TIMERWAVEFORM_H_
+
+#include <libmaple/timer.h>
+#include <libmaple/dma.h>
+
+class TimerWaveform {
+public:
+    /**
+     * Called with the half of a stream buffer that was just sent, to
+     * be filled with the next steps.
+     */
+    typedef void (*RefillFn)(uint16 *steps, uint16 count);
+
+    /**
+     * @param timerNum Timer to use, 1 to 5.
+     */
+    TimerWaveform(uint8 timerNum);
+
+    /**
+     * Configure the timer.
+     * @param tickHz Counter rate, rounded to a divider of the timer clock.
+     * @param period Ticks per step (ARR + 1).
+     * @param firstChannel First channel written per step, 1 to 4.
+     * @param channels Number of consecutive channels written per step.
+     * @param withPeriod Each step starts with its own period, e.g. for
+     *        stepper ramps; needs firstChannel 1. A step is then
+     *        {ticks - 1, 0, compare values...}: ARR, the repetition
+     *        counter (must be 0), then the channels.
+     * @return false if the timer or channels can't be used.
+     */
+    bool begin(uint32 tickHz, uint16 period, uint8 firstChannel,
+               uint8 channels = 1, bool withPeriod = false);
+
+    /** Stop any output and release the DMA channel. */
+    void end(void);
+
+    /**
+     * Send steps once, or repeat them forever with loop.
+     * @param buf Steps, each of stepSize() halfwords; must stay valid
+     *        while playing.
+     * @param steps Number of steps.
+     * @param done Called from the DMA interrupt after the last step of
+     *        a single shot was loaded, may be NULL.
+     */
+    bool play(const uint16 *buf, uint16 steps, bool loop = false,
+              voidFuncPtr done = NULL);
+
+    /**
+     * Send a continuous stream, double buffered: while one half of buf
+     * is sent, refill() fills the other one.
+     * @param buf Steps, filled before the call.
+     * @param steps Number of steps in buf, even.
+     */
+    bool stream(uint16 *buf, uint16 steps, RefillFn refill);
+
+    /** Stop sending; the channels go to compare value 0. */
+    void stop(void);
+
+    /** True until a single shot has loaded its last step. */
+    bool busy(void) const { return _busy; }
+
+    /** Halfwords per step. */
+    uint8 stepSize(void) const { return _stepSize; }
+
+    /** Actual counter rate, in Hz. */
+    uint32 tickHz(void) const { return _tickHz; }
+
+private:
+    bool start(const uint16 *buf, uint16 steps, uint32 flags);
+    void dmaEvent(void);
+    template<uint8 N> static void irq(void) { _active[N]->dmaEvent(); }
+
+    static TimerWaveform *_active[5];
+    static const voidFuncPtr _irqs[5];
+
+    timer_dev *_dev;
+    uint8 _index;
+    dma_dev *_dma;
+    dma_tube _tube;
+    dma_request_src _src;
+    uint8 _firstChannel;
+    uint8 _channels;
+    uint8 _stepSize;
+    uint8 _dbaBase;
+    uint32 _tickHz;
+    uint16 *_buf;
+    uint16 _steps;
+    bool _loop;
+    volatile bool _busy;
+    voidFuncPtr _done;
+    RefillFn _refill;
+};
+
+#endif
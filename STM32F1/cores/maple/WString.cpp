@@ -123,13 +123,22 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	releaseBuffer();
 }
 
 /*********************************************/
 /*  Memory Management                        */
 /*********************************************/
 
+String::AllocFn String::allocFn = NULL;
+String::FreeFn String::freeFn = NULL;
+
+void String::setAllocator(AllocFn alloc, FreeFn release)
+{
+	allocFn = alloc;
+	freeFn = release;
+}
+
 inline void String::init(void)
 {
 	buffer = NULL;
@@ -137,9 +146,17 @@ inline void String::init(void)
 	len = 0;
 }
 
+void String::releaseBuffer(void)
+{
+	if (buffer && !isInline()) {
+		if (freeFn) freeFn(buffer);
+		else free(buffer);
+	}
+}
+
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	releaseBuffer();
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -154,15 +171,33 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+// Never shrinks, and does not use realloc(): a pool or arena allocator
+// can not resize in place.  Heap buffers grow by at least half, so a
+// series of concat() calls needs O(log n) allocations.
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
-	if (newbuffer) {
-		buffer = newbuffer;
-		capacity = maxStrLen;
-		return 1;
+#if STRING_SSO_SIZE > 0
+	if (maxStrLen < STRING_SSO_SIZE) {
+		if (!buffer) {
+			buffer = sso;
+			capacity = STRING_SSO_SIZE - 1;
+			return 1;
+		}
+		if (maxStrLen <= capacity) return 1;
 	}
-	return 0;
+#endif
+	if (buffer && !isInline() && maxStrLen < capacity + capacity / 2) {
+		maxStrLen = capacity + capacity / 2;
+	}
+	char *newbuffer = (char *)(allocFn ? allocFn(maxStrLen + 1) : malloc(maxStrLen + 1));
+	if (!newbuffer) return 0;
+	if (buffer) {
+		memcpy(newbuffer, buffer, len + 1);
+		releaseBuffer();
+	}
+	buffer = newbuffer;
+	capacity = maxStrLen;
+	return 1;
 }
 
 /*********************************************/
@@ -194,16 +229,19 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
 #if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
 void String::move(String &rhs)
 {
-	if (buffer) {
-		if (rhs && capacity >= rhs.len) {
-			strcpy(buffer, rhs.buffer);
+	if (rhs.isInline() || (buffer && rhs && capacity >= rhs.len)) {
+		// short strings are copied, there is no buffer to take over
+		if (reserve(rhs.len)) {
+			memcpy(buffer, rhs.buffer, rhs.len + 1);
 			len = rhs.len;
-			rhs.len = 0;
-			return;
 		} else {
-			free(buffer);
+			invalidate();
 		}
+		rhs.len = 0;
+		if (rhs.buffer) rhs.buffer[0] = 0;
+		return;
 	}
+	releaseBuffer();
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
@@ -267,8 +305,16 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
-	strcpy(buffer + len, cstr);
+	if (buffer && cstr >= buffer && cstr <= buffer + len) {
+		// concatenating (a part of) itself, the buffer may move
+		unsigned int offset = cstr - buffer;
+		if (!reserve(newlen)) return 0;
+		cstr = buffer + offset;
+	} else if (!reserve(newlen)) {
+		return 0;
+	}
+	memcpy(buffer + len, cstr, length);
+	buffer[newlen] = 0;
 	len = newlen;
 	return 1;
 }
@@ -352,81 +398,81 @@ unsigned char String::concat(const __FlashStringHelper * str)
 /*  Concatenate                              */
 /*********************************************/
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs)
+StringSumRef operator + (const StringSumHelper &lhs, const String &rhs)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(rhs.buffer, rhs.len)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr)
+StringSumRef operator + (const StringSumHelper &lhs, const char *cstr)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!cstr || !a.concat(cstr, strlen(cstr))) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, char c)
+StringSumRef operator + (const StringSumHelper &lhs, char c)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(c)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num)
+StringSumRef operator + (const StringSumHelper &lhs, unsigned char num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, int num)
+StringSumRef operator + (const StringSumHelper &lhs, int num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num)
+StringSumRef operator + (const StringSumHelper &lhs, unsigned int num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, long num)
+StringSumRef operator + (const StringSumHelper &lhs, long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num)
+StringSumRef operator + (const StringSumHelper &lhs, unsigned long num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, float num)
+StringSumRef operator + (const StringSumHelper &lhs, float num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, double num)
+StringSumRef operator + (const StringSumHelper &lhs, double num)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(num)) a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
+StringSumRef operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
 	if (!a.concat(rhs))	a.invalidate();
-	return a;
+	return static_cast<StringSumRef>(a);
 }
 
 /*********************************************/
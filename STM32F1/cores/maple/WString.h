@@ -34,12 +34,27 @@
 //     -felide-constructors
 //     -std=c++0x
 
+// Size of the storage inside each String object, including the '\0'.
+// Off by default, as it adds this many bytes to every String.  Build
+// with e.g. -DSTRING_SSO_SIZE=16 so that strings up to 15 characters
+// do not use the heap.
+#ifndef STRING_SSO_SIZE
+#define STRING_SSO_SIZE 0
+#endif
+
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+// The result of + is an rvalue, so "String s = a + b;" takes over the
+// buffer of the temporary instead of copying it.
+typedef StringSumHelper && StringSumRef;
+#else
+typedef StringSumHelper & StringSumRef;
+#endif
 
 // The string class
 class String
@@ -80,6 +95,13 @@ public:
 	unsigned char reserve(unsigned int size);
 	inline unsigned int length(void) const {return len;}
 
+	// allocator for the buffers of strings that do not fit the inline
+	// storage, e.g. a StringPool or an arena.  Must be set before any
+	// String owns a buffer; NULL functions restore malloc()/free().
+	typedef void *(*AllocFn)(size_t size);
+	typedef void (*FreeFn)(void *ptr);
+	static void setAllocator(AllocFn alloc, FreeFn release);
+
 	// creates a copy of the assigned value.  if the value is null or
 	// invalid, or if the memory allocation fails, the string will be 
 	// marked as invalid ("if (s)" will be false).
@@ -122,17 +144,17 @@ public:
 	String & operator += (double num)		{concat(num); return (*this);}
 	String & operator += (const __FlashStringHelper *str){concat(str); return (*this);}
 
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, float num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, double num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs);
+	friend StringSumRef operator + (const StringSumHelper &lhs, const String &rhs);
+	friend StringSumRef operator + (const StringSumHelper &lhs, const char *cstr);
+	friend StringSumRef operator + (const StringSumHelper &lhs, char c);
+	friend StringSumRef operator + (const StringSumHelper &lhs, unsigned char num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, int num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, unsigned int num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, long num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, unsigned long num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, float num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, double num);
+	friend StringSumRef operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs);
 
 	// comparison (only works w/ Strings and "strings")
 	operator StringIfHelperType() const { return buffer ? &String::StringIfHelper : 0; }
@@ -195,9 +217,18 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+#if STRING_SSO_SIZE > 0
+	char sso[STRING_SSO_SIZE];	// inline storage for short strings
+	inline unsigned char isInline(void) const {return buffer == sso;}
+#else
+	inline unsigned char isInline(void) const {return 0;}
+#endif
+	static AllocFn allocFn;
+	static FreeFn freeFn;
 protected:
 	void init(void);
 	void invalidate(void);
+	void releaseBuffer(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
 	unsigned char concat(const char *cstr, unsigned int length);
 
@@ -213,6 +244,10 @@ class StringSumHelper : public String
 {
 public:
 	StringSumHelper(const String &s) : String(s) {}
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+	// a temporary String on the left of + is reused, not copied
+	StringSumHelper(String &&s) : String(static_cast<String &&>(s)) {}
+#endif
 	StringSumHelper(const char *p) : String(p) {}
 	StringSumHelper(char c) : String(c) {}
 	StringSumHelper(unsigned char num) : String(num) {}
@@ -137,13 +137,48 @@ uint32 digitalRead(uint8 pin);
  * conversion, and has 12 bits of resolution.  The pin must have its
  * mode set to INPUT_ANALOG.
  *
+ * While a background scan is installed with analogReadCache(), this
+ * returns the latest scanned value of the pin's channel instead, and
+ * does not block. Its resolution then depends on the oversampling of
+ * the scan.
+ *
  * @param pin Pin to read from.
  * @return Converted voltage, in the range 0--4095, (i.e. a 12-bit ADC
  *         conversion).
  * @see pinMode()
+ * @see analogReadCache()
  */
 uint16 analogRead(uint8 pin);
 
+/**
+ * Return the ADC channel of a pin.
+ *
+ * @param pin Pin number.
+ * @return ADC1 channel, or ADCx if the pin has no analog input.
+ */
+uint8 analogPinChannel(uint8 pin);
+
+/**
+ * Serve analogRead() from a table kept up to date in the background,
+ * e.g. by STM32ADC::startBackground(), instead of converting.
+ *
+ * @param values Latest conversion result of each ADC channel, indexed
+ *               by channel; NULL to go back to blocking conversions.
+ * @param stamps micros() of the latest update of each channel.
+ * @see analogReadTimestamp()
+ */
+void analogReadCache(const volatile uint16 *values, const volatile uint32 *stamps);
+
+/**
+ * Time of the value analogRead() returns for a pin, in background mode.
+ *
+ * @param pin Pin to query.
+ * @return micros() when the channel of the pin was last updated, or 0
+ *         when analogRead() is not served from a cache.
+ * @see analogReadCache()
+ */
+uint32 analogReadTimestamp(uint8 pin);
+
 /**
  * Shift out a byte of data, one bit at a time.
  *
@@ -162,4 +197,34 @@ void shiftOut(uint8 dataPin, uint8 clockPin, uint8 bitOrder, uint8 value);
 
 uint32 shiftIn( uint32 ulDataPin, uint32 ulClockPin, uint32 ulBitOrder );
 
+/**
+ * Shift out a buffer of bytes, like shiftOut() for each byte.
+ *
+ * If clockPin and dataPin are the SCK and MOSI pins of an idle SPI
+ * port, the bytes are sent by the SPI with DMA, at up to 4.5 MHz. If
+ * they are on the same GPIO port, TIMER4 (when not running) paces a DMA
+ * stream of BSRR writes at 1 MHz. Otherwise the pins are driven
+ * directly. Both pins are left as outputs with the clock low.
+ *
+ * @param dataPin  Pin to shift data out on
+ * @param clockPin Pin to pulse after each bit is shifted out
+ * @param bitOrder Either MSBFIRST or LSBFIRST.
+ * @param buf      Bytes to shift out
+ * @param len      Number of bytes
+ */
+void shiftOutBuffer(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                    const uint8 *buf, uint32 len);
+
+/**
+ * Shift in len bytes, like shiftIn() for each byte.
+ *
+ * If clockPin and dataPin are the SCK and MISO pins of an idle SPI
+ * port, the SPI reads them with DMA, otherwise the pins are driven
+ * directly.
+ *
+ * @see shiftOutBuffer()
+ */
+void shiftInBuffer(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                   uint8 *buf, uint32 len);
+
 #endif
@@ -0,0 +1,119 @@
+/**
+ * @file libmaple/audio_mix.c
+ * @brief Wavetable voices mixed into blocks of output samples.
+ */
+
+#include <libmaple/audio_mix.h>
+
+const int16 audio_sine256[256] = {
+         0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+      6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+     12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+     18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+     23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+     27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+     30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+     32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+     32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+     32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+     30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+     27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+     23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+     18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+     12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+      6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+         0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+     -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+    -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+    -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+    -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+    -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+    -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+    -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+    -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+    -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+     -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+};
+
+void audio_voice_start(audio_voice *voice, uint32 freq, uint32 rate,
+                       uint32 samples, uint8 volume,
+                       const int16 *wave, uint8 wave_bits) {
+    voice->active = 0;
+    voice->wave = wave;
+    voice->wave_bits = wave_bits;
+    voice->volume = volume;
+    voice->phase = 0;
+    voice->step = (uint32)(((uint64)freq << 32) / rate);
+    voice->remaining = samples;
+    voice->active = 1;
+}
+
+/* Add count samples of a voice to acc */
+static void mix_voice(audio_voice *voice, int32 *acc, uint16 count) {
+    uint32 phase = voice->phase;
+    uint32 step = voice->step;
+    int32 volume = voice->volume;
+    uint16 i;
+
+    if (voice->remaining) {
+        if (voice->remaining <= count) {
+            count = voice->remaining;
+            voice->active = 0;
+        }
+        voice->remaining -= count;
+    }
+
+    if (voice->wave) {
+        const int16 *wave = voice->wave;
+        uint8 shift = 32 - voice->wave_bits;
+        for (i = 0; i < count; i++) {
+            acc[i] += (wave[phase >> shift] * volume) >> 8;
+            phase += step;
+        }
+    } else {
+        int32 level = (32767 * volume) >> 8;
+        for (i = 0; i < count; i++) {
+            acc[i] += (int32)phase < 0 ? -level : level;
+            phase += step;
+        }
+    }
+    voice->phase = phase;
+}
+
+void audio_mix_render(audio_voice *voices, uint8 nvoices,
+                      uint16 *out, uint16 count, uint16 top) {
+    int32 acc[AUDIO_MIX_BLOCK];
+    int32 half = top / 2;
+
+    while (count) {
+        uint16 block = count < AUDIO_MIX_BLOCK ? count : AUDIO_MIX_BLOCK;
+        uint16 i;
+        uint8 v;
+
+        for (i = 0; i < block; i++) {
+            acc[i] = 0;
+        }
+        for (v = 0; v < nvoices; v++) {
+            if (voices[v].active) {
+                mix_voice(&voices[v], acc, block);
+            }
+        }
+        for (i = 0; i < block; i++) {
+            int32 s = acc[i];
+            if (s > 32767) {
+                s = 32767;
+            } else if (s < -32768) {
+                s = -32768;
+            }
+            s = half + ((s * half) >> 15);
+            out[i] = (uint16)(s < 0 ? 0 : s);
+        }
+        out += block;
+        count -= block;
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file libmaple/audio_mix.h
+ * @brief Wavetable voices mixed into blocks of output samples.
+ *
+ * Each voice is a phase accumulator stepping through a wavetable (or a
+ * square wave). Voices are mixed one after the other into a block of
+ * AUDIO_MIX_BLOCK accumulators, which keeps a voice's state in
+ * registers for the whole block, then the block is scaled to the range
+ * of the output (PWM compare values, DAC codes).
+ *
+ * No hardware access, the mixer also runs on a host.
+ */
+
+#ifndef _LIBMAPLE_AUDIO_MIX_H_
+#define _LIBMAPLE_AUDIO_MIX_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libmaple/libmaple_types.h>
+
+#ifndef AUDIO_MIX_BLOCK
+#define AUDIO_MIX_BLOCK         64
+#endif
+
+/** Voice state. Use audio_voice_start() and audio_voice_stop(). */
+typedef struct audio_voice {
+    const int16 *wave;          /**< 1 << wave_bits samples, NULL for square */
+    uint8 wave_bits;
+    uint8 volume;               /**< 255 is full scale */
+    volatile uint8 active;
+    uint32 phase;
+    uint32 step;                /**< Phase increment per sample */
+    uint32 remaining;           /**< Samples left, 0 plays until stopped */
+} audio_voice;
+
+/** One period of a sine, full scale */
+extern const int16 audio_sine256[256];
+
+/**
+ * Start a voice.
+ * @param freq Frequency, in Hz.
+ * @param rate Output sample rate, in Hz.
+ * @param samples Duration in samples, 0 for no limit.
+ */
+void audio_voice_start(audio_voice *voice, uint32 freq, uint32 rate,
+                       uint32 samples, uint8 volume,
+                       const int16 *wave, uint8 wave_bits);
+
+static inline void audio_voice_stop(audio_voice *voice) {
+    voice->active = 0;
+}
+
+/**
+ * Mix the active voices into count output samples in 0..top, silence
+ * at top / 2. Sums beyond full scale are clipped.
+ */
+void audio_mix_render(audio_voice *voices, uint8 nvoices,
+                      uint16 *out, uint16 count, uint16 top);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
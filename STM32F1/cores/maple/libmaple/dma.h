@@ -244,6 +244,22 @@ typedef struct dma_tube_config {
  */
 extern int dma_tube_cfg(dma_dev *dev, dma_tube tube, dma_tube_config *cfg);
 
+/**
+ * @brief Check a tube configuration and compute its register values,
+ *        without touching the tube.
+ *
+ * The image can be loaded into the tube later, e.g. from an interrupt
+ * handler, without checking cfg again. See libmaple/dma_chain.h.
+ *
+ * @param image Receives the register values. CCR has neither the
+ *              enable bit nor interrupt enables beyond those in
+ *              cfg->tube_flags.
+ * @return DMA_TUBE_CFG_SUCCESS, or an error as dma_tube_cfg().
+ * @see dma_tube_cfg()
+ */
+extern int dma_tube_cfg_image(dma_dev *dev, dma_tube tube, dma_tube_config *cfg,
+                              struct dma_tube_reg_map *image);
+
 /* Other tube configuration functions. You can use these if
  * dma_tube_cfg() isn't enough, or to adjust parts of an existing tube
  * configuration. */
@@ -330,6 +346,24 @@ extern void dma_set_per_addr(dma_dev *dev, dma_tube tube, __IO void *address);
 extern void dma_attach_interrupt(dma_dev *dev, dma_tube tube,
                                  void (*handler)(void));
 
+/**
+ * @brief Attach an interrupt handler which clears the ISR bits itself.
+ *
+ * As dma_attach_interrupt(), but the tube's ISR bits are not cleared
+ * after the handler returns. For handlers that start the next transfer
+ * on the tube: it may complete before the handler returns, and its
+ * events must not be lost.
+ *
+ * @param dev DMA device
+ * @param tube Tube to attach handler to
+ * @param handler Interrupt handler, which must clear the ISR bits
+ *                before it starts a new transfer.
+ * @see dma_attach_interrupt()
+ * @see dma_clear_isr_bits()
+ */
+extern void dma_attach_interrupt_noclear(dma_dev *dev, dma_tube tube,
+                                         void (*handler)(void));
+
 
 /**
  * @brief Detach a DMA transfer interrupt handler.
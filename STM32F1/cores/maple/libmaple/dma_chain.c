@@ -0,0 +1,174 @@
+#include <libmaple/dma_chain.h>
+#include <libmaple/dwt.h>
+
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+#define DMA_CHAIN_SLOTS         12      /* DMA1 channels 1..7, DMA2 1..5 */
+#else
+#define DMA_CHAIN_SLOTS         7
+#endif
+
+static dma_chain *chains[DMA_CHAIN_SLOTS];
+
+static int chain_slot(dma_dev *dev, dma_tube tube) {
+#if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
+    if (dev == DMA2) {
+        return 7 + tube - 1;
+    }
+#endif
+    return tube - 1;
+}
+
+static void chain_end(dma_chain *chain) {
+    dma_chain_stop(chain);
+    if (chain->finished) {
+        chain->finished(chain);
+    }
+}
+
+/* Transfer complete or error: load the next descriptor first, then do
+ * the bookkeeping while it runs */
+static inline void chain_irq(dma_chain *chain) {
+    uint32 shift = 4 * (chain->tube - 1);
+    uint32 flags = chain->dev->regs->ISR >> shift;
+    dma_chain_desc *desc = chain->current;
+    dma_chain_desc *next;
+
+    chain->dev->regs->IFCR = (flags & 0xE) << shift;
+    if (flags & DMA_ISR_TEIF1) {
+        chain->error = 1;
+        chain_end(chain);
+        return;
+    }
+    if (!(flags & DMA_ISR_TCIF1)) {
+        return;
+    }
+    next = desc->next;
+    if (next) {
+        dma_tube_load(chain->regs, &next->image);
+        chain->current = next;
+    }
+    chain->descs++;
+    chain->items += desc->image.CNDTR;
+    if (desc->done) {
+        desc->done(chain, desc);
+    }
+    if (!next) {
+        chain_end(chain);
+    }
+}
+
+#define CHAIN_IRQ(n) static void chain_irq##n(void) { \
+        if (chains[n]) { chain_irq(chains[n]); } }
+CHAIN_IRQ(0) CHAIN_IRQ(1) CHAIN_IRQ(2) CHAIN_IRQ(3) CHAIN_IRQ(4) CHAIN_IRQ(5)
+CHAIN_IRQ(6)
+#if DMA_CHAIN_SLOTS > 7
+CHAIN_IRQ(7) CHAIN_IRQ(8) CHAIN_IRQ(9) CHAIN_IRQ(10) CHAIN_IRQ(11)
+#endif
+
+static void (* const chain_irqs[DMA_CHAIN_SLOTS])(void) = {
+    chain_irq0, chain_irq1, chain_irq2, chain_irq3, chain_irq4, chain_irq5,
+    chain_irq6,
+#if DMA_CHAIN_SLOTS > 7
+    chain_irq7, chain_irq8, chain_irq9, chain_irq10, chain_irq11,
+#endif
+};
+
+int dma_chain_desc_cfg(dma_chain_desc *desc, dma_dev *dev, dma_tube tube,
+                       dma_tube_config *cfg, dma_chain_desc *next) {
+    int ret;
+
+    if (cfg->tube_flags & DMA_CFG_CIRC) {
+        return -DMA_TUBE_CFG_ECFG;
+    }
+    ret = dma_tube_cfg_image(dev, tube, cfg, &desc->image);
+    if (ret < 0) {
+        return ret;
+    }
+    desc->image.CCR |= DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_EN;
+    desc->next = next;
+    desc->done = NULL;
+    return DMA_TUBE_CFG_SUCCESS;
+}
+
+void dma_chain_link(dma_chain_desc *descs, uint16 count, uint8 circular) {
+    uint16 i;
+
+    for (i = 0; i + 1 < count; i++) {
+        descs[i].next = &descs[i + 1];
+    }
+    if (count) {
+        descs[count - 1].next = circular ? descs : NULL;
+    }
+}
+
+void dma_chain_init(dma_chain *chain, dma_dev *dev, dma_tube tube) {
+    chain->dev = dev;
+    chain->tube = tube;
+    chain->regs = dma_tube_regs(dev, tube);
+    chain->current = NULL;
+    chain->finished = NULL;
+    chain->running = 0;
+    chain->error = 0;
+    if (!(DWT_BASE->CTRL & DWT_CTRL_CYCCNTENA)) {
+        dwt_cyccnt_enable();
+    }
+    dma_chain_reset_stats(chain);
+}
+
+uint8 dma_chain_start(dma_chain *chain, dma_chain_desc *first) {
+    int slot = chain_slot(chain->dev, chain->tube);
+
+    if (chains[slot] && chains[slot] != chain) {
+        return 0;
+    }
+    dma_chain_stop(chain);
+    dma_init(chain->dev);
+    chain->current = first;
+    chain->error = 0;
+    chain->running = 1;
+    chains[slot] = chain;
+    dma_clear_isr_bits(chain->dev, chain->tube);
+    dma_attach_interrupt_noclear(chain->dev, chain->tube, chain_irqs[slot]);
+    chain->started = dwt_cycles();
+    dma_tube_load(chain->regs, &first->image);
+    return 1;
+}
+
+void dma_chain_stop(dma_chain *chain) {
+    if (!chain->running) {
+        return;
+    }
+    chain->regs->CCR = 0;
+    dma_detach_interrupt(chain->dev, chain->tube);
+    chain->busy += dwt_cycles() - chain->started;
+    chain->running = 0;
+    chains[chain_slot(chain->dev, chain->tube)] = NULL;
+}
+
+uint32 dma_chain_load(dma_chain *chain) {
+    uint32 now = dwt_cycles();
+    uint32 busy = chain->busy;
+    uint32 span = now - chain->since;
+
+    if (chain->running) {
+        busy += now - chain->started;
+    }
+    if (!span) {
+        return 0;
+    }
+    return (uint32)((uint64)busy * 1000 / span);
+}
+
+void dma_chain_reset_stats(dma_chain *chain) {
+    chain->descs = 0;
+    chain->items = 0;
+    chain->busy = 0;
+    chain->since = dwt_cycles();
+    if (chain->running) {
+        chain->started = chain->since;
+    }
+}
+
+dma_chain *dma_chain_of(dma_dev *dev, dma_tube tube) {
+    return chains[chain_slot(dev, tube)];
+}
@@ -0,0 +1,131 @@
+/**
+ * @file libmaple/dma_chain.h
+ * @brief Descriptor chains (scatter-gather) on a DMA tube.
+ *
+ * The F1 DMA controller runs one transfer per tube and stops. A chain
+ * is a linked list of descriptors, each holding the register values of
+ * one transfer, checked and computed once by dma_chain_desc_cfg(). The
+ * transfer complete interrupt loads the next descriptor into the tube
+ * with four register writes, so a driver gets scatter-gather (several
+ * buffers, one peripheral) or gather-scatter without reprogramming the
+ * tube itself.
+ *
+ * A chain ends at a descriptor whose next is NULL (one shot), or loops
+ * when the last descriptor points back to an earlier one (circular).
+ *
+ * Between two descriptors the peripheral request waits for the
+ * interrupt handler, some 50 cycles plus the interrupt latency. A
+ * peripheral that doesn't hold its data (ADC in continuous mode, USART
+ * RX at a high baud rate) can overrun there; use circular mode on the
+ * tube itself for those.
+ *
+ * Each chain counts completed descriptors and transferred items, and
+ * the cycles its tube was running (DWT cycle counter), for
+ * dma_chain_load().
+ */
+
+#ifndef _LIBMAPLE_DMA_CHAIN_H_
+#define _LIBMAPLE_DMA_CHAIN_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libmaple/dma.h>
+
+struct dma_chain;
+
+/** One transfer of a chain. Set up with dma_chain_desc_cfg(). */
+typedef struct dma_chain_desc {
+    dma_tube_reg_map image;             /**< Register values, with EN set */
+    struct dma_chain_desc *next;        /**< Next transfer, NULL ends the chain */
+    /** Called from the interrupt handler when this transfer is done,
+     * may be NULL (as left by dma_chain_desc_cfg()). The next transfer
+     * is already running. */
+    void (*done)(struct dma_chain *chain, struct dma_chain_desc *desc);
+    void *arg;                          /**< For the application */
+} dma_chain_desc;
+
+/** A chain running on one tube. Use dma_chain_init() to initialize. */
+typedef struct dma_chain {
+    dma_dev *dev;
+    dma_tube tube;
+    dma_tube_reg_map *regs;
+    dma_chain_desc * volatile current;  /**< Transfer in progress */
+    /** Called from the interrupt handler at the end of a one shot
+     * chain, or after a transfer error; may be NULL */
+    void (*finished)(struct dma_chain *chain);
+    volatile uint8 running;
+    volatile uint8 error;               /**< Stopped by a transfer error */
+
+    volatile uint32 descs;              /**< Completed descriptors */
+    volatile uint32 items;              /**< Transferred data items */
+    uint32 busy;                        /**< Cycles running, until the last stop */
+    uint32 started;                     /**< Cycle count at the last start */
+    uint32 since;                       /**< Cycle count at the last stats reset */
+} dma_chain;
+
+/**
+ * Set up a descriptor of a chain for dev, tube. cfg is checked as by
+ * dma_tube_cfg(); DMA_CFG_CIRC is refused (make the chain circular
+ * instead), the interrupt enables are set by the chain.
+ * @param next Following descriptor, or NULL.
+ * @return DMA_TUBE_CFG_SUCCESS, or an error as dma_tube_cfg().
+ */
+int dma_chain_desc_cfg(dma_chain_desc *desc, dma_dev *dev, dma_tube tube,
+                       dma_tube_config *cfg, dma_chain_desc *next);
+
+/**
+ * Link count descriptors in order, the last one back to the first if
+ * circular, else to NULL.
+ */
+void dma_chain_link(dma_chain_desc *descs, uint16 count, uint8 circular);
+
+void dma_chain_init(dma_chain *chain, dma_dev *dev, dma_tube tube);
+
+/**
+ * Start the chain at first. Takes over the tube and its interrupt
+ * handler until dma_chain_stop() or the end of the chain.
+ * @return false if the tube is already used by another chain.
+ */
+uint8 dma_chain_start(dma_chain *chain, dma_chain_desc *first);
+
+/** Stop the chain, the current transfer is abandoned. */
+void dma_chain_stop(dma_chain *chain);
+
+/** Items left in the current transfer. */
+static inline uint16 dma_chain_remaining(dma_chain *chain) {
+    return chain->regs->CNDTR;
+}
+
+/**
+ * Share of the time since the last dma_chain_reset_stats() the tube
+ * was running the chain, in 1/1000. The measured span must stay below
+ * 2^32 cycles (59 s at 72 MHz).
+ */
+uint32 dma_chain_load(dma_chain *chain);
+
+void dma_chain_reset_stats(dma_chain *chain);
+
+/** The chain running on dev, tube, or NULL. */
+dma_chain *dma_chain_of(dma_dev *dev, dma_tube tube);
+
+/**
+ * Load a register image into a tube, e.g. one from
+ * dma_tube_cfg_image(), without checking it. The tube is disabled
+ * first; it is enabled if the image's CCR has EN set.
+ */
+static inline void dma_tube_load(dma_tube_reg_map *regs,
+                                 const dma_tube_reg_map *image) {
+    regs->CCR = 0;
+    regs->CNDTR = image->CNDTR;
+    regs->CPAR = image->CPAR;
+    regs->CMAR = image->CMAR;
+    regs->CCR = image->CCR;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -63,6 +63,7 @@ struct dma_reg_map;
 typedef struct dma_handler_config {
     void (*handler)(void);     /* User handler */
     nvic_irq_num irq_line;     /* IRQ line for interrupt */
+    uint8 clears_isr;          /* Handler clears the ISR bits itself */
 } dma_handler_config;
 
 /** DMA device type */
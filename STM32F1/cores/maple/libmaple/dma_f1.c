@@ -210,6 +210,25 @@ int dma_tube_cfg(dma_dev *dev, dma_channel channel, dma_tube_config *cfg) {
     return DMA_TUBE_CFG_SUCCESS;
 }
 
+int dma_tube_cfg_image(dma_dev *dev, dma_channel channel,
+                       dma_tube_config *cfg, dma_tube_reg_map *image) {
+    int ret = preconfig_check(dev, channel, cfg);
+
+    if (ret < 0) {
+        return ret;
+    }
+    switch (_dma_addr_type(cfg->tube_dst)) {
+    case DMA_ATYPE_PER:
+        return config_to_per(image, cfg);
+    case DMA_ATYPE_MEM:
+        return config_to_mem(image, cfg);
+    default:
+        /* Can't happen */
+        ASSERT(0);
+        return -DMA_TUBE_CFG_ECFG;
+    }
+}
+
 void dma_set_priority(dma_dev *dev,
                       dma_channel channel,
                       dma_priority priority)
@@ -233,9 +252,16 @@ void dma_set_num_transfers(dma_dev *dev,
 void dma_attach_interrupt(dma_dev *dev, dma_channel channel,
                           void (*handler)(void)) {
     DMA_GET_HANDLER(dev, channel) = handler;
+    dev->handlers[channel - 1].clears_isr = 0;
     nvic_irq_enable(dev->handlers[channel - 1].irq_line);
 }
 
+void dma_attach_interrupt_noclear(dma_dev *dev, dma_channel channel,
+                                  void (*handler)(void)) {
+    dma_attach_interrupt(dev, channel, handler);
+    dev->handlers[channel - 1].clears_isr = 1;
+}
+
 void dma_detach_interrupt(dma_dev *dev, dma_channel channel) {
     /* Don't use nvic_irq_disable()! Think about DMA2 channels 4 and 5. */
     dma_channel_regs(dev, channel)->CCR &= ~0xF;
@@ -350,8 +376,17 @@ __always_inline void dma_irq_handler(dma_dev *dev, dma_tube tube)
 {
     void (*handler)(void) = DMA_GET_HANDLER(dev, tube);
     if (handler) {
+        uint32 shift = 4 * (tube - 1);
+        uint32 flags = dev->regs->ISR & (0xE << shift);
         handler();
-	    dma_clear_isr_bits(dev, tube); /* in case handler doesn't */
+        /* in case handler doesn't. Only the events seen before the
+         * handler are cleared (not with CGIF). That still loses the
+         * events of a transfer the handler started, if it completed
+         * before the handler returned: such handlers clear the flags
+         * themselves, see dma_attach_interrupt_noclear(). */
+        if (!dev->handlers[tube - 1].clears_isr) {
+            dev->regs->IFCR = flags;
+        }
     }
 }
 
@@ -397,10 +432,13 @@ __weak void __irq_dma2_channel3(void) {
 }
 
 __weak void __irq_dma2_channel4_5(void) {
-    if ((DMA2_BASE->CCR4 & DMA_CCR_EN) && (DMA2_BASE->ISR & DMA_ISR_GIF4)) {
+    /* GIF may be left set by dma_irq_handler(), look at the events */
+    if ((DMA2_BASE->CCR4 & DMA_CCR_EN) &&
+        (DMA2_BASE->ISR & (DMA_ISR_TEIF4 | DMA_ISR_HTIF4 | DMA_ISR_TCIF4))) {
         dma_irq_handler(DMA2, DMA_CH4);
     }
-    if ((DMA2_BASE->CCR5 & DMA_CCR_EN) && (DMA2_BASE->ISR & DMA_ISR_GIF5)) {
+    if ((DMA2_BASE->CCR5 & DMA_CCR_EN) &&
+        (DMA2_BASE->ISR & (DMA_ISR_TEIF5 | DMA_ISR_HTIF5 | DMA_ISR_TCIF5))) {
         dma_irq_handler(DMA2, DMA_CH5);
     }
 }
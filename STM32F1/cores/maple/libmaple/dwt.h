@@ -0,0 +1,79 @@
+/**
+ * @file libmaple/dwt.h
+ * @brief Data watchpoint and trace unit, cycle counter access.
+ *
+ * The DWT cycle counter (CYCCNT) counts core clock cycles. It is used
+ * for cycle exact time measurements, e.g. in benchmarks.
+ */
+
+#ifndef _LIBMAPLE_DWT_H_
+#define _LIBMAPLE_DWT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libmaple/libmaple_types.h>
+
+/*
+ * Register maps and base pointers
+ */
+
+/** DWT register map type (only the first registers are used) */
+typedef struct dwt_reg_map {
+    __IO uint32 CTRL;    /**< Control register */
+    __IO uint32 CYCCNT;  /**< Cycle count register */
+    __IO uint32 CPICNT;  /**< CPI count register */
+    __IO uint32 EXCCNT;  /**< Exception overhead count register */
+    __IO uint32 SLEEPCNT;/**< Sleep count register */
+    __IO uint32 LSUCNT;  /**< LSU count register */
+    __IO uint32 FOLDCNT; /**< Folded instruction count register */
+} dwt_reg_map;
+
+/** DWT register map base pointer */
+#define DWT_BASE                        ((struct dwt_reg_map*)0xE0001000)
+
+/** Debug exception and monitor control register */
+#define DWT_DEMCR                       (*(__IO uint32*)0xE000EDFC)
+
+/*
+ * Register bit definitions
+ */
+
+/** DEMCR: global enable for DWT and ITM */
+#define DWT_DEMCR_TRCENA                (1U << 24)
+/** CTRL: cycle counter enable */
+#define DWT_CTRL_CYCCNTENA              (1U << 0)
+
+/*
+ * Convenience functions
+ */
+
+/**
+ * @brief Enable and reset the cycle counter.
+ */
+static inline void dwt_cyccnt_enable(void) {
+    DWT_DEMCR |= DWT_DEMCR_TRCENA;
+    DWT_BASE->CYCCNT = 0;
+    DWT_BASE->CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/**
+ * @brief Disable the cycle counter.
+ */
+static inline void dwt_cyccnt_disable(void) {
+    DWT_BASE->CTRL &= ~DWT_CTRL_CYCCNTENA;
+}
+
+/**
+ * @brief Get the current cycle count. Wraps around every 2^32 cycles.
+ */
+static inline uint32 dwt_cycles(void) {
+    return DWT_BASE->CYCCNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file libmaple/event_queue.c
+ * @brief Lock-free multi-producer, single-consumer event queue.
+ *
+ * Bounded queue with per slot sequence numbers: slot i of position pos
+ * is free when seq == pos, and holds the event of pos when
+ * seq == pos + 1. After the consumer read it, seq becomes pos + size,
+ * i.e. free for the next round.
+ */
+
+#include <libmaple/event_queue.h>
+#include <libmaple/dwt.h>
+#include <libmaple/util/atomic.h>
+
+/**
+ * @brief Initialize an event queue.
+ *
+ * Also enables the DWT cycle counter, used for the latency statistics,
+ * if it is not running yet.
+ *
+ * @param q Queue to initialize
+ * @param size Number of slots, must be a power of 2
+ * @param slots Slot array of size elements
+ */
+void evq_init(evq *q, uint32 size, evq_slot *slots)
+{
+    uint32 i;
+    for (i = 0; i < size; i++) {
+        slots[i].seq = i;
+    }
+    q->head = 0;
+    q->tail = 0;
+    q->mask = size - 1;
+    q->slots = slots;
+    evq_reset_stats(q);
+
+    if (!(DWT_BASE->CTRL & DWT_CTRL_CYCCNTENA)) {
+        dwt_cyccnt_enable();
+    }
+}
+
+/**
+ * @brief Post an event.
+ *
+ * Safe to call from any interrupt priority and from thread mode, does
+ * not disable interrupts.
+ *
+ * @param q Queue to post to
+ * @param id Event type
+ * @param data Event argument
+ * @return 1 on success, 0 if the queue was full and the event dropped.
+ */
+int evq_post(evq *q, uint32 id, uint32 data)
+{
+    uint32 pos = q->head;
+    evq_slot *slot;
+
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        int32 diff = (int32)(slot->seq - pos);
+        if (diff == 0) {
+            uint32 cur = __cas32(&q->head, pos, pos + 1);
+            if (cur == pos) {
+                break;
+            }
+            pos = cur;
+        } else if (diff < 0) {
+            // the slot of the previous round has not been read yet
+            uint32 dropped;
+            do {
+                dropped = __ldrexw(&q->dropped);
+            } while (__strexw(dropped + 1, &q->dropped));
+            return 0;
+        } else {
+            // another producer claimed pos
+            pos = q->head;
+        }
+    }
+
+    slot->event.id = id;
+    slot->event.data = data;
+    slot->stamp = dwt_cycles();
+    __dmb();
+    slot->seq = pos + 1;
+
+    uint32 posted;
+    do {
+        posted = __ldrexw(&q->posted);
+    } while (__strexw(posted + 1, &q->posted));
+    return 1;
+}
+
+/**
+ * @brief Get the oldest event. Must only be called by one consumer.
+ * @param q Queue to read from
+ * @param event Receives the event
+ * @return 1 if an event was read, 0 if no event is ready.
+ */
+int evq_get(evq *q, evq_event *event)
+{
+    uint32 pos = q->tail;
+    evq_slot *slot = &q->slots[pos & q->mask];
+
+    if (slot->seq != pos + 1) {
+        return 0;
+    }
+    __dmb();
+    *event = slot->event;
+    uint32 latency = dwt_cycles() - slot->stamp;
+    __dmb();
+    slot->seq = pos + q->mask + 1;
+    q->tail = pos + 1;
+
+    q->received++;
+    q->latency_sum += latency;
+    if (latency > q->latency_max) {
+        q->latency_max = latency;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reset the posted, dropped, received and latency counters.
+ */
+void evq_reset_stats(evq *q)
+{
+    q->posted = 0;
+    q->dropped = 0;
+    q->received = 0;
+    q->latency_max = 0;
+    q->latency_sum = 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file libmaple/event_queue.h
+ * @brief Lock-free multi-producer, single-consumer event queue.
+ *
+ * Hands events from several interrupt handlers (EXTI, timers, DMA...)
+ * to one consumer, typically loop(), without disabling interrupts.
+ * Producers claim a slot with LDREX/STREX; each slot has a sequence
+ * number telling whether it is free, being written, or ready.
+ *
+ * A producer that is preempted between claiming and filling its slot
+ * only delays the consumer; evq_get() returns 0 until the slot is ready.
+ */
+
+#ifndef _LIBMAPLE_EVENT_QUEUE_H_
+#define _LIBMAPLE_EVENT_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libmaple/libmaple_types.h>
+
+/** An event, as posted to and read from the queue */
+typedef struct evq_event {
+    uint32 id;                  /**< Event type, defined by the application */
+    uint32 data;                /**< Event argument */
+} evq_event;
+
+/** Queue slot. Treat the members as private. */
+typedef struct evq_slot {
+    volatile uint32 seq;
+    uint32 stamp;               /**< DWT cycle count when posted */
+    evq_event event;
+} evq_slot;
+
+/** Event queue. Use evq_init() to initialize.
+ * The members updated with LDREX/STREX are uint32_t, the type the
+ * util/atomic.h helpers take. */
+typedef struct evq {
+    volatile uint32_t head;     /**< Next position to post to */
+    uint32 tail;                /**< Next position to read, consumer only */
+    uint32 mask;                /**< Number of slots - 1 */
+    evq_slot *slots;
+
+    /* Statistics */
+    volatile uint32_t posted;   /**< Events posted */
+    volatile uint32_t dropped;  /**< Events dropped, queue full */
+    uint32 received;            /**< Events read by the consumer */
+    uint32 latency_max;         /**< Longest post to get time, in cycles */
+    uint64 latency_sum;         /**< Sum of all post to get times, in cycles */
+} evq;
+
+void evq_init(evq *q, uint32 size, evq_slot *slots);
+int evq_post(evq *q, uint32 id, uint32 data);
+int evq_get(evq *q, evq_event *event);
+void evq_reset_stats(evq *q);
+
+/**
+ * @brief Return the number of events posted and not read yet.
+ *
+ * Can be off by the events that are being posted concurrently.
+ */
+static inline uint32 evq_count(const evq *q) {
+    return q->head - q->tail;
+}
+
+/**
+ * @brief Return the mean post to get latency, in CPU cycles.
+ */
+static inline uint32 evq_latency_avg(const evq *q) {
+    return q->received ? (uint32)(q->latency_sum / q->received) : 0;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file libmaple/isr_profile.c
+ * @brief Interrupt handler run time and critical section profiler.
+ */
+
+#include <libmaple/isr_profile.h>
+#include <libmaple/scb.h>
+#include <libmaple/dwt.h>
+#include <libmaple/util/atomic.h>
+
+typedef void (*isr_handler)(void);
+
+/* VTOR needs the table aligned to its size rounded up to a power of 2 */
+static isr_handler ram_vectors[ISR_PROFILE_NR_EXC] __attribute__((aligned(512)));
+static const isr_handler *orig_vectors;
+static uint32 orig_vtor;
+
+static isr_stats stats[ISR_PROFILE_NR_EXC];
+static isr_cs_stats cs_stats;
+static uint32 cs_start;
+static uint8 cs_active;
+static uint8 running;
+
+/* Cycles spent in handlers that preempted the current one */
+static uint32 preempted;
+
+static inline uint32 current_exc(void) {
+    uint32 ipsr;
+    asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+    return ipsr & 0x1FF;
+}
+
+/* Installed for every profiled exception in ram_vectors */
+static void isr_profile_dispatch(void) {
+    uint32 exc = current_exc();
+    uint32 outer = preempted;
+    preempted = 0;
+
+    uint32 start = dwt_cycles();
+    orig_vectors[exc]();
+    uint32 elapsed = dwt_cycles() - start;
+
+    uint32 self = elapsed - preempted;
+    isr_stats *s = &stats[exc];
+    s->count++;
+    s->total += self;
+    if (self < s->min) {
+        s->min = self;
+    }
+    if (self > s->max) {
+        s->max = self;
+    }
+    preempted = outer + elapsed;
+}
+
+/**
+ * @brief Start profiling interrupt handlers.
+ *
+ * Copies the active vector table to RAM, wraps SysTick and all
+ * peripheral interrupts, and enables the DWT cycle counter if needed.
+ * Handlers attached later (e.g. with nvic/timer attach functions) are
+ * still called, they are looked up in the original table.
+ */
+void isr_profile_start(void) {
+    uint32 i;
+
+    if (running) {
+        return;
+    }
+    if (!(DWT_BASE->CTRL & DWT_CTRL_CYCCNTENA)) {
+        dwt_cyccnt_enable();
+    }
+    isr_profile_reset();
+
+    orig_vtor = SCB_BASE->VTOR;
+    orig_vectors = (const isr_handler *)orig_vtor;
+    for (i = 0; i < ISR_PROFILE_NR_EXC; i++) {
+        ram_vectors[i] = i < ISR_PROFILE_FIRST_EXC ? orig_vectors[i] : isr_profile_dispatch;
+    }
+    asm volatile("dsb" : : : "memory");
+    SCB_BASE->VTOR = (uint32)ram_vectors;
+    asm volatile("dsb\n\tisb" : : : "memory");
+    running = 1;
+}
+
+/**
+ * @brief Stop profiling, restore the original vector table.
+ *
+ * The statistics are kept until the next isr_profile_start() or
+ * isr_profile_reset().
+ */
+void isr_profile_stop(void) {
+    if (!running) {
+        return;
+    }
+    SCB_BASE->VTOR = orig_vtor;
+    asm volatile("dsb\n\tisb" : : : "memory");
+    running = 0;
+}
+
+/**
+ * @brief Clear all statistics.
+ */
+void isr_profile_reset(void) {
+    uint32 i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (i = 0; i < ISR_PROFILE_NR_EXC; i++) {
+            stats[i].count = 0;
+            stats[i].min = 0xFFFFFFFF;
+            stats[i].max = 0;
+            stats[i].total = 0;
+        }
+        for (i = 0; i < ISR_PROFILE_CS_BUCKETS; i++) {
+            cs_stats.hist[i] = 0;
+        }
+        cs_stats.max = 0;
+    }
+}
+
+/**
+ * @brief Return the statistics of an exception.
+ * @param exc Exception number: 15 for SysTick, 16 + n for IRQ n
+ *            (see nvic_irq_num).
+ * @return Statistics, or NULL if exc is out of range. Values are not
+ *         read atomically.
+ */
+const isr_stats *isr_profile_get(uint32 exc) {
+    return exc < ISR_PROFILE_NR_EXC ? &stats[exc] : NULL;
+}
+
+/**
+ * @brief Return the critical section histogram.
+ */
+const isr_cs_stats *isr_profile_cs(void) {
+    return &cs_stats;
+}
+
+void isr_profile_cs_enter(void) {
+    if (!cs_active) {
+        cs_active = 1;
+        cs_start = DWT_BASE->CYCCNT;
+    }
+}
+
+void isr_profile_cs_exit(void) {
+    if (cs_active) {
+        uint32 cycles = DWT_BASE->CYCCNT - cs_start;
+        uint32 bucket = cycles ? 31 - __builtin_clz(cycles) : 0;
+        cs_active = 0;
+        if (bucket >= ISR_PROFILE_CS_BUCKETS) {
+            bucket = ISR_PROFILE_CS_BUCKETS - 1;
+        }
+        cs_stats.hist[bucket]++;
+        if (cycles > cs_stats.max) {
+            cs_stats.max = cycles;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file libmaple/isr_profile.h
+ * @brief Interrupt handler run time and critical section profiler.
+ *
+ * isr_profile_start() moves the vector table to RAM and routes SysTick
+ * and all peripheral interrupts through a dispatcher, which times the
+ * original handlers with the DWT cycle counter. For each exception it
+ * records the count and the min, max and total run time in cycles,
+ * excluding the time spent in nested (preempting) handlers.
+ *
+ * When built with LIBMAPLE_ISR_PROFILE defined, nvic_globalirq_disable()/
+ * nvic_globalirq_enable() and ATOMIC_BLOCK() sections are also timed
+ * into a log2 histogram, which bounds the interrupt latency they cause.
+ *
+ * The profiler costs about 2 KiB of RAM and some 30 cycles per
+ * interrupt. SVC and PendSV are not wrapped, RTOS ports use them for
+ * context switches.
+ */
+
+#ifndef _LIBMAPLE_ISR_PROFILE_H_
+#define _LIBMAPLE_ISR_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libmaple/libmaple_types.h>
+#include <libmaple/stm32.h>
+
+/** Number of exceptions: 16 system exceptions + the interrupts */
+#define ISR_PROFILE_NR_EXC              (16 + STM32_NR_INTERRUPTS)
+/** First profiled exception number, SysTick */
+#define ISR_PROFILE_FIRST_EXC           15
+
+/** Number of critical section histogram buckets. Bucket i counts
+ * sections of [2^i, 2^(i+1)) cycles, the last one everything longer. */
+#define ISR_PROFILE_CS_BUCKETS          24
+
+/** Run time statistics of one exception */
+typedef struct isr_stats {
+    uint32 count;               /**< Number of calls */
+    uint32 min;                 /**< Shortest run time, in cycles */
+    uint32 max;                 /**< Longest run time, in cycles */
+    uint64 total;               /**< Total run time, in cycles */
+} isr_stats;
+
+/** Critical section (interrupts disabled) statistics */
+typedef struct isr_cs_stats {
+    uint32 hist[ISR_PROFILE_CS_BUCKETS];
+    uint32 max;                 /**< Longest section, in cycles */
+} isr_cs_stats;
+
+void isr_profile_start(void);
+void isr_profile_stop(void);
+void isr_profile_reset(void);
+const isr_stats *isr_profile_get(uint32 exc);
+const isr_cs_stats *isr_profile_cs(void);
+
+/* Called by the instrumented nvic_globalirq_*() and ATOMIC_BLOCK(),
+ * with interrupts disabled. */
+void isr_profile_cs_enter(void);
+void isr_profile_cs_exit(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -105,6 +105,13 @@ void nvic_set_vector_table(uint32 address, uint32 offset);
 void nvic_irq_set_priority(nvic_irq_num irqn, uint8 priority);
 void nvic_sys_reset();
 
+#ifdef LIBMAPLE_ISR_PROFILE
+#include <libmaple/isr_profile.h>
+
+/* Instrumented versions, time the critical sections; see isr_profile.h */
+inline void nvic_globalirq_enable() { isr_profile_cs_exit(); asm volatile("cpsie i"); }
+inline void nvic_globalirq_disable() { asm volatile("cpsid i"); isr_profile_cs_enter(); }
+#else
 /**
  * Enables interrupts and configurable fault handlers (clear PRIMASK).
  */
@@ -114,6 +121,7 @@ inline void nvic_globalirq_enable() { asm volatile("cpsie i"); }
  * Disable interrupts and configurable fault handlers (set PRIMASK).
  */
 inline void nvic_globalirq_disable() { asm volatile("cpsid i"); }
+#endif
 
 inline void interrupts() { nvic_globalirq_enable(); }
 
@@ -32,6 +32,7 @@
  * these functions is guaranteed re-entrant.
  */
 
+#include <string.h>
 #include "ring_buffer.h"
 
 
@@ -72,23 +73,70 @@ int rb_write_safe(ring_buffer_t * rb, const uint8_t element)
 	return true;
 }
 
+// returns the count of free slots starting at head, up to the buffer end
+uint16_t rb_write_contiguous(ring_buffer_t * rb)
+{
+	register rb_ptrs_t temp = { rb->ptrs.both };
+	if ( temp.tail > temp.head )
+		return (temp.tail - temp.head - 1);
+	// free space reaches up to the buffer end, leave one slot open if tail is at 0
+	return (rb->CAPACITY + 1 - temp.head - (temp.tail==0));
+}
+
+// returns the count of used slots starting at tail, up to the buffer end
+uint16_t rb_read_contiguous(ring_buffer_t * rb)
+{
+	register rb_ptrs_t temp = { rb->ptrs.both };
+	if ( temp.head >= temp.tail )
+		return (temp.head - temp.tail);
+	return (rb->CAPACITY + 1 - temp.tail);
+}
+
+// fills in the free windows, returns the overall free space
+//---------------------------------------------------------------------------
+uint16_t rb_write_spans(ring_buffer_t * rb, rb_span_t spans[2])
+{
+	register rb_ptrs_t temp = { rb->ptrs.both };
+	register uint16_t cap = rb->CAPACITY;
+	uint16_t total = (temp.tail - temp.head - 1) & cap;
+	uint16_t first = cap + 1 - temp.head; // up to the buffer end
+	if ( first > total ) first = total;
+	spans[0].ptr = &rb->buffer[temp.head];
+	spans[0].len = first;
+	spans[1].ptr = &rb->buffer[0];
+	spans[1].len = total - first;
+	return total;
+}
+
+// fills in the used windows, returns the overall used space
+//---------------------------------------------------------------------------
+uint16_t rb_read_spans(ring_buffer_t * rb, rb_span_t spans[2])
+{
+	register rb_ptrs_t temp = { rb->ptrs.both };
+	register uint16_t cap = rb->CAPACITY;
+	uint16_t total = (temp.head - temp.tail) & cap;
+	uint16_t first = cap + 1 - temp.tail; // up to the buffer end
+	if ( first > total ) first = total;
+	spans[0].ptr = &rb->buffer[temp.tail];
+	spans[0].len = first;
+	spans[1].ptr = &rb->buffer[0];
+	spans[1].len = total - first;
+	return total;
+}
+
 // Adds multiple elements to the end of the queue
 // checks for available free space
 //---------------------------------------------------------------------------
 uint32 rb_write_safe_n(ring_buffer_t * rb, const uint8_t * buf, uint16_t len)
 {
-	register rb_ptrs_t temp = { rb->ptrs.both };
-	register uint16 cap = rb->CAPACITY;
-	uint32 txd = 0;
-	while ( txd < len ) {
-		rb->buffer[temp.head++] = *buf++; // safe to write because it does not overwrite active data
-		temp.head &= cap;
-		if (temp.head==temp.tail)
-			break;
-		++txd;
-	}
-	rb->ptrs.head = temp.head; // update volatile variable
-	return txd;
+	rb_span_t spans[2];
+	uint16_t room = rb_write_spans(rb, spans);
+	if ( len > room ) len = room;
+	uint16_t n = (len < spans[0].len) ? len : spans[0].len;
+	memcpy(spans[0].ptr, buf, n);
+	memcpy(spans[1].ptr, buf + n, len - n);
+	rb_write_finish(rb, len); // update volatile variable
+	return len;
 }
 
 // does not check for available free space !!
@@ -123,32 +171,24 @@ uint8_t rb_read(ring_buffer_t * rb)
 	return elem;
 }
 
-// does not check for available data !!
-uint32 rb_read_n(ring_buffer_t * rb, uint8_t* buf, uint16 len)
+// copies at most len elements, returns the number of copied elements
+//---------------------------------------------------------------------------
+uint32 rb_peek_n(ring_buffer_t * rb, uint8_t* buf, uint16 len)
 {
-	uint32 rd = 0;
-	register rb_ptrs_t temp = {rb->ptrs.both};
-	register uint16 tmp_tail = temp.tail;
-	register uint16 cap = rb->CAPACITY;
-	while ( (tmp_tail!=temp.head) && ((rd++)<len) ) {
-		*buf++ = rb->buffer[tmp_tail++];
-		tmp_tail &= cap;
-	}
-	rb->ptrs.tail = tmp_tail; // update volatile variable
-	return rd;
+	rb_span_t spans[2];
+	uint16_t used = rb_read_spans(rb, spans);
+	if ( len > used ) len = used;
+	uint16_t n = (len < spans[0].len) ? len : spans[0].len;
+	memcpy(buf, spans[0].ptr, n);
+	memcpy(buf + n, spans[1].ptr, len - n);
+	return len;
 }
 
-uint32 rb_peek_n(ring_buffer_t * rb, uint8_t* buf, uint16 len)
+// reads at most len elements, returns the number of read elements
+//---------------------------------------------------------------------------
+uint32 rb_read_n(ring_buffer_t * rb, uint8_t* buf, uint16 len)
 {
-	uint32 peeked = 0;
-	register rb_ptrs_t temp = {rb->ptrs.both};
-	register uint16 tmp_tail = temp.tail;
-	register uint16 cap = rb->CAPACITY;
-	while ( (tmp_tail!=temp.head) && ((peeked++)<len) ) {
-		*buf++ = rb->buffer[tmp_tail++];
-		tmp_tail &= cap;
-	}
-	// no need to update volatile tail
-	return peeked;
+	len = rb_peek_n(rb, buf, len);
+	rb_read_finish(rb, len); // update volatile variable
+	return len;
 }
-
@@ -67,6 +67,16 @@ typedef struct ring_buffer_t {
 									.CAPACITY = (size-1), \
 									.buffer[size] = 0 }
 
+/**
+   A contiguous window into the ring buffer memory.
+   Returned by rb_read_spans() / rb_write_spans(), so that DMA or
+   endpoint copies can run directly into or out of the buffer.
+*/
+typedef struct rb_span_t {
+	uint8_t * ptr;
+	uint16_t len;
+} rb_span_t;
+
 //	enum { CAPACITY = SIZE - 1 }; // leave one slot open
 
 // --- public methods ---
@@ -100,20 +110,40 @@ uint32 rb_write_safe_n(ring_buffer_t * rb, const uint8_t * buf, uint16_t len);
 
 // does not check for available free space !!
 void rb_write_n(ring_buffer_t * rb, const uint8_t * buf, uint16_t len);
-/*
+
+//  Zero-copy access
+//  The *_spans() functions return the total free/used slot count and fill
+//  in up to two windows: spans[0] starts at head/tail, spans[1] is the
+//  wrapped part at the start of the buffer (len==0 if no wrap).
+//  After filling/draining the windows, call rb_write_finish()/rb_read_finish()
+//  with the number of bytes actually written/read.
+//---------------------------------------------------------------------------
 static inline uint8_t * rb_write_ptr(ring_buffer_t * rb) {
 	return &rb->buffer[rb->ptrs.head];
 }
-*/
-inline void rb_write_finish(ring_buffer_t * rb, uint16_t n) {
+
+static inline uint8_t * rb_read_ptr(ring_buffer_t * rb) {
+	return &rb->buffer[rb->ptrs.tail];
+}
+
+uint16_t rb_write_contiguous(ring_buffer_t * rb); // free slots starting at head, without wrap
+uint16_t rb_read_contiguous(ring_buffer_t * rb);  // used slots starting at tail, without wrap
+
+uint16_t rb_write_spans(ring_buffer_t * rb, rb_span_t spans[2]);
+uint16_t rb_read_spans(ring_buffer_t * rb, rb_span_t spans[2]);
+
+// commits n bytes written through rb_write_ptr()/rb_write_spans()
+static inline void rb_write_finish(ring_buffer_t * rb, uint16_t n) {
 	register uint16_t temp_head = (rb->ptrs.head + n) & rb->CAPACITY;
 	rb->ptrs.head = temp_head;
 }
-/*
-inline uint8_t * rb_read_ptr(ring_buffer_t * rb) {
-	return &rb->buffer[rb->ptrs.tail];
+
+// consumes n bytes read through rb_read_ptr()/rb_read_spans()
+static inline void rb_read_finish(ring_buffer_t * rb, uint16_t n) {
+	register uint16_t temp_tail = (rb->ptrs.tail + n) & rb->CAPACITY;
+	rb->ptrs.tail = temp_tail;
 }
-*/
+
 inline int rb_peek(ring_buffer_t * rb) {
 	return rb->buffer[rb->ptrs.tail];
 }
@@ -66,6 +66,15 @@ extern struct adc_dev *ADC3;
  * Register bit definitions
  */
 
+/* Control register 1 */
+
+#define ADC_CR1_DUALMOD_SHIFT           16
+#define ADC_CR1_DUALMOD                 (0xF << ADC_CR1_DUALMOD_SHIFT)
+#define ADC_CR1_DUALMOD_INDEPENDENT     (0x0 << ADC_CR1_DUALMOD_SHIFT)
+#define ADC_CR1_DUALMOD_REG_SIMUL       (0x6 << ADC_CR1_DUALMOD_SHIFT)
+#define ADC_CR1_DUALMOD_FAST_INT        (0x7 << ADC_CR1_DUALMOD_SHIFT)
+#define ADC_CR1_DUALMOD_SLOW_INT        (0x8 << ADC_CR1_DUALMOD_SHIFT)
+
 /* Control register 2 */
 
 #define ADC_CR2_ADON_BIT                0
@@ -0,0 +1,247 @@
+/**
+ * @file libmaple/sw_timer.c
+ * @brief Software timers, driven by SysTick.
+ *
+ * The wheel has SW_TIMER_LEVELS levels of SW_TIMER_SLOTS slots. Level 0
+ * has a resolution of 1 ms, each next level is SW_TIMER_SLOTS times
+ * coarser. Each slot is a doubly linked list, so start and stop are O(1).
+ * When the level 0 index wraps, the matching slot of the next level is
+ * cascaded (re-inserted) into the lower levels, and so on.
+ */
+
+#include <libmaple/sw_timer.h>
+#include <libmaple/systick.h>
+#include <libmaple/scb.h>
+#include <libmaple/nvic.h>
+#include <libmaple/util/atomic.h>
+
+#define SW_TIMER_SLOTS      (1UL << SW_TIMER_SLOT_BITS)
+#define SW_TIMER_SLOT_MASK  (SW_TIMER_SLOTS - 1)
+/* Largest delta which can be placed without clamping */
+#define SW_TIMER_MAX_DELTA  ((1ULL << (SW_TIMER_LEVELS * SW_TIMER_SLOT_BITS)) - 1)
+
+static struct {
+    sw_timer *slot[SW_TIMER_LEVELS][SW_TIMER_SLOTS];
+    uint32 now;             /* last processed tick */
+    volatile uint32 count;  /* number of running timers */
+} wheel;
+
+/* Requests the dispatch from the SysTick handler, see systick.c */
+extern void (*systick_sw_timer_hook)(void);
+
+static void sw_timer_systick(void)
+{
+    if (wheel.count) {
+        SCB_BASE->ICSR = SCB_ICSR_PENDSVSET;
+    }
+}
+
+/* Must be called with interrupts disabled.
+ * min_delta is 1 for new timers, as the slot of wheel.now is already
+ * processed, and 0 while cascading, before the slot of wheel.now runs. */
+static void wheel_add(sw_timer *t, int32 min_delta)
+{
+    int32 delta = (int32)(t->expires - wheel.now);
+    uint32 expires = t->expires;
+    uint8 level = 0;
+
+    if (delta < min_delta) {
+        expires = wheel.now + min_delta; // already due
+    } else if ((uint32)delta > SW_TIMER_MAX_DELTA) {
+        expires = wheel.now + SW_TIMER_MAX_DELTA; // re-evaluated on cascade
+    }
+    delta = expires - wheel.now;
+    while (level < (SW_TIMER_LEVELS - 1) &&
+           (uint32)delta >= (1UL << ((level + 1) * SW_TIMER_SLOT_BITS))) {
+        level++;
+    }
+    sw_timer **head = &wheel.slot[level][(expires >> (level * SW_TIMER_SLOT_BITS)) & SW_TIMER_SLOT_MASK];
+    t->next = *head;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    t->pprev = head;
+    *head = t;
+}
+
+/* Must be called with interrupts disabled */
+static void wheel_del(sw_timer *t)
+{
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->pprev = NULL;
+}
+
+/* Re-inserts all timers of a slot into the lower levels */
+static void wheel_cascade(uint8 level, uint32 index)
+{
+    sw_timer **head = &wheel.slot[level][index];
+    while (*head) {
+        // one timer per critical section, to keep the interrupt latency low
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            sw_timer *t = *head;
+            if (t) {
+                wheel_del(t);
+                wheel_add(t, 0);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Initialize a software timer.
+ * @param timer Timer to initialize
+ * @param callback Function called on expiry, from the PendSV handler
+ * @param arg Argument passed to callback
+ */
+void sw_timer_init(sw_timer *timer, sw_timer_callback callback, void *arg)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+/**
+ * @brief Start or restart a software timer.
+ *
+ * Can be called from any context, including interrupt handlers and
+ * timer callbacks.
+ *
+ * @param timer Timer to start
+ * @param delay_ms Time until the first expiry, in ms
+ * @param period_ms Reload period for periodic timers in ms, 0 for one-shot.
+ *                  Both are clamped to SW_TIMER_MAX_MS.
+ */
+void sw_timer_start(sw_timer *timer, uint32 delay_ms, uint32 period_ms)
+{
+    if (delay_ms > SW_TIMER_MAX_MS) {
+        delay_ms = SW_TIMER_MAX_MS;
+    }
+    if (period_ms > SW_TIMER_MAX_MS) {
+        period_ms = SW_TIMER_MAX_MS;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (timer->pprev) {
+            wheel_del(timer);
+        } else {
+            if (wheel.count++ == 0) {
+                // all slots are empty, catch up with the current time
+                wheel.now = systick_uptime_millis;
+                nvic_irq_set_priority(NVIC_PEND_SVC, 0xF);
+                systick_sw_timer_hook = sw_timer_systick;
+            }
+        }
+        timer->expires = systick_uptime_millis + delay_ms;
+        timer->period = period_ms;
+        wheel_add(timer, 1);
+    }
+}
+
+/**
+ * @brief Stop a software timer. Does nothing if it is not running.
+ * @param timer Timer to stop
+ */
+void sw_timer_stop(sw_timer *timer)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (timer->pprev) {
+            wheel_del(timer);
+            wheel.count--;
+        }
+    }
+}
+
+/**
+ * @brief Return the number of running timers.
+ */
+uint32 sw_timer_count(void)
+{
+    return wheel.count;
+}
+
+/**
+ * @brief Return the number of ticks the SysTick interrupt can be
+ *        suppressed for without delaying a timer.
+ *
+ * Used by systick_sleep(). Only level 0 is scanned: higher levels
+ * do not change before the next cascade, at the next level 0 wrap.
+ */
+uint32 sw_timer_idle_ticks(void)
+{
+    if (!wheel.count) {
+        return 0xFFFFFFFF;
+    }
+    if (wheel.now != systick_uptime_millis) {
+        return 0; // PendSV has ticks to catch up with
+    }
+    uint32 i;
+    for (i = 1; i < SW_TIMER_SLOTS; i++) {
+        uint32 index = (wheel.now + i) & SW_TIMER_SLOT_MASK;
+        if (index == 0 || wheel.slot[0][index]) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Process all ticks up to now, and call the expired callbacks.
+ *
+ * Called from the PendSV handler. Exposed so that the wheel can also
+ * be driven from another tick source.
+ *
+ * @param now Current time in ms
+ */
+void sw_timer_process(uint32 now)
+{
+    while ((int32)(now - wheel.now) > 0) {
+        uint32 tick = ++wheel.now;
+        uint32 index = tick & SW_TIMER_SLOT_MASK;
+
+        // cascade the next level(s) on index wrap
+        uint8 level = 1;
+        while (index == 0 && level < SW_TIMER_LEVELS) {
+            index = (tick >> (level * SW_TIMER_SLOT_BITS)) & SW_TIMER_SLOT_MASK;
+            wheel_cascade(level, index);
+            level++;
+        }
+
+        // run the due timers one by one, callbacks may start/stop timers
+        sw_timer **head = &wheel.slot[0][tick & SW_TIMER_SLOT_MASK];
+        while (*head) {
+            sw_timer *t;
+            sw_timer_callback callback;
+            void *arg;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                t = *head;
+                if (t) {
+                    wheel_del(t);
+                    callback = t->callback;
+                    arg = t->arg;
+                    if (t->period) {
+                        t->expires = tick + t->period;
+                        wheel_add(t, 1);
+                    } else {
+                        wheel.count--;
+                    }
+                }
+            }
+            if (t && callback) {
+                callback(arg);
+            }
+        }
+    }
+}
+
+/*
+ * PendSV handler
+ */
+
+void __exc_pendsv(void)
+{
+    sw_timer_process(systick_uptime_millis);
+}
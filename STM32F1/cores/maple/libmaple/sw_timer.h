@@ -0,0 +1,74 @@
+/**
+ * @file libmaple/sw_timer.h
+ * @brief Software timers, driven by SysTick.
+ *
+ * A hierarchical timer wheel with O(1) start and stop, for large
+ * numbers of concurrent millisecond timeouts. The SysTick handler only
+ * pends the PendSV exception; expired timers are processed and their
+ * callbacks are called from the PendSV handler, at the lowest
+ * interrupt priority.
+ *
+ * Note: RTOS ports (FreeRTOS, CoOS) use PendSV for context switching
+ * and can not be combined with these timers.
+ */
+
+#ifndef _LIBMAPLE_SW_TIMER_H_
+#define _LIBMAPLE_SW_TIMER_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libmaple/libmaple_types.h>
+
+/** Number of wheel levels */
+#ifndef SW_TIMER_LEVELS
+#define SW_TIMER_LEVELS                 4
+#endif
+
+/** log2 of the number of slots per level.
+ * Timeouts up to 2^(SW_TIMER_LEVELS*SW_TIMER_SLOT_BITS) ms are placed
+ * directly, longer ones are re-evaluated when the last level cascades. */
+#ifndef SW_TIMER_SLOT_BITS
+#define SW_TIMER_SLOT_BITS              5
+#endif
+
+/** Longest delay or period in ms, about 24.8 days. Longer values are
+ * clamped: expiry times are compared as signed 32 bit differences,
+ * with some margin for ticks not processed yet. */
+#define SW_TIMER_MAX_MS                 (0x7FFFFFFFUL - 0xFFFFUL)
+
+typedef void (*sw_timer_callback)(void *arg);
+
+/** Software timer. Treat the members as private. */
+typedef struct sw_timer {
+    struct sw_timer *next;
+    struct sw_timer **pprev;    /**< NULL if the timer is not running */
+    uint32 expires;             /**< Expiry time, in systick_uptime() ms */
+    uint32 period;              /**< Reload period in ms, 0 for one-shot */
+    sw_timer_callback callback;
+    void *arg;
+} sw_timer;
+
+void sw_timer_init(sw_timer *timer, sw_timer_callback callback, void *arg);
+void sw_timer_start(sw_timer *timer, uint32 delay_ms, uint32 period_ms);
+void sw_timer_stop(sw_timer *timer);
+uint32 sw_timer_count(void);
+uint32 sw_timer_idle_ticks(void);
+void sw_timer_process(uint32 now);
+
+/**
+ * @brief Check whether a timer is running.
+ * @param timer Timer to check
+ * @return nonzero if the timer is started and has not expired yet
+ *         (or is periodic).
+ */
+static inline uint8 sw_timer_is_active(const sw_timer *timer) {
+    return timer->pprev != NULL;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -31,9 +31,18 @@
  */
 
 #include <libmaple/systick.h>
+#include <libmaple/scb.h>
+#include <libmaple/dwt.h>
 
 volatile uint32 systick_uptime_millis;
 static void (*systick_user_callback)(void);
+/* Set by libmaple/sw_timer.c when software timers are in use */
+void (*systick_sw_timer_hook)(void);
+/* Weak reference, NULL unless libmaple/sw_timer.c is linked in */
+extern uint32 sw_timer_idle_ticks(void) __weak;
+
+volatile uint64 systick_sleep_cycles;
+volatile uint32 systick_sleep_count;
 
 /**
  * @brief Initialize and enable SysTick.
@@ -76,12 +85,140 @@ void systick_attach_callback(void (*callback)(void)) {
     systick_user_callback = callback;
 }
 
+/* Below this many cycles to the next tick, sleeping is not worth it */
+#define SYSTICK_SLEEP_MIN_CYCLES        64
+/* Cycles from the last dwt_cycles() read to the CNT write, plus the
+ * reload cycle; see systick_restart() */
+#define SYSTICK_RESTART_CYCLES          4
+
+/* Restart the running counter so that it reaches 0 cycles after the
+ * DWT cycle count since. The counter is never stopped, the cycles spent
+ * computing are taken off instead, so no time is lost. Returns the
+ * reload value written, cycles must leave it at least 1. */
+static inline uint32 systick_restart(uint32 cycles, uint32 since) {
+    uint32 rvr = cycles - (dwt_cycles() - since) - SYSTICK_RESTART_CYCLES;
+    SYSTICK_BASE->RVR = rvr;
+    SYSTICK_BASE->CNT = 0;
+    return rvr;
+}
+
+/**
+ * @brief Sleep with WFI, suppressing the SysTick interrupts in between.
+ *
+ * Reprograms SysTick to interrupt after up to max_ticks ms and waits
+ * for an interrupt. Any interrupt ends the sleep early. On wakeup,
+ * systick_uptime_millis is advanced by the number of ticks slept and
+ * SysTick is restarted in phase with the original 1 ms ticks, so
+ * millis() and micros() are not disturbed. The counter keeps running
+ * throughout; the DWT cycle counter (enabled if needed) measures the
+ * time spent reprogramming it.
+ *
+ * The sleep is limited to the next software timer expiry (see
+ * libmaple/sw_timer.h) and to the 24 bit SysTick counter range, about
+ * 233 ms at 72 MHz. Ticks that were skipped do not call the callback
+ * set with systick_attach_callback().
+ *
+ * @param max_ticks Maximum number of ms to sleep. The sleep ends on a
+ *                  tick boundary, so it never lasts longer than
+ *                  max_ticks ms from now.
+ * @return Number of ms ticks slept, including a final tick whose
+ *         interrupt is still pending.
+ */
+uint32 systick_sleep(uint32 max_ticks) {
+    uint32 reload = SYSTICK_BASE->RVR + 1;
+    uint32 ticks = max_ticks;
+    uint32 slept, elapsed, remaining, pending = 0;
+    uint32 cur, cnt, t0, t1, rvr;
+
+    if (ticks > SYSTICK_CVR_TENMS / reload) {
+        ticks = SYSTICK_CVR_TENMS / reload;
+    }
+    if (!(DWT_BASE->CTRL & DWT_CTRL_CYCCNTENA)) {
+        dwt_cyccnt_enable();
+    }
+
+    asm volatile("cpsid i" : : : "memory");
+    if (sw_timer_idle_ticks) {
+        uint32 idle = sw_timer_idle_ticks();
+        if (ticks > idle) {
+            ticks = idle;
+        }
+    }
+    /* Give up if a tick is (almost) due, leaving SysTick alone */
+    cur = SYSTICK_BASE->CNT;
+    t0 = dwt_cycles();
+    if (ticks == 0 || cur < SYSTICK_SLEEP_MIN_CYCLES ||
+        (SCB_BASE->ICSR & SCB_ICSR_PENDSTSET)) {
+        asm volatile("cpsie i" : : : "memory");
+        return 0;
+    }
+
+    /* The first tick is due in cur cycles from t0, then one every
+     * reload; the counter reaches 0 at total */
+    uint32 total = cur + (ticks - 1) * reload;
+    rvr = systick_restart(total, t0);
+
+    asm volatile("dsb\n\twfi\n\tisb" : : : "memory");
+
+    /* A consistent pair: the counter may reach 0 between the reads */
+    do {
+        pending = SCB_BASE->ICSR & SCB_ICSR_PENDSTSET;
+        cnt = SYSTICK_BASE->CNT;
+        t1 = dwt_cycles();
+    } while (pending != (SCB_BASE->ICSR & SCB_ICSR_PENDSTSET));
+
+    if (pending) {
+        /* Slept all the way; the pending interrupt counts the last tick */
+        uint32 since = rvr - cnt + 1;   /* cycles since it reached 0 */
+        elapsed = total + since;
+        slept = ticks - 1;
+        pending = 1;
+        remaining = since < reload ? reload - since : reload;
+    } else {
+        /* Woken early by another interrupt */
+        elapsed = total - cnt;
+        if (elapsed < cur) {
+            slept = 0;
+            remaining = cur - elapsed;
+        } else {
+            uint32 over = elapsed - cur;
+            slept = 1 + over / reload;
+            remaining = reload - over % reload;
+        }
+    }
+    /* Leave time to restart before the next tick, else count it here */
+    if (remaining < (dwt_cycles() - t1) + SYSTICK_RESTART_CYCLES + 16) {
+        remaining += reload;
+        slept++;
+    }
+
+    /* Restart with the rest of the current tick, then 1 ms ticks */
+    systick_restart(remaining, t1);
+    while (SYSTICK_BASE->CNT == 0) {
+        /* until the counter has loaded the rest of the tick */
+    }
+    SYSTICK_BASE->RVR = reload - 1;
+    if (!pending) {
+        /* The end of total may have passed meanwhile, it is counted */
+        SCB_BASE->ICSR = SCB_ICSR_PENDSTCLR;
+    }
+
+    systick_uptime_millis += slept;
+    systick_sleep_cycles += elapsed;
+    systick_sleep_count++;
+    asm volatile("cpsie i" : : : "memory");
+    return slept + pending;
+}
+
 /*
  * SysTick ISR
  */
 
 __weak void __exc_systick(void) {
     systick_uptime_millis++;
+    if (systick_sw_timer_hook) {
+        systick_sw_timer_hook();
+    }
     if (systick_user_callback) {
         systick_user_callback();
     }
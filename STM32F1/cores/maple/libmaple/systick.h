@@ -108,6 +108,26 @@ static inline uint32 systick_check_underflow(void) {
     return SYSTICK_BASE->CSR & SYSTICK_CSR_COUNTFLAG;
 }
 
+uint32 systick_sleep(uint32 max_ticks);
+
+/** Core clock cycles spent in systick_sleep(), since reset */
+extern volatile uint64 systick_sleep_cycles;
+/** Number of systick_sleep() calls that actually slept */
+extern volatile uint32 systick_sleep_count;
+
+/**
+ * @brief Returns the time spent in systick_sleep(), in milliseconds.
+ *
+ * The time spent awake is systick_uptime() minus this value.
+ */
+static inline uint32 systick_sleep_millis(void) {
+    uint64 cycles;
+    do {
+        cycles = systick_sleep_cycles;
+    } while (cycles != systick_sleep_cycles);
+    return (uint32)(cycles / (SYSTICK_BASE->RVR + 1));
+}
+
 /**
  * @brief prototype for systick_attach_callback
  *
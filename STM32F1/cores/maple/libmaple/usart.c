@@ -81,6 +81,8 @@ void usart_disable(const usart_dev *dev) {
     /* Disable UE */
     regs->CR1 &= ~USART_CR1_UE;
 
+    usart_dma_disable(dev);
+
     // Clean up buffer
     rb_reset(dev->rb);
     rb_reset(dev->wb);
@@ -95,14 +97,8 @@ void usart_disable(const usart_dev *dev) {
  */
 uint16 usart_tx(const usart_dev *dev, const uint8 *buf, uint16 len)
 {
-    uint16 txed = 0;
-	while ( txed < len )
-	{
-		if ( !rb_write_safe(dev->wb, *buf++) ) // checks for buffer full
-			break;
-		txed++;
-	}
-	dev->regs->CR1 |= USART_CR1_TXEIE; // enable Tx IRQ
+    uint16 txed = rb_write_safe_n(dev->wb, buf, len); // checks for buffer full
+	usart_tx_start(dev); // enable Tx IRQ or kick Tx DMA
 
     return txed;
 }
@@ -115,12 +111,7 @@ uint16 usart_tx(const usart_dev *dev, const uint8 *buf, uint16 len)
  * @return Number of bytes received
  */
 uint16 usart_rx(const usart_dev *dev, uint8 *buf, uint16 len) {
-    uint16 rxed = 0;
-    while (usart_rx_available(dev) && rxed < len) {
-        *buf++ = usart_getc(dev);
-        rxed++;
-    }
-    return rxed;
+    return rb_read_n(dev->rb, buf, len);
 }
 
 /**
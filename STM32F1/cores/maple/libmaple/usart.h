@@ -421,6 +421,26 @@ typedef struct usart_reg_map {
 */
 
 #include "ring_buffer.h"
+#include "dma.h"
+
+/** USART DMA mode flags, see usart_dma_enable() */
+#define USART_DMA_RX                    BIT(0)
+#define USART_DMA_TX                    BIT(1)
+
+/**
+ * @brief USART DMA state.
+ *
+ * RX uses a circular DMA transfer directly into the RX ring buffer
+ * memory, TX drains the TX ring buffer in contiguous chunks.
+ */
+typedef struct usart_dma_state {
+    dma_request_src rx_req_src;       /**< RX DMA request source */
+    dma_request_src tx_req_src;       /**< TX DMA request source */
+    voidFuncPtr rx_handler;           /**< RX DMA channel interrupt handler */
+    voidFuncPtr tx_handler;           /**< TX DMA channel interrupt handler */
+    dma_dev * dev;                    /**< DMA device, set by usart_dma_enable() */
+    volatile uint16 tx_len;           /**< Length of TX chunk in flight, 0 if idle */
+} usart_dma_state;
 
 /** USART device type */
 typedef struct {
@@ -429,6 +449,7 @@ typedef struct {
     ring_buffer_t * wb;               /**< TX ring buffer */
     rcc_clk_id clk_id;               /**< RCC clock information */
     nvic_irq_num irq_num;            /**< USART NVIC interrupt */
+    usart_dma_state * dma;           /**< DMA state, NULL if not supported */
 } usart_dev;
 
 /*
@@ -458,8 +479,12 @@ enum uart_stop_bits_t { UART_STOP_BITS_0_5 = USART_CR2_STOP_BITS_0_5, UART_STOP_
 
 // Define constants and variables for buffering incoming serial data.
 
-#define SERIAL_TX_BUFFER_SIZE 64
-#define SERIAL_RX_BUFFER_SIZE 64
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64 // must be power of 2 !!!
+#endif
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64 // must be power of 2 !!!
+#endif
 
 
 void usart_init(const usart_dev *dev);
@@ -487,6 +512,11 @@ void usart_tx_fast(const usart_dev *dev, uint8 *buf, uint16 n);
 uint16 usart_rx(const usart_dev *dev, uint8 *buf, uint16 n);
 void usart_putudec(const usart_dev *dev, uint32 val);
 
+int usart_dma_enable(const usart_dev *dev, uint8 flags);
+void usart_dma_disable(const usart_dev *dev);
+void usart_dma_tx_start(const usart_dev *dev);
+void usart_dma_rx_update(const usart_dev *dev);
+
 /**
  * @brief Disable all serial ports.
  */
@@ -554,19 +584,34 @@ static inline int usart_peek(const usart_dev *dev) {
 static inline uint16_t usart_tx_available(const usart_dev *dev) {
     return rb_write_available(dev->wb);
 }
-/*
-static inline uint8_t * usart_tx_ptr(usart_dev *dev) {
-    return rb_write_ptr(dev->wb);
+/**
+ * @brief Get the free windows of a serial port's TX buffer.
+ *
+ * Fill the windows, then call usart_tx_finish() with the number of
+ * bytes written to queue them for transmission.
+ *
+ * @param dev Serial port to check
+ * @param spans Filled in with up to two contiguous windows
+ * @return Overall number of free slots in dev's TX buffer.
+ */
+static inline uint16_t usart_tx_spans(const usart_dev *dev, rb_span_t spans[2]) {
+    return rb_write_spans(dev->wb, spans);
 }
-*/
 static inline void usart_tx_start(const usart_dev *dev) {
-	dev->regs->CR1 |= USART_CR1_TXEIE;
+	if (dev->regs->CR3 & USART_CR3_DMAT)
+		usart_dma_tx_start(dev);
+	else
+		dev->regs->CR1 |= USART_CR1_TXEIE;
 }
-/*
-static inline void usart_tx_finish(usart_dev *dev, uint16_t nr) {
-    rb_write_finish(dev->txB, nr);
+/**
+ * @brief Commit bytes written through usart_tx_spans() and start transmission.
+ * @param dev Serial port to send on
+ * @param nr Number of bytes written into the windows
+ */
+static inline void usart_tx_finish(const usart_dev *dev, uint16_t nr) {
+    rb_write_finish(dev->wb, nr);
+    usart_tx_start(dev);
 }
-*/
 /**
  * @brief Return the amount of data available in a serial port's RX buffer.
  * @param dev Serial port to check
@@ -37,6 +37,37 @@
 #include <libmaple/gpio.h>
 #include "usart_private.h"
 
+/*
+ * DMA state
+ */
+
+static void usart1_dma_rx_irq(void) { usart_dma_rx_update(USART1); }
+static void usart1_dma_tx_irq(void);
+static usart_dma_state usart1_dma = {
+    .rx_req_src = DMA_REQ_SRC_USART1_RX,
+    .tx_req_src = DMA_REQ_SRC_USART1_TX,
+    .rx_handler = usart1_dma_rx_irq,
+    .tx_handler = usart1_dma_tx_irq,
+};
+
+static void usart2_dma_rx_irq(void) { usart_dma_rx_update(USART2); }
+static void usart2_dma_tx_irq(void);
+static usart_dma_state usart2_dma = {
+    .rx_req_src = DMA_REQ_SRC_USART2_RX,
+    .tx_req_src = DMA_REQ_SRC_USART2_TX,
+    .rx_handler = usart2_dma_rx_irq,
+    .tx_handler = usart2_dma_tx_irq,
+};
+
+static void usart3_dma_rx_irq(void) { usart_dma_rx_update(USART3); }
+static void usart3_dma_tx_irq(void);
+static usart_dma_state usart3_dma = {
+    .rx_req_src = DMA_REQ_SRC_USART3_RX,
+    .tx_req_src = DMA_REQ_SRC_USART3_TX,
+    .rx_handler = usart3_dma_rx_irq,
+    .tx_handler = usart3_dma_tx_irq,
+};
+
 /*
  * Devices
  */
@@ -50,6 +81,7 @@ const usart_dev usart1 = {
     .wb       = &usart1_wb,
     .clk_id   = RCC_USART1,
     .irq_num  = NVIC_USART1,
+    .dma      = &usart1_dma,
 };
 
 static RING_BUFFER(usart2_rb, SERIAL_RX_BUFFER_SIZE);
@@ -61,6 +93,7 @@ const usart_dev usart2 = {
     .wb       = &usart2_wb,
     .clk_id   = RCC_USART2,
     .irq_num  = NVIC_USART2,
+    .dma      = &usart2_dma,
 };
 
 static RING_BUFFER(usart3_rb, SERIAL_RX_BUFFER_SIZE);
@@ -72,6 +105,7 @@ const usart_dev usart3 = {
     .wb       = &usart3_wb,
     .clk_id   = RCC_USART3,
     .irq_num  = NVIC_USART3,
+    .dma      = &usart3_dma,
 };
 
 #if defined(STM32_HIGH_DENSITY) || defined(STM32_XL_DENSITY)
@@ -167,6 +201,185 @@ void usart_set_baud_rate(const usart_dev *dev, uint32 baud)
     dev->regs->BRR = (uint16)tmp;
 }
 
+/*
+ * DMA mode
+ */
+
+/**
+ * @brief Switch a serial port to DMA driven transfers.
+ *
+ * RX runs as circular DMA directly into the RX ring buffer. The buffer
+ * head is updated on the DMA half/complete transfer interrupts and on
+ * the USART IDLE line interrupt, so short messages are available as
+ * soon as the line goes idle. If the application does not read fast
+ * enough, DMA overwrites the oldest unread data; usart_dma_rx_update()
+ * then drops it by moving the tail, so the buffer holds the newest
+ * CAPACITY bytes. An overrun by a whole buffer size or more between two
+ * updates (interrupts blocked for half the buffer time) is not detected.
+ *
+ * TX drains the TX ring buffer in contiguous chunks, one DMA transfer
+ * per chunk, instead of one interrupt per byte.
+ *
+ * Call after usart_enable(). Only USART1..3 (DMA1) are supported.
+ *
+ * @param dev Serial port to switch
+ * @param flags USART_DMA_RX and/or USART_DMA_TX
+ * @return 0 on success, <0 on failure.
+ */
+int usart_dma_enable(const usart_dev *dev, uint8 flags)
+{
+    usart_dma_state *st = dev->dma;
+    usart_reg_map *regs = dev->regs;
+    dma_tube_config cfg;
+
+    if (st == NULL) {
+        return -1;
+    }
+    st->dev = DMA1;
+    dma_init(st->dev);
+    cfg.target_data = NULL;
+
+    if (flags & USART_DMA_RX) {
+        ring_buffer_t *rb = dev->rb;
+        cfg.tube_src = &regs->DR;
+        cfg.tube_src_size = DMA_SIZE_8BITS;
+        cfg.tube_dst = rb->buffer;
+        cfg.tube_dst_size = DMA_SIZE_8BITS;
+        cfg.tube_nr_xfers = rb->CAPACITY + 1;
+        cfg.tube_flags = (DMA_CFG_DST_INC | DMA_CFG_CIRC |
+                          DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE);
+        cfg.tube_req_src = st->rx_req_src;
+
+        regs->CR1 &= ~USART_CR1_RXNEIE;
+        rb_reset(rb);
+        if (dma_tube_cfg(st->dev, st->rx_req_src & 0x7, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+            regs->CR1 |= USART_CR1_RXNEIE;
+            return -1;
+        }
+        dma_attach_interrupt(st->dev, st->rx_req_src & 0x7, st->rx_handler);
+        dma_enable(st->dev, st->rx_req_src & 0x7);
+        regs->CR3 |= USART_CR3_DMAR;
+        (void)regs->SR; // clear pending IDLE flag
+        (void)regs->DR;
+        regs->CR1 |= USART_CR1_IDLEIE;
+    }
+
+    if (flags & USART_DMA_TX) {
+        while (!rb_is_empty(dev->wb))
+            ; // let the interrupt driven TX finish
+        cfg.tube_src = dev->wb->buffer;
+        cfg.tube_src_size = DMA_SIZE_8BITS;
+        cfg.tube_dst = &regs->DR;
+        cfg.tube_dst_size = DMA_SIZE_8BITS;
+        cfg.tube_nr_xfers = 1; // set for each chunk
+        cfg.tube_flags = (DMA_CFG_SRC_INC | DMA_CFG_CMPLT_IE);
+        cfg.tube_req_src = st->tx_req_src;
+
+        if (dma_tube_cfg(st->dev, st->tx_req_src & 0x7, &cfg) != DMA_TUBE_CFG_SUCCESS) {
+            return -1;
+        }
+        st->tx_len = 0;
+        dma_attach_interrupt(st->dev, st->tx_req_src & 0x7, st->tx_handler);
+        regs->CR1 &= ~USART_CR1_TXEIE;
+        regs->CR3 |= USART_CR3_DMAT;
+    }
+    return 0;
+}
+
+/**
+ * @brief Switch a serial port back to interrupt driven transfers.
+ * @param dev Serial port to switch
+ */
+void usart_dma_disable(const usart_dev *dev)
+{
+    usart_dma_state *st = dev->dma;
+    usart_reg_map *regs = dev->regs;
+
+    if (st == NULL || st->dev == NULL) {
+        return;
+    }
+    if (regs->CR3 & USART_CR3_DMAR) {
+        regs->CR1 &= ~USART_CR1_IDLEIE;
+        regs->CR3 &= ~USART_CR3_DMAR;
+        dma_disable(st->dev, st->rx_req_src & 0x7);
+        dma_detach_interrupt(st->dev, st->rx_req_src & 0x7);
+        usart_dma_rx_update(dev);
+        regs->CR1 |= USART_CR1_RXNEIE;
+    }
+    if (regs->CR3 & USART_CR3_DMAT) {
+        while (!rb_is_empty(dev->wb))
+            ; // wait for TX completed
+        regs->CR3 &= ~USART_CR3_DMAT;
+        dma_disable(st->dev, st->tx_req_src & 0x7);
+        dma_detach_interrupt(st->dev, st->tx_req_src & 0x7);
+    }
+}
+
+/**
+ * @brief Start a TX DMA transfer of the next contiguous TX buffer chunk.
+ *
+ * Does nothing if a transfer is already in flight; the transfer
+ * complete interrupt picks up the remaining data.
+ *
+ * @param dev Serial port to send on
+ */
+void usart_dma_tx_start(const usart_dev *dev)
+{
+    usart_dma_state *st = dev->dma;
+    if (st->tx_len) {
+        return;
+    }
+    uint16 len = rb_read_contiguous(dev->wb);
+    if (len == 0) {
+        return;
+    }
+    st->tx_len = len;
+    dma_tube_reg_map *chregs = dma_tube_regs(st->dev, st->tx_req_src & 0x7);
+    chregs->CCR &= ~DMA_CCR_EN;
+    chregs->CMAR = (uint32)rb_read_ptr(dev->wb);
+    chregs->CNDTR = len;
+    chregs->CCR |= DMA_CCR_EN;
+}
+
+/**
+ * @brief Publish the data written by RX DMA to the RX ring buffer.
+ *
+ * If DMA has written more than the free space since the last update,
+ * the oldest data was overwritten and head has lapped tail; tail is
+ * moved to head+1 so the buffer reads as full instead of empty.
+ *
+ * @param dev Serial port to update
+ */
+void usart_dma_rx_update(const usart_dev *dev)
+{
+    usart_dma_state *st = dev->dma;
+    ring_buffer_t *rb = dev->rb;
+    uint16 cap = rb->CAPACITY;
+    uint16 left = dma_get_count(st->dev, st->rx_req_src & 0x7);
+    rb_ptrs_t temp = { rb->ptrs.both };
+    uint16 head = (cap + 1 - left) & cap;
+    uint16 used = (temp.head - temp.tail) & cap;
+    uint16 added = (head - temp.head) & cap;
+    if (used + added > cap) {
+        temp.tail = (head + 1) & cap; // overrun, drop the overwritten data
+    }
+    temp.head = head;
+    rb->ptrs.both = temp.both;
+}
+
+/* TX DMA transfer complete: release the sent chunk and start the next one */
+static inline void usart_dma_tx_irq(const usart_dev *dev)
+{
+    usart_dma_state *st = dev->dma;
+    rb_read_finish(dev->wb, st->tx_len);
+    st->tx_len = 0;
+    usart_dma_tx_start(dev);
+}
+
+static void usart1_dma_tx_irq(void) { usart_dma_tx_irq(USART1); }
+static void usart2_dma_tx_irq(void) { usart_dma_tx_irq(USART2); }
+static void usart3_dma_tx_irq(void) { usart_dma_tx_irq(USART3); }
+
 /**
  * @brief Call a function on each USART.
  * @param fn Function to call.
@@ -54,6 +54,11 @@ static inline void usart_irq(const usart_dev * udev)
             /* By default, push bytes around in the ring buffer. */
             rb_write_safe(udev->rb, (uint8) regs->DR);
        }
+    }
+	// DMA receive part. IDLE signifies the end of a received burst
+    if ((regs->CR1 & USART_CR1_IDLEIE) && (regs->SR & USART_SR_IDLE)) {
+        regs->DR; // clears IDLE
+        usart_dma_rx_update(udev);
     }
 	// Transmit part. TXE signifies readiness to send a byte to DR
     if ((regs->CR1 & USART_CR1_TXEIE) && (regs->SR & USART_SR_TXE))
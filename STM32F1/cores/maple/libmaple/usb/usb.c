@@ -39,10 +39,12 @@ uint8_t deviceAddress;
 const epTableAddress_t epTableAddr[NUM_EP] = { // number of EPs
 	{ .txAddr = (uint32*)EP_CTRL_TX_BUF_ADDRESS, .rxAddr = (uint32*)EP_CTRL_RX_BUF_ADDRESS },
 	{ .txAddr = (uint32*)EP_COMM_TX_BUF_ADDRESS, .rxAddr = (uint32*)EP_COMM_RX_BUF_ADDRESS },
-	{ .txAddr = (uint32*)EP_DATA_TX_BUF_ADDRESS, .rxAddr = (uint32*)EP_DATA_RX_BUF_ADDRESS },
+	{ .txAddr = (uint32*)EP_DATA_TX0_BUF_ADDRESS, .rxAddr = (uint32*)EP_DATA_TX1_BUF_ADDRESS },
+	{ .txAddr = (uint32*)EP_DATA_RX0_BUF_ADDRESS, .rxAddr = (uint32*)EP_DATA_RX1_BUF_ADDRESS },
 };
-volatile bool receiving;
-volatile bool transmitting;
+volatile bool receiving;    // the USB may fill an OUT buffer
+volatile bool transmitting; // the USB owns an IN buffer
+volatile bool txReady;      // the application IN buffer is filled, waiting for the USB
 
 // constant to send zero byte packets
 const uint8_t ZERO = 0;
@@ -65,6 +67,7 @@ void USB_Start(void)
 	deviceAddress = 0;
 	receiving = true;
 	transmitting = false;
+	txReady = false;
 	usb_state.suspended = true;
 	usb_state.configured = false;
 }
@@ -101,6 +104,21 @@ void DisableUsbIRQ (void)
 {
     NVIC_ICER[USB_IRQ_NUMBER/32] = ((uint32_t) 1) << (USB_IRQ_NUMBER % 32);
 }
+
+// Disable the USB IRQ and return whether it was enabled, for RestoreUsbIRQ().
+// The IRQ stays off if USBSerial::end() turned it off meanwhile.
+static inline uint32_t SaveDisableUsbIRQ (void)
+{
+    uint32_t enabled = NVIC_ISER[USB_IRQ_NUMBER/32] & (((uint32_t) 1) << (USB_IRQ_NUMBER % 32));
+    DisableUsbIRQ();
+    return enabled;
+}
+
+static inline void RestoreUsbIRQ (uint32_t enabled)
+{
+    if (enabled)
+        EnableUsbIRQ();
+}
 //-----------------------------------------------------------------------------
 static inline void USB_SetAddress(uint8_t adr)
 {
@@ -209,6 +227,36 @@ void MarkBufferTxReady(int ep)
 	USB_EpRegs(ep) = (data ^ STAT_TX) & mask;
 }
 
+//-----------------------------------------------------------------------------
+// toggle the given DTOG/STAT bits, without touching the others
+//-----------------------------------------------------------------------------
+static inline void ToggleEpBits(int ep, uint32_t bits)
+{
+	uint32_t data = USB_EpRegs(ep);
+	USB_EpRegs(ep) = (data & EP_MASK_NoToggleBits) | CTR_RX | CTR_TX | bits;
+}
+
+//-----------------------------------------------------------------------------
+// (re)start the double buffered bulk EPs from their initial state
+//-----------------------------------------------------------------------------
+static void InitDataEndpoint(int ep, uint32_t toggleBits)
+{
+	USB_EpRegs(ep) = EP_KIND | ep; // EP_TYPE = 0, Bulk; EP_KIND = 1, double buffered
+	uint32_t data = USB_EpRegs(ep);
+	ToggleEpBits(ep, (data ^ toggleBits) & (DTOG_RX|STAT_RX|DTOG_TX|STAT_TX));
+}
+
+void InitDataEndpoints(void)
+{
+	transmitting = false;
+	txReady = false;
+	receiving = true;
+	// IN: Tx valid, DTOG_TX = SW_BUF = 0, NAK until the first buffer is released
+	InitDataEndpoint(EP_DATA_IN, (3 << 4));
+	// OUT: Rx valid, DTOG_RX = 0, SW_BUF = 1, the USB may fill buffer 0
+	InitDataEndpoint(EP_DATA_OUT, (3 << 12) | DTOG_TX);
+}
+
 //-----------------------------------------------------------------------------
 // initialize the EPs
 //-----------------------------------------------------------------------------
@@ -227,7 +275,7 @@ void InitEndpoints(void)
 
 	// EP0 ist always reserved for control
 	// the other endpoints must match the numbers written in the descriptors
-	// see usb_desc.c: EP_DATA, EP_COMM
+	// see usb_desc.c: EP_DATA_IN, EP_DATA_OUT, EP_COMM
 
 	// EP0 = Control, IN und OUT
 	EpTable[EP_CTRL].txOffset = EP_CTRL_TX_OFFSET;
@@ -241,11 +289,17 @@ void InitEndpoints(void)
 	EpTable[EP_COMM].rxOffset = EP_COMM_RX_OFFSET;
 	EpTable[EP_COMM].rxCount = EP_RX_LEN_ID;
 
-	// EP2 = Bulk IN and OUT
-	EpTable[EP_DATA].txOffset = EP_DATA_TX_OFFSET;
-	EpTable[EP_DATA].txCount = 0;
-	EpTable[EP_DATA].rxOffset = EP_DATA_RX_OFFSET;
-	EpTable[EP_DATA].rxCount = EP_RX_LEN_ID;
+	// EP2 = Bulk IN, double buffered: both halves are Tx buffers
+	EpTable[EP_DATA_IN].txOffset = EP_DATA_TX0_OFFSET;
+	EpTable[EP_DATA_IN].txCount = 0;
+	EpTable[EP_DATA_IN].rxOffset = EP_DATA_TX1_OFFSET;
+	EpTable[EP_DATA_IN].rxCount = 0;
+
+	// EP3 = Bulk OUT, double buffered: both halves are Rx buffers
+	EpTable[EP_DATA_OUT].txOffset = EP_DATA_RX0_OFFSET;
+	EpTable[EP_DATA_OUT].txCount = EP_RX_LEN_ID;
+	EpTable[EP_DATA_OUT].rxOffset = EP_DATA_RX1_OFFSET;
+	EpTable[EP_DATA_OUT].rxCount = EP_RX_LEN_ID;
 
 	USB_BTABLE = EP_TABLE_OFFSET;
 
@@ -261,12 +315,8 @@ void InitEndpoints(void)
 		(2 << 4) |		// STAT_TX = 2, NAK
 		(3 << 9) |		// EP_TYPE = 3, INT
 		EP_COMM;
-	// DATA EP
-	USB_EP2R =			// EP2 = Bulk IN and OUT
-		(3 << 12) |		// STAT_RX = 3, Rx enabled
-		(2 << 4) |		// STAT_TX = 2, NAK
-		(0 << 9) |		// EP_TYPE = 0, Bulk
-		EP_DATA;
+	// DATA EPs
+	InitDataEndpoints();	// EP2 = Bulk IN, EP3 = Bulk OUT
 
 	USB_ISTR = 0;          // clear pending Interrupts
 	USB_CNTR =
@@ -462,7 +512,7 @@ void Req_GetStatus()
 	case USB_REQ_TYPE_ENDPOINT: // for an Endpoint
 	{
 		int ep = CMD.setupPacket.wIndex;
-		if ( (ep >= EP_CTRL) && (ep <= EP_DATA) )
+		if ( (ep >= EP_CTRL) && (ep < NUM_EP) )
 			buf[0] = 1;
 		break;
 	}
@@ -574,6 +624,7 @@ void Req_SetConfiguration()
 	{
 		USB_ConfigDevice(true);
 		USB_Start();
+		InitDataEndpoints();
 		CMD.configuration = CMD.setupPacket.wValue & 0xFF;
 		usb_state.configured = true;
 	}
@@ -597,6 +648,7 @@ void Req_GetInterface()
 void Req_SetInterface()
 {
 	USB_Start();
+	InitDataEndpoints();
 	ACK();
 }
 //-----------------------------------------------------------------------------
@@ -735,53 +787,167 @@ void OnEpCtrlIn(void) // Control-EP IN
 }
 
 //-----------------------------------------------------------------------------
-// Send data to USB host from ring buffer. Can send zero packets.
-// Special handling because of ring buffer pointer characteristics which
-// have to safeguard the read pointer against going out of boundary.
+// Copy a contiguous byte run into the PMA, which holds 16 bits per 32 bit word.
+// 'pending' carries a not yet written low byte between consecutive runs (-1: none).
 //-----------------------------------------------------------------------------
-void USB_BeginDataTx(void)
+static uint32* PMA_WriteRun(register uint32* wrPtr, register const uint8_t* p, uint16_t n, int32_t* pending)
 {
-	if ( transmitting==true ) return;
-
-	uint16_t count = rb_read_available(&usbTxRB);
-	if (count==0) return;
+	if ( n && *pending>=0 ) {
+		*wrPtr++ = (uint32)(*pending) | (*p++ << 8);
+		*pending = -1;
+		n--;
+	}
+	register int j = n/2;
+	while (j--) {
+		register uint32 val = p[0] | (p[1] << 8);
+		p += 2;
+		*wrPtr++ = val;
+	}
+	if (n&1)
+		*pending = *p;
+	return wrPtr;
+}
+//-----------------------------------------------------------------------------
+// Copy bytes from the PMA into a contiguous run, counterpart of PMA_WriteRun.
+//-----------------------------------------------------------------------------
+static uint32* PMA_ReadRun(register uint32* rdPtr, register uint8_t* p, uint16_t n, int32_t* pending)
+{
+	if ( n && *pending>=0 ) {
+		*p++ = (uint8_t)(*pending);
+		*pending = -1;
+		n--;
+	}
+	register int j = n/2;
+	while (j--) {
+		register uint32 val = *rdPtr++;
+		p[0] = val;
+		p[1] = val>>8;
+		p += 2;
+	}
+	if (n&1) {
+		register uint32 val = *rdPtr++;
+		*p = (uint8_t)val;
+		*pending = (val>>8) & 0xFF;
+	}
+	return rdPtr;
+}
+//-----------------------------------------------------------------------------
+// The application IN buffer is the one selected by SW_BUF (DTOG_RX of the IN EP).
+// Returns its PMA address and sets the matching count field.
+//-----------------------------------------------------------------------------
+static uint32* TxAppBuffer(uint32** count)
+{
+	if ( USB_EpRegs(EP_DATA_IN) & DTOG_RX ) {
+		*count = &EpTable[EP_DATA_IN].rxCount;
+		return (uint32*) EP_DATA_TX1_BUF_ADDRESS;
+	}
+	*count = &EpTable[EP_DATA_IN].txCount;
+	return (uint32*) EP_DATA_TX0_BUF_ADDRESS;
+}
+//-----------------------------------------------------------------------------
+// Hand the filled application buffer to the USB: toggle SW_BUF.
+// Only allowed while the USB has no buffer (DTOG_TX == SW_BUF).
+//-----------------------------------------------------------------------------
+static inline void TxRelease(void)
+{
+	ToggleEpBits(EP_DATA_IN, DTOG_RX);
+}
+//-----------------------------------------------------------------------------
+// Fill the application IN buffer from the ring buffer.
+// The data is copied directly out of the ring buffer windows into the PMA.
+//-----------------------------------------------------------------------------
+static bool TxFill(void)
+{
+	rb_span_t spans[2];
+	uint16_t count = rb_read_spans(&usbTxRB, spans);
+	if (count==0) return false;
 
-    transmitting = true;
 	if (count > EP_DATA_LEN)
 		count = EP_DATA_LEN;
 
-    EpTable[EP_DATA].txCount = count;
-
-    register uint32* wrPtr = (uint32*) EP_DATA_TX_BUF_ADDRESS;
-	register uint16_t temp_tail = usbTxRB.ptrs.tail;
-	register uint16 cap = usbTxRB.CAPACITY;
-	int j = count/2;
-	while (j--)
-	{
-	    register uint32 val;
-	    val = usbTxRB.buffer[temp_tail++];
-	    temp_tail &= cap;
-	    val |= (usbTxRB.buffer[temp_tail++] << 8);
-	    temp_tail &= cap;
-	    *wrPtr++ = val;
-	}
-	if (count&1) // send last odd byte if any
-	{
-		register uint32 val = usbTxRB.buffer[temp_tail++];
-		temp_tail &= cap;
-		*wrPtr = val;
+	uint32* countField;
+	register uint32* wrPtr = TxAppBuffer(&countField);
+	int32_t pending = -1;
+	uint16_t n = (count < spans[0].len) ? count : spans[0].len;
+	wrPtr = PMA_WriteRun(wrPtr, spans[0].ptr, n, &pending);
+	wrPtr = PMA_WriteRun(wrPtr, spans[1].ptr, count - n, &pending);
+	if (pending>=0) // send last odd byte if any
+		*wrPtr = pending;
+	*countField = count;
+	rb_read_finish(&usbTxRB, count); // update volatile ptr
+	return true;
+}
+//-----------------------------------------------------------------------------
+// Send data to USB host from ring buffer.
+// If the USB is idle, the first packet is released right away and the second
+// one is prepared in the other buffer, to be released from OnEpBulkIn().
+//-----------------------------------------------------------------------------
+void USB_BeginDataTx(void)
+{
+	uint32_t irq = SaveDisableUsbIRQ();
+	if ( transmitting==false ) {
+		if ( TxFill() ) {
+			TxRelease();
+			transmitting = true;
+			txReady = TxFill();
+		}
+	} else if ( txReady==false ) {
+		txReady = TxFill();
 	}
-	usbTxRB.ptrs.tail = temp_tail; // update volatile ptr
-
-    MarkBufferTxReady(EP_DATA);
+	RestoreUsbIRQ(irq);
 }
 //-----------------------------------------------------------------------------
-// Request for data to be transmitted to host via EP_DATA IN
+// Zero copy write: copies whole packets from buf straight into the free IN
+// buffers, skipping the ring buffer. Only done while the ring buffer is empty,
+// to keep the byte order. Returns the number of bytes taken.
+//-----------------------------------------------------------------------------
+uint32 USB_WriteDataDirect(const uint8_t* buf, uint32 len)
+{
+	uint32 done = 0;
+	uint32_t irq = SaveDisableUsbIRQ();
+
+	if ( rb_is_empty(&usbTxRB) ) {
+		while ( (len - done) >= EP_DATA_LEN && txReady==false ) {
+			uint32* countField;
+			int32_t pending = -1;
+			PMA_WriteRun(TxAppBuffer(&countField), buf + done, EP_DATA_LEN, &pending);
+			*countField = EP_DATA_LEN;
+			done += EP_DATA_LEN;
+			if ( transmitting==false ) {
+				TxRelease();
+				transmitting = true;
+			} else {
+				txReady = true;
+			}
+		}
+	}
+	RestoreUsbIRQ(irq);
+	return done;
+}
+//-----------------------------------------------------------------------------
+// A packet was sent to the host via EP_DATA_IN: the USB now waits on SW_BUF,
+// release the prepared buffer first, then prepare the next one.
 //-----------------------------------------------------------------------------
 void OnEpBulkIn(void)
 {
-	transmitting = false;
-	USB_BeginDataTx();
+	if ( txReady==true ) {
+		TxRelease();
+		txReady = TxFill();
+	} else {
+		transmitting = false;
+		if ( TxFill() ) {
+			TxRelease();
+			transmitting = true;
+		}
+	}
+}
+//-----------------------------------------------------------------------------
+// Give the USB the other OUT buffer: toggle SW_BUF (DTOG_TX of the OUT EP)
+//-----------------------------------------------------------------------------
+static inline void RxRelease(void)
+{
+	receiving = true;
+	ToggleEpBits(EP_DATA_OUT, DTOG_TX);
 }
 //-----------------------------------------------------------------------------
 // re-starts Rx process if previously NAK-ed
@@ -790,54 +956,47 @@ void USB_BeginDataRx(void)
 {
 	if ( ( receiving==false ) && ( rb_write_available(&usbRxRB) >= EP_DATA_LEN ) )
 	{
-		MarkBufferRxDone(EP_DATA); // set Rx buffer free for next data
+		RxRelease(); // set Rx buffer free for next data
 	}
 }
 //-----------------------------------------------------------------------------
-// Read received bytes and write them directly into the ring buffer
-// This need special handling due to the "ring" characteristic,
-// to safeguard the write pointer against going out of boundary
+// Read received bytes and write them directly into the ring buffer windows.
+// The USB has toggled DTOG_RX and NAKs until SW_BUF is toggled; if there is room
+// for one more packet, the other buffer is released before this one is copied.
 //-----------------------------------------------------------------------------
 void OnEpBulkOut(void)
 {
-	receiving = false;
-	// read number of available bytes
-	uint16_t rxd = EpTable[EP_DATA].rxCount & 0x3FF;
+	register uint32 * rdPtr;
+	uint16_t rxd;
+	if ( USB_EpRegs(EP_DATA_OUT) & DTOG_RX ) { // buffer 0 was filled
+		rdPtr = (uint32*) EP_DATA_RX0_BUF_ADDRESS;
+		rxd = EpTable[EP_DATA_OUT].txCount & 0x3FF;
+	} else {
+		rdPtr = (uint32*) EP_DATA_RX1_BUF_ADDRESS;
+		rxd = EpTable[EP_DATA_OUT].rxCount & 0x3FF;
+	}
 
-	register rb_ptrs_t temp = { usbRxRB.ptrs.both };
-	register uint16_t cap = usbRxRB.CAPACITY;
-	uint16_t room = (temp.tail - temp.head - 1) & cap; // available space in buffer
+	rb_span_t spans[2];
+	uint16_t room = rb_write_spans(&usbRxRB, spans); // available space in buffer
+	if ( room >= (rxd + EP_DATA_LEN) ) // is there enough room for a next full data packet
+	{
+		RxRelease(); // let the USB fill the other buffer meanwhile
+	}
+	else
+	{
+		receiving = false; // EP replies NAK until USB_BeginDataRx()
+	}
 	if (room < rxd)
 	{ // not enough space for data
 		return;
 	}
-	register uint16 temp_head = temp.head;
 	// store the received bytes directly into the ring buffer
-	// special handling due to nature of the ring buffer (size=power of 2)
-	register uint32 * rdPtr = (uint32*) EP_DATA_RX_BUF_ADDRESS;
-	uint16_t i = rxd/2;
-	while (i--) {
-		register uint32 val = *rdPtr++;
-		usbRxRB.buffer[temp_head++] = val;
-		temp_head &= cap;
-		usbRxRB.buffer[temp_head++] = val>>8;
-		temp_head &= cap;
-	}
-	if (rxd&1) { // for a last odd byte
-		register uint32 val = *rdPtr;
-		usbRxRB.buffer[temp_head++] = (uint8)val;
-		temp_head &= cap;
-	}
-	usbRxRB.ptrs.head = temp_head; // update volatile ptr
+	int32_t pending = -1;
+	uint16_t n = (rxd < spans[0].len) ? rxd : spans[0].len;
+	rdPtr = PMA_ReadRun(rdPtr, spans[0].ptr, n, &pending);
+	PMA_ReadRun(rdPtr, spans[1].ptr, rxd - n, &pending);
+	rb_write_finish(&usbRxRB, rxd); // update volatile ptr
 
-    if ( room >= (rxd + EP_DATA_LEN) ) // is there enough room for a next full data packet
-    {
-		MarkBufferRxDone(EP_DATA); // set Rx buffer free for next data packet
-    }
-    else
-    {
-        // EP reply NAK (automatically set by HW)
-    }
     if (dataHook!=NULL) dataHook();
 }
 
@@ -894,7 +1053,7 @@ void NAME_OF_USB_IRQ_HANDLER(void)
 						OnEpCtrlOut(); // finished TX on CTRL endpoint
 					}
 				}
-				else if (ep == EP_DATA)
+				else if (ep == EP_DATA_OUT)
 				{
 					OnEpBulkOut();
 				}
@@ -920,7 +1079,7 @@ void NAME_OF_USB_IRQ_HANDLER(void)
 				{
 					OnEpCtrlIn();
 				}
-				else if (ep == EP_DATA)
+				else if (ep == EP_DATA_IN)
 				{
 					OnEpBulkIn();
 				}
@@ -88,10 +88,13 @@ bool usb_cdcacm_write(char c)
     return true;
 }
 
-// Transmits a string over the USB serial interface
+// Transmits a string over the USB serial interface.
+// Whole packets go straight into the endpoint buffers when they are free,
+// the rest through the transmit ring buffer.
 uint32 usb_cdcacm_tx(const uint8* buf, uint32 len)
 {
-	uint32 ret = rb_write_safe_n(&usbTxRB, buf, len);
+	uint32 ret = USB_WriteDataDirect(buf, len);
+	ret += rb_write_safe_n(&usbTxRB, buf + ret, len - ret);
 
 	USB_BeginDataTx();
 
@@ -42,8 +42,12 @@ extern "C" {
 #endif
 
 
-#define USB_RX_BUF_SIZE		256 // must be power of 2 !!!
-#define USB_TX_BUF_SIZE		256 // must be power of 2 !!!
+#ifndef USB_RX_BUF_SIZE
+#define USB_RX_BUF_SIZE		1024 // must be power of 2 !!!
+#endif
+#ifndef USB_TX_BUF_SIZE
+#define USB_TX_BUF_SIZE		1024 // must be power of 2 !!!
+#endif
 /*
  * CDC ACM interface
  */
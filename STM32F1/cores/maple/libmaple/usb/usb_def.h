@@ -156,18 +156,23 @@
  Layout:
  Control_In   64 bytes
  Control_Out  64 bytes
- Bulk_In_A    64 bytes (evtl. DoubleBuffered)
- Bulk_In_B    64 bytes
- Bulk_Out_A   64 bytes (evtl. DoubleBuffered)
- Bulk_Out_B   64 bytes
- Int_In        8 bytes (not used)
+ Int_In        8 bytes
  Int_Out       8 bytes (not used)
+ Bulk_In_0    64 bytes (double buffered)
+ Bulk_In_1    64 bytes
+ Bulk_Out_0   64 bytes (double buffered)
+ Bulk_Out_1   64 bytes
  -----------------------
  total       400 bytes
 
- At the end comes the EP table pointed by USB_BTABLE with 4 entries (Control, BulkIn, BuklOut, Int)
- each entry having 4 bytes = 64.
- Total RAM occupation is therefore 464 bytes.
+ At the end comes the EP table pointed by USB_BTABLE with 4 entries (Control, Int, BulkIn, BulkOut)
+ each entry having 4 half words = 8 bytes.
+ Total RAM occupation is therefore 432 bytes.
+
+ A double buffered EP uses both halves of its EP table entry for one direction:
+ the TX half describes buffer 0, the RX half buffer 1. The USB works on the buffer
+ selected by its DTOG bit, the application on the one selected by SW_BUF, which is
+ the DTOG bit of the other direction. While DTOG == SW_BUF the EP NAKs.
  */
 #define EP_DATA_LEN   64
 
@@ -186,9 +191,13 @@
 #define EP_COMM_TX_OFFSET  (EP_CTRL_RX_OFFSET + EP_DATA_LEN) //128    // +64 Bytes
 #define EP_COMM_RX_OFFSET  (EP_COMM_TX_OFFSET + EP_INT_MAX_LEN) //136    // +8 Bytes
 
-// EP2 = Bulk-IN+OUT for DATA
-#define EP_DATA_TX_OFFSET  (EP_COMM_RX_OFFSET + EP_INT_MAX_LEN) //144    // +8 Bytes
-#define EP_DATA_RX_OFFSET  (EP_DATA_TX_OFFSET + EP_DATA_LEN) //208    // +64 Bytes
+// EP2 = Bulk-IN for DATA, double buffered
+#define EP_DATA_TX0_OFFSET  (EP_COMM_RX_OFFSET + EP_INT_MAX_LEN) //144    // +8 Bytes
+#define EP_DATA_TX1_OFFSET  (EP_DATA_TX0_OFFSET + EP_DATA_LEN) //208    // +64 Bytes
+
+// EP3 = Bulk-OUT for DATA, double buffered
+#define EP_DATA_RX0_OFFSET  (EP_DATA_TX1_OFFSET + EP_DATA_LEN) //272    // +64 Bytes
+#define EP_DATA_RX1_OFFSET  (EP_DATA_RX0_OFFSET + EP_DATA_LEN) //336    // +64 Bytes
 
 
 // Allocation of the EP buffers
@@ -200,8 +209,10 @@
 #define EP_COMM_TX_BUF_ADDRESS	(USB_RAM + (EP_COMM_TX_OFFSET<<UMEM_SHIFT))
 #define EP_COMM_RX_BUF_ADDRESS	(USB_RAM + (EP_COMM_RX_OFFSET<<UMEM_SHIFT))
 
-#define EP_DATA_TX_BUF_ADDRESS	(USB_RAM + (EP_DATA_TX_OFFSET<<UMEM_SHIFT))
-#define EP_DATA_RX_BUF_ADDRESS	(USB_RAM + (EP_DATA_RX_OFFSET<<UMEM_SHIFT))
+#define EP_DATA_TX0_BUF_ADDRESS	(USB_RAM + (EP_DATA_TX0_OFFSET<<UMEM_SHIFT))
+#define EP_DATA_TX1_BUF_ADDRESS	(USB_RAM + (EP_DATA_TX1_OFFSET<<UMEM_SHIFT))
+#define EP_DATA_RX0_BUF_ADDRESS	(USB_RAM + (EP_DATA_RX0_OFFSET<<UMEM_SHIFT))
+#define EP_DATA_RX1_BUF_ADDRESS	(USB_RAM + (EP_DATA_RX1_OFFSET<<UMEM_SHIFT))
 
 
 // EP table
@@ -217,9 +228,9 @@ typedef struct epTableAddress_t {
     uint32 * txAddr;
     uint32 * rxAddr;
 } epTableAddress_t;
-extern const epTableAddress_t epTableAddr[3]; // number of EPs
+extern const epTableAddress_t epTableAddr[4]; // number of EPs
 
-#define EP_TABLE_OFFSET		400    // storing 64 bytes after 400
+#define EP_TABLE_OFFSET		400    // storing 32 bytes after 400
 
 #define EpTable   ((epTableEntry_t *) (USB_RAM + (EP_TABLE_OFFSET<<UMEM_SHIFT)))
 
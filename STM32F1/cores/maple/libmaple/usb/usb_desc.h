@@ -18,7 +18,8 @@
 #endif
 
 // assignment of the USB EP numbers - bEndpointAddress
-enum { EP_CTRL, EP_COMM, EP_DATA, NUM_EP };
+// the bulk data EPs are double buffered, which takes one EP per direction
+enum { EP_CTRL, EP_COMM, EP_DATA_IN, EP_DATA_OUT, NUM_EP };
 
 #define NUM_IFACES	2 // COMM + DATA
 
@@ -26,8 +27,8 @@ enum { EP_CTRL, EP_COMM, EP_DATA, NUM_EP };
 #define EP_CTRL_ADDR_OUT	USB_EP_ADDR_OUT(EP_CTRL)
 #define EP_COMM_ADDR_IN		USB_EP_ADDR_IN(EP_COMM)
 #define EP_COMM_ADDR_OUT	USB_EP_ADDR_OUT(EP_COMM)
-#define EP_DATA_ADDR_IN		USB_EP_ADDR_IN(EP_DATA)
-#define EP_DATA_ADDR_OUT	USB_EP_ADDR_OUT(EP_DATA)
+#define EP_DATA_ADDR_IN		USB_EP_ADDR_IN(EP_DATA_IN)
+#define EP_DATA_ADDR_OUT	USB_EP_ADDR_OUT(EP_DATA_OUT)
 
 
 #endif /* USB_DESC_H_ */
@@ -38,6 +38,7 @@ extern void EnableUsbIRQ();
 extern void DisableUsbIRQ();
 extern void USB_BeginDataTx(); // called when Tx data has to be sent
 extern void USB_BeginDataRx(); // called when Rx data can be received again
+extern uint32 USB_WriteDataDirect(const uint8_t* buf, uint32 len); // whole packets straight into the PMA
 
 
 
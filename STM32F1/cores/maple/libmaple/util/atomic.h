@@ -18,6 +18,15 @@
 #ifndef _CORTEX_M3_ATOMIC_H_
 #define _CORTEX_M3_ATOMIC_H_
 
+#ifdef LIBMAPLE_ISR_PROFILE
+#include <libmaple/isr_profile.h>
+#define __ISR_PROFILE_CS_ENTER()    isr_profile_cs_enter()
+#define __ISR_PROFILE_CS_EXIT(s)    do { if (!(s)) isr_profile_cs_exit(); } while (0)
+#else
+#define __ISR_PROFILE_CS_ENTER()    do { } while (0)
+#define __ISR_PROFILE_CS_EXIT(s)    do { } while (0)
+#endif
+
 static __inline__ uint32_t __get_primask(void) \
 { uint32_t primask = 0; \
   __asm__ volatile ("MRS %[result], PRIMASK\n\t":[result]"=r"(primask)::); \
@@ -28,25 +37,54 @@ static __inline__ void __set_primask(uint32_t setval) \
   __asm__ volatile ("" ::: "memory");}
 
 static __inline__ uint32_t __iSeiRetVal(void) \
-{ __asm__ volatile ("CPSIE i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
+{ __ISR_PROFILE_CS_EXIT(0); __asm__ volatile ("CPSIE i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
   __asm__ volatile ("" ::: "memory"); return 1; }
 
 static __inline__ uint32_t __iCliRetVal(void) \
 { __asm__ volatile ("CPSID i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
-  __asm__ volatile ("" ::: "memory"); return 1; }
+  __asm__ volatile ("" ::: "memory"); __ISR_PROFILE_CS_ENTER(); return 1; }
 
 static __inline__ void    __iSeiParam(const uint32_t *__s) \
-{ __asm__ volatile ("CPSIE i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
+{ __ISR_PROFILE_CS_EXIT(0); __asm__ volatile ("CPSIE i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
   __asm__ volatile ("" ::: "memory"); (void)__s; }
 
 static __inline__ void    __iCliParam(const uint32_t *__s) \
 { __asm__ volatile ("CPSID i\n\t""dmb\n\t""dsb\n\t""isb\n\t"); \
-  __asm__ volatile ("" ::: "memory"); (void)__s; }
+  __asm__ volatile ("" ::: "memory"); __ISR_PROFILE_CS_ENTER(); (void)__s; }
 
 static __inline__ void    __iRestore(const  uint32_t *__s) \
-{ __set_primask(*__s); __asm__ volatile ("dmb\n\t""dsb\n\t""isb\n\t"); \
+{ __ISR_PROFILE_CS_EXIT(*__s); __set_primask(*__s); __asm__ volatile ("dmb\n\t""dsb\n\t""isb\n\t"); \
   __asm__ volatile ("" ::: "memory"); }
 
+/* Exclusive access, for lock-free updates without masking interrupts.
+ * Exception entry and return clear the exclusive monitor, so a store
+ * fails if the sequence was preempted. */
+static __inline__ uint32_t __ldrexw(volatile uint32_t *addr) \
+{ uint32_t result; \
+  __asm__ volatile ("ldrex %0, [%1]" : "=r"(result) : "r"(addr) : "memory"); \
+  return result; }
+
+static __inline__ uint32_t __strexw(uint32_t value, volatile uint32_t *addr) \
+{ uint32_t result; \
+  __asm__ volatile ("strex %0, %2, [%1]" : "=&r"(result) : "r"(addr), "r"(value) : "memory"); \
+  return result; } // returns 0 on success
+
+static __inline__ void __clrex(void) \
+{ __asm__ volatile ("clrex" ::: "memory"); }
+
+/* Data memory barrier, orders the slot writes of lock-free queues */
+static __inline__ void __dmb(void) \
+{ __asm__ volatile ("dmb" ::: "memory"); }
+
+/* Compare and swap; returns the previous value, *addr is set to
+ * newval only if it was equal to oldval. */
+static __inline__ uint32_t __cas32(volatile uint32_t *addr, uint32_t oldval, uint32_t newval) \
+{ uint32_t cur; \
+  do { cur = __ldrexw(addr); \
+       if (cur != oldval) { __clrex(); break; } \
+  } while (__strexw(newval, addr)); \
+  return cur; }
+
 
 #define ATOMIC_BLOCK(type) \
 for ( type, __ToDo = __iCliRetVal(); __ToDo ; __ToDo = 0 )
@@ -35,4 +35,12 @@ uint32_t pulseIn( uint32_t ulPin, uint32_t ulState, uint32_t ulTimeout = 1000000
 
 #define pulseInLong pulseIn
 
+/*
+ * pulseIn() on the timer input capture hardware, for pins on channel 1
+ * or 2 of a timer (see PulseCapture.h); other pins fall back to
+ * pulseIn(). Timer resolution and interrupts do not affect the result,
+ * but the timer of the pin is reconfigured.
+ */
+uint32_t pulseInCapture( uint32_t ulPin, uint32_t ulState, uint32_t ulTimeout = 1000000L ) ;
+
 #endif
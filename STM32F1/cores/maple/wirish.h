@@ -53,6 +53,8 @@
 
 #include <boards.h>
 #include <io.h>
+#include <FastPin.h>
+#include <PortBus.h>
 #include <bit_constants.h>
 #include <pwm.h>
 #include <ext_interrupts.h>
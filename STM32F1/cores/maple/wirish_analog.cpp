@@ -34,14 +34,45 @@
 #include <libmaple/adc.h>
 #include "boards.h"
 
+/* Set by analogReadCache() while a background scan is running */
+static const volatile uint16 *analog_values;
+static const volatile uint32 *analog_stamps;
+
+uint8 analogPinChannel(uint8 pin)
+{
+    if ( (pin>PB1) || ((pin<PB0) && (pin>PA7)) ) {
+        return ADCx;
+    }
+    return (pin<PA8) ? pin : (pin-8);
+}
+
+void analogReadCache(const volatile uint16 *values, const volatile uint32 *stamps)
+{
+    analog_values = NULL;
+    analog_stamps = stamps;
+    analog_values = values;
+}
+
 /* Unlike Wiring and Arduino, this assumes that the pin's mode is set
  * to INPUT_ANALOG. That's faster, but it does require some extra work
  * on the user's part. Not too much, we think ;). */
 uint16 analogRead(uint8 pin)
 {
-    if ( (pin>PB1) || ((pin<PB0) && (pin>PA7)) ) {
+    uint8 adc_chan = analogPinChannel(pin);
+    if (adc_chan == ADCx) {
         return 0;
     }
-    uint8 adc_chan = (pin<PA8) ? pin : (pin-8);
+    if (analog_values) {
+        return analog_values[adc_chan];
+    }
     return adc_read(ADC1, adc_chan);
 }
+
+uint32 analogReadTimestamp(uint8 pin)
+{
+    uint8 adc_chan = analogPinChannel(pin);
+    if (adc_chan == ADCx || !analog_values) {
+        return 0;
+    }
+    return analog_stamps[adc_chan];
+}
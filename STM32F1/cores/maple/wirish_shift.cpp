@@ -25,38 +25,353 @@
  *****************************************************************************/
 
 #include "wirish.h"
+#include <libmaple/dma.h>
+#include <libmaple/spi.h>
+#include <libmaple/timer.h>
+
+/* Highest SPI clock shiftOutBuffer()/shiftInBuffer() use */
+#ifndef SHIFT_SPI_MAX_HZ
+#define SHIFT_SPI_MAX_HZ        4500000
+#endif
+
+/* Timer, update DMA request and BSRR write rate of the DMA bitstream;
+ * the shift clock is half the rate */
+#ifndef SHIFT_DMA_TIMER
+#define SHIFT_DMA_TIMER         TIMER4
+#define SHIFT_DMA_TIMER_REQ     DMA_REQ_SRC_TIM4_UP
+#endif
+#ifndef SHIFT_DMA_HZ
+#define SHIFT_DMA_HZ            2000000
+#endif
+/* Bytes per half of the bitstream buffer, 64 bytes of stack each */
+#ifndef SHIFT_DMA_CHUNK
+#define SHIFT_DMA_CHUNK         8
+#endif
+
+/* Minimum clock high and low time of the bit-banged shift functions.
+ * The default suits 74HC595/74HC165 style registers down to 3.3 V. */
+#ifndef SHIFT_CLOCK_NS
+#define SHIFT_CLOCK_NS          100
+#endif
+
+#define SHIFT_TIMER_HZ          (CYCLES_PER_MICROSECOND * 1000000UL)
+/* A wait loop iteration takes at least 3 cycles */
+#define SHIFT_CLOCK_LOOPS       ((SHIFT_CLOCK_NS * CYCLES_PER_MICROSECOND + 2999) / 3000)
+
+/* Data and clock pins resolved once per call */
+typedef struct shift_pins {
+    gpio_reg_map *data;
+    gpio_reg_map *clk;
+    uint32 dataMask;
+    uint32 clkMask;
+} shift_pins;
+
+static inline void shift_pins_init(shift_pins *p, uint8 dataPin, uint8 clockPin) {
+    p->data = gpio_devs[dataPin / 16]->regs;
+    p->clk = gpio_devs[clockPin / 16]->regs;
+    p->dataMask = 1U << (dataPin % 16);
+    p->clkMask = 1U << (clockPin % 16);
+}
+
+static inline void shift_clock_wait(void) {
+    for (uint32 n = SHIFT_CLOCK_LOOPS; n > 0; n--) {
+        asm volatile("nop");
+    }
+}
+
+/* The wait before the rising edge is the data setup and clock low time */
+static inline void shift_out_byte(const shift_pins *p, uint8 bitOrder, uint8 value) {
+    for (uint8 i = 0; i < 8; i++) {
+        uint8 bit = bitOrder == LSBFIRST ? (value >> i) & 1 : (value >> (7 - i)) & 1;
+        p->data->BSRR = bit ? p->dataMask : p->dataMask << 16;
+        shift_clock_wait();
+        p->clk->BSRR = p->clkMask;
+        shift_clock_wait();
+        p->clk->BRR = p->clkMask;
+    }
+}
+
+/* Reads the data pin at the end of the clock high time, like shiftIn() */
+static inline uint8 shift_in_byte(const shift_pins *p, uint8 bitOrder) {
+    uint8 value = 0;
+    for (uint8 i = 0; i < 8; i++) {
+        p->clk->BSRR = p->clkMask;
+        shift_clock_wait();
+        uint8 bit = (p->data->IDR & p->dataMask) ? 1 : 0;
+        p->clk->BRR = p->clkMask;
+        shift_clock_wait();
+        value |= bitOrder == LSBFIRST ? bit << i : bit << (7 - i);
+    }
+    return value;
+}
 
 void shiftOut(uint8 dataPin, uint8 clockPin, uint8 bitOrder, uint8 value) {
-    digitalWrite(clockPin, LOW);
-    for (int i = 0; i < 8; i++) {
-        int bit = bitOrder == LSBFIRST ? i : (7 - i);
-        digitalWrite(dataPin, (value >> bit) & 0x1);
-		gpio_toggle_pin(clockPin);// togglePin(clockPin);
-		gpio_toggle_pin(clockPin);// togglePin(clockPin);
+    shift_pins p;
+    if (dataPin >= BOARD_NR_GPIO_PINS || clockPin >= BOARD_NR_GPIO_PINS) {
+        return;
     }
+    shift_pins_init(&p, dataPin, clockPin);
+    p.clk->BRR = p.clkMask;
+    shift_out_byte(&p, bitOrder, value);
 }
 
 uint32_t shiftIn( uint32_t ulDataPin, uint32_t ulClockPin, uint32_t ulBitOrder )
 {
-  uint8_t value = 0 ;
-  uint8_t i ;
+    shift_pins p;
+    if (ulDataPin >= BOARD_NR_GPIO_PINS || ulClockPin >= BOARD_NR_GPIO_PINS) {
+        return 0;
+    }
+    shift_pins_init(&p, ulDataPin, ulClockPin);
+    return shift_in_byte(&p, ulBitOrder);
+}
+
+/*
+ * Hardware SPI with DMA, when the pins are the SCK and MOSI (out) or
+ * MISO (in) pins of a SPI port that is not in use.
+ */
+
+typedef struct shift_spi_port {
+    spi_dev *dev;
+    uint8 sck, mosi, miso;
+    uint32 pclk;
+    dma_request_src tx, rx;
+} shift_spi_port;
+
+static const shift_spi_port shift_spi_ports[] = {
+#ifdef BOARD_SPI1_SCK_PIN
+    { SPI1, BOARD_SPI1_SCK_PIN, BOARD_SPI1_MOSI_PIN, BOARD_SPI1_MISO_PIN,
+      SHIFT_TIMER_HZ, DMA_REQ_SRC_SPI1_TX, DMA_REQ_SRC_SPI1_RX },
+#endif
+#ifdef BOARD_SPI2_SCK_PIN
+    { SPI2, BOARD_SPI2_SCK_PIN, BOARD_SPI2_MOSI_PIN, BOARD_SPI2_MISO_PIN,
+      SHIFT_TIMER_HZ / 2, DMA_REQ_SRC_SPI2_TX, DMA_REQ_SRC_SPI2_RX },
+#endif
+};
+
+static void shift_dma_cfg(dma_tube tube, dma_request_src src, __IO void *from,
+                          __IO void *to, uint32 flags, uint16 count) {
+    dma_tube_config cfg;
+    cfg.tube_src = from;
+    cfg.tube_src_size = DMA_SIZE_8BITS;
+    cfg.tube_dst = to;
+    cfg.tube_dst_size = DMA_SIZE_8BITS;
+    cfg.tube_nr_xfers = count;
+    cfg.tube_flags = flags;
+    cfg.tube_req_src = src;
+    dma_tube_cfg(DMA1, tube, &cfg);
+}
+
+static bool shift_spi(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                      uint8 *buf, uint32 len, bool in) {
+    const shift_spi_port *p = NULL;
+    for (uint8 i = 0; i < sizeof(shift_spi_ports) / sizeof(shift_spi_ports[0]); i++) {
+        if (shift_spi_ports[i].sck == clockPin &&
+            (in ? shift_spi_ports[i].miso : shift_spi_ports[i].mosi) == dataPin) {
+            p = &shift_spi_ports[i];
+        }
+    }
+    dma_tube tx = (dma_tube)(p ? p->tx & 0x7 : 0);
+    dma_tube rx = (dma_tube)(p ? p->rx & 0x7 : 0);
+    if (!p || spi_is_enabled(p->dev) || dma_is_enabled(DMA1, tx) ||
+        (in && dma_is_enabled(DMA1, rx))) {
+        return false;
+    }
 
-  
-  for ( i=0 ; i < 8 ; ++i )
-  {
-    digitalWrite( ulClockPin, HIGH ) ;
+    uint8 br = 0;
+    while ((p->pclk >> (br + 1)) > SHIFT_SPI_MAX_HZ && br < 7) {
+        br++;
+    }
+    /* shiftIn() samples after the rising edge, hence mode 1 for input */
+    spi_init(p->dev);
+    spi_master_enable(p->dev, (spi_baud_rate)(br << 3), in ? SPI_MODE_1 : SPI_MODE_0,
+                      SPI_DFF_8_BIT | SPI_SW_SLAVE | SPI_SOFT_SS |
+                      (bitOrder == LSBFIRST ? SPI_FRAME_LSB : SPI_FRAME_MSB));
+    gpio_set_pin_mode(clockPin, GPIO_AF_OUTPUT_PP);
+    if (!in) {
+        gpio_set_pin_mode(dataPin, GPIO_AF_OUTPUT_PP);
+    }
+    dma_init(DMA1);
+
+    __IO void *dr = &p->dev->regs->DR;
+    uint8 dummy = 0xFF;
+    while (len) {
+        uint16 n = len > 0xFFFF ? 0xFFFF : (uint16)len;
+        if (in) {
+            /* the received bytes go to buf, the clock comes from sending dummies */
+            shift_dma_cfg(rx, p->rx, dr, buf, DMA_CFG_DST_INC, n);
+            shift_dma_cfg(tx, p->tx, &dummy, dr, 0, n);
+            spi_rx_dma_enable(p->dev);
+            dma_enable(DMA1, rx);
+        } else {
+            shift_dma_cfg(tx, p->tx, buf, dr, DMA_CFG_SRC_INC, n);
+        }
+        dma_enable(DMA1, tx);
+        spi_tx_dma_enable(p->dev);
+        dma_tube done = in ? rx : tx;
+        while (!(dma_get_isr_bits(DMA1, done) & 0x2)) {
+        }
+        while (!spi_is_tx_empty(p->dev) || spi_is_busy(p->dev)) {
+        }
+        spi_tx_dma_disable(p->dev);
+        spi_rx_dma_disable(p->dev);
+        dma_disable(DMA1, tx);
+        dma_clear_isr_bits(DMA1, tx);
+        if (in) {
+            dma_disable(DMA1, rx);
+            dma_clear_isr_bits(DMA1, rx);
+        }
+        buf += n;
+        len -= n;
+    }
+
+    spi_peripheral_disable(p->dev);
+    gpio_write_pin(clockPin, LOW);
+    gpio_set_pin_mode(clockPin, GPIO_OUTPUT_PP);
+    if (!in) {
+        gpio_set_pin_mode(dataPin, GPIO_OUTPUT_PP);
+    }
+    return true;
+}
+
+/*
+ * Timer paced DMA to BSRR, when the data and clock pins are on the same
+ * port. Each bit is two BSRR words, data with the clock low, then the
+ * clock high. A circular buffer of two halves is refilled as the DMA
+ * goes, so an interrupt that blocks for longer than a half buffer
+ * (SHIFT_DMA_CHUNK * 16 words) corrupts the stream.
+ */
+
+#define SHIFT_DMA_HALF          (SHIFT_DMA_CHUNK * 16)
+
+typedef struct shift_stream {
+    const uint8 *buf;
+    uint32 len;
+    uint32 word;                /* next word of the stream */
+    uint32 dataMask, clkMask;
+    uint8 bitOrder;
+} shift_stream;
+
+/* Next half buffer of the stream: len * 16 bit words, a clock low word,
+ * then zeros, which don't change any pin */
+static void shift_stream_fill(shift_stream *s, uint32 *out) {
+    for (uint16 i = 0; i < SHIFT_DMA_HALF; i++, s->word++) {
+        uint32 w = s->word;
+        if (w < s->len * 16) {
+            if (w & 1) {
+                out[i] = s->clkMask;
+            } else {
+                uint8 value = s->buf[w >> 4], k = (w >> 1) & 7;
+                uint8 bit = s->bitOrder == LSBFIRST ? (value >> k) & 1 : (value >> (7 - k)) & 1;
+                out[i] = (s->clkMask << 16) | (bit ? s->dataMask : s->dataMask << 16);
+            }
+        } else {
+            out[i] = w == s->len * 16 ? s->clkMask << 16 : 0;
+        }
+    }
+}
 
-    if ( ulBitOrder == LSBFIRST )
-    {
-      value |= digitalRead( ulDataPin ) << i ;
+static bool shift_out_dma(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                          const uint8 *buf, uint32 len) {
+    timer_dev *dev = SHIFT_DMA_TIMER;
+    timer_gen_reg_map *regs = dev->regs.gen;
+    dma_tube tube = (dma_tube)(SHIFT_DMA_TIMER_REQ & 0x7);
+    uint32 period = SHIFT_TIMER_HZ / SHIFT_DMA_HZ;
+    if (dataPin / 16 != clockPin / 16 || (regs->CR1 & TIMER_CR1_CEN) ||
+        dma_is_enabled(DMA1, tube) || period < 2 || period > 0x10000) {
+        return false;
     }
-    else
-    {
-      value |= digitalRead( ulDataPin ) << (7 - i) ;
+
+    uint32 words[2 * SHIFT_DMA_HALF];
+    shift_stream s;
+    s.buf = buf;
+    s.len = len;
+    s.word = 0;
+    s.dataMask = 1U << (dataPin % 16);
+    s.clkMask = 1U << (clockPin % 16);
+    s.bitOrder = bitOrder;
+    shift_stream_fill(&s, words);
+    shift_stream_fill(&s, words + SHIFT_DMA_HALF);
+
+    /* the timer isn't running, but may be set up: keep its settings */
+    uint16 psc = regs->PSC, arr = regs->ARR;
+    uint32 dier = regs->DIER;
+    regs->DIER = 0;
+    timer_set_prescaler(dev, 0);
+    timer_set_reload(dev, period - 1);
+    timer_generate_update(dev);
+
+    dma_tube_config cfg;
+    cfg.tube_src = words;
+    cfg.tube_src_size = DMA_SIZE_32BITS;
+    cfg.tube_dst = &gpio_devs[clockPin / 16]->regs->BSRR;
+    cfg.tube_dst_size = DMA_SIZE_32BITS;
+    cfg.tube_nr_xfers = 2 * SHIFT_DMA_HALF;
+    cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC;
+    cfg.tube_req_src = SHIFT_DMA_TIMER_REQ;
+    dma_init(DMA1);
+    dma_tube_cfg(DMA1, tube, &cfg);
+    dma_clear_isr_bits(DMA1, tube);
+    dma_enable(DMA1, tube);
+    gpio_devs[clockPin / 16]->regs->BRR = s.clkMask;
+    regs->DIER = TIMER_DIER_UDE;
+    timer_resume(dev);
+
+    /* half k of the stream ends with HT (even k) or TC (odd k) */
+    uint32 halves = (len * 16 + 1 + SHIFT_DMA_HALF - 1) / SHIFT_DMA_HALF;
+    uint32 shift = 4 * (tube - 1);
+    for (uint32 k = 0; k < halves; k++) {
+        uint32 flag = (k & 1 ? DMA_ISR_TCIF1 : DMA_ISR_HTIF1) << shift;
+        while (!(DMA1->regs->ISR & flag)) {
+        }
+        DMA1->regs->IFCR = flag;
+        if (k + 2 <= halves) {
+            shift_stream_fill(&s, words + (k & 1) * SHIFT_DMA_HALF);
+        }
     }
 
-    digitalWrite( ulClockPin, LOW ) ;
-  }
+    timer_pause(dev);
+    dma_disable(DMA1, tube);
+    dma_clear_isr_bits(DMA1, tube);
+    /* load the old prescaler now, not at the next overflow, with the
+     * update interrupt still masked; then drop the flags of the run */
+    regs->DIER = 0;
+    timer_set_prescaler(dev, psc);
+    timer_set_reload(dev, arr);
+    timer_generate_update(dev);
+    regs->SR = 0;
+    regs->DIER = dier;
+    return true;
+}
 
-  return value ;
+void shiftOutBuffer(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                    const uint8 *buf, uint32 len) {
+    if (dataPin >= BOARD_NR_GPIO_PINS || clockPin >= BOARD_NR_GPIO_PINS || !buf || !len) {
+        return;
+    }
+    gpio_write_pin(clockPin, LOW);
+    if (shift_spi(dataPin, clockPin, bitOrder, (uint8 *)buf, len, false) ||
+        shift_out_dma(dataPin, clockPin, bitOrder, buf, len)) {
+        return;
+    }
+    shift_pins p;
+    shift_pins_init(&p, dataPin, clockPin);
+    while (len--) {
+        shift_out_byte(&p, bitOrder, *buf++);
+    }
+}
+
+void shiftInBuffer(uint8 dataPin, uint8 clockPin, uint8 bitOrder,
+                   uint8 *buf, uint32 len) {
+    if (dataPin >= BOARD_NR_GPIO_PINS || clockPin >= BOARD_NR_GPIO_PINS || !buf || !len) {
+        return;
+    }
+    gpio_write_pin(clockPin, LOW);
+    if (shift_spi(dataPin, clockPin, bitOrder, buf, len, true)) {
+        return;
+    }
+    shift_pins p;
+    shift_pins_init(&p, dataPin, clockPin);
+    while (len--) {
+        *buf++ = shift_in_byte(&p, bitOrder);
+    }
 }
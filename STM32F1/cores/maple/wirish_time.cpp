@@ -34,6 +34,13 @@
 #include <libmaple/delay.h>
 #include "Arduino.h"
 
+static bool tickless_delay;
+
+void ticklessDelay(bool enable)
+{
+    tickless_delay = enable;
+}
+
 void delay(unsigned long ms)
 {
     uint32 start = micros();
@@ -45,9 +52,20 @@ void delay(unsigned long ms)
             ms--;
             start += 1000;
         }
+        /* less than 1 ms of the current one has passed, so ms - 1 tick
+         * boundaries are always before the end of the delay */
+        if (tickless_delay && ms > 1)
+        {
+            systick_sleep(ms - 1);
+        }
     }
 }
 
+uint32 idleSleep(uint32 max_ms)
+{
+    return systick_sleep(max_ms);
+}
+
 void delayMicroseconds(uint32 us) {
     delay_us(us);
 }
@@ -82,6 +82,32 @@ static inline uint32 micros(void) {
  */
 void delay(unsigned long ms);
 
+/**
+ * Let delay() sleep with interrupts enabled instead of spinning.
+ *
+ * With tickless delays enabled, delay() reprograms SysTick and waits
+ * in WFI for all but the last millisecond, which saves power when the
+ * program spends most of its time waiting. yield() is still called
+ * after each wakeup; interrupts wake the CPU as usual.
+ *
+ * @param enable true to enable tickless delays, false to spin (default).
+ * @see idleSleep()
+ */
+void ticklessDelay(bool enable);
+
+/**
+ * Sleep until the next interrupt, or at most max_ms milliseconds.
+ *
+ * Intended to be called from loop() when there is nothing to do.
+ * millis() and micros() stay correct across the sleep; the time spent
+ * asleep is returned by systick_sleep_millis().
+ *
+ * @param max_ms maximum time to sleep, in milliseconds.
+ * @return the number of milliseconds slept.
+ * @see ticklessDelay()
+ */
+uint32 idleSleep(uint32 max_ms = 0xFFFFFFFF);
+
 /**
  * Delay for at least the given number of microseconds.
  *
@@ -0,0 +1,75 @@
+/*
+  FastPinBenchmark
+  Compares the cycle count of digitalWrite()/digitalRead() with the
+  compile-time FastPin<> access, measured with the DWT cycle counter.
+
+  The test pin toggles during the measurement, don't connect anything to it.
+
+  This example code is in the public domain.
+ */
+
+#include <libmaple/dwt.h>
+
+#define TEST_PIN PB12
+#define LOOPS    1000
+
+typedef FastPin<TEST_PIN> Pin;
+
+void report(const char * name, uint32 cycles)
+{
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((float)cycles / LOOPS, 2);
+  Serial.println(" cycles/call");
+}
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(TEST_PIN, OUTPUT);
+  dwt_cyccnt_enable();
+}
+
+void loop() {
+  uint32 start, cycles;
+  volatile uint32 sink = 0;
+
+  delay(2000);
+  noInterrupts();
+
+  start = dwt_cycles();
+  for (int i = 0; i < LOOPS; i++) {
+    digitalWrite(TEST_PIN, HIGH);
+    digitalWrite(TEST_PIN, LOW);
+  }
+  cycles = dwt_cycles() - start;
+  uint32 dw = cycles / 2;
+
+  start = dwt_cycles();
+  for (int i = 0; i < LOOPS; i++) {
+    Pin::set();
+    Pin::clear();
+  }
+  cycles = dwt_cycles() - start;
+  uint32 fw = cycles / 2;
+
+  start = dwt_cycles();
+  for (int i = 0; i < LOOPS; i++) {
+    sink += digitalRead(TEST_PIN);
+  }
+  uint32 dr = dwt_cycles() - start;
+
+  start = dwt_cycles();
+  for (int i = 0; i < LOOPS; i++) {
+    sink += Pin::read();
+  }
+  uint32 fr = dwt_cycles() - start;
+
+  interrupts();
+
+  // the numbers include the loop overhead
+  report("digitalWrite      ", dw);
+  report("FastPin::set/clear", fw);
+  report("digitalRead       ", dr);
+  report("FastPin::read     ", fr);
+  Serial.println();
+}
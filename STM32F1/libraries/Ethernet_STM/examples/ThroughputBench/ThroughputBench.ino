@@ -0,0 +1,99 @@
+/*
+ Throughput Bench
+
+ Measures the TCP throughput of the W5x00 and its SPI link. Connect to
+ port 5001 and send one command byte:
+
+   R  the board receives and discards everything until the connection
+      closes:   (printf R; head -c 10000000 /dev/zero) | nc -q 1 192.168.1.177 5001
+   T  the board sends a test pattern until the connection closes:
+                printf T | nc 192.168.1.177 5001 | head -c 10000000 | wc -c
+
+ The rate (payload bytes through the SPI bus) is printed on the serial
+ port every second and at the end of each run. Payloads of 32 bytes and
+ more move by DMA, see W5X00_SPI_DMA_MIN in utility/w5x00_spi.h.
+
+ <---- Pinout ---->
+ W5x00 <--> STM32F103
+ SS    <-->  PA4 <-->  BOARD_SPI1_NSS_PIN
+ SCK   <-->  PA5 <-->  BOARD_SPI1_SCK_PIN
+ MISO  <-->  PA6 <-->  BOARD_SPI1_MISO_PIN
+ MOSI  <-->  PA7 <-->  BOARD_SPI1_MOSI_PIN
+ */
+
+#include <SPI.h>
+#include <Ethernet_STM.h>
+
+#if defined(WIZ550io_WITH_MACADDRESS) // Use assigned MAC address of WIZ550io
+;
+#else
+byte mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED};
+#endif  
+
+IPAddress ip(192, 168, 1, 177);
+
+EthernetServer server(5001);
+uint8_t buf[2048];
+
+void report(const char *what, uint32_t bytes, uint32_t ms)
+{
+  Serial.print(what);
+  Serial.print(bytes);
+  Serial.print(" bytes in ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print(ms ? bytes / ms : 0);
+  Serial.println(" kB/s");
+}
+
+void run(EthernetClient &client, bool transmit)
+{
+  uint32_t start = millis(), last = start, total = 0, since = 0;
+
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+    buf[i] = (uint8_t)i;
+  while (client.connected()) {
+    int n;
+    if (transmit) {
+      n = client.write(buf, sizeof(buf));
+    } else {
+      n = client.read(buf, sizeof(buf));
+    }
+    if (n > 0) {
+      total += n;
+      since += n;
+    }
+    uint32_t now = millis();
+    if (now - last >= 1000) {
+      report(transmit ? "  tx " : "  rx ", since, now - last);
+      last = now;
+      since = 0;
+    }
+  }
+  report(transmit ? "sent " : "received ", total, millis() - start);
+  client.stop();
+}
+
+void setup() {
+  Serial.begin(115200);
+#if defined(WIZ550io_WITH_MACADDRESS)
+  Ethernet.begin(ip);
+#else
+  Ethernet.begin(mac, ip);
+#endif
+  server.begin();
+  Serial.print("throughput bench on ");
+  Serial.print(Ethernet.localIP());
+  Serial.println(":5001");
+}
+
+void loop() {
+  EthernetClient client = server.available();
+  if (client) {
+    int cmd = client.read();
+    if (cmd == 'R' || cmd == 'T')
+      run(client, cmd == 'T');
+    else
+      client.stop();
+  }
+}
@@ -12,6 +12,7 @@
 //#include <SPI.h>
 
 #include "utility/w5100.h"
+#include "utility/w5x00_spi.h"
 
 #if defined(W5100_ETHERNET_SHIELD)
 
@@ -155,11 +156,9 @@ uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
   SPI.transfer(_data);
   resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[4] = { 0xF0, (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _data };
   digitalWrite(STM32_SPI_CS, LOW);
-  SPI.transfer(0xF0);
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(_data);
+  SPI.write(frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
   SPI.transfer(SPI_CS, 0xF0, SPI_CONTINUE);
@@ -183,12 +182,11 @@ uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
   SPI.transfer(_buf[i]);
   resetSS();
 #elif defined(__STM32F1__)
+  // one frame per byte, the W5100 has no burst mode
+  uint8_t frame[4] = { 0xF0, (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _buf[i] };
+  _addr++;
   digitalWrite(STM32_SPI_CS, LOW);
-	SPI.transfer( 0xF0);
-	SPI.transfer( _addr >> 8);
-	SPI.transfer( _addr & 0xFF);
-     _addr++; 
-	SPI.transfer( _buf[i]);
+  SPI.write(frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
 	SPI.transfer(SPI_CS, 0xF0, SPI_CONTINUE);
@@ -211,12 +209,11 @@ uint8_t W5100Class::read(uint16_t _addr)
   uint8_t _data = SPI.transfer(0);
   resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[4] = { 0x0F, (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), 0 };
   digitalWrite(STM32_SPI_CS, LOW);
-  SPI.transfer(0x0F);
-  SPI.transfer( _addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  uint8_t _data = SPI.transfer(0);
+  SPI.transfer(frame, frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
+  uint8_t _data = frame[3];
 #else
   SPI.transfer(SPI_CS, 0x0F, SPI_CONTINUE);
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
@@ -239,13 +236,12 @@ uint16_t W5100Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
   _buf[i] = SPI.transfer(0);
   resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[4] = { 0x0F, (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), 0 };
+  _addr++;
   digitalWrite(STM32_SPI_CS, LOW);
-	SPI.transfer(0x0F);
-	SPI.transfer(_addr >> 8);
-	SPI.transfer(_addr & 0xFF);
-  _addr++;  
-  _buf[i] = SPI.transfer(0);
+  SPI.transfer(frame, frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
+  _buf[i] = frame[3];
 #else
 	SPI.transfer(SPI_CS, 0x0F, SPI_CONTINUE);
 	SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
@@ -14,9 +14,12 @@
 
 typedef uint8_t SOCKET;
 
+// The chip can also be selected with a build flag (-DW5100_ETHERNET_SHIELD ...)
+#if !defined(W5100_ETHERNET_SHIELD) && !defined(W5200_ETHERNET_SHIELD) && !defined(W5500_ETHERNET_SHIELD)
 //#define W5100_ETHERNET_SHIELD // Arduino Ethenret Shield and Compatibles ...
 //#define W5200_ETHERNET_SHIELD // WIZ820io, W5200 Ethernet Shield 
 #define W5500_ETHERNET_SHIELD   // WIZ550io, ioShield series of WIZnet
+#endif
 
 #if defined(W5500_ETHERNET_SHIELD)
 //#define WIZ550io_WITH_MACADDRESS // Use assigned MAC address of WIZ550io
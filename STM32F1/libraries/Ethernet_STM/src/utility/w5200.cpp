@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "utility/w5100.h"
+#include "utility/w5x00_spi.h"
 
 #if defined(W5200_ETHERNET_SHIELD)
 // W5200 controller instance
@@ -160,12 +161,9 @@ uint8_t W5200Class::write(uint16_t _addr, uint8_t _data)
   SPI.transfer(_data);
   resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[5] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), 0x80, 0x01, _data };
   digitalWrite(STM32_SPI_CS, LOW);
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(0x80);
-  SPI.transfer(0x01);
-  SPI.transfer(_data);
+  SPI.write(frame, 5);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
@@ -196,17 +194,11 @@ uint16_t W5200Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
   }
     resetSS();
 #elif defined(__STM32F1__)
+  uint8_t header[4] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF),
+                        (uint8_t)(0x80 | ((_len & 0x7F00) >> 8)), (uint8_t)(_len & 0x00FF) };
   digitalWrite(STM32_SPI_CS, LOW);
-	SPI.transfer( _addr >> 8);
-	SPI.transfer( _addr & 0xFF);
-  SPI.transfer(0x80 | ((_len & 0x7F00) >> 8));
-  SPI.transfer(_len & 0x00FF);
-  
-  for (uint16_t i=0; i<(_len-1); i++)
-  {
-    SPI.transfer(_buf[i]);
-  }
-	SPI.transfer(_buf[_len-1]);
+  SPI.write(header, 4);
+  w5x00_spi_send(_buf, _len);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
@@ -237,11 +229,11 @@ uint8_t W5200Class::read(uint16_t _addr)
   uint8_t _data = SPI.transfer(0);
   resetSS();
 #elif defined(__STM32F1__)
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(0x00);
-  SPI.transfer(0x01);
-  uint8_t _data = SPI.transfer(0);
+  uint8_t frame[5] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), 0x00, 0x01, 0 };
+  digitalWrite(STM32_SPI_CS, LOW);
+  SPI.transfer(frame, frame, 5);
+  digitalWrite(STM32_SPI_CS, HIGH);
+  uint8_t _data = frame[4];
 #else
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
   SPI.transfer(SPI_CS, _addr & 0xFF, SPI_CONTINUE);
@@ -269,15 +261,12 @@ uint16_t W5200Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
   }
     resetSS();
 #elif defined(__STM32F1__)
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(0x00 | ((_len & 0x7F00) >> 8));
-  SPI.transfer(_len & 0x00FF);
-  for (uint16_t i=0; i<(_len-1); i++)
-  {
-    _buf[i] = SPI.transfer(0);
-  }
-    _buf[_len-1] = SPI.transfer(0);
+  uint8_t header[4] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF),
+                        (uint8_t)(0x00 | ((_len & 0x7F00) >> 8)), (uint8_t)(_len & 0x00FF) };
+  digitalWrite(STM32_SPI_CS, LOW);
+  SPI.transfer(header, header, 4);
+  w5x00_spi_recv(_buf, _len);
+  digitalWrite(STM32_SPI_CS, HIGH);
 #else
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
   SPI.transfer(SPI_CS, _addr & 0xFF, SPI_CONTINUE);
@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "utility/w5100.h"
+#include "utility/w5x00_spi.h"
 #if defined(W5500_ETHERNET_SHIELD)
 
 // W5500 controller instance
@@ -122,11 +123,9 @@ uint8_t W5500Class::write(uint16_t _addr, uint8_t _cb, uint8_t _data)
     SPI.transfer(_data);
     resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[4] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _cb, _data };
   digitalWrite(STM32_SPI_CS, LOW);
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(_cb);
-  SPI.transfer(_data);
+  SPI.write(frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
   SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
@@ -149,13 +148,10 @@ uint16_t W5500Class::write(uint16_t _addr, uint8_t _cb, const uint8_t *_buf, uin
     }
     resetSS();
 #elif defined(__STM32F1__)
+  uint8_t header[3] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _cb };
   digitalWrite(STM32_SPI_CS, LOW);
-	SPI.transfer( _addr >> 8);
-	SPI.transfer( _addr & 0xFF);
-  SPI.transfer(_cb);
-  for (uint16_t i=0; i<_len; i++){
-        SPI.transfer(_buf[i]);
-  }
+  SPI.write(header, 3);
+  w5x00_spi_send(_buf, _len);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
   uint16_t i;
@@ -181,12 +177,11 @@ uint8_t W5500Class::read(uint16_t _addr, uint8_t _cb)
     uint8_t _data = SPI.transfer(0);
     resetSS();
 #elif defined(__STM32F1__)
+  uint8_t frame[4] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _cb, 0 };
   digitalWrite(STM32_SPI_CS, LOW);
-  SPI.transfer( _addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(_cb);
-  uint8_t _data = SPI.transfer(0);
+  SPI.transfer(frame, frame, 4);
   digitalWrite(STM32_SPI_CS, HIGH);
+  uint8_t _data = frame[3];
 #else
     SPI.transfer(SPI_CS, _addr >> 8, SPI_CONTINUE);
     SPI.transfer(SPI_CS, _addr & 0xFF, SPI_CONTINUE);
@@ -208,13 +203,10 @@ uint16_t W5500Class::read(uint16_t _addr, uint8_t _cb, uint8_t *_buf, uint16_t _
     }
     resetSS();
 #elif defined(__STM32F1__)
+  uint8_t header[3] = { (uint8_t)(_addr >> 8), (uint8_t)(_addr & 0xFF), _cb };
   digitalWrite(STM32_SPI_CS, LOW);
-	SPI.transfer(_addr >> 8);
-	SPI.transfer(_addr & 0xFF);
-  SPI.transfer(_cb);
-  for (uint16_t i=0; i<_len; i++){
-        _buf[i] = SPI.transfer(0);
-  }
+  SPI.transfer(header, header, 3);
+  w5x00_spi_recv(_buf, _len);
   digitalWrite(STM32_SPI_CS, HIGH);
 #else
     uint16_t i;
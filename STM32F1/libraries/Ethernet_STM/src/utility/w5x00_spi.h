@@ -0,0 +1,47 @@
+/*
+ * SPI burst helpers shared by the W5100, W5200 and W5500 drivers on STM32F1.
+ *
+ * A frame header goes out with one SPI.write() (or SPI.transfer() on a
+ * read, which also keeps the receiver free of overruns), the payload is
+ * moved straight between the caller's buffer and the chip: by DMA from
+ * W5X00_SPI_DMA_MIN bytes on, below that with the polled burst functions,
+ * which are faster than setting up the DMA channels.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef	W5X00_SPI_H_INCLUDED
+#define	W5X00_SPI_H_INCLUDED
+
+#if defined(__STM32F1__)
+
+#include <SPI.h>
+
+#ifndef W5X00_SPI_DMA_MIN
+#define W5X00_SPI_DMA_MIN 32
+#endif
+
+// Send len payload bytes; CS must already be low.
+static inline void w5x00_spi_send(const uint8_t *buf, uint16_t len)
+{
+  if (len >= W5X00_SPI_DMA_MIN)
+    SPI.dmaSend(buf, len);
+  else if (len)
+    SPI.write(buf, len);
+}
+
+// Receive len payload bytes into buf, clocking out 0xFF; CS must already be low.
+static inline void w5x00_spi_recv(uint8_t *buf, uint16_t len)
+{
+  if (len >= W5X00_SPI_DMA_MIN)
+    SPI.dmaTransfer((uint16_t)0xFF, buf, len);
+  else if (len)
+    SPI.read(buf, len);
+}
+
+#endif // __STM32F1__
+
+#endif
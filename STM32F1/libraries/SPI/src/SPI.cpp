@@ -35,6 +35,7 @@
 #include <libmaple/timer.h>
 #include <libmaple/util.h>
 #include <libmaple/rcc.h>
+#include <libmaple/util/atomic.h>
 
 #include "wirish.h"
 #include "boards.h"
@@ -164,6 +165,118 @@ SPISettings _settings[BOARD_NR_SPI];
 * @brief Waits unti TXE (tx empy) flag set and BSY (busy) flag unset.
 */
 #define waitSpiTxEnd(spi_d) { while (spi_is_tx_empty(spi_d) == 0); while (spi_is_busy(spi_d) != 0); }
+//-----------------------------------------------------------------------------
+//  Asynchronous job queue, one per port. The queue is a linked list of
+//  caller owned jobs; the head is the running one.
+//-----------------------------------------------------------------------------
+typedef struct
+{
+    SPIJob * head;
+    SPIJob * tail;
+    uint32 jobStart;            // micros() when the running job started
+    uint32 portCR1;             // CR1 of the port settings, restored when empty
+    SPIQueueStats stats;
+} spi_queue_t;
+
+static spi_queue_t _queues[BOARD_NR_SPI];
+static const uint16_t jobFill = 0xFFFF;
+static uint16_t jobDiscard;
+
+//-----------------------------------------------------------------------------
+//  Master mode CR1 value for the given baud rate bits and frame format.
+//-----------------------------------------------------------------------------
+static uint32 spiMasterCR1(uint32 baud, BitOrder bitOrder, uint32 dataSize, uint8 dataMode)
+{
+    return (baud & SPI_CR1_BR) |
+           (bitOrder == MSBFIRST ? SPI_FRAME_MSB : SPI_FRAME_LSB) |
+           (dataSize & SPI_CR1_DFF) | (dataMode & (SPI_CR1_CPOL|SPI_CR1_CPHA)) |
+           SPI_SW_SLAVE | SPI_SOFT_SS | SPI_CR1_MSTR | SPI_CR1_SPE;
+}
+
+//-----------------------------------------------------------------------------
+//  Set CR1, DFF may only change while disabled.
+//-----------------------------------------------------------------------------
+static void spiSetCR1(spi_reg_map * regs, uint32 cr1)
+{
+    if (regs->CR1 != cr1) {
+        regs->CR1 = cr1 & ~SPI_CR1_SPE;
+        regs->CR1 = cr1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  Program both DMA channels straight from the job and start it.
+//-----------------------------------------------------------------------------
+void spiJobStart(uint32 spi_num)
+{
+    SPISettings * crtSetting = &_settings[spi_num];
+    SPIJob * job = _queues[spi_num].head;
+    spi_reg_map * regs = crtSetting->spi_d->regs;
+    dma_tube_reg_map * rx = dma_channel_regs(crtSetting->spiDmaDev, crtSetting->spiRxDmaChannel);
+    dma_tube_reg_map * tx = dma_channel_regs(crtSetting->spiDmaDev, crtSetting->spiTxDmaChannel);
+
+    spiSetCR1(regs, job->cr1);
+    uint32 size = (job->cr1 & SPI_CR1_DFF) ? (DMA_CCR_MSIZE_16BITS | DMA_CCR_PSIZE_16BITS) : 0;
+
+    rx->CCR = 0;
+    tx->CCR = 0;
+    dma_clear_isr_bits(crtSetting->spiDmaDev, crtSetting->spiRxDmaChannel);
+    dma_clear_isr_bits(crtSetting->spiDmaDev, crtSetting->spiTxDmaChannel);
+    rx->CPAR = (uint32)&regs->DR;
+    tx->CPAR = (uint32)&regs->DR;
+    rx->CMAR = job->rxBuf ? (uint32)job->rxBuf : (uint32)&jobDiscard;
+    tx->CMAR = job->txBuf ? (uint32)job->txBuf : (uint32)&jobFill;
+    rx->CNDTR = job->length;
+    tx->CNDTR = job->length;
+
+    job->status = SPI_JOB_ACTIVE;
+    if (job->csPin < BOARD_NR_GPIO_PINS)
+        gpio_write_pin(job->csPin, 0);
+    spi_rx_reg(crtSetting->spi_d); // pre-empty Rx pipe
+    rx->CCR = size | DMA_CCR_PL_VERY_HIGH | (job->rxBuf ? DMA_CCR_MINC : 0) | DMA_CCR_TCIE | DMA_CCR_EN;
+    tx->CCR = size | DMA_CCR_PL_LOW | DMA_CCR_DIR_FROM_MEM | (job->txBuf ? DMA_CCR_MINC : 0) | DMA_CCR_EN;
+    spi_rx_dma_enable(crtSetting->spi_d);
+    spi_tx_dma_enable(crtSetting->spi_d);
+}
+
+//-----------------------------------------------------------------------------
+//  Rx complete of the running job: all frames are clocked out and in.
+//  Release it, start the next one, then call back. When the queue is
+//  empty, the port gets its own settings back for the other functions.
+//-----------------------------------------------------------------------------
+void spiJobDone(uint32 spi_num)
+{
+    SPISettings * crtSetting = &_settings[spi_num];
+    spi_queue_t * q = &_queues[spi_num];
+    SPIJob * job = q->head;
+
+    spi_tx_dma_disable(crtSetting->spi_d);
+    spi_rx_dma_disable(crtSetting->spi_d);
+    dma_channel_regs(crtSetting->spiDmaDev, crtSetting->spiRxDmaChannel)->CCR = 0;
+    dma_channel_regs(crtSetting->spiDmaDev, crtSetting->spiTxDmaChannel)->CCR = 0;
+    if (job->csPin < BOARD_NR_GPIO_PINS)
+        gpio_write_pin(job->csPin, 1);
+
+    uint32 now = micros();
+    q->stats.busyMicros += now - q->jobStart;
+    q->stats.jobs++;
+    q->stats.frames += job->length;
+    q->stats.depth--;
+    q->head = job->next;
+    job->status = SPI_JOB_DONE;
+
+    if (q->head) {
+        q->jobStart = now;
+        spiJobStart(spi_num);
+    } else {
+        q->tail = NULL;
+        spiSetCR1(crtSetting->spi_d->regs, q->portCR1);
+        crtSetting->state = SPI_STATE_READY;
+    }
+    if (job->callback)
+        job->callback(job);
+}
+
 //-----------------------------------------------------------------------------
 //  This function will be called after the stream finished to transfer
 //  (read or write) the programmed number of data (bytes or words).
@@ -172,6 +285,11 @@ SPISettings _settings[BOARD_NR_SPI];
 void spiEventCallback(uint32 spi_num)
 {
     SPISettings * crtSetting = &_settings[spi_num];
+    if (crtSetting->state==SPI_STATE_TRANSFER)
+    {
+        spiJobDone(spi_num);
+        return;
+    }
     dma_channel dmaChannel = (crtSetting->state==SPI_STATE_TRANSMIT) ? crtSetting->spiTxDmaChannel :
                              ( (crtSetting->state==SPI_STATE_RECEIVE) ? crtSetting->spiRxDmaChannel : (dma_channel)-1);
 
@@ -593,6 +711,10 @@ void SPIClass::transfer(const uint16_t tx_data, uint16_t * rx_buf, uint32 len)
 void SPIClass::dmaWaitCompletion(void)
 {
     PRINTF("<dWC-");
+    // A running job queue ends in READY by itself, however long it is.
+    // Forcing READY would leave its CS asserted and the queue stalled.
+    while (_currentSetting->state == SPI_STATE_TRANSFER)
+        yield();
     if (_currentSetting->state != SPI_STATE_READY)
     {
         uint32_t m = millis();
@@ -830,6 +952,95 @@ void SPIClass::dmaSendInit(const uint16_t tx_data, uint16 length, uint16 flags)
 }
 
 
+//-----------------------------------------------------------------------------
+//  Asynchronous job queue
+//-----------------------------------------------------------------------------
+bool SPIClass::queue(SPIJob & job)
+{
+    if (job.length == 0 || job.status == SPI_JOB_QUEUED || job.status == SPI_JOB_ACTIVE)
+        return false;
+    if (_currentSetting->state == SPI_STATE_IDLE) // not started
+        return false;
+
+    uint32 spi_num = _currentSetting - _settings;
+    spi_queue_t * q = &_queues[spi_num];
+    SPISettings & st = job.settings;
+    job.cr1 = spiMasterCR1(determine_baud_rate(_currentSetting->spi_d, st.clock),
+                           st.bitOrder, st.dataSize, st.dataMode);
+    job.next = NULL;
+    if (job.csPin < BOARD_NR_GPIO_PINS) {
+        gpio_write_pin(job.csPin, 1);
+        pinMode(job.csPin, OUTPUT);
+    }
+
+    bool start = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        job.status = SPI_JOB_QUEUED;
+        if (q->head) {
+            q->tail->next = &job;
+        } else {
+            q->head = &job;
+            start = true;
+        }
+        q->tail = &job;
+        if (++q->stats.depth > q->stats.maxDepth)
+            q->stats.maxDepth = q->stats.depth;
+    }
+    if (start) {
+        // the other DMA functions leave the channels to us once READY
+        dmaWaitCompletion();
+        dma_init(_currentSetting->spiDmaDev);
+        // spiJobStart() clears the flags, the next job may end within the IRQ
+        dma_attach_interrupt_noclear(_currentSetting->spiDmaDev, _currentSetting->spiRxDmaChannel, _currentSetting->dmaIsr);
+        _currentSetting->state = SPI_STATE_TRANSFER;
+        q->portCR1 = spiMasterCR1(_currentSetting->clockDivider, _currentSetting->bitOrder,
+                                  _currentSetting->dataSize, _currentSetting->dataMode);
+        q->jobStart = micros();
+        spiJobStart(spi_num);
+    }
+    return true;
+}
+
+uint16 SPIClass::queueDepth(void)
+{
+    return _queues[_currentSetting - _settings].stats.depth;
+}
+
+void SPIClass::queueWait(void)
+{
+    while (_queues[_currentSetting - _settings].head)
+        yield();
+}
+
+void SPIClass::queueStats(SPIQueueStats & stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats = _queues[_currentSetting - _settings].stats;
+    }
+}
+
+void SPIClass::resetQueueStats(void)
+{
+    SPIQueueStats & stats = _queues[_currentSetting - _settings].stats;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats.jobs = 0;
+        stats.frames = 0;
+        stats.maxDepth = stats.depth;
+        stats.busyMicros = 0;
+        stats.startMicros = micros();
+    }
+}
+
+uint8 SPIClass::queueUtilization(void)
+{
+    SPIQueueStats stats;
+    queueStats(stats);
+    uint32 elapsed = micros() - stats.startMicros;
+    if (elapsed == 0)
+        return 0;
+    return (uint8)(((uint64)stats.busyMicros * 100) / elapsed);
+}
+
 void SPIClass::attachInterrupt(void) {
     // Should be enableInterrupt()
 }
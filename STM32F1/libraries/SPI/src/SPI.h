@@ -155,6 +155,60 @@ private:
 
 extern SPISettings _settings[BOARD_NR_SPI];
 
+typedef enum {
+    SPI_JOB_IDLE,
+    SPI_JOB_QUEUED,
+    SPI_JOB_ACTIVE,
+    SPI_JOB_DONE
+} spi_job_status_t;
+
+struct SPIJob;
+typedef void (*SPIJobCallback)(SPIJob * job);
+
+/**
+ * @brief One asynchronous SPI transaction, see SPIClass::queue().
+ *
+ * The job and its buffers belong to the caller and must stay untouched
+ * from queue() until the job is done.
+ */
+struct SPIJob
+{
+    SPISettings settings;
+    uint8 csPin;                // driven low for the job, 0xFF for none
+    const void * txBuf;         // NULL sends 0xFF
+    void * rxBuf;               // NULL discards the received data
+    uint16 length;              // bytes, or words in 16 bit mode
+    SPIJobCallback callback;    // run from the DMA interrupt when done, or NULL
+    void * user;                // free for the callback
+
+    SPIJob() : csPin(0xFF), txBuf(NULL), rxBuf(NULL), length(0),
+               callback(NULL), user(NULL), status(SPI_JOB_IDLE), next(NULL) {}
+
+    bool done(void) const { return status == SPI_JOB_DONE; }
+
+    volatile spi_job_status_t status;
+private:
+    uint32 cr1;                 // SPI configuration, set by queue()
+    SPIJob * next;
+
+    friend class SPIClass;
+    friend void spiJobStart(uint32 spi_num);
+    friend void spiJobDone(uint32 spi_num);
+};
+
+/**
+ * @brief Job queue counters of a SPI port.
+ */
+typedef struct
+{
+    uint32 jobs;                // completed jobs
+    uint32 frames;              // completed bytes/words
+    uint16 depth;               // queued jobs, including the running one
+    uint16 maxDepth;
+    uint32 busyMicros;          // time with a job running
+    uint32 startMicros;         // micros() at the last resetQueueStats()
+} SPIQueueStats;
+
 /**
  * @brief Wirish SPI interface.
  *
@@ -335,6 +389,48 @@ public:
 
     #define dmaSendAsync(transmit, length, minc) dmaSend(transmit, length, (minc&BIT0))
 
+    /**
+     * @brief Queue an asynchronous transaction.
+     *
+     * Jobs run back to back from the DMA interrupt: each one applies its
+     * settings, asserts its CS pin, transfers with DMA in both
+     * directions and releases CS, then the next job starts and the
+     * callback of the finished one is called. Several devices can share
+     * the bus this way without the caller waiting or handling CS.
+     *
+     * The port must have been started with begin(). The other DMA
+     * functions wait until the queue is empty, so they must not be
+     * called from a job callback while more jobs are queued; polled
+     * transfers must not be used while the queue runs. When it is
+     * empty, the settings of the port are restored.
+     *
+     * @param job Transaction to run, not already queued.
+     * @return false if the job can't be queued.
+     */
+    bool queue(SPIJob & job);
+
+    /**
+     * @brief Number of queued jobs, including the running one.
+     */
+    uint16 queueDepth(void);
+
+    /**
+     * @brief Wait until all queued jobs are done.
+     */
+    void queueWait(void);
+
+    /**
+     * @brief Get the job queue counters.
+     */
+    void queueStats(SPIQueueStats & stats);
+    void resetQueueStats(void);
+
+    /**
+     * @brief Percentage of time the bus was busy with queued jobs since
+     *        the last resetQueueStats().
+     */
+    uint8 queueUtilization(void);
+
     /*
      * Pin accessors
      */
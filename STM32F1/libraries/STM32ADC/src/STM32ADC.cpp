@@ -1,5 +1,60 @@
 #include "STM32ADC.h"
 #include "boards.h"
+#include "Arduino.h"
+
+/*
+    Background sampling state. A frame is oversample scans; each half of
+    the DMA buffer holds one or more whole frames. The interrupt of the
+    half that completed reduces its last frame into the per channel
+    cache that analogRead() returns.
+*/
+#define BG_BUF_LEN 256
+
+static struct {
+    uint16 buf[BG_BUF_LEN];
+    uint8 chan[16];             // scan sequence
+    uint8 nch;                  // 0 while stopped
+    uint8 oversample;
+    uint8 extraBits;
+    uint16 frame;               // conversions per frame
+    uint16 half;                // conversions per half of buf
+} bg;
+
+static volatile uint16 bg_value[16];
+static volatile uint32 bg_stamp[16];
+
+static void bg_dma_isr(void) {
+    const uint16 *frame = bg.buf + bg.half - bg.frame;
+    if (dma_get_irq_cause(DMA1, DMA_CH1) == DMA_TRANSFER_COMPLETE)
+        frame += bg.half;
+    uint32 now = micros();
+    for (uint8 i = 0; i < bg.nch; i++) {
+        uint32 sum = 0;
+        for (const uint16 *p = frame + i; p < frame + bg.frame; p += bg.nch)
+            sum += *p;
+        uint8 ch = bg.chan[i];
+        bg_value[ch] = (sum << bg.extraBits) / bg.oversample;
+        bg_stamp[ch] = now;
+    }
+}
+
+/*
+    Dual mode capture state, see startDual().
+*/
+static struct {
+    uint32 *buf;                // NULL while stopped
+    uint16 len;
+    adc_dual_handler handler;
+} dual;
+
+static void dual_dma_isr(void) {
+    uint16 half = dual.len / 2;
+    const uint32 *words = dual.buf;
+    if (dma_get_irq_cause(DMA1, DMA_CH1) == DMA_TRANSFER_COMPLETE)
+        words += half;
+    if (dual.handler)
+        dual.handler(words, half);
+}
 
 
 /*
@@ -225,3 +280,169 @@
         _AWD_int = func;
 
     }
+
+/*
+    Background sampling. Scans every pin in INPUT_ANALOG mode into a
+    circular DMA buffer and serves analogRead() from the results.
+*/
+    bool STM32ADC::startBackground(uint8 oversample, uint8 extraBits, adc_extsel_event trigger){
+        if (_dev != ADC1 || oversample < 1 || oversample > 64 || extraBits > 3)
+            return false;
+        if (oversample < (1 << (2 * extraBits)))
+            return false;
+        stopDual();
+        stopBackground();
+
+//collect the channels of the analog inputs, each one once.
+        uint8 nch = 0;
+        uint32 seen = 0;
+        for (uint8 pin = 0; pin < BOARD_NR_GPIO_PINS; pin++) {
+            uint8 ch = analogPinChannel(pin);
+            if (ch == ADCx || (seen & (1 << ch)))
+                continue;
+            if (gpio_get_mode(gpio_devs[pin / 16], pin % 16) != GPIO_INPUT_ANALOG)
+                continue;
+            seen |= 1 << ch;
+            bg.chan[nch++] = ch;
+        }
+        if (nch == 0 || 2 * nch * oversample > BG_BUF_LEN)
+            return false;
+
+        for (uint8 i = 0; i < 16; i++) {
+            bg_value[i] = 0;
+            bg_stamp[i] = 0;
+        }
+        bg.oversample = oversample;
+        bg.extraBits = extraBits;
+        bg.frame = nch * oversample;
+        bg.half = bg.frame;
+//converting back to back, fill the buffer with frames: one interrupt per
+//frame would be hundreds of thousands per second. A timer sets the rate.
+        if (trigger == ADC_EXT_EV_SWSTART)
+            bg.half = (BG_BUF_LEN / 2) / bg.frame * bg.frame;
+        bg.nch = nch;
+
+//with ADON clear, writing CR2 can't start a stray conversion.
+        adc_disable(_dev);
+        setChannels(bg.chan, nch);
+        setScanMode();
+        setDMA(bg.buf, 2 * bg.half, (DMA_MINC_MODE | DMA_CIRC_MODE | DMA_HALF_TRNS | DMA_TRNS_CMPLT), bg_dma_isr);
+        setTrigger(trigger);
+        if (trigger == ADC_EXT_EV_SWSTART)
+            setContinuous();
+        adc_enable(_dev);
+        delayMicroseconds(1);//tSTAB
+        calibrate();
+        analogReadCache(bg_value, bg_stamp);
+        if (trigger == ADC_EXT_EV_SWSTART)
+            startConversion();
+        return true;
+    }
+
+/*
+    Stop background sampling and restore ADC1 for single conversions.
+*/
+    void STM32ADC::stopBackground(){
+        if (_dev != ADC1 || bg.nch == 0)
+            return;
+        analogReadCache(NULL, NULL);
+        adc_disable(_dev);
+        dma_disable(DMA1, DMA_CH1);
+        dma_detach_interrupt(DMA1, DMA_CH1);
+        _dev->regs->CR1 &= ~ADC_CR1_SCAN;
+        _dev->regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_DMA);
+        adc_set_extsel(_dev, ADC_EXT_EV_SWSTART);
+        adc_set_reg_seqlen(_dev, 1);
+        adc_enable(_dev);
+        delayMicroseconds(1);
+        calibrate();
+        bg.nch = 0;
+    }
+
+/*
+    Dual capture, ADC1 master and ADC2 slave, packed 32 bit words
+    through DMA1 channel 1.
+*/
+    bool STM32ADC::startDual(adc_dual_mode mode, uint8 channel1, uint8 channel2,
+                             uint32 *buf, uint16 len, adc_dual_handler handler,
+                             adc_extsel_event trigger){
+        if (_dev != ADC1 || buf == NULL || len < 2 || (len & 1))
+            return false;
+        stopBackground();
+        stopDual();
+
+        uint8 slave_channel = (mode == ADC_DUAL_FAST_INTERLEAVED) ? channel1 : channel2;
+
+//with ADON clear, writing CR2 can't start a stray conversion.
+        adc_disable(ADC2);
+        adc_disable(ADC1);
+        ADC2->regs->SMPR1 = ADC1->regs->SMPR1;
+        ADC2->regs->SMPR2 = ADC1->regs->SMPR2;
+        adc_set_reg_seq_channel(ADC1, &channel1, 1);
+        adc_set_reg_seq_channel(ADC2, &slave_channel, 1);
+        ADC1->regs->CR1 &= ~(ADC_CR1_SCAN | ADC_CR1_DUALMOD);
+        ADC2->regs->CR1 &= ~ADC_CR1_SCAN;
+        ADC1->regs->CR1 |= (mode == ADC_DUAL_FAST_INTERLEAVED) ?
+            ADC_CR1_DUALMOD_FAST_INT : ADC_CR1_DUALMOD_REG_SIMUL;
+
+//the slave follows the master; it only needs a software trigger, so
+//it doesn't start on its own. Its DMA bit makes its data show up in
+//the high half of ADC1 DR.
+        adc_set_extsel(ADC2, ADC_EXT_EV_SWSTART);
+        adc_dma_enable(ADC2);
+        setTrigger(trigger);
+        if (trigger == ADC_EXT_EV_SWSTART) {
+            ADC2->regs->CR2 |= ADC_CR2_CONT;
+            ADC1->regs->CR2 |= ADC_CR2_CONT;
+        }
+
+        dual.buf = buf;
+        dual.len = len;
+        dual.handler = handler;
+        setDualDMA(buf, len, (DMA_MINC_MODE | DMA_CIRC_MODE | DMA_HALF_TRNS | DMA_TRNS_CMPLT));
+        attachDMAInterrupt(dual_dma_isr);
+
+        adc_enable(ADC2);
+        adc_enable(ADC1);
+        delayMicroseconds(1);//tSTAB
+        adc_calibrate(ADC2);
+        adc_calibrate(ADC1);
+        if (trigger == ADC_EXT_EV_SWSTART)
+            startConversion();
+        return true;
+    }
+
+/*
+    Stop dual capture and restore both ADCs for single conversions.
+*/
+    void STM32ADC::stopDual(){
+        if (_dev != ADC1 || dual.buf == NULL)
+            return;
+        adc_disable(ADC1);
+        adc_disable(ADC2);
+        dma_disable(DMA1, DMA_CH1);
+        dma_detach_interrupt(DMA1, DMA_CH1);
+        ADC1->regs->CR1 &= ~ADC_CR1_DUALMOD;
+        ADC1->regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_DMA);
+        ADC2->regs->CR2 &= ~(ADC_CR2_CONT | ADC_CR2_DMA);
+        adc_set_extsel(ADC1, ADC_EXT_EV_SWSTART);
+        adc_enable(ADC1);
+        adc_enable(ADC2);
+        delayMicroseconds(1);
+        adc_calibrate(ADC1);
+        adc_calibrate(ADC2);
+        dual.buf = NULL;
+    }
+
+/*
+    In fast interleaved mode ADC2 converts 7 ADC clocks before ADC1, so
+    the high half of a word is the older sample. words and samples may
+    be the same buffer.
+*/
+    void STM32ADC::unpackInterleaved(const uint32 *words, uint16 *samples, uint16 count){
+        for (uint16 i = 0; i < count; i++) {
+            uint32 w = words[i];
+            samples[2 * i] = w >> 16;
+            samples[2 * i + 1] = w & 0xFFFF;
+        }
+    }
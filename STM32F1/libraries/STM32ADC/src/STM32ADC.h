@@ -2,6 +2,20 @@
 #include "libmaple/dma.h"
 
 
+/*
+    Dual ADC modes, see startDual().
+*/
+enum adc_dual_mode {
+    ADC_DUAL_SIMULTANEOUS,      // ADC1 and ADC2 convert their channel at the same time
+    ADC_DUAL_FAST_INTERLEAVED   // both convert one channel, 7 ADC clocks apart
+};
+
+/*
+    Called from the DMA interrupt with the half of the capture buffer
+    that was just filled; it is overwritten again after the other half.
+*/
+typedef void (*adc_dual_handler)(const uint32 *words, uint16 count);
+
 class STM32ADC{
 
 public:
@@ -30,7 +44,7 @@ public:
     It will be independent of the mode used. It will either be used in continuous or scan mode
     or even both... go figure. :)  
     
-    The reason why this is a uint16 is that I am not ready for dual mode. 
+    For dual mode, see setDualDMA() and startDual().
 */
     void setDMA(uint16 * Buf, uint16 BufLen, uint32 dmaFlags, voidFuncPtr func);
 
@@ -146,6 +160,71 @@ public:
 */
     uint32 getData();
 
+/*
+    Background sampling. ADC1 scans every pin set to INPUT_ANALOG into a
+    circular DMA buffer, and the DMA interrupt keeps the latest value of
+    each channel. analogRead() then returns that value without waiting
+    for a conversion; analogReadTimestamp() tells when it was taken.
+    Set the pin modes first, pins changed later are not picked up.
+
+    oversample: conversions of each channel per update, 1 to 64.
+    extraBits: 0 averages the conversions. With extraBits > 0 the sum is
+    scaled to 12 + extraBits bits instead, which needs oversample of at
+    least 4^extraBits (and some noise on the input) to be meaningful.
+    trigger: ADC_EXT_EV_SWSTART converts back to back, at the rate set by
+    setSampleRate(); the values are then updated once per half of the
+    256 conversion buffer, from the latest oversample scans. A timer
+    event starts one scan per event, and the values are updated after
+    every oversample events.
+
+    Uses DMA1 channel 1; returns false on another ADC than ADC1, when no
+    pin is in INPUT_ANALOG mode or the parameters don't fit the buffer.
+*/
+    bool startBackground(uint8 oversample = 1, uint8 extraBits = 0,
+                         adc_extsel_event trigger = ADC_EXT_EV_SWSTART);
+
+/*
+    Stop background sampling, analogRead() converts on demand again.
+*/
+    void stopBackground();
+
+/*
+    Dual capture with ADC1 as master and ADC2 as slave, for sample rates
+    above what one ADC can do. Call on the ADC1 object.
+
+    Every conversion pair is one 32 bit word: ADC1 in the low half, ADC2
+    in the high half. The DMA fills buf circularly; handler gets each
+    half as soon as it is complete, so the buffer must be processed
+    within the time it takes to fill the other half.
+
+    ADC_DUAL_SIMULTANEOUS: ADC1 converts channel1 and ADC2 channel2 at
+    the same instants, e.g. voltage and current.
+    ADC_DUAL_FAST_INTERLEAVED: both convert channel1. ADC2 samples first,
+    ADC1 7 ADC clocks later, so the time ordered stream is the high half
+    then the low half of each word (see unpackInterleaved()). Needs the
+    1.5 cycle sample time; with a 12 MHz ADC clock (72 MHz core) that is
+    1.71 MS/s, 2 MS/s with a 14 MHz ADC clock.
+
+    Both ADCs use the sample time set with setSampleRate() on ADC1.
+    trigger: ADC_EXT_EV_SWSTART converts continuously, a timer event
+    starts one conversion pair per event.
+    len: number of words in buf, even.
+*/
+    bool startDual(adc_dual_mode mode, uint8 channel1, uint8 channel2,
+                   uint32 *buf, uint16 len, adc_dual_handler handler,
+                   adc_extsel_event trigger = ADC_EXT_EV_SWSTART);
+
+/*
+    Stop dual capture, both ADCs go back to independent single conversions.
+*/
+    void stopDual();
+
+/*
+    Expand fast interleaved words into the time ordered sample stream,
+    2 * count samples.
+*/
+    static void unpackInterleaved(const uint32 *words, uint16 *samples, uint16 count);
+
 private:
 
     adc_dev * _dev;
@@ -0,0 +1,125 @@
+// Web server and echo server with several connections at a time.
+//
+// Unlike the single session server of rbbb_server, tcpListen() keeps a
+// table of connections (4, see tcp_conn.h), each with its own receive and
+// transmit buffers: replies longer than a packet are written as the
+// buffers drain, and lost packets are sent again from the transmit buffer.
+// Port 80 answers any request with a page of uptime and connection data,
+// port 1883 echoes what it receives until the peer closes.
+//
+// PIN Connections (Using STM32F103):
+//
+// ENC28J60 -  STM32F103
+//   VCC    -    3.3V
+//   GND    -    GND
+//   SCK    -    Pin PA5
+//   SO     -    Pin PA6
+//   SI     -    Pin PA7
+//   CS     -    Pin PA8
+
+#include <EtherCard_STM.h>
+#include <tcp_conn.h>
+#include <SPI.h>
+
+#define HTTP_PORT 80
+#define ECHO_PORT 1883
+
+// ethernet interface mac address, must be unique on the LAN
+static byte mymac[] = { 0x74,0x69,0x69,0x2D,0x30,0x31 };
+static byte myip[] = { 192,168,1,203 };
+
+byte Ethernet::buffer[700];
+
+// per connection state of the application
+static struct {
+  bool active;
+  byte match;       // bytes of the "\r\n\r\n" ending the request seen
+  word pos;         // reply bytes written
+  word len;         // reply length
+  char reply[400];
+} conn[TCP_CONN_MAX];
+
+void setup () {
+  Serial.begin(57600);
+  delay(10);
+  if (ether.begin(sizeof Ethernet::buffer, mymac) == 0)
+    Serial.println(F("Failed to access Ethernet controller"));
+  ether.staticSetup(myip);
+
+  ether.printIp("IP:  ", ether.myip);
+  ether.tcpListen(HTTP_PORT);
+  ether.tcpListen(ECHO_PORT);
+}
+
+static void makePage (byte id) {
+  const byte *ip = ether.tcpRemoteIp(id);
+  long t = millis() / 1000;
+  int n = snprintf(conn[id].reply, sizeof conn[id].reply,
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "Up %ld s\r\n"
+    "Connection %d from %d.%d.%d.%d:%u\r\n",
+    t, id, ip[0], ip[1], ip[2], ip[3], ether.tcpRemotePort(id));
+  for (byte i = 0; i < TCP_CONN_MAX; ++i)
+    n += snprintf(conn[id].reply + n, sizeof conn[id].reply - n,
+                  "  %d: state %d, %u bytes to read\r\n",
+                  i, ether.tcpState(i), ether.tcpAvailable(i));
+  conn[id].len = n;
+  conn[id].pos = 0;
+}
+
+static void serveHttp (byte id) {
+  char c;
+  while (conn[id].match < 4 && ether.tcpRead(id, &c, 1))
+    conn[id].match = c == "\r\n\r\n"[conn[id].match] ? conn[id].match + 1 : c == '\r';
+  if (conn[id].match < 4)
+    return;
+  if (conn[id].match == 4) {
+    makePage(id);
+    conn[id].match++;
+  }
+  conn[id].pos += ether.tcpWrite(id, conn[id].reply + conn[id].pos,
+                                 conn[id].len - conn[id].pos);
+  if (conn[id].pos == conn[id].len) {
+    ether.tcpClose(id);
+    conn[id].active = false;
+  }
+}
+
+static void serveEcho (byte id) {
+  byte buf[64];
+  word n = ether.tcpAvailable(id);
+  if (n > ether.tcpWritable(id))
+    n = ether.tcpWritable(id);
+  if (n > sizeof buf)
+    n = sizeof buf;
+  ether.tcpWrite(id, buf, ether.tcpRead(id, buf, n));
+  if (ether.tcpState(id) == TCP_CONN_CLOSE_WAIT && !ether.tcpAvailable(id)) {
+    ether.tcpClose(id);
+    conn[id].active = false;
+  }
+}
+
+void loop () {
+  // receives, and sends what the connections have due
+  ether.packetLoop(ether.packetReceive());
+
+  int8_t id;
+  while ((id = ether.tcpAccept()) >= 0) {
+    conn[id].active = true;
+    conn[id].match = 0;
+  }
+  for (byte i = 0; i < TCP_CONN_MAX; ++i) {
+    if (!conn[i].active)
+      continue;
+    if (ether.tcpState(i) == TCP_CONN_CLOSED) {
+      // reset by the peer or timed out: free the connection
+      ether.tcpClose(i);
+      conn[i].active = false;
+    } else if (ether.tcpLocalPort(i) == HTTP_PORT)
+      serveHttp(i);
+    else
+      serveEcho(i);
+  }
+}
@@ -0,0 +1,67 @@
+// Answer pings and print the driver statistics every second: frames and
+// bytes per second in each direction, and the share of CPU time spent in
+// ENC28J60::packetReceive() and packetSend(). Load it with a flood ping
+// (ping -f 192.168.1.203) to see the DMA transfers at work.
+//
+// PIN Connections (Using STM32F103):
+//
+// ENC28J60 -  STM32F103
+//   VCC    -    3.3V
+//   GND    -    GND
+//   SCK    -    Pin PA5
+//   SO     -    Pin PA6
+//   SI     -    Pin PA7
+//   CS     -    Pin PA8
+//-----------------------------------------------------------------
+
+#include <SPI.h>
+#include <EtherCard_STM.h>
+
+// ethernet interface mac address, must be unique on the LAN
+static byte mymac[] = { 0x74,0x69,0x69,0x2D,0x30,0x31 };
+static byte myip[] = { 192,168,1,203 };
+static byte gwip[] = { 192,168,1,1 };
+
+byte Ethernet::buffer[1518];
+
+static uint32_t timer;
+
+void setup () {
+  Serial.begin(57600);
+  delay(10);
+  Serial.println("\n[netStats]");
+
+  if (ether.begin(sizeof Ethernet::buffer, mymac) == 0)
+    Serial.println(F("Failed to access Ethernet controller"));
+  ether.staticSetup(myip, gwip);
+  ether.printIp("IP:  ", ether.myip);
+  timer = millis();
+}
+
+void loop () {
+  ether.packetLoop(ether.packetReceive());
+
+  uint32_t ms = millis() - timer;
+  if (ms >= 1000) {
+    ENC28J60::Stats s = ENC28J60::stats;
+    uint16_t load = ENC28J60::loadPermille();
+    ENC28J60::resetStats();
+    timer += ms;
+
+    Serial.print("rx ");
+    Serial.print(s.rxFrames * 1000 / ms);
+    Serial.print(" fps ");
+    Serial.print(s.rxBytes / ms);
+    Serial.print(" kB/s, tx ");
+    Serial.print(s.txFrames * 1000 / ms);
+    Serial.print(" fps ");
+    Serial.print(s.txBytes / ms);
+    Serial.print(" kB/s, errors ");
+    Serial.print(s.rxErrors);
+    Serial.print(", driver load ");
+    Serial.print(load / 10);
+    Serial.print('.');
+    Serial.print(load % 10);
+    Serial.println('%');
+  }
+}
@@ -470,6 +470,94 @@ public:
     */
     static bool udpServerHasProcessedPacket(uint16_t len);    //called by tcpip, in packetLoop
 
+    //tcpserver.cpp
+    /**   @brief  Accept TCP connections on a port, several at a time (see tcp_conn.h for the limits)
+    *     @param  port Port to listen on
+    *     @return <i>uint8_t</i> 0 if no more ports can be listened on
+    *     @note   Connections are served by packetLoop, which must be called often
+    */
+    static uint8_t tcpListen(uint16_t port);
+
+    /**   @brief  Check if the TCP server is listening on any ports
+    *     @return <i>bool</i> True if tcpListen was called
+    */
+    static bool tcpServerListening();                        //called by tcpip, in packetLoop
+
+    /**   @brief  Passes packet to TCP server
+    *     @param  len Length of received packet
+    *     @return <i>bool</i> True if packet was for a listening port
+    */
+    static bool tcpServerHasProcessedPacket(uint16_t len);   //called by tcpip, in packetLoop
+
+    /**   @brief  Send what the TCP server connections have due (data, acknowledgements, retransmissions)
+    */
+    static void tcpServerPoll();                             //called by tcpip, in packetLoop
+
+    /**   @brief  Get a newly established connection
+    *     @param  port Local port, 0 for any
+    *     @return <i>int8_t</i> Connection id or -1 if none
+    */
+    static int8_t tcpAccept(uint16_t port = 0);
+
+    /**   @brief  Get connection state
+    *     @param  id Connection id
+    *     @return <i>uint8_t</i> TCP_CONN_ESTABLISHED, TCP_CONN_CLOSE_WAIT (peer closed), ... TCP_CONN_CLOSED once finished
+    */
+    static uint8_t tcpState(uint8_t id);
+
+    /**   @brief  Get number of received bytes waiting to be read
+    *     @param  id Connection id
+    */
+    static uint16_t tcpAvailable(uint8_t id);
+
+    /**   @brief  Read received data
+    *     @param  id Connection id
+    *     @param  buf Pointer to buffer for the data
+    *     @param  len Size of buffer
+    *     @return <i>uint16_t</i> Number of bytes read
+    */
+    static uint16_t tcpRead(uint8_t id, void *buf, uint16_t len);
+
+    /**   @brief  Get free space for data to send
+    *     @param  id Connection id
+    */
+    static uint16_t tcpWritable(uint8_t id);
+
+    /**   @brief  Queue data to send; it is kept until acknowledged
+    *     @param  id Connection id
+    *     @param  data Pointer to data
+    *     @param  len Length of data
+    *     @return <i>uint16_t</i> Number of bytes queued
+    */
+    static uint16_t tcpWrite(uint8_t id, const void *data, uint16_t len);
+
+    /**   @brief  Close connection after the queued data is sent
+    *     @param  id Connection id
+    *     @note   Every accepted connection must be closed or aborted, also one found closed, to free it
+    */
+    static void tcpClose(uint8_t id);
+
+    /**   @brief  Reset connection and free it
+    *     @param  id Connection id
+    */
+    static void tcpAbort(uint8_t id);
+
+    /**   @brief  Get IP address of the remote host
+    *     @param  id Connection id
+    *     @return <i>const uint8_t*</i> Pointer to 4 byte IP address
+    */
+    static const uint8_t *tcpRemoteIp(uint8_t id);
+
+    /**   @brief  Get port of the remote host
+    *     @param  id Connection id
+    */
+    static uint16_t tcpRemotePort(uint8_t id);
+
+    /**   @brief  Get local port of connection
+    *     @param  id Connection id
+    */
+    static uint16_t tcpLocalPort(uint8_t id);
+
     // dhcp.cpp
     /**   @brief  Update DHCP state
     *     @param  len Length of received data packet
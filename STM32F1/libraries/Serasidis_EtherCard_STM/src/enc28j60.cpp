@@ -21,9 +21,12 @@
 #endif
 #include "enc28j60.h"
 #include <SPI.h> // Using library SPI in folder: D:\Documents\Arduino\hardware\STM32\STM32F1XX\libraries\SPI
+#include <libmaple/dwt.h>
 
 uint16_t ENC28J60::bufferSize;
 bool ENC28J60::broadcast_enabled = false;
+bool (*ENC28J60::rxFilter)(const uint8_t* frame, uint16_t len);
+ENC28J60::Stats ENC28J60::stats;
 
 // ENC28J60 Control Registers
 // Control register definitions are a combination of address,
@@ -284,6 +287,23 @@ static void disableChip () {
     //while (!(SPSR&(1<<SPIF)))
 //}
 
+// Buffer memory payloads of ENC28J60_DMA_MIN bytes and more move by SPI
+// DMA, shorter ones with the polled burst functions, which are quicker
+// than setting up the DMA channels. CS must be low.
+static void sendBurst(uint16_t len, const byte* data) {
+    if (len >= ENC28J60_DMA_MIN)
+        SPI.dmaSend(data, len);
+    else if (len)
+        SPI.write(data, len);
+}
+
+static void receiveBurst(uint16_t len, byte* data, uint16_t flags = 0) {
+    if (len >= ENC28J60_DMA_MIN)
+        SPI.dmaTransfer((uint16_t)0x00, data, len, flags);
+    else if (len)
+        SPI.transfer((uint8_t)0x00, data, len);
+}
+
 static byte readOp (byte op, byte address) {
     enableChip();
 	byte result;
@@ -313,26 +333,15 @@ static void writeOp (byte op, byte address, byte data) {
 
 static void readBuf(uint16_t len, byte* data) {
     enableChip();
-    //xferSPI(ENC28J60_READ_BUF_MEM);
 	SPI.transfer(ENC28J60_READ_BUF_MEM);
-    while (len--) {
-        //xferSPI(0x00);
-        //*data++ = SPDR;
-		*data++ = SPI.transfer(0x00);
-    }
+	receiveBurst(len, data);
     disableChip();
 }
 
 static void writeBuf(uint16_t len, const byte* data) {
     enableChip();
-    //xferSPI(ENC28J60_WRITE_BUF_MEM);
 	SPI.transfer(ENC28J60_WRITE_BUF_MEM);
-    //while (len--)
-    //    xferSPI(*data++);
-
-	while (len--)
-		SPI.transfer(*data++);
-
+	sendBurst(len, data);
     disableChip();
 }
 
@@ -382,6 +391,9 @@ static void writePhy (byte address, uint16_t data) {
 byte ENC28J60::initialize (uint16_t size, const byte* macaddr, byte csPin) {
 	
     bufferSize = size;
+    if (!(DWT_BASE->CTRL & DWT_CTRL_CYCCNTENA))
+        dwt_cyccnt_enable();
+    resetStats();
     //if (bitRead(SPCR, SPE) == 0)
     initSPI();
     selectPin = csPin;
@@ -433,6 +445,7 @@ bool ENC28J60::isLinkUp() {
 }
 
 void ENC28J60::packetSend(uint16_t len) {
+    uint32_t start = dwt_cycles();
     while (readOp(ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS)
         if (readRegByte(EIR) & EIR_TXERIF) {
             writeOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRST);
@@ -440,13 +453,29 @@ void ENC28J60::packetSend(uint16_t len) {
         }
     writeReg(EWRPT, TXSTART_INIT);
     writeReg(ETXND, TXSTART_INIT+len);
-    writeOp(ENC28J60_WRITE_BUF_MEM, 0, 0x00);
-    writeBuf(len, buffer);
+    // per packet control byte (0: use MACON3) and the frame, in one command
+    enableChip();
+    SPI.transfer(ENC28J60_WRITE_BUF_MEM);
+    SPI.transfer(0x00);
+    sendBurst(len, buffer);
+    disableChip();
     writeOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRTS);
+    stats.txFrames++;
+    stats.txBytes += len;
+    stats.cycles += dwt_cycles() - start;
 }
 
+/*
+ * The receive status vector and the frame are read in one buffer memory
+ * command, straight into buffer: first the status and the header window
+ * (ENC28J60_RX_WINDOW bytes) polled, then the rest by DMA. rxFilter, if
+ * set, sees the window first and can drop the frame without reading the
+ * rest; while the DMA runs, the next packet pointer and the statistics
+ * are worked out.
+ */
 uint16_t ENC28J60::packetReceive() {
     uint16_t len = 0;
+    uint32_t start = dwt_cycles();
     if (readRegByte(EPKTCNT) > 0) {
         writeReg(ERDPT, gNextPacketPtr);
 
@@ -456,7 +485,9 @@ uint16_t ENC28J60::packetReceive() {
             uint16_t status;
         } header;
 
-        readBuf(sizeof header, (byte*) &header);
+        enableChip();
+        SPI.transfer(ENC28J60_READ_BUF_MEM);
+        SPI.transfer((uint8_t)0x00, (byte*) &header, sizeof header);
 
         gNextPacketPtr  = header.nextPacket;
         len = header.byteCount - 4; //remove the CRC count
@@ -464,18 +495,44 @@ uint16_t ENC28J60::packetReceive() {
             len=bufferSize-1;
         if ((header.status & 0x80)==0)
             len = 0;
-        else
-            readBuf(len, buffer);
+        if (len) {
+            uint16_t window = len < ENC28J60_RX_WINDOW ? len : ENC28J60_RX_WINDOW;
+            SPI.transfer((uint8_t)0x00, buffer, window);
+            if (rxFilter && !rxFilter(buffer, len)) {
+                stats.rxFiltered++;
+                len = 0;
+            } else if (len > window) {
+                receiveBurst(len - window, buffer + window, DMA_ASYNC);
+            }
+        }
+        uint16_t rdpt = gNextPacketPtr - 1 > RXSTOP_INIT ? RXSTOP_INIT : gNextPacketPtr - 1;
+        if (len) {
+            stats.rxFrames++;
+            stats.rxBytes += len;
+        } else if ((header.status & 0x80)==0) {
+            stats.rxErrors++;
+        }
+        while (!SPI.dmaTransferReady())
+            ;
+        disableChip();
         buffer[len] = 0;
-        if (gNextPacketPtr - 1 > RXSTOP_INIT)
-            writeReg(ERXRDPT, RXSTOP_INIT);
-        else
-            writeReg(ERXRDPT, gNextPacketPtr - 1);
+        writeReg(ERXRDPT, rdpt);
         writeOp(ENC28J60_BIT_FIELD_SET, ECON2, ECON2_PKTDEC);
+        stats.cycles += dwt_cycles() - start;
     }
     return len;
 }
 
+void ENC28J60::resetStats() {
+    memset(&stats, 0, sizeof stats);
+    stats.since = dwt_cycles();
+}
+
+uint16_t ENC28J60::loadPermille() {
+    uint32_t span = dwt_cycles() - stats.since;
+    return span ? (uint16_t)((uint64_t)stats.cycles * 1000 / span) : 0;
+}
+
 void ENC28J60::copyout (byte page, const byte* data) {
     uint16_t destPos = SCRATCH_START + (page << SCRATCH_PAGE_SHIFT);
     if (destPos < SCRATCH_START || destPos > SCRATCH_LIMIT - SCRATCH_PAGE_SIZE)
@@ -28,6 +28,13 @@
 #ifndef ENC28J60_H
 #define ENC28J60_H
 
+#ifndef ENC28J60_DMA_MIN
+#define ENC28J60_DMA_MIN    32  //!< Buffer memory transfers from this size on use SPI DMA
+#endif
+#ifndef ENC28J60_RX_WINDOW
+#define ENC28J60_RX_WINDOW  54  //!< Frame bytes read before the DMA: Ethernet, IP and TCP headers
+#endif
+
 /** This class provide low-level interfacing with the ENC28J60 network interface. This is used by the EtherCard class and not intended for use by (normal) end users. */
 class ENC28J60 {
 public:
@@ -35,6 +42,26 @@ public:
     static uint16_t bufferSize; //!< Size of data buffer
     static bool broadcast_enabled; //!< True if broadcasts enabled (used to allow temporary disable of broadcast for DHCP or other internal functions)
 
+    /** Driver statistics, since initialize() or resetStats() */
+    struct Stats {
+        uint32_t rxFrames;      //!< Frames received
+        uint32_t rxBytes;       //!< Bytes of received frames
+        uint32_t rxErrors;      //!< Frames dropped for a bad receive status
+        uint32_t rxFiltered;    //!< Frames dropped by rxFilter
+        uint32_t txFrames;      //!< Frames sent
+        uint32_t txBytes;       //!< Bytes of sent frames
+        uint32_t cycles;        //!< CPU cycles spent in packetReceive() and packetSend()
+        uint32_t since;         //!< Cycle counter at the last reset
+    };
+    static Stats stats; //!< Frame counters and driver time
+
+    /** Called by packetReceive() when the first ENC28J60_RX_WINDOW bytes of
+    *   a frame are in buffer, before the rest is read. Return false to drop
+    *   the frame without reading the rest. May be NULL (the default).
+    *   len is the whole frame length.
+    */
+    static bool (*rxFilter)(const uint8_t* frame, uint16_t len);
+
     static uint8_t* tcpOffset () { return buffer + 0x36; } //!< Pointer to the start of TCP payload
 
     /**   @brief  Initialise SPI interface
@@ -68,6 +95,16 @@ public:
     */
     static uint16_t packetReceive ();
 
+    /**   @brief  Clear the statistics
+    */
+    static void resetStats ();
+
+    /**   @brief  Share of the CPU time spent in the driver since the last reset
+    *     @return <i>uint16_t</i> In 1/1000. The measured span must stay below 2^32 cycles (59 s at 72 MHz)
+    *     @note   Frames per second are stats.rxFrames and stats.txFrames over the same span
+    */
+    static uint16_t loadPermille ();
+
     /**   @brief  Copy data from ENC28J60 memory
     *     @param  page Data page of memory
     *     @param  data Pointer to buffer to copy data to
@@ -0,0 +1,81 @@
+/*
+ inet_chksum.h - Internet (RFC 1071) checksum, a word at a time
+
+ The same file is used by the uIP (STM32F4) and EtherCard (STM32F1)
+ libraries; keep both copies identical.
+
+ Sums and checksums are the 16 bit value of a big endian (network
+ order) field, in host order: ~inet_chksum_add(0, hdr, len) goes into a
+ checksum field as hdr[n] = ck >> 8, hdr[n + 1] = ck & 0xFF, or as
+ htons(ck) through a u16_t pointer.
+
+ Data passed to one inet_chksum_add() call must start at an even offset
+ of the checksummed packet (header and payload boundaries all do); the
+ pointer itself may have any alignment.
+
+ Copyright (c) 2026, the author.
+ Under the same BSD license as uIP, so that it can go into both:
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. The name of the author may not be used to endorse or promote
+    products derived from this software without specific prior
+    written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INET_CHKSUM_H
+#define INET_CHKSUM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One's complement sum of len bytes at data added to sum, not inverted.
+ * Sums 32 bit words; an odd address or length costs one byte step.
+ */
+uint16_t inet_chksum_add(uint16_t sum, const void *data, uint16_t len);
+
+/**
+ * Copy len bytes from src to dst and return their sum added to sum, as
+ * inet_chksum_add(), in one pass. For paths that copy with the CPU
+ * anyway; the word loop needs src and dst equally aligned, else this
+ * is memcpy() followed by inet_chksum_add().
+ */
+uint16_t inet_chksum_copy(uint16_t sum, void *dst, const void *src, uint16_t len);
+
+/**
+ * Checksum field value after one 16 bit word of the data it covers went
+ * from old_word to new_word (RFC 1624, eqn. 3), e.g. the TTL/protocol
+ * word of an IP header.
+ */
+uint16_t inet_chksum_update16(uint16_t chksum, uint16_t old_word, uint16_t new_word);
+
+/** As inet_chksum_update16() for a 32 bit field, e.g. a TCP seq or ack. */
+uint16_t inet_chksum_update32(uint16_t chksum, uint32_t old_word, uint32_t new_word);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,613 @@
+// TCP server connections with per-connection state and buffers.
+//
+// Copyright: GPL V2
+
+#include <string.h>
+#include "tcp_conn.h"
+#include "inet_chksum.h"
+#include "net.h"
+
+#define F_ACK           0x01    // an ACK is due
+#define F_ACCEPT        0x02    // established, not yet accepted
+#define F_APP           0x04    // accepted, not yet closed by the application
+#define F_CLOSE         0x08    // FIN after the queued data
+#define F_FIN_SENT      0x10    // FIN sent since the last go back
+#define F_PROBE         0x20    // one segment due whatever the window
+#define F_ABORT         0x40    // reset due
+
+#define SEQ_LT(a, b)    ((int32_t)((a) - (b)) < 0)
+#define SEQ_LEQ(a, b)   ((int32_t)((a) - (b)) <= 0)
+
+#define HDR_LEN         (ETH_HEADER_LEN + IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN)
+#define DEFAULT_MSS     536
+
+typedef struct {
+    uint8_t state;
+    uint8_t flags;
+    uint8_t retries;
+    uint8_t rmac[6];
+    uint8_t rip[4];
+    uint16_t rport;
+    uint16_t lport;
+    uint16_t mss;               // peer's MSS, clamped to the frame buffer
+    uint16_t wnd;               // peer's window
+    uint16_t max_wnd;           // largest window the peer offered
+    uint16_t rto;
+    uint32_t timer;             // retransmission / TIME-WAIT start
+    uint32_t iss;
+    uint32_t snd_una;
+    uint32_t snd_nxt;
+    uint32_t snd_max;           // highest sequence number sent
+    uint32_t rcv_nxt;
+    uint32_t tx_seq;            // sequence number of tx[tx_head]
+    uint16_t tx_head;
+    uint16_t tx_len;            // unacknowledged and unsent data
+    uint16_t rx_head;
+    uint16_t rx_len;
+    uint8_t tx[TCP_CONN_TXBUF];
+    uint8_t rx[TCP_CONN_RXBUF];
+} tcp_conn;
+
+static tcp_conn_netif nif;
+static tcp_conn conns[TCP_CONN_MAX];
+static uint16_t ports[TCP_CONN_LISTEN_MAX];
+static uint16_t isn_salt;
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    put16(p, v >> 16);
+    put16(p + 2, v);
+}
+
+static uint8_t listening(uint16_t port) {
+    uint8_t i;
+    for (i = 0; i < TCP_CONN_LISTEN_MAX; i++)
+        if (ports[i] && ports[i] == port)
+            return 1;
+    return 0;
+}
+
+static uint16_t rx_window(const tcp_conn *c) {
+    return TCP_CONN_RXBUF - c->rx_len;
+}
+
+static void set_closed(tcp_conn *c) {
+    c->state = TCP_CONN_CLOSED;
+    c->flags &= F_APP;          // an unaccepted connection is dropped
+    c->tx_len = 0;
+}
+
+// Ethernet, IP and TCP headers (plus the MSS option on a SYN) for a segment
+// with dlen data bytes; returns the sum of the pseudo header and TCP header
+static uint16_t put_headers(const uint8_t *rmac, const uint8_t *rip,
+                            uint16_t lport, uint16_t rport, uint32_t seq,
+                            uint32_t ack, uint8_t flags, uint16_t wnd,
+                            uint16_t dlen) {
+    uint8_t *b = nif.buf;
+    uint8_t hlen = TCP_HEADER_LEN_PLAIN + ((flags & TCP_FLAGS_SYN_V) ? 4 : 0);
+    uint16_t tcplen = hlen + dlen;
+    uint16_t ck;
+
+    memcpy(b + ETH_DST_MAC, rmac, 6);
+    memcpy(b + ETH_SRC_MAC, nif.mac, 6);
+    b[ETH_TYPE_H_P] = ETHTYPE_IP_H_V;
+    b[ETH_TYPE_L_P] = ETHTYPE_IP_L_V;
+    b[IP_P] = 0x45;
+    b[IP_P + 1] = 0;
+    put16(b + IP_TOTLEN_H_P, IP_HEADER_LEN + tcplen);
+    put16(b + IP_P + 4, 0);
+    b[IP_FLAGS_P] = 0x40;       // don't fragment
+    b[IP_FLAGS_P + 1] = 0;
+    b[IP_TTL_P] = 64;
+    b[IP_PROTO_P] = IP_PROTO_TCP_V;
+    put16(b + IP_CHECKSUM_P, 0);
+    memcpy(b + IP_SRC_P, nif.ip, 4);
+    memcpy(b + IP_DST_P, rip, 4);
+    ck = ~inet_chksum_add(0, b + IP_P, IP_HEADER_LEN);
+    put16(b + IP_CHECKSUM_P, ck);
+
+    put16(b + TCP_SRC_PORT_H_P, lport);
+    put16(b + TCP_DST_PORT_H_P, rport);
+    put32(b + TCP_SEQ_H_P, seq);
+    put32(b + TCP_SEQACK_H_P, ack);
+    b[TCP_HEADER_LEN_P] = hlen << 2;
+    b[TCP_FLAGS_P] = flags;
+    put16(b + TCP_WIN_SIZE, wnd);
+    put16(b + TCP_CHECKSUM_H_P, 0);
+    put16(b + TCP_CHECKSUM_H_P + 2, 0);
+    if (flags & TCP_FLAGS_SYN_V) {
+        uint16_t mss = nif.size - HDR_LEN - 4;
+        b[TCP_OPTIONS_P] = 2;
+        b[TCP_OPTIONS_P + 1] = 4;
+        put16(b + TCP_OPTIONS_P + 2, mss > 1460 ? 1460 : mss);
+    }
+    return inet_chksum_add(IP_PROTO_TCP_V + tcplen, b + IP_SRC_P, 8 + hlen);
+}
+
+static void finish(uint16_t sum, uint16_t tcplen) {
+    put16(nif.buf + TCP_CHECKSUM_H_P, ~sum);
+    nif.send(ETH_HEADER_LEN + IP_HEADER_LEN + tcplen);
+}
+
+// Send a segment of connection c with n data bytes from offset off of the
+// transmit ring, checksummed while they are copied into the frame
+static void send_segment(tcp_conn *c, uint32_t seq, uint8_t flags,
+                         uint16_t off, uint16_t n) {
+    uint8_t hlen = TCP_HEADER_LEN_PLAIN + ((flags & TCP_FLAGS_SYN_V) ? 4 : 0);
+    uint8_t *data = nif.buf + ETH_HEADER_LEN + IP_HEADER_LEN + hlen;
+    uint16_t sum = put_headers(c->rmac, c->rip, c->lport, c->rport, seq,
+                               c->rcv_nxt, flags, rx_window(c), n);
+    uint16_t pos = (c->tx_head + off) % TCP_CONN_TXBUF;
+    uint16_t first = TCP_CONN_TXBUF - pos;
+
+    if (first >= n) {
+        sum = inet_chksum_copy(sum, data, c->tx + pos, n);
+    } else if (!(first & 1)) {
+        sum = inet_chksum_copy(sum, data, c->tx + pos, first);
+        sum = inet_chksum_copy(sum, data + first, c->tx, n - first);
+    } else {
+        // second part at an odd offset: copy, then sum as one
+        memcpy(data, c->tx + pos, first);
+        memcpy(data + first, c->tx, n - first);
+        sum = inet_chksum_add(sum, data, n);
+    }
+    c->flags &= ~F_ACK;
+    finish(sum, hlen + n);
+}
+
+// Reset in reply to the segment in the frame buffer (RFC 793, "Reset Generation")
+static void send_reset(uint32_t seq, uint32_t ack, uint8_t flags, uint16_t dlen) {
+    uint8_t *b = nif.buf;
+    uint8_t rmac[6], rip[4];
+    uint16_t lport = get16(b + TCP_DST_PORT_H_P), rport = get16(b + TCP_SRC_PORT_H_P);
+    uint16_t sum;
+
+    memcpy(rmac, b + ETH_SRC_MAC, 6);
+    memcpy(rip, b + IP_SRC_P, 4);
+    if (flags & TCP_FLAGS_ACK_V) {
+        sum = put_headers(rmac, rip, lport, rport, ack, 0, TCP_FLAGS_RST_V, 0, 0);
+    } else {
+        ack = seq + dlen + ((flags & TCP_FLAGS_SYN_V) ? 1 : 0) + (flags & TCP_FLAGS_FIN_V);
+        sum = put_headers(rmac, rip, lport, rport, 0, ack,
+                          TCP_FLAGS_RST_V | TCP_FLAGS_ACK_V, 0, 0);
+    }
+    finish(sum, TCP_HEADER_LEN_PLAIN);
+}
+
+static tcp_conn *find(const uint8_t *rip, uint16_t rport, uint16_t lport) {
+    uint8_t i;
+    for (i = 0; i < TCP_CONN_MAX; i++) {
+        tcp_conn *c = &conns[i];
+        if (c->state != TCP_CONN_CLOSED && c->rport == rport &&
+                c->lport == lport && !memcmp(c->rip, rip, 4))
+            return c;
+    }
+    return 0;
+}
+
+static tcp_conn *alloc(void) {
+    uint8_t i;
+    for (i = 0; i < TCP_CONN_MAX; i++)
+        if (conns[i].state == TCP_CONN_CLOSED && !(conns[i].flags & F_APP))
+            return &conns[i];
+    return 0;
+}
+
+static uint16_t syn_mss(const uint8_t *opt, uint8_t len) {
+    uint16_t mss = DEFAULT_MSS;
+    uint8_t i = 0;
+
+    while (i < len && opt[i] != 0) {
+        if (opt[i] == 1) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= len || opt[i + 1] < 2)
+            break;
+        if (opt[i] == 2 && opt[i + 1] == 4 && i + 3 < len)
+            mss = get16(opt + i + 2);
+        i += opt[i + 1];
+    }
+    if (mss < 64)
+        mss = DEFAULT_MSS;
+    if (mss > nif.size - HDR_LEN)
+        mss = nif.size - HDR_LEN;
+    return mss;
+}
+
+void tcp_conn_init(const tcp_conn_netif *n) {
+    nif = *n;
+    memset(conns, 0, sizeof(conns));
+    memset(ports, 0, sizeof(ports));
+}
+
+uint8_t tcp_conn_listen(uint16_t port) {
+    uint8_t i;
+    if (!port || listening(port))
+        return port != 0;
+    for (i = 0; i < TCP_CONN_LISTEN_MAX; i++) {
+        if (!ports[i]) {
+            ports[i] = port;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t tcp_conn_input(uint16_t len, uint32_t now) {
+    uint8_t *b = nif.buf;
+    uint16_t iplen, tcplen, hlen, dlen, lport, wnd;
+    uint32_t seq, ack;
+    uint8_t flags;
+    tcp_conn *c;
+
+    if (len < HDR_LEN || b[ETH_TYPE_H_P] != ETHTYPE_IP_H_V ||
+            b[ETH_TYPE_L_P] != ETHTYPE_IP_L_V || b[IP_HEADER_LEN_VER_P] != 0x45 ||
+            b[IP_PROTO_P] != IP_PROTO_TCP_V || memcmp(b + IP_DST_P, nif.ip, 4))
+        return 0;
+    lport = get16(b + TCP_DST_PORT_H_P);
+    if (!listening(lport))
+        return 0;
+
+    iplen = get16(b + IP_TOTLEN_H_P);
+    hlen = (b[TCP_HEADER_LEN_P] >> 4) * 4;
+    if (iplen < IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN || iplen > len - ETH_HEADER_LEN)
+        return 1;
+    tcplen = iplen - IP_HEADER_LEN;
+    if (hlen < TCP_HEADER_LEN_PLAIN || hlen > tcplen)
+        return 1;
+    if (inet_chksum_add(IP_PROTO_TCP_V + tcplen, b + IP_SRC_P, 8 + tcplen) != 0xFFFF)
+        return 1;
+    dlen = tcplen - hlen;
+    seq = get32(b + TCP_SEQ_H_P);
+    ack = get32(b + TCP_SEQACK_H_P);
+    flags = b[TCP_FLAGS_P];
+    wnd = get16(b + TCP_WIN_SIZE);
+
+    c = find(b + IP_SRC_P, get16(b + TCP_SRC_PORT_H_P), lport);
+    if (!c) {
+        if (flags & TCP_FLAGS_RST_V)
+            return 1;
+        if ((flags & (TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V)) == TCP_FLAGS_SYN_V) {
+            c = alloc();
+            if (!c)
+                return 1;       // table full: the peer retries the SYN
+            memset(c, 0, (uint8_t *)c->tx - (uint8_t *)c);
+            c->state = TCP_CONN_SYN_RCVD;
+            memcpy(c->rmac, b + ETH_SRC_MAC, 6);
+            memcpy(c->rip, b + IP_SRC_P, 4);
+            c->rport = get16(b + TCP_SRC_PORT_H_P);
+            c->lport = lport;
+            c->mss = syn_mss(b + TCP_OPTIONS_P, hlen - TCP_HEADER_LEN_PLAIN);
+            c->wnd = c->max_wnd = wnd;
+            c->rcv_nxt = seq + 1;
+            // RFC 793 clock, 4 us ticks, and a salt for SYNs in the same ms
+            c->iss = now * 250 + (uint32_t)++isn_salt * 0x10000;
+            c->snd_una = c->snd_nxt = c->snd_max = c->iss;
+            c->tx_seq = c->iss + 1;
+            c->rto = TCP_CONN_RTO;
+            c->timer = now;
+            return 1;
+        }
+        send_reset(seq, ack, flags, dlen);
+        return 1;
+    }
+
+    if (flags & TCP_FLAGS_RST_V) {
+        if (SEQ_LEQ(c->rcv_nxt, seq) && SEQ_LT(seq, c->rcv_nxt + rx_window(c) + 1))
+            set_closed(c);
+        return 1;
+    }
+    if (flags & TCP_FLAGS_SYN_V) {
+        if (c->state == TCP_CONN_SYN_RCVD && seq + 1 == c->rcv_nxt)
+            c->snd_nxt = c->iss;        // our SYN-ACK was lost, send it again
+        else
+            c->flags |= F_ACK;
+        return 1;
+    }
+    if (!(flags & TCP_FLAGS_ACK_V))
+        return 1;
+
+    if (SEQ_LT(c->snd_una, ack) && SEQ_LEQ(ack, c->snd_max)) {
+        uint32_t data_end = c->tx_seq + c->tx_len;
+        uint16_t n = 0;
+
+        if (c->state == TCP_CONN_SYN_RCVD) {
+            c->state = TCP_CONN_ESTABLISHED;
+            c->flags |= F_ACCEPT;
+        }
+        if (SEQ_LT(c->tx_seq, ack))
+            n = SEQ_LT(ack, data_end) ? ack - c->tx_seq : c->tx_len;
+        c->tx_head = (c->tx_head + n) % TCP_CONN_TXBUF;
+        c->tx_len -= n;
+        c->tx_seq += n;
+        c->snd_una = ack;
+        if (SEQ_LT(c->snd_nxt, ack))
+            c->snd_nxt = ack;   // acknowledged before it was sent again
+        c->retries = 0;
+        c->rto = TCP_CONN_RTO;
+        c->timer = now;
+        if ((c->flags & F_CLOSE) && ack == data_end + 1) {
+            c->flags |= F_FIN_SENT;
+            if (c->state == TCP_CONN_FIN_WAIT_1) {
+                c->state = TCP_CONN_FIN_WAIT_2;
+            } else if (c->state == TCP_CONN_CLOSING) {
+                c->state = TCP_CONN_TIME_WAIT;
+            } else if (c->state == TCP_CONN_LAST_ACK) {
+                set_closed(c);
+                return 1;
+            }
+        }
+    } else if (SEQ_LT(c->snd_max, ack)) {
+        c->flags |= F_ACK;              // acknowledges something not sent
+        return 1;
+    }
+    if (c->state == TCP_CONN_SYN_RCVD)
+        return 1;
+    if (SEQ_LEQ(c->snd_una, ack)) {
+        c->wnd = wnd;
+        if (wnd > c->max_wnd)
+            c->max_wnd = wnd;
+        if (!wnd && ack == c->snd_una)
+            c->retries = 0;     // the peer answers the probes: keep persisting
+    }
+
+    if (dlen || (flags & TCP_FLAGS_FIN_V)) {
+        if (seq == c->rcv_nxt && (c->state == TCP_CONN_ESTABLISHED ||
+                c->state == TCP_CONN_FIN_WAIT_1 || c->state == TCP_CONN_FIN_WAIT_2)) {
+            const uint8_t *data = b + TCP_SRC_PORT_H_P + hlen;
+            uint16_t n = dlen;
+
+            if (!(c->flags & F_CLOSE)) {
+                uint16_t room = rx_window(c), pos, first;
+                if (n > room)
+                    n = room;
+                pos = (c->rx_head + c->rx_len) % TCP_CONN_RXBUF;
+                first = TCP_CONN_RXBUF - pos;
+                if (first > n)
+                    first = n;
+                memcpy(c->rx + pos, data, first);
+                memcpy(c->rx, data + first, n - first);
+                c->rx_len += n;
+            }
+            // else: closed by the application, the data is acknowledged and dropped
+            c->rcv_nxt += n;
+            if (n == dlen && (flags & TCP_FLAGS_FIN_V)) {
+                c->rcv_nxt++;
+                if (c->state == TCP_CONN_ESTABLISHED) {
+                    c->state = TCP_CONN_CLOSE_WAIT;
+                } else if (c->state == TCP_CONN_FIN_WAIT_1) {
+                    c->state = TCP_CONN_CLOSING;
+                } else {
+                    c->state = TCP_CONN_TIME_WAIT;
+                    c->timer = now;
+                }
+            }
+        }
+        c->flags |= F_ACK;      // also a duplicate ACK for out of order data
+    }
+    return 1;
+}
+
+static void conn_retransmit(tcp_conn *c, uint32_t now) {
+    if (++c->retries > TCP_CONN_RETRIES) {
+        if (c->state != TCP_CONN_SYN_RCVD) {
+            uint16_t sum = put_headers(c->rmac, c->rip, c->lport, c->rport,
+                                       c->snd_nxt, 0, TCP_FLAGS_RST_V, 0, 0);
+            finish(sum, TCP_HEADER_LEN_PLAIN);
+        }
+        set_closed(c);
+        return;
+    }
+    c->rto = c->rto * 2 > TCP_CONN_RTO_MAX ? TCP_CONN_RTO_MAX : c->rto * 2;
+    c->timer = now;
+    // go back to the first unacknowledged byte (or the SYN-ACK, or the
+    // FIN); the first segment goes out even if the window or the silly
+    // window rule holds it back, which makes it a probe
+    c->flags |= F_PROBE;
+    c->snd_nxt = c->snd_una;
+    c->flags &= ~F_FIN_SENT;
+}
+
+static void conn_output(tcp_conn *c) {
+    uint8_t sent = 0;
+
+    if (c->state == TCP_CONN_SYN_RCVD) {
+        if (c->snd_nxt == c->iss) {
+            send_segment(c, c->iss, TCP_FLAGS_SYNACK_V, 0, 0);
+            c->snd_nxt = c->snd_max = c->iss + 1;
+        }
+        return;
+    }
+    if (!(c->flags & F_FIN_SENT)) {
+        for (;;) {
+            uint16_t off = c->snd_nxt - c->tx_seq;
+            uint16_t inflight = c->snd_nxt - c->snd_una;
+            uint16_t n = c->tx_len - off;
+            uint16_t room = c->wnd > inflight ? c->wnd - inflight : 0;
+
+            if (!n)
+                break;
+            if (!room) {
+                if (!(c->flags & F_PROBE))
+                    break;
+                room = 1;
+            }
+            if (n > room)
+                n = room;
+            if (n > c->mss)
+                n = c->mss;
+            // no silly windows (RFC 1122, 4.2.3.4): a full segment, all
+            // that is queued, or half the peer's window, else wait for
+            // the window to open or the persist timer
+            if (n < c->mss && off + n < c->tx_len && n < c->max_wnd / 2 &&
+                    !(c->flags & F_PROBE))
+                break;
+            c->flags &= ~F_PROBE;
+            send_segment(c, c->snd_nxt, TCP_FLAGS_ACK_V |
+                         (off + n == c->tx_len ? TCP_FLAGS_PUSH_V : 0), off, n);
+            c->snd_nxt += n;
+            sent = 1;
+        }
+        c->flags &= ~F_PROBE;
+        if ((c->flags & F_CLOSE) && c->snd_nxt == c->tx_seq + c->tx_len) {
+            send_segment(c, c->snd_nxt, TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V, 0, 0);
+            c->snd_nxt++;
+            c->flags |= F_FIN_SENT;
+            if (c->state == TCP_CONN_ESTABLISHED)
+                c->state = TCP_CONN_FIN_WAIT_1;
+            else if (c->state == TCP_CONN_CLOSE_WAIT)
+                c->state = TCP_CONN_LAST_ACK;
+            sent = 1;
+        }
+    }
+    if (!sent && (c->flags & F_ACK))
+        send_segment(c, c->snd_nxt, TCP_FLAGS_ACK_V, 0, 0);
+    if (SEQ_LT(c->snd_max, c->snd_nxt))
+        c->snd_max = c->snd_nxt;
+}
+
+void tcp_conn_poll(uint32_t now) {
+    uint8_t i;
+
+    for (i = 0; i < TCP_CONN_MAX; i++) {
+        tcp_conn *c = &conns[i];
+
+        if (c->state == TCP_CONN_CLOSED)
+            continue;
+        if (c->flags & F_ABORT) {
+            uint16_t sum = put_headers(c->rmac, c->rip, c->lport, c->rport,
+                                       c->snd_nxt, 0, TCP_FLAGS_RST_V, 0, 0);
+            finish(sum, TCP_HEADER_LEN_PLAIN);
+            set_closed(c);
+            continue;
+        }
+        if (c->state == TCP_CONN_TIME_WAIT) {
+            if (c->flags & F_ACK)
+                send_segment(c, c->snd_nxt, TCP_FLAGS_ACK_V, 0, 0);
+            if (now - c->timer >= TCP_CONN_TIME_WAIT_MS)
+                set_closed(c);
+            continue;
+        }
+        // unacknowledged data, SYN or FIN, or data held back by the window
+        if (c->snd_una != c->snd_max || c->tx_len) {
+            if (now - c->timer >= c->rto) {
+                conn_retransmit(c, now);
+                if (c->state == TCP_CONN_CLOSED)
+                    continue;
+            }
+        } else {
+            c->timer = now;     // idle: the timer starts with the next segment
+        }
+        conn_output(c);
+    }
+}
+
+int8_t tcp_conn_accept(uint16_t port) {
+    uint8_t i;
+    for (i = 0; i < TCP_CONN_MAX; i++) {
+        tcp_conn *c = &conns[i];
+        if ((c->flags & F_ACCEPT) && (!port || c->lport == port)) {
+            c->flags = (c->flags & ~F_ACCEPT) | F_APP;
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t tcp_conn_state(uint8_t id) {
+    return conns[id].state;
+}
+
+uint16_t tcp_conn_available(uint8_t id) {
+    return conns[id].rx_len;
+}
+
+uint16_t tcp_conn_read(uint8_t id, void *buf, uint16_t len) {
+    tcp_conn *c = &conns[id];
+    uint16_t before = rx_window(c), first;
+
+    if (len > c->rx_len)
+        len = c->rx_len;
+    first = TCP_CONN_RXBUF - c->rx_head;
+    if (first > len)
+        first = len;
+    memcpy(buf, c->rx + c->rx_head, first);
+    memcpy((uint8_t *)buf + first, c->rx, len - first);
+    c->rx_head = (c->rx_head + len) % TCP_CONN_RXBUF;
+    c->rx_len -= len;
+    // window update once half the ring is free again
+    if (before < TCP_CONN_RXBUF / 2 && rx_window(c) >= TCP_CONN_RXBUF / 2 &&
+            c->state != TCP_CONN_CLOSED)
+        c->flags |= F_ACK;
+    return len;
+}
+
+uint16_t tcp_conn_writable(uint8_t id) {
+    tcp_conn *c = &conns[id];
+    if (c->state != TCP_CONN_ESTABLISHED && c->state != TCP_CONN_CLOSE_WAIT)
+        return 0;
+    if (c->flags & F_CLOSE)
+        return 0;
+    return TCP_CONN_TXBUF - c->tx_len;
+}
+
+uint16_t tcp_conn_write(uint8_t id, const void *data, uint16_t len) {
+    tcp_conn *c = &conns[id];
+    uint16_t room = tcp_conn_writable(id), pos, first;
+
+    if (len > room)
+        len = room;
+    pos = (c->tx_head + c->tx_len) % TCP_CONN_TXBUF;
+    first = TCP_CONN_TXBUF - pos;
+    if (first > len)
+        first = len;
+    memcpy(c->tx + pos, data, first);
+    memcpy(c->tx, (const uint8_t *)data + first, len - first);
+    c->tx_len += len;
+    return len;
+}
+
+void tcp_conn_close(uint8_t id) {
+    tcp_conn *c = &conns[id];
+
+    c->flags &= ~(F_APP | F_ACCEPT);
+    c->rx_len = 0;
+    if (c->state == TCP_CONN_SYN_RCVD)
+        tcp_conn_abort(id);
+    else if (c->state != TCP_CONN_CLOSED)
+        c->flags |= F_CLOSE;
+}
+
+void tcp_conn_abort(uint8_t id) {
+    tcp_conn *c = &conns[id];
+
+    c->flags &= ~(F_APP | F_ACCEPT);
+    c->rx_len = 0;
+    if (c->state != TCP_CONN_CLOSED)
+        c->flags |= F_ABORT;    // sent by tcp_conn_poll()
+}
+
+const uint8_t *tcp_conn_remote_ip(uint8_t id) {
+    return conns[id].rip;
+}
+
+uint16_t tcp_conn_remote_port(uint8_t id) {
+    return conns[id].rport;
+}
+
+uint16_t tcp_conn_local_port(uint8_t id) {
+    return conns[id].lport;
+}
@@ -0,0 +1,129 @@
+// TCP server connections with per-connection state and buffers.
+//
+// A table of TCP_CONN_MAX connections accepted on the listening ports.
+// Each has its own receive ring, which sets the advertised window, and
+// a transmit ring that keeps sent data until the peer acknowledges it,
+// so lost segments are sent again from there instead of being
+// regenerated by the application. Everything runs from two calls:
+// tcp_conn_input() for each received frame and tcp_conn_poll() to send
+// what is due; the application reads and writes the rings in between.
+//
+// Frames are built in the buffer given to tcp_conn_init() (the EtherCard
+// packet buffer); the module has no other dependencies, so the host
+// replay tool (tools/profiling/ethercard_tcp_replay.c) runs the same code.
+//
+// Copyright: GPL V2
+
+#ifndef TCP_CONN_H
+#define TCP_CONN_H
+
+#include <stdint.h>
+
+#ifndef TCP_CONN_MAX
+#define TCP_CONN_MAX            4       ///< Connections (sockets)
+#endif
+#ifndef TCP_CONN_LISTEN_MAX
+#define TCP_CONN_LISTEN_MAX     4       ///< Listening ports
+#endif
+#ifndef TCP_CONN_TXBUF
+#define TCP_CONN_TXBUF          512     ///< Transmit ring (kept until acknowledged), bytes
+#endif
+#ifndef TCP_CONN_RXBUF
+#define TCP_CONN_RXBUF          256     ///< Receive ring (the window), bytes
+#endif
+#ifndef TCP_CONN_RTO
+#define TCP_CONN_RTO            250     ///< First retransmission timeout, ms
+#endif
+#ifndef TCP_CONN_RTO_MAX
+#define TCP_CONN_RTO_MAX        4000    ///< Retransmission timeout limit, ms
+#endif
+#ifndef TCP_CONN_RETRIES
+#define TCP_CONN_RETRIES        8       ///< Retransmissions before the connection is reset
+#endif
+#ifndef TCP_CONN_TIME_WAIT_MS
+#define TCP_CONN_TIME_WAIT_MS   2000    ///< TIME-WAIT, ms
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Connection states (RFC 793 names; LISTEN is the port table) */
+enum {
+    TCP_CONN_CLOSED,
+    TCP_CONN_SYN_RCVD,
+    TCP_CONN_ESTABLISHED,
+    TCP_CONN_CLOSE_WAIT,        ///< Peer closed, sending is still possible
+    TCP_CONN_FIN_WAIT_1,
+    TCP_CONN_FIN_WAIT_2,
+    TCP_CONN_CLOSING,
+    TCP_CONN_LAST_ACK,
+    TCP_CONN_TIME_WAIT,
+};
+
+/** Where frames are built and how they go out */
+typedef struct {
+    uint8_t *buf;               ///< Frame buffer, shared with the rest of the stack
+    uint16_t size;              ///< Its size, limits the MSS
+    const uint8_t *mac;         ///< Own hardware address (6 bytes)
+    const uint8_t *ip;          ///< Own IP address (4 bytes)
+    void (*send)(uint16_t len); ///< Transmit len bytes of buf
+} tcp_conn_netif;
+
+/** Set the interface; connections and listening ports are cleared */
+void tcp_conn_init(const tcp_conn_netif *nif);
+
+/** Accept connections on port; returns 0 if the port table is full */
+uint8_t tcp_conn_listen(uint16_t port);
+
+/**
+ * Process the received frame of len bytes in the frame buffer at time now
+ * (ms). Returns 1 if it was a TCP segment to a listening port, 0 to leave
+ * it to the rest of the stack. Replies are only queued; the frame buffer
+ * is not modified unless a reset is sent for a segment of no connection.
+ */
+uint8_t tcp_conn_input(uint16_t len, uint32_t now);
+
+/** Send what is due at time now (ms): SYN-ACKs, data, FINs, ACKs, retransmissions */
+void tcp_conn_poll(uint32_t now);
+
+/** A newly established connection on port (0: any), or -1 */
+int8_t tcp_conn_accept(uint16_t port);
+
+/** State of connection id, TCP_CONN_CLOSED once reset, timed out or done */
+uint8_t tcp_conn_state(uint8_t id);
+
+/** Received bytes waiting to be read */
+uint16_t tcp_conn_available(uint8_t id);
+
+/** Read up to len received bytes; returns the count */
+uint16_t tcp_conn_read(uint8_t id, void *buf, uint16_t len);
+
+/** Free space in the transmit ring */
+uint16_t tcp_conn_writable(uint8_t id);
+
+/** Queue up to len bytes for sending; returns the count taken */
+uint16_t tcp_conn_write(uint8_t id, const void *data, uint16_t len);
+
+/**
+ * Close after the queued data is sent (FIN); unread data is dropped. Every
+ * accepted connection is closed (or aborted) by the application, also one
+ * found in TCP_CONN_CLOSED, which gives its slot back to the table.
+ */
+void tcp_conn_close(uint8_t id);
+
+/** Reset the connection (on the next tcp_conn_poll()) and give back its slot */
+void tcp_conn_abort(uint8_t id);
+
+/** Remote address and port of connection id */
+const uint8_t *tcp_conn_remote_ip(uint8_t id);
+uint16_t tcp_conn_remote_port(uint8_t id);
+
+/** Local port of connection id */
+uint16_t tcp_conn_local_port(uint8_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "EtherCard_STM.h"
 #include "net.h"
+#include "inet_chksum.h"
 #undef word // arduino nonsense
 
 #define gPB ether.buffer
@@ -70,19 +71,9 @@ const unsigned char ntpreqhdr[] PROGMEM = { 0xE3,0,4,0xFA,0,1,0,0,0,1 }; //NTP r
 const uint8_t allOnes[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }; // Used for hardware (MAC) and IP broadcast addresses
 
 static void fill_checksum(uint8_t dest, uint8_t off, uint16_t len,uint8_t type) {
-    const uint8_t* ptr = gPB + off;
-    uint32_t sum = type==1 ? IP_PROTO_UDP_V+len-8 :
+    uint16_t sum = type==1 ? IP_PROTO_UDP_V+len-8 :
                    type==2 ? IP_PROTO_TCP_V+len-8 : 0;
-    while(len >1) {
-        sum += (uint16_t) (((uint32_t)*ptr<<8)|*(ptr+1));
-        ptr+=2;
-        len-=2;
-    }
-    if (len)
-        sum += ((uint32_t)*ptr)<<8;
-    while (sum>>16)
-        sum = (uint16_t) sum + (sum >> 16);
-    uint16_t ck = ~ (uint16_t) sum;
+    uint16_t ck = ~inet_chksum_add(sum, gPB + off, len);
     gPB[dest] = ck>>8;
     gPB[dest+1] = ck;
 }
@@ -189,9 +180,11 @@ static void make_arp_answer_from_request() {
 static void make_echo_reply_from_request(uint16_t len) {
     make_eth_ip();
     gPB[ICMP_TYPE_P] = ICMP_TYPE_ECHOREPLY_V;
-    if (gPB[ICMP_CHECKSUM_P] > (0xFF-0x08))
-        gPB[ICMP_CHECKSUM_P+1]++;
-    gPB[ICMP_CHECKSUM_P] += 0x08;
+    // only the type changed (8 -> 0), no need to sum the ping data again
+    uint16_t ck = inet_chksum_update16((gPB[ICMP_CHECKSUM_P]<<8) | gPB[ICMP_CHECKSUM_P+1],
+                                       ICMP_TYPE_ECHOREQUEST_V<<8, ICMP_TYPE_ECHOREPLY_V<<8);
+    gPB[ICMP_CHECKSUM_P] = ck>>8;
+    gPB[ICMP_CHECKSUM_P+1] = ck;
     EtherCard::packetSend(len);
 }
 
@@ -665,6 +658,8 @@ uint16_t EtherCard::packetLoop (uint16_t plen) {
 	
 	
         delaycnt++;
+        if (ether.tcpServerListening())
+            ether.tcpServerPoll();
         //Initiate TCP/IP session if pending
         if (tcp_client_state==1 && (waitgwmac & WGW_HAVE_GW_MAC)) { // send a syn
             tcp_client_state = 2;
@@ -719,6 +714,11 @@ uint16_t EtherCard::packetLoop (uint16_t plen) {
         if(ether.udpServerHasProcessedPacket(plen))
             return 0; //An UDP server handler (callback) has processed this packet
     }
+    if (ether.tcpServerListening() && gPB[IP_PROTO_P]==IP_PROTO_TCP_V)
+    {   //Connections of the TCP server (tcpListen), several at a time
+        if(ether.tcpServerHasProcessedPacket(plen))
+            return 0;
+    }
     if (plen<54 && gPB[IP_PROTO_P]!=IP_PROTO_TCP_V )
         return 0; //Packet flagged as TCP but shorter than minimum TCP packet length
     if (gPB[TCP_DST_PORT_H_P]==TCPCLIENT_SRC_PORT_H)
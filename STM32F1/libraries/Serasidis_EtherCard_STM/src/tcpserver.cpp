@@ -0,0 +1,93 @@
+// TCP server with several concurrent connections
+//
+// Glue between EtherCard and the connection table in tcp_conn.c: frames
+// to a port opened with tcpListen() are handed to the table by
+// packetLoop(), which also sends what the table has due. The legacy
+// single session server (accept(), httpServerReply()) is unchanged and
+// keeps serving the ports not listened on here.
+//
+// Copyright: GPL V2
+// See http://www.gnu.org/licenses/gpl.html
+
+#include "EtherCard_STM.h"
+#include "tcp_conn.h"
+
+static bool tcpServerReady;
+
+static void tcpServerSend(uint16_t len) {
+    ether.packetSend(len);
+}
+
+uint8_t EtherCard::tcpListen(uint16_t port) {
+    if (!tcpServerReady) {
+        tcp_conn_netif nif;
+        nif.buf = buffer;
+        nif.size = bufferSize;
+        nif.mac = mymac;
+        nif.ip = myip;
+        nif.send = tcpServerSend;
+        tcp_conn_init(&nif);
+        tcpServerReady = true;
+    }
+    return tcp_conn_listen(port);
+}
+
+bool EtherCard::tcpServerListening() {
+    return tcpServerReady;
+}
+
+bool EtherCard::tcpServerHasProcessedPacket(uint16_t len) {
+    if (!tcp_conn_input(len, millis()))
+        return false;
+    tcp_conn_poll(millis());
+    return true;
+}
+
+void EtherCard::tcpServerPoll() {
+    if (tcpServerReady)
+        tcp_conn_poll(millis());
+}
+
+int8_t EtherCard::tcpAccept(uint16_t port) {
+    return tcp_conn_accept(port);
+}
+
+uint8_t EtherCard::tcpState(uint8_t id) {
+    return tcp_conn_state(id);
+}
+
+uint16_t EtherCard::tcpAvailable(uint8_t id) {
+    return tcp_conn_available(id);
+}
+
+uint16_t EtherCard::tcpRead(uint8_t id, void *buf, uint16_t len) {
+    return tcp_conn_read(id, buf, len);
+}
+
+uint16_t EtherCard::tcpWritable(uint8_t id) {
+    return tcp_conn_writable(id);
+}
+
+uint16_t EtherCard::tcpWrite(uint8_t id, const void *data, uint16_t len) {
+    return tcp_conn_write(id, data, len);
+}
+
+void EtherCard::tcpClose(uint8_t id) {
+    tcp_conn_close(id);
+}
+
+void EtherCard::tcpAbort(uint8_t id) {
+    tcp_conn_abort(id);
+}
+
+const uint8_t *EtherCard::tcpRemoteIp(uint8_t id) {
+    return tcp_conn_remote_ip(id);
+}
+
+uint16_t EtherCard::tcpRemotePort(uint8_t id) {
+    return tcp_conn_remote_port(id);
+}
+
+uint16_t EtherCard::tcpLocalPort(uint8_t id) {
+    return tcp_conn_local_port(id);
+}
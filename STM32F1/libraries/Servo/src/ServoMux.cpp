@@ -0,0 +1,308 @@
+/*
+ * Many servos on one timer, on any GPIO pins.
+ */
+
+#include "ServoMux.h"
+
+#include <boards.h>
+#include <io.h>
+#include <wirish_math.h>
+
+#define SERVO_MUX_TIMER_HZ      (CYCLES_PER_MICROSECOND * 1000000UL)
+
+ServoMux *ServoMux::_active[3];
+
+const voidFuncPtr ServoMux::_irqs[3] = {
+    ServoMux::irq<0>,
+    ServoMux::irq<1>,
+    ServoMux::irq<2>,
+};
+
+/*
+ * Update event and compare channel 1 to 3 DMA requests of timers 1, 2
+ * and 4. TIM3 has no channel 2 request, and its channel 4 and update
+ * requests share a DMA channel.
+ */
+static const dma_request_src mux_req_src[3][1 + SERVO_FRAME_PORTS] = {
+    { DMA_REQ_SRC_TIM1_UP, DMA_REQ_SRC_TIM1_CH1, DMA_REQ_SRC_TIM1_CH2, DMA_REQ_SRC_TIM1_CH3 },
+    { DMA_REQ_SRC_TIM2_UP, DMA_REQ_SRC_TIM2_CH1, DMA_REQ_SRC_TIM2_CH2, DMA_REQ_SRC_TIM2_CH3 },
+    { DMA_REQ_SRC_TIM4_UP, DMA_REQ_SRC_TIM4_CH1, DMA_REQ_SRC_TIM4_CH2, DMA_REQ_SRC_TIM4_CH3 },
+};
+
+#define mux_tube(src)           ((dma_tube)((src) & 0x7))
+
+ServoMux::ServoMux(uint8 timerNum)
+{
+    switch (timerNum) {
+    case 1: _dev = TIMER1; _index = 0; break;
+    case 2: _dev = TIMER2; _index = 1; break;
+    case 4: _dev = TIMER4; _index = 2; break;
+    default: _dev = NULL; _index = 0; break;
+    }
+    _running = false;
+    _tickHz = 0;
+    _count = 0;
+    _ports = 0;
+    _pending = 0;
+}
+
+bool ServoMux::begin(uint32 tickHz, uint32 frameMicros)
+{
+    if (!_dev || !tickHz || !frameMicros) {
+        return false;
+    }
+    end();
+
+    uint32 div = (SERVO_MUX_TIMER_HZ + tickHz / 2) / tickHz;
+    if (div < 1) {
+        div = 1;
+    } else if (div > 0x10000) {
+        div = 0x10000;
+    }
+    _tickHz = SERVO_MUX_TIMER_HZ / div;
+    _frameTicks = (uint32)(((uint64)frameMicros * _tickHz) / 1000000UL);
+    /* DMA needs about a microsecond for the writes of one event */
+    _minTicks = _tickHz / 1000000UL;
+    if (_minTicks < 2) {
+        _minTicks = 2;
+    }
+
+    timer_pause(_dev);
+    timer_set_prescaler(_dev, div - 1);
+    for (uint8 ch = 1; ch <= SERVO_FRAME_PORTS; ch++) {
+        timer_oc_set_mode(_dev, ch, TIMER_OC_MODE_FROZEN, 0);
+        timer_set_compare(_dev, ch, 1);
+    }
+    dma_init(DMA1);
+    _active[_index] = this;
+    _running = true;
+    if (!restart(_count)) {
+        end();
+        return false;
+    }
+    return true;
+}
+
+void ServoMux::end(void)
+{
+    if (!_running) {
+        return;
+    }
+    stop();
+    _running = false;
+    _active[_index] = NULL;
+}
+
+int ServoMux::attach(uint8 pin, uint16 minPulseWidth, uint16 maxPulseWidth,
+                     int16 minAngle, int16 maxAngle)
+{
+    if (!_running || pin >= BOARD_NR_GPIO_PINS || pin / 16 >= SERVO_FRAME_PORTS ||
+        minPulseWidth > maxPulseWidth) {
+        return -1;
+    }
+
+    uint8 index = 0;
+    while (index < _count && _pins[index] != NOT_ATTACHED_PIN) {
+        index++;
+    }
+    if (index == SERVO_MUX_MAX_SERVOS) {
+        return -1;
+    }
+
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    _pins[index] = pin;
+    _minPW[index] = minPulseWidth;
+    _maxPW[index] = maxPulseWidth;
+    _minAngle[index] = minAngle;
+    _maxAngle[index] = maxAngle;
+    _micros[index] = 0;
+    _widths[index] = 0;
+
+    uint8 count = index < _count ? _count : index + 1;
+    if (!restart(count)) {
+        _pins[index] = NOT_ATTACHED_PIN;
+        restart(_count);
+        return -1;
+    }
+    return index;
+}
+
+bool ServoMux::detach(uint8 index)
+{
+    if (!attached(index)) {
+        return false;
+    }
+    _widths[index] = 0;
+    _pending = 2;
+    _pins[index] = NOT_ATTACHED_PIN;
+    return true;
+}
+
+void ServoMux::write(uint8 index, int angle)
+{
+    if (!attached(index)) {
+        return;
+    }
+    angle = constrain(angle, _minAngle[index], _maxAngle[index]);
+    writeMicroseconds(index, map(angle, _minAngle[index], _maxAngle[index],
+                                 _minPW[index], _maxPW[index]));
+}
+
+int ServoMux::read(uint8 index) const
+{
+    if (!attached(index)) {
+        return 0;
+    }
+    return map(_micros[index], _minPW[index], _maxPW[index],
+               _minAngle[index], _maxAngle[index]);
+}
+
+void ServoMux::writeMicroseconds(uint8 index, uint16 pulseWidth)
+{
+    if (!attached(index)) {
+        return;
+    }
+    pulseWidth = constrain(pulseWidth, _minPW[index], _maxPW[index]);
+    _micros[index] = pulseWidth;
+    _widths[index] = (uint32)(((uint64)pulseWidth * _tickHz) / 1000000UL);
+    _pending = 2;
+}
+
+uint16 ServoMux::readMicroseconds(uint8 index) const
+{
+    return attached(index) ? _micros[index] : 0;
+}
+
+/*
+ * Size the frame for count servos and start playing it from its first
+ * event. The timer period is set to the fixed first two periods, the
+ * DMA then loads the period of event k + 2 on the update ending event k.
+ */
+bool ServoMux::restart(uint8 count)
+{
+    uint32 maxWidth = 0;
+    uint8 ports = 0;
+    for (uint8 i = 0; i < count; i++) {
+        if (_pins[i] != NOT_ATTACHED_PIN) {
+            uint32 w = ((uint64)_maxPW[i] * _tickHz) / 1000000UL;
+            maxWidth = max(maxWidth, w);
+            ports |= BIT(_pins[i] / 16);
+        }
+    }
+    uint16 events = servo_frame_events(count, _frameTicks, _minTicks, maxWidth,
+                                       SERVO_MUX_MAX_GAP);
+    if (!events) {
+        return false;
+    }
+
+    stop();
+    _count = count;
+    _ports = ports;
+    _events = events;
+    _pending = 0;
+    build(0);
+    build(1);
+
+    timer_gen_reg_map *regs = _dev->regs.gen;
+    const dma_request_src *src = mux_req_src[_index];
+    dma_tube_config cfg;
+
+    regs->CR1 |= TIMER_CR1_ARPE;
+    timer_set_reload(_dev, _minTicks - 1);
+    timer_generate_update(_dev);
+
+    cfg.tube_src = _arr;
+    cfg.tube_src_size = DMA_SIZE_16BITS;
+    cfg.tube_dst = &regs->ARR;
+    cfg.tube_dst_size = DMA_SIZE_16BITS;
+    cfg.tube_nr_xfers = 2 * _events;
+    cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC |
+                     DMA_CFG_HALF_CMPLT_IE | DMA_CFG_CMPLT_IE;
+    cfg.tube_req_src = src[0];
+    if (dma_tube_cfg(DMA1, mux_tube(src[0]), &cfg) != DMA_TUBE_CFG_SUCCESS) {
+        return false;
+    }
+    dma_set_priority(DMA1, mux_tube(src[0]), DMA_PRIORITY_HIGH);
+    dma_attach_interrupt(DMA1, mux_tube(src[0]), _irqs[_index]);
+    dma_enable(DMA1, mux_tube(src[0]));
+
+    uint32 dier = TIMER_DIER_UDE;
+    for (uint8 p = 0; p < SERVO_FRAME_PORTS; p++) {
+        if (!(_ports & BIT(p))) {
+            continue;
+        }
+        cfg.tube_src = _bsrr[p];
+        cfg.tube_src_size = DMA_SIZE_32BITS;
+        cfg.tube_dst = (void *)&gpio_devs[p]->regs->BSRR;
+        cfg.tube_dst_size = DMA_SIZE_32BITS;
+        cfg.tube_flags = DMA_CFG_SRC_INC | DMA_CFG_CIRC;
+        cfg.tube_req_src = src[1 + p];
+        if (dma_tube_cfg(DMA1, mux_tube(src[1 + p]), &cfg) != DMA_TUBE_CFG_SUCCESS) {
+            stop();
+            return false;
+        }
+        dma_set_priority(DMA1, mux_tube(src[1 + p]), DMA_PRIORITY_VERY_HIGH);
+        dma_enable(DMA1, mux_tube(src[1 + p]));
+        dier |= TIMER_DIER_CC1DE << p;
+    }
+    regs->SR = 0;
+    regs->DIER = dier;
+    timer_resume(_dev);
+    return true;
+}
+
+/* Stop the timer and its DMA channels, with all servo pins low */
+void ServoMux::stop(void)
+{
+    const dma_request_src *src = mux_req_src[_index];
+
+    timer_pause(_dev);
+    _dev->regs.gen->DIER = 0;
+    dma_disable(DMA1, mux_tube(src[0]));
+    dma_detach_interrupt(DMA1, mux_tube(src[0]));
+    for (uint8 p = 0; p < SERVO_FRAME_PORTS; p++) {
+        if (_ports & BIT(p)) {
+            dma_disable(DMA1, mux_tube(src[1 + p]));
+        }
+    }
+    for (uint8 i = 0; i < _count; i++) {
+        if (_pins[i] != NOT_ATTACHED_PIN) {
+            gpio_write_pin(_pins[i], 0);
+        }
+    }
+}
+
+void ServoMux::build(uint8 half)
+{
+    servo_frame frame;
+    frame.frame_ticks = _frameTicks;
+    frame.min_ticks = _minTicks;
+    frame.events = _events;
+    frame.arr = _arr + half * _events;
+    for (uint8 p = 0; p < SERVO_FRAME_PORTS; p++) {
+        frame.bsrr[p] = (_ports & BIT(p)) ? _bsrr[p] + half * _events : NULL;
+    }
+    servo_frame_build(&frame, _pins, _widths, _count, _order);
+}
+
+/*
+ * A half of the tables has been played: the half complete interrupt
+ * comes at the start of the second frame, the complete one at the start
+ * of the first. The half just played is rebuilt for the next round.
+ */
+void ServoMux::dmaEvent(void)
+{
+    dma_irq_cause cause = dma_get_irq_cause(DMA1, mux_tube(mux_req_src[_index][0]));
+    if (!_pending) {
+        return;
+    }
+    if (cause == DMA_TRANSFER_HALF_COMPLETE) {
+        build(0);
+    } else if (cause == DMA_TRANSFER_COMPLETE) {
+        build(1);
+    } else {
+        return;
+    }
+    _pending--;
+}
@@ -0,0 +1,143 @@
+/*
+ * Many servos on one timer, on any GPIO pins.
+ *
+ * Every 20 ms all servo pins go high together, and each one goes low
+ * again at the end of its pulse. The edges are written to the ports'
+ * BSRR registers by DMA, on compare events of a timer whose period is
+ * reloaded by DMA from a table of the sorted edge times. The CPU only
+ * rebuilds the table after a write(), from the DMA interrupt at a frame
+ * boundary, so the pulses have no interrupt latency jitter: every edge
+ * of a port lags the timer by the same few cycles of DMA latency.
+ *
+ * Timers 1, 2 and 4 can be used. They are taken over completely, along
+ * with the DMA channels of their update event and of compare channels
+ * 1 to 3, one per GPIO port (A, B, C) that has servos on it:
+ *
+ *     timer   update   port A   port B   port C     (DMA1 channels)
+ *       1       5        2        3        6
+ *       2       2        5        7        1
+ *       4       7        1        4        5
+ *
+ * Pulses ending within a microsecond of each other are spaced out by
+ * up to a microsecond; equal pulses end on the same edge.
+ *
+ * Example:
+ *
+ *     ServoMux servos(2);
+ *     servos.begin();
+ *     for (int i = 0; i < 16; i++) {
+ *         legs[i] = servos.attach(pins[i]);
+ *     }
+ *     servos.write(legs[0], 90);
+ */
+
+#ifndef _SERVOMUX_H_
+#define _SERVOMUX_H_
+
+#include <libmaple/timer.h>
+#include <libmaple/dma.h>
+#include "Servo.h"
+#include "utility/servo_frame.h"
+
+#define SERVO_MUX_MAX_SERVOS            32
+#define SERVO_MUX_MAX_GAP               8   /* idle events, 8 * 65536 ticks */
+#define SERVO_MUX_MAX_EVENTS            (SERVO_FRAME_LEAD + 1 + \
+                                         SERVO_MUX_MAX_SERVOS + SERVO_MUX_MAX_GAP)
+#define SERVO_MUX_DEFAULT_TICK_HZ       8000000
+#define SERVO_MUX_DEFAULT_FRAME_US      20000
+
+class ServoMux {
+public:
+    /**
+     * @param timerNum Timer to use, 1, 2 or 4.
+     */
+    ServoMux(uint8 timerNum);
+
+    /**
+     * Start the frames, before attaching servos.
+     * @param tickHz Edge resolution, rounded to a divider of the timer
+     *        clock. The widest pulse must fit in 65536 ticks.
+     * @param frameMicros Pulse period.
+     * @return false if the timer can't be used or the frame doesn't fit
+     *         the attached servos.
+     */
+    bool begin(uint32 tickHz = SERVO_MUX_DEFAULT_TICK_HZ,
+               uint32 frameMicros = SERVO_MUX_DEFAULT_FRAME_US);
+
+    /** Stop the frames; the servo pins are left low. */
+    void end(void);
+
+    /**
+     * Add a servo. It outputs no pulses until the first write.
+     * Attaching restarts the current frame.
+     * @return The servo's index for the other calls, or -1 if there
+     *         is no room, or the pin or pulse range can't be used.
+     */
+    int attach(uint8 pin,
+               uint16 minPulseWidth = SERVO_DEFAULT_MIN_PW,
+               uint16 maxPulseWidth = SERVO_DEFAULT_MAX_PW,
+               int16 minAngle = SERVO_DEFAULT_MIN_ANGLE,
+               int16 maxAngle = SERVO_DEFAULT_MAX_ANGLE);
+
+    /** Stop the pulses of a servo and free its index. */
+    bool detach(uint8 index);
+
+    bool attached(uint8 index) const {
+        return index < _count && _pins[index] != NOT_ATTACHED_PIN;
+    }
+
+    /** Set the target angle, clamped to the attach() range. */
+    void write(uint8 index, int angle);
+
+    /** Target angle, in degrees. */
+    int read(uint8 index) const;
+
+    /**
+     * Set the pulse width in microseconds, clamped to the attach()
+     * range. It takes effect at the start of the next frame.
+     */
+    void writeMicroseconds(uint8 index, uint16 pulseWidth);
+
+    uint16 readMicroseconds(uint8 index) const;
+
+    /** Actual tick rate, in Hz. */
+    uint32 tickHz(void) const { return _tickHz; }
+
+private:
+    enum { NOT_ATTACHED_PIN = 0xFF };
+
+    bool restart(uint8 count);
+    void stop(void);
+    void build(uint8 half);
+    void dmaEvent(void);
+    template<uint8 N> static void irq(void) { _active[N]->dmaEvent(); }
+
+    static ServoMux *_active[3];
+    static const voidFuncPtr _irqs[3];
+
+    timer_dev *_dev;
+    uint8 _index;
+    bool _running;
+    uint32 _tickHz;
+    uint32 _frameTicks;
+    uint16 _minTicks;
+    uint16 _events;
+    uint8 _count;
+    uint8 _ports;               /* bit per GPIO port with servos */
+    volatile uint8 _pending;    /* halves still to rebuild */
+
+    uint8 _pins[SERVO_MUX_MAX_SERVOS];
+    uint16 _minPW[SERVO_MUX_MAX_SERVOS];
+    uint16 _maxPW[SERVO_MUX_MAX_SERVOS];
+    int16 _minAngle[SERVO_MUX_MAX_SERVOS];
+    int16 _maxAngle[SERVO_MUX_MAX_SERVOS];
+    uint16 _micros[SERVO_MUX_MAX_SERVOS];
+    volatile uint32 _widths[SERVO_MUX_MAX_SERVOS];
+    uint8 _order[SERVO_MUX_MAX_SERVOS];
+
+    /* two frames, played in a loop */
+    uint16 _arr[2 * SERVO_MUX_MAX_EVENTS];
+    uint32 _bsrr[SERVO_FRAME_PORTS][2 * SERVO_MUX_MAX_EVENTS];
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "servo_frame.h"
+
+uint16 servo_frame_events(uint8 n, uint32 frame_ticks, uint16 min_ticks,
+                          uint32 max_width, uint8 max_gap)
+{
+    uint32 gap = (frame_ticks + SERVO_FRAME_MAX_TICKS - 1) / SERVO_FRAME_MAX_TICKS;
+    uint32 fill = (uint32)min_ticks * n;
+
+    /* falling edges and fillers end at most n min_ticks after the
+     * widest pulse, the rest is split into gap + 1 periods */
+    if (min_ticks < 2 || gap > max_gap ||
+        max_width + fill > SERVO_FRAME_MAX_TICKS ||
+        (SERVO_FRAME_LEAD + gap + 1) * min_ticks + max_width + fill > frame_ticks) {
+        return 0;
+    }
+    return SERVO_FRAME_LEAD + 1 + n + gap;
+}
+
+/* Period of event k, in ticks. It is loaded two events ahead. */
+static void set_len(servo_frame *frame, uint16 k, uint32 ticks)
+{
+    uint16 events = frame->events;
+    frame->arr[(k + events - 2) % events] = (uint16)(ticks - 1);
+}
+
+/* Event k starts at tick t, which ends the period of event k - 1 */
+static void start(servo_frame *frame, uint16 k, uint32 t, uint32 *last)
+{
+    if (k > 0) {
+        set_len(frame, k - 1, t - *last);
+    }
+    *last = t;
+}
+
+void servo_frame_build(servo_frame *frame, const uint8 *pins,
+                       const volatile uint32 *widths, uint8 n, uint8 *work)
+{
+    uint16 events = frame->events;
+    uint16 min = frame->min_ticks;
+    uint32 rise = SERVO_FRAME_LEAD * min;
+    uint32 last = 0;
+    uint16 k, gap, g;
+    uint8 i, j, p;
+
+    for (p = 0; p < SERVO_FRAME_PORTS; p++) {
+        if (frame->bsrr[p]) {
+            for (k = 0; k < events; k++) {
+                frame->bsrr[p][k] = 0;
+            }
+        }
+    }
+
+    /* servos by pulse width */
+    for (i = 0; i < n; i++) {
+        for (j = i; j > 0 && widths[work[j - 1]] > widths[i]; j--) {
+            work[j] = work[j - 1];
+        }
+        work[j] = i;
+    }
+
+    for (k = 0; k < SERVO_FRAME_LEAD; k++) {
+        start(frame, k, k * min, &last);
+    }
+    start(frame, k, rise, &last);
+    for (i = 0; i < n; i++) {
+        if (widths[i]) {
+            p = pins[i] >> 4;
+            frame->bsrr[p][k] |= (1U << (pins[i] & 15));
+        }
+    }
+    k++;
+
+    /* one falling edge per distinct width; an edge closer than
+     * min_ticks to the previous one is delayed */
+    for (i = 0; i < n; ) {
+        uint32 w = widths[work[i]];
+        uint32 t = rise + w;
+        if (!w) {
+            i++;
+            continue;
+        }
+        if (t < last + min) {
+            t = last + min;
+        }
+        start(frame, k, t, &last);
+        for (; i < n && widths[work[i]] == w; i++) {
+            p = pins[work[i]] >> 4;
+            frame->bsrr[p][k] |= (1U << (pins[work[i]] & 15)) << 16;
+        }
+        k++;
+    }
+    while (k < SERVO_FRAME_LEAD + 1 + n) {
+        start(frame, k, last + min, &last);
+        k++;
+    }
+
+    /* idle up to the end of the frame, in gap + 1 periods */
+    gap = events - k;
+    for (g = 0; g < gap; g++) {
+        start(frame, k, last + (frame->frame_ticks - last) / (gap + 1 - g), &last);
+        k++;
+    }
+    set_len(frame, events - 1, frame->frame_ticks - last);
+}
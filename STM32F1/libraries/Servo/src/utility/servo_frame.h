@@ -0,0 +1,61 @@
+/*
+ * Frame tables of the multiplexed servo engine (ServoMux).
+ *
+ * A frame is a list of events. Event k writes bsrr[port][k] to the BSRR
+ * of each port and is followed by a timer period of len(k) ticks:
+ *
+ *   0, 1     idle, min_ticks each; fixed, see below
+ *   2        rising edge of every active servo
+ *   3 ...    falling edges, sorted by pulse width; servos with the same
+ *            width share an event, unused events are min_ticks fillers
+ *   last G   idle up to the end of the frame, at most 65536 ticks each
+ *
+ * The timer's update DMA request writes the next ARR while the current
+ * period runs, so arr[k] is the period of event k + 2. The first two
+ * periods of a frame never change, which lets one half of a double
+ * buffered table be rebuilt while the other one is played.
+ *
+ * Plain C without hardware access, so it can be checked on a host.
+ */
+
+#ifndef _SERVO_FRAME_H_
+#define _SERVO_FRAME_H_
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERVO_FRAME_PORTS               3
+#define SERVO_FRAME_LEAD                2   /* fixed idle events */
+#define SERVO_FRAME_MAX_TICKS           0x10000UL
+
+typedef struct servo_frame {
+    uint32 frame_ticks;                 /* frame length */
+    uint16 min_ticks;                   /* shortest period, >= 2 */
+    uint16 events;                      /* events per frame */
+    uint16 *arr;                        /* events entries */
+    uint32 *bsrr[SERVO_FRAME_PORTS];    /* events entries, NULL if unused */
+} servo_frame;
+
+/*
+ * Events per frame for n servos, 0 if the frame is too long for the
+ * available idle events or too short for the widest pulse.
+ */
+uint16 servo_frame_events(uint8 n, uint32 frame_ticks, uint16 min_ticks,
+                          uint32 max_width, uint8 max_gap);
+
+/*
+ * Fill one frame. pins[i] is a GPIO pin number (port * 16 + bit),
+ * widths[i] its pulse width in ticks, 0 keeps the pin low.
+ * work holds n bytes of scratch space.
+ */
+void servo_frame_build(servo_frame *frame, const uint8 *pins,
+                       const volatile uint32 *widths, uint8 n, uint8 *work);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -184,7 +184,7 @@ UIPClient::_write(uip_userdata_t* u, const uint8_t *buf, size_t size)
       if (u->packets_out[p] == NOBLOCK)
         {
 newpacket:
-          u->packets_out[p] = Enc28J60Network::allocBlock(UIP_SOCKET_DATALEN);
+          u->packets_out[p] = Enc28J60Network::allocBlock(UIP_SOCKET_PHYH_LEN+UIP_SOCKET_DATALEN);
           if (u->packets_out[p] == NOBLOCK)
             {
 #if UIP_ATTEMPTS_ON_WRITE > 0
@@ -195,8 +195,11 @@ newpacket:
 #endif
               goto ready;
             }
-          u->out_pos = 0;
+          u->out_pos = UIP_SOCKET_PHYH_LEN;
         }
+      else if (u->out_pos == 0)
+        // the last packet is being sent, don't add to it
+        goto nextpacket;
 #ifdef UIPETHERNET_DEBUG_CLIENT
       Serial.print(F("UIPClient.write: writePacket("));
       Serial.print(u->packets_out[p]);
@@ -215,6 +218,7 @@ newpacket:
       u->out_pos+=written;
       if (remain > 0)
         {
+nextpacket:
           if (p == UIP_SOCKET_NUMPACKETS-1)
             {
 #if UIP_ATTEMPTS_ON_WRITE > 0
@@ -417,35 +421,16 @@ finish_newdata:
 #ifdef UIPETHERNET_DEBUG_CLIENT
           Serial.println(F("UIPClient uip_acked"));
 #endif
-          UIPClient::_eatBlock(&u->packets_out[0]);
+          UIPClient::_ackBlocks(u, uip_acklen);
         }
-      if (uip_poll() || uip_rexmit())
+      if (uip_poll() || uip_rexmit() || uip_acked())
         {
 #ifdef UIPETHERNET_DEBUG_CLIENT
           //Serial.println(F("UIPClient uip_poll"));
 #endif
           if (u->packets_out[0] != NOBLOCK)
             {
-              if (u->packets_out[1] == NOBLOCK)
-                {
-                  send_len = u->out_pos;
-                  if (send_len > 0)
-                    {
-                      Enc28J60Network::resizeBlock(u->packets_out[0],0,send_len);
-                    }
-                }
-              else
-                send_len = Enc28J60Network::blockSize(u->packets_out[0]);
-              if (send_len > 0)
-                {
-                  UIPEthernetClass::uip_hdrlen = ((uint8_t*)uip_appdata)-uip_buf;
-                  UIPEthernetClass::uip_packet = Enc28J60Network::allocBlock(UIPEthernetClass::uip_hdrlen+send_len);
-                  if (UIPEthernetClass::uip_packet != NOBLOCK)
-                    {
-                      Enc28J60Network::copyPacket(UIPEthernetClass::uip_packet,UIPEthernetClass::uip_hdrlen,u->packets_out[0],0,send_len);
-                      UIPEthernetClass::packetstate |= UIPETHERNET_SENDPACKET;
-                    }
-                }
+              send_len = UIPClient::_sendBlock(u);
               goto finish;
             }
         }
@@ -538,6 +523,65 @@ UIPClient::_eatBlock(memhandle* block)
 #endif
 }
 
+// drop the acknowledged data from the front of the outgoing packets
+void
+UIPClient::_ackBlocks(uip_userdata_t *u, uint16_t len)
+{
+  while (len > 0 && u->packets_out[0] != NOBLOCK)
+    {
+      memaddress size = Enc28J60Network::blockSize(u->packets_out[0])-UIP_SOCKET_PHYH_LEN;
+      if (len < size)
+        {
+          // the room for the headers moves along with the data
+          Enc28J60Network::resizeBlock(u->packets_out[0],len);
+          return;
+        }
+      len -= size;
+      _eatBlock(&u->packets_out[0]);
+    }
+}
+
+// Pick the next segment: the first uip_conn->len bytes of the first packet
+// on retransmit, otherwise the packet following the data in flight, as far
+// as uip_sendwnd() allows. The segment is sent straight out of the packet
+// with the headers written in front of it. Returns its length.
+uint16_t
+UIPClient::_sendBlock(uip_userdata_t* u)
+{
+  uint16_t off = uip_rexmit() ? 0 : uip_conn->len;
+  uint16_t len = 0;
+  bool open = false;
+  uint8_t p;
+
+  for (p = 0; p < UIP_SOCKET_NUMPACKETS && u->packets_out[p] != NOBLOCK; p++)
+    {
+      open = u->out_pos && (p == UIP_SOCKET_NUMPACKETS-1 || u->packets_out[p+1] == NOBLOCK);
+      len = (open ? u->out_pos : Enc28J60Network::blockSize(u->packets_out[p]))-UIP_SOCKET_PHYH_LEN;
+      if (off < len)
+        break;
+      off -= len;
+    }
+  // segments start at the beginning of a packet: the rest of a packet sent
+  // in part goes out once that part is acknowledged
+  if (p == UIP_SOCKET_NUMPACKETS || u->packets_out[p] == NOBLOCK || off)
+    return 0;
+  off = uip_rexmit() ? uip_conn->len : uip_sendwnd();
+  if (len > off)
+    len = off;
+  if (len == 0)
+    return 0;
+  if (open)
+    {
+      Enc28J60Network::resizeBlock(u->packets_out[p],0,u->out_pos);
+      u->out_pos = 0;
+    }
+  UIPEthernetClass::uip_hdrlen = ((uint8_t*)uip_appdata)-uip_buf;
+  UIPEthernetClass::uip_packet = u->packets_out[p];
+  Enc28J60Network::refBlock(UIPEthernetClass::uip_packet);
+  UIPEthernetClass::packetstate |= UIPETHERNET_SENDPACKET;
+  return len;
+}
+
 void
 UIPClient::_flushBlocks(memhandle* block)
 {
@@ -30,6 +30,8 @@ extern "C" {
 }
 
 #define UIP_SOCKET_DATALEN UIP_TCP_MSS
+// outgoing packets keep room for the headers in front of the data, they are sent without a copy
+#define UIP_SOCKET_PHYH_LEN (UIP_LLH_LEN+UIP_TCPIP_HLEN)
 //#define UIP_SOCKET_NUMPACKETS UIP_RECEIVE_WINDOW/UIP_TCP_MSS+1
 #ifndef UIP_SOCKET_NUMPACKETS
 #define UIP_SOCKET_NUMPACKETS 5
@@ -54,7 +56,7 @@ typedef struct {
   uint8_t state;
   memhandle packets_in[UIP_SOCKET_NUMPACKETS];
   memhandle packets_out[UIP_SOCKET_NUMPACKETS];
-  memaddress out_pos;
+  memaddress out_pos;    /**< Write position in the last outgoing packet, 0 once it is being sent. */
 #if UIP_CLIENT_TIMER >= 0
   unsigned long timer;
 #endif
@@ -97,6 +99,8 @@ private:
   static uint8_t _currentBlock(memhandle* blocks);
   static void _eatBlock(memhandle* blocks);
   static void _flushBlocks(memhandle* blocks);
+  static void _ackBlocks(uip_userdata_t *, uint16_t len);
+  static uint16_t _sendBlock(uip_userdata_t *);
 
 #ifdef UIPETHERNET_DEBUG_CLIENT
   static void _dumpAllData();
@@ -20,6 +20,7 @@
 #include <Arduino.h>
 #include "UIPEthernet.h"
 #include "utility/Enc28J60Network.h"
+#include "utility/inet_chksum.h"
 
 #if(defined UIPETHERNET_DEBUG || defined UIPETHERNET_DEBUG_CHKSUM)
 #include "HardwareSerial.h"
@@ -199,6 +200,8 @@ UIPEthernetClass::tick()
                 {
                   uip_arp_out();
                   network_send();
+                  if (uip_conn)
+                    fillSendWindow();
                 }
             }
           else if (ETH_HDR ->type == HTONS(UIP_ETHTYPE_ARP))
@@ -262,6 +265,7 @@ UIPEthernetClass::tick()
         {
           uip_arp_out();
           network_send();
+          fillSendWindow();
         }
     }
 #if UIP_CLIENT_TIMER >= 0
@@ -297,7 +301,8 @@ boolean UIPEthernetClass::network_send()
 #endif
       Enc28J60Network::writePacket(uip_packet,0,uip_buf,uip_hdrlen);
       packetstate &= ~ UIPETHERNET_SENDPACKET;
-      goto sendandfree;
+      Enc28J60Network::sendPacket(uip_packet,uip_len);
+      goto freepacket;
     }
   uip_packet = Enc28J60Network::allocBlock(uip_len);
   if (uip_packet != NOBLOCK)
@@ -314,11 +319,28 @@ boolean UIPEthernetClass::network_send()
   return false;
 sendandfree:
   Enc28J60Network::sendPacket(uip_packet);
+freepacket:
   Enc28J60Network::freeBlock(uip_packet);
   uip_packet = NOBLOCK;
   return true;
 }
 
+// uip sends one segment per call: poll the connection again until its
+// send window is full or it has nothing more to send
+void UIPEthernetClass::fillSendWindow()
+{
+#if UIP_TCP_SEGS > 1
+  for (uint8_t i = 1; i < UIP_TCP_SEGS; i++)
+    {
+      uip_process(UIP_POLL_REQUEST);
+      if (uip_len == 0)
+        return;
+      uip_arp_out();
+      network_send();
+    }
+#endif
+}
+
 void UIPEthernetClass::init(const uint8_t* mac) {
   periodic_timer = millis() + UIP_PERIODIC_TIMER;
 
@@ -350,32 +372,8 @@ UIPEthernetClass UIPEthernet;
 uint16_t
 UIPEthernetClass::chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {  /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;            /* carry */
-    }
-    dataptr += 2;
-  }
-
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;            /* carry */
-    }
-  }
-
   /* Return sum in host byte order. */
-  return sum;
+  return inet_chksum_add(sum, data, len);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -100,6 +100,7 @@ private:
   static void tick();
 
   static boolean network_send();
+  static void fillSendWindow();
 
   friend class UIPServer;
 
@@ -51,6 +51,13 @@ uint8_t Enc28J60Network::bank=0xff;
 
 struct memblock Enc28J60Network::receivePkt;
 
+// frame on the wire: its block is held until the transmission is done
+memhandle Enc28J60Network::txPacket;
+uint16_t Enc28J60Network::txStart;
+uint16_t Enc28J60Network::txEnd;
+// control byte and the bytes overwritten by the tx status vector
+uint8_t Enc28J60Network::txSaved[8];
+
 bool Enc28J60Network::broadcast_enabled = false;
 static byte selectPin;
 
@@ -59,6 +66,7 @@ void Enc28J60Network::init(uint8_t* macaddr)
 {
   uint32 timeout = 0;
   MemoryPool::init(); // 1 byte in between RX_STOP_INIT and pool to allow prepending of controlbyte
+  txPacket = NOBLOCK;
   // initialize I/O
   // ss as output:
   pinMode(ENC28J60_CONTROL_CS, OUTPUT);
@@ -260,14 +268,33 @@ Enc28J60Network::blockSize(memhandle handle)
 void
 Enc28J60Network::sendPacket(memhandle handle)
 {
+  sendPacket(handle, blocks[handle].size);
+}
+
+// Transmit the first len bytes of a block. The frame is sent straight
+// out of the block (e.g. a socket's outgoing data with the headers
+// written in front of it), the block stays allocated until the
+// controller is done with it.
+void
+Enc28J60Network::sendPacket(memhandle handle, memaddress len)
+{
+  waitTx();
+
   memblock *packet = &blocks[handle];
   uint16_t start = packet->begin-1;
-  uint16_t end = start + packet->size;
+  uint16_t end = start + len;
+  uint8_t tail = TXSTOP_INIT - end < 7 ? TXSTOP_INIT - end : 7;
 
-  // backup data at control-byte position
-  uint8_t data = readByte(start);
+  // backup data at control-byte position and where the controller
+  // writes the 7 byte status vector behind the frame
+  txSaved[0] = readByte(start);
+  if (tail)
+    {
+      writeRegPair(ERDPTL, end+1);
+      readBuffer(tail, &txSaved[1]);
+    }
   // write control-byte (if not 0 anyway)
-  if (data)
+  if (txSaved[0])
     writeByte(start, 0);
 
 #ifdef ENC28J60DEBUG
@@ -292,15 +319,42 @@ Enc28J60Network::sendPacket(memhandle handle)
   writeRegPair(ETXNDL, end);
   // send the contents of the transmit buffer onto the network
   writeOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRTS);
-  // Reset the transmit logic problem. See Rev. B4 Silicon Errata point 12.
-  if( (readReg(EIR) & EIR_TXERIF) )
+
+  refBlock(handle);
+  txPacket = handle;
+  txStart = start;
+  txEnd = end;
+}
+
+// Wait for the frame on the wire, put back the bytes around it and
+// release its block. Called before anything touches the buffer memory.
+void
+Enc28J60Network::waitTx()
+{
+  if (txPacket == NOBLOCK)
+    return;
+  while (readOp(ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS)
     {
-      writeOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRTS);
+      // Reset the transmit logic problem. See Rev. B4 Silicon Errata point 12.
+      if (readReg(EIR) & EIR_TXERIF)
+        {
+          writeOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRTS);
+          writeOp(ENC28J60_BIT_FIELD_CLR, EIR, EIR_TXERIF);
+        }
     }
+  uint8_t tail = TXSTOP_INIT - txEnd < 7 ? TXSTOP_INIT - txEnd : 7;
 
-  //restore data on control-byte position
-  if (data)
-    writeByte(start, data);
+  //restore data on control-byte position and behind the frame
+  if (txSaved[0])
+    writeByte(txStart, txSaved[0]);
+  if (tail)
+    {
+      writeRegPair(EWRPTL, txEnd+1);
+      writeBuffer(tail, &txSaved[1]);
+    }
+  memhandle handle = txPacket;
+  txPacket = NOBLOCK;
+  freeBlock(handle);
 }
 
 uint16_t
@@ -309,6 +363,7 @@ Enc28J60Network::setReadPtr(memhandle handle, memaddress position, uint16_t len)
   memblock *packet = handle == UIP_RECEIVEBUFFERHANDLE ? &receivePkt : &blocks[handle];
   memaddress start = handle == UIP_RECEIVEBUFFERHANDLE && packet->begin + position > RXSTOP_INIT ? packet->begin + position-RXSTOP_INIT+RXSTART_INIT : packet->begin + position;
 
+  waitTx();
   writeRegPair(ERDPTL, start);
   
   if (len > packet->size - position)
@@ -330,6 +385,7 @@ Enc28J60Network::writePacket(memhandle handle, memaddress position, uint8_t* buf
   memblock *packet = &blocks[handle];
   uint16_t start = packet->begin + position;
 
+  waitTx();
   writeRegPair(EWRPTL, start);
 
   if (len > packet->size - position)
@@ -410,6 +466,8 @@ enc28J60_mempool_block_move_callback(memaddress dest, memaddress src, memaddress
 //void
 //Enc28J60Network::memblock_mv_cb(uint16_t dest, uint16_t src, uint16_t len)
 //{
+  // the frame on the wire may be moved or overwritten
+  Enc28J60Network::waitTx();
   //as ENC28J60 DMA is unable to copy single bytes:
   if (len == 1)
     {
@@ -53,6 +53,11 @@ private:
 
   static struct memblock receivePkt;
 
+  static memhandle txPacket;
+  static uint16_t txStart;
+  static uint16_t txEnd;
+  static uint8_t txSaved[8];
+
   static bool broadcast_enabled; //!< True if broadcasts enabled (used to allow temporary disable of broadcast for DHCP or other internal functions)
 
   static uint8_t readOp(uint8_t op, uint8_t address);
@@ -70,6 +75,7 @@ private:
   static void phyWrite(uint8_t address, uint16_t data);
   static uint16_t phyRead(uint8_t address);
   static void clkout(uint8_t clk);
+  static void waitTx();
 
   static void enableBroadcast (bool temporary);
   static void disableBroadcast (bool temporary);
@@ -93,6 +99,7 @@ public:
   static void freePacket();
   static memaddress blockSize(memhandle handle);
   static void sendPacket(memhandle handle);
+  static void sendPacket(memhandle handle, memaddress len);
   static uint16_t readPacket(memhandle handle, memaddress position, uint8_t* buffer, uint16_t len);
   static uint16_t writePacket(memhandle handle, memaddress position, uint8_t* buffer, uint16_t len);
   static void copyPacket(memhandle dest, memaddress dest_pos, memhandle src, memaddress src_pos, uint16_t len);
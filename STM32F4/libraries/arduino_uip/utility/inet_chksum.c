@@ -0,0 +1,158 @@
+/*
+ inet_chksum.c - Internet (RFC 1071) checksum, a word at a time
+
+ The same file is used by the uIP (STM32F4) and EtherCard (STM32F1)
+ libraries; keep both copies identical.
+
+ Copyright (c) 2026, the author.
+ Under the same BSD license as uIP, so that it can go into both:
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. The name of the author may not be used to endorse or promote
+    products derived from this software without specific prior
+    written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "inet_chksum.h"
+
+/*
+ * The one's complement sum doesn't depend on byte order (RFC 1071 2.B):
+ * the words are summed as loaded, in host order, into a 64 bit
+ * accumulator that collects the carries, and the folded result is byte
+ * swapped when the host order word grid doesn't line up with the big
+ * endian one. On a little endian CPU it does when the data starts at an
+ * odd address: the first byte is then the high byte of a host word, as
+ * it is of the first network word.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HEAD_HIGH(b)    ((uint32_t)(b))
+#define TAIL_LOW(b)     ((uint32_t)(b) << 8)
+#define SWAP_IF_ODD     1
+#else
+#define HEAD_HIGH(b)    ((uint32_t)(b) << 8)
+#define TAIL_LOW(b)     ((uint32_t)(b))
+#define SWAP_IF_ODD     0
+#endif
+
+static inline uint16_t fold(uint64_t acc)
+{
+  acc = (acc & 0xFFFFFFFFu) + (acc >> 32);
+  acc = (acc & 0xFFFFFFFFu) + (acc >> 32);
+  acc = (acc & 0xFFFF) + (acc >> 16);
+  acc = (acc & 0xFFFF) + (acc >> 16);
+  acc = (acc & 0xFFFF) + (acc >> 16);
+  return (uint16_t)acc;
+}
+
+static inline uint16_t add16(uint32_t a, uint32_t b)
+{
+  a += b;
+  a = (a & 0xFFFF) + (a >> 16);
+  return (uint16_t)((a & 0xFFFF) + (a >> 16));
+}
+
+/* Sum (and copy, if dst isn't NULL) len bytes; dst and src equally aligned */
+static inline uint16_t sum_words(uint16_t sum, uint8_t *dst, const uint8_t *src,
+                                 uint16_t len)
+{
+  uint64_t acc = 0;
+  int odd = (uintptr_t)src & 1;
+  uint16_t s;
+
+  if (len && odd) {
+    if (dst) *dst++ = *src;
+    acc = HEAD_HIGH(*src++);
+    len--;
+  }
+  if (len >= 2 && ((uintptr_t)src & 2)) {
+    uint16_t w = *(const uint16_t *)src;
+    if (dst) { *(uint16_t *)dst = w; dst += 2; }
+    acc += w;
+    src += 2;
+    len -= 2;
+  }
+  while (len >= 16) {
+    const uint32_t *w = (const uint32_t *)src;
+    uint32_t a = w[0], b = w[1], c = w[2], d = w[3];
+    if (dst) {
+      uint32_t *o = (uint32_t *)dst;
+      o[0] = a; o[1] = b; o[2] = c; o[3] = d;
+      dst += 16;
+    }
+    acc += a;
+    acc += b;
+    acc += c;
+    acc += d;
+    src += 16;
+    len -= 16;
+  }
+  while (len >= 4) {
+    uint32_t a = *(const uint32_t *)src;
+    if (dst) { *(uint32_t *)dst = a; dst += 4; }
+    acc += a;
+    src += 4;
+    len -= 4;
+  }
+  if (len >= 2) {
+    uint16_t w = *(const uint16_t *)src;
+    if (dst) { *(uint16_t *)dst = w; dst += 2; }
+    acc += w;
+    src += 2;
+    len -= 2;
+  }
+  if (len) {
+    if (dst) *dst = *src;
+    acc += TAIL_LOW(*src);
+  }
+
+  s = fold(acc);
+  if (odd == SWAP_IF_ODD)
+    s = (uint16_t)((s << 8) | (s >> 8));
+  return add16(sum, s);
+}
+
+uint16_t inet_chksum_add(uint16_t sum, const void *data, uint16_t len)
+{
+  return sum_words(sum, NULL, (const uint8_t *)data, len);
+}
+
+uint16_t inet_chksum_copy(uint16_t sum, void *dst, const void *src, uint16_t len)
+{
+  if (((uintptr_t)dst ^ (uintptr_t)src) & 3) {
+    memcpy(dst, src, len);
+    return sum_words(sum, NULL, (const uint8_t *)dst, len);
+  }
+  return sum_words(sum, (uint8_t *)dst, (const uint8_t *)src, len);
+}
+
+uint16_t inet_chksum_update16(uint16_t chksum, uint16_t old_word, uint16_t new_word)
+{
+  /* HC' = ~(~HC + ~m + m') */
+  return (uint16_t)~add16(add16((uint16_t)~chksum, (uint16_t)~old_word), new_word);
+}
+
+uint16_t inet_chksum_update32(uint16_t chksum, uint32_t old_word, uint32_t new_word)
+{
+  chksum = inet_chksum_update16(chksum, (uint16_t)(old_word >> 16), (uint16_t)(new_word >> 16));
+  return inet_chksum_update16(chksum, (uint16_t)old_word, (uint16_t)new_word);
+}
@@ -108,6 +108,7 @@ MemoryPool::allocBlock(memaddress size)
 #endif
           block->begin = address;
           block->size = size;
+          block->refs = 1;
           block->nextblock = best->nextblock;
           best->nextblock = cur;
           return cur;
@@ -117,11 +118,25 @@ MemoryPool::allocBlock(memaddress size)
   notfound: return NOBLOCK;
 }
 
+// a block shared by several users (e.g. a socket and a frame being
+// transmitted from it) is freed when the last of them calls freeBlock()
+void
+MemoryPool::refBlock(memhandle handle)
+{
+  if (handle != NOBLOCK)
+    blocks[handle].refs++;
+}
+
 void
 MemoryPool::freeBlock(memhandle handle)
 {
   if (handle == NOBLOCK)
     return;
+  if (blocks[handle].refs > 1)
+    {
+      blocks[handle].refs--;
+      return;
+    }
   memblock *b = &blocks[POOLSTART];
 
   do
@@ -135,6 +150,7 @@ MemoryPool::freeBlock(memhandle handle)
 #endif
           b->nextblock = f->nextblock;
           f->size = 0;
+          f->refs = 0;
           f->nextblock = NOBLOCK;
           return;
         }
@@ -32,6 +32,7 @@ struct memblock
   memaddress begin;
   memaddress size;
   memhandle nextblock;
+  uint8_t refs;
 };
 
 class MemoryPool
@@ -46,6 +47,7 @@ protected:
 public:
   static void init();
   static memhandle allocBlock(memaddress);
+  static void refBlock(memhandle);
   static void freeBlock(memhandle);
   static void resizeBlock(memhandle handle, memaddress position);
   static void resizeBlock(memhandle handle, memaddress position, memaddress size);
@@ -82,6 +82,7 @@
 #include "uip.h"
 #include "uipopt.h"
 #include "uip_arch.h"
+#include "inet_chksum.h"
 
 #if UIP_CONF_IPV6
 #include "uip-neighbor.h"
@@ -157,6 +158,13 @@ u16_t uip_len, uip_slen;
 				depending on the maximum packet
 				size. */
 
+u16_t uip_acklen;            /* The number of bytes acknowledged
+				(UIP_ACKDATA). */
+#if UIP_TCP_SEGS > 1
+static u16_t uip_sndoff;     /* Offset from snd_nxt of the data
+				segment being sent. */
+#endif /* UIP_TCP_SEGS > 1 */
+
 u8_t uip_flags;     /* The uip_flags variable is used for
 				communication between the TCP/IP stack
 				and the application program. */
@@ -279,32 +287,8 @@ uip_add32(u8_t *op32, u16_t op16)
 static u16_t
 chksum(u16_t sum, const u8_t *data, u16_t len)
 {
-  u16_t t;
-  const u8_t *dataptr;
-  const u8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-  
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
-  
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-  }
-
   /* Return sum in host byte order. */
-  return sum;
+  return inet_chksum_add(sum, data, len);
 }
 /*---------------------------------------------------------------------------*/
 u16_t
@@ -455,6 +439,9 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   conn->initialmss = conn->mss = UIP_TCP_MSS;
   
   conn->len = 1;   /* TCP length of the SYN is one. */
+#if UIP_TCP_SEGS > 1
+  conn->nsegs = 0;
+#endif /* UIP_TCP_SEGS > 1 */
   conn->nrtx = 0;
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
@@ -678,6 +665,49 @@ uip_add_rcv_nxt(u16_t n)
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP_SEGS > 1
+/* Take the data acknowledged by the incoming ACK off the segments in
+   flight and move snd_nxt past it. A segment may be acknowledged in
+   part, when the peer got it split differently before a retransmit.
+   Returns the number of bytes acknowledged. */
+static u16_t
+uip_acksegs(struct uip_conn *conn)
+{
+  unsigned long acked;
+  u16_t left;
+  u8_t n;
+
+  acked = ((((unsigned long)BUF->ackno[0] << 24) |
+	    ((unsigned long)BUF->ackno[1] << 16) |
+	    ((unsigned long)BUF->ackno[2] << 8) | BUF->ackno[3]) -
+	   (((unsigned long)conn->snd_nxt[0] << 24) |
+	    ((unsigned long)conn->snd_nxt[1] << 16) |
+	    ((unsigned long)conn->snd_nxt[2] << 8) | conn->snd_nxt[3])) &
+    0xffffffffUL;
+  if(acked == 0 || acked > conn->len) {
+    return 0;
+  }
+  uip_add32(conn->snd_nxt, (u16_t)acked);
+  conn->snd_nxt[0] = uip_acc32[0];
+  conn->snd_nxt[1] = uip_acc32[1];
+  conn->snd_nxt[2] = uip_acc32[2];
+  conn->snd_nxt[3] = uip_acc32[3];
+  conn->len -= (u16_t)acked;
+
+  left = (u16_t)acked;
+  for(n = 0; n < conn->nsegs && left >= conn->seglen[n]; ++n) {
+    left -= conn->seglen[n];
+  }
+  if(n < conn->nsegs) {
+    conn->seglen[n] -= left;
+  }
+  conn->nsegs -= n;
+  memmove(conn->seglen, &conn->seglen[n],
+	  conn->nsegs * sizeof(conn->seglen[0]));
+  return (u16_t)acked;
+}
+#endif /* UIP_TCP_SEGS > 1 */
+/*---------------------------------------------------------------------------*/
 void
 uip_process(u8_t flag)
 {
@@ -695,7 +725,7 @@ uip_process(u8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       uip_pollable(uip_connr)) {
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -786,6 +816,14 @@ uip_process(u8_t flag)
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
                label). */
+#if UIP_TCP_SEGS > 1
+	    /* Go back to the first segment: the ones after it are
+	       sent again as new data. */
+	    if(uip_connr->nsegs > 1) {
+	      uip_connr->len = uip_connr->seglen[0];
+	      uip_connr->nsegs = 1;
+	    }
+#endif /* UIP_TCP_SEGS > 1 */
 	    uip_flags = UIP_REXMIT;
 	    UIP_APPCALL();
 	    goto apprexmit;
@@ -798,7 +836,9 @@ uip_process(u8_t flag)
 	    
 	  }
 	}
-      } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      }
+      if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+	 uip_pollable(uip_connr)) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
 	uip_flags = UIP_POLL;
@@ -995,11 +1035,9 @@ uip_process(u8_t flag)
 
   ICMPBUF->type = ICMP_ECHO_REPLY;
 
-  if(ICMPBUF->icmpchksum >= HTONS(0xffff - (ICMP_ECHO << 8))) {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8) + 1;
-  } else {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8);
-  }
+  ICMPBUF->icmpchksum = htons(inet_chksum_update16(ntohs(ICMPBUF->icmpchksum),
+                                                   ICMP_ECHO << 8,
+                                                   ICMP_ECHO_REPLY << 8));
 
   /* Swap IP addresses. */
   uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
@@ -1315,6 +1353,9 @@ uip_process(u8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SEGS > 1
+  uip_connr->nsegs = 0;
+#endif /* UIP_TCP_SEGS > 1 */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[3] = BUF->seqno[3];
@@ -1420,6 +1461,10 @@ uip_process(u8_t flag)
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+#if UIP_TCP_SEGS > 1
+    uip_acklen = uip_acksegs(uip_connr);
+    if(uip_acklen > 0) {
+#else /* UIP_TCP_SEGS > 1 */
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
     if(BUF->ackno[0] == uip_acc32[0] &&
@@ -1431,6 +1476,8 @@ uip_process(u8_t flag)
       uip_connr->snd_nxt[1] = uip_acc32[1];
       uip_connr->snd_nxt[2] = uip_acc32[2];
       uip_connr->snd_nxt[3] = uip_acc32[3];
+      uip_acklen = uip_connr->len;
+#endif /* UIP_TCP_SEGS > 1 */
 	
 
       /* Do RTT estimation, unless we have done retransmissions. */
@@ -1453,11 +1500,18 @@ uip_process(u8_t flag)
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
 
+#if UIP_TCP_SEGS == 1
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
+#endif /* UIP_TCP_SEGS == 1 */
     }
     
   }
+#if UIP_TCP_SEGS > 1
+  if(BUF->flags & TCP_ACK) {
+    uip_connr->wnd = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+  }
+#endif /* UIP_TCP_SEGS > 1 */
 
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
@@ -1657,6 +1711,9 @@ uip_process(u8_t flag)
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
 	uip_connr->len = 1;
+#if UIP_TCP_SEGS > 1
+	uip_connr->nsegs = 0;
+#endif /* UIP_TCP_SEGS > 1 */
 	uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
 	uip_connr->nrtx = 0;
 	BUF->flags = TCP_FIN | TCP_ACK;
@@ -1665,6 +1722,18 @@ uip_process(u8_t flag)
 
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
+#if UIP_TCP_SEGS > 1
+	/* A new segment after the ones in flight, as far as the
+	   window allows. */
+	if(uip_slen > uip_sendwnd()) {
+	  uip_slen = uip_sendwnd();
+	}
+	if(uip_slen > 0) {
+	  uip_sndoff = uip_connr->len;
+	  uip_connr->seglen[uip_connr->nsegs++] = uip_slen;
+	  uip_connr->len += uip_slen;
+	}
+#else /* UIP_TCP_SEGS > 1 */
 
 	/* If the connection has acknowledged data, the contents of
 	   the ->len variable should be discarded. */
@@ -1694,6 +1763,7 @@ uip_process(u8_t flag)
 	     retransmit) out more than it previously sent out. */
 	  uip_slen = uip_connr->len;
 	}
+#endif /* UIP_TCP_SEGS > 1 */
       }
       uip_connr->nrtx = 0;
     apprexmit:
@@ -1703,7 +1773,12 @@ uip_process(u8_t flag)
          packet had new data in it, we must send out a packet. */
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
+#if UIP_TCP_SEGS > 1
+	uip_len = (uip_flags & UIP_REXMIT ? uip_connr->len : uip_slen) +
+	  UIP_TCPIP_HLEN;
+#else /* UIP_TCP_SEGS > 1 */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#endif /* UIP_TCP_SEGS > 1 */
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
 	/* Send the packet. */
@@ -1804,10 +1879,25 @@ uip_process(u8_t flag)
   BUF->ackno[2] = uip_connr->rcv_nxt[2];
   BUF->ackno[3] = uip_connr->rcv_nxt[3];
   
+#if UIP_TCP_SEGS > 1
+  /* A data segment starts at uip_sndoff (0 when it is sent again);
+     anything else carries the sequence number after the segments in
+     flight. */
+  if(uip_len == UIP_IPTCPH_LEN && uip_connr->nsegs > 0) {
+    uip_sndoff = uip_connr->len;
+  }
+  uip_add32(uip_connr->snd_nxt, uip_sndoff);
+  uip_sndoff = 0;
+  BUF->seqno[0] = uip_acc32[0];
+  BUF->seqno[1] = uip_acc32[1];
+  BUF->seqno[2] = uip_acc32[2];
+  BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SEGS > 1 */
   BUF->seqno[0] = uip_connr->snd_nxt[0];
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SEGS > 1 */
 
   BUF->proto = UIP_PROTO_TCP;
   
@@ -1879,6 +1969,33 @@ uip_process(u8_t flag)
 }
 /*---------------------------------------------------------------------------*/
 u16_t
+uip_sendwnd(void)
+{
+#if UIP_TCP_SEGS > 1
+  u16_t room;
+
+  if(uip_conn->nsegs == UIP_TCP_SEGS) {
+    return 0;
+  }
+  if(uip_conn->len == 0) {
+    return uip_conn->mss;
+  }
+  room = uip_conn->wnd > uip_conn->len? uip_conn->wnd - uip_conn->len: 0;
+  if(room > uip_conn->mss) {
+    room = uip_conn->mss;
+  }
+  /* No small segments into a window that is about to open
+     (RFC 1122, 4.2.3.4). */
+  if(room < uip_conn->mss && room < uip_conn->wnd / 2) {
+    return 0;
+  }
+  return room;
+#else /* UIP_TCP_SEGS > 1 */
+  return uip_outstanding(uip_conn)? 0: uip_conn->mss;
+#endif /* UIP_TCP_SEGS > 1 */
+}
+/*---------------------------------------------------------------------------*/
+u16_t
 htons(u16_t val)
 {
   return HTONS(val);
@@ -510,6 +510,22 @@ struct uip_conn *uip_connect(uip_ipaddr_t *ripaddr, u16_t port);
  */
 #define uip_outstanding(conn) ((conn)->len)
 
+/**
+ * \internal
+ *
+ * Check if a connection can take a new segment from the application,
+ * i.e. if it should be polled.
+ *
+ * \param conn A pointer to the uip_conn structure for the connection.
+ *
+ * \hideinitializer
+ */
+#if UIP_TCP_SEGS > 1
+#define uip_pollable(conn) ((conn)->nsegs < UIP_TCP_SEGS)
+#else /* UIP_TCP_SEGS > 1 */
+#define uip_pollable(conn) (!uip_outstanding(conn))
+#endif /* UIP_TCP_SEGS > 1 */
+
 /**
  * Send data on the current connection.
  *
@@ -537,6 +553,18 @@ struct uip_conn *uip_connect(uip_ipaddr_t *ripaddr, u16_t port);
  */
 void uip_send(const void *data, int len);
 
+/**
+ * How much data may be sent on the current connection now.
+ *
+ * The number of bytes that uip_send() would send as a new segment:
+ * the MSS of the connection, less if the receiver's window has little
+ * room left, and 0 while UIP_TCP_SEGS segments are in flight (with
+ * the default of 1: while there is any unacknowledged data). An
+ * application that keeps several segments in flight sends no more
+ * than this, so it knows how much of its data went out.
+ */
+u16_t uip_sendwnd(void);
+
 /**
  * The length of any incoming data that is currently avaliable (if avaliable)
  * in the uip_appdata buffer.
@@ -697,6 +725,10 @@ void uip_send(const void *data, int len);
  * application should send the exact same data as it did the last
  * time, using the uip_send() function.
  *
+ * With UIP_TCP_SEGS above 1, only the first unacknowledged segment
+ * (uip_conn->len bytes) is sent again; the segments after it count as
+ * not sent and go out again as new data when uip_sendwnd() allows.
+ *
  * \hideinitializer
  */
 #define uip_rexmit()     (uip_flags & UIP_REXMIT)
@@ -1139,6 +1171,15 @@ extern u16_t uip_len;
 extern u16_t uip_urglen, uip_surglen;
 #endif /* UIP_URGDATA > 0 */
 
+/**
+ * The number of bytes acknowledged, when uip_acked() is set.
+ *
+ * All the data sent before with the default UIP_TCP_SEGS of 1, the
+ * first uip_acklen bytes of the unacknowledged data otherwise (usually
+ * whole segments, possibly part of one after a retransmission).
+ */
+extern u16_t uip_acklen;
+
 
 /**
  * Representation of a uIP TCP connection.
@@ -1161,7 +1202,8 @@ struct uip_conn {
 			 receive next. */
   u8_t snd_nxt[4];    /**< The sequence number that was last sent by
                          us. */
-  u16_t len;          /**< Length of the data that was previously sent. */
+  u16_t len;          /**< Length of the data that was previously sent
+			 and is not yet acknowledged. */
   u16_t mss;          /**< Current maximum segment size for the
 			 connection. */
   u16_t initialmss;   /**< Initial maximum segment size for the
@@ -1175,6 +1217,13 @@ struct uip_conn {
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_SEGS > 1
+  u16_t wnd;          /**< The window advertised by the remote host. */
+  u16_t seglen[UIP_TCP_SEGS]; /**< Lengths of the segments in flight,
+			 which make up len. */
+  u8_t nsegs;         /**< Number of segments in flight; 0 with a SYN
+			 or FIN (len 1) or nothing in flight. */
+#endif /* UIP_TCP_SEGS > 1 */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -5,6 +5,15 @@
 #define UIP_SOCKET_NUMPACKETS    5
 #define UIP_CONF_MAX_CONNECTIONS 4
 
+/* number of segments a connection may have in flight, sent straight out of
+ * the outgoing packets (at most UIP_SOCKET_NUMPACKETS). 1 is the plain uIP
+ * stop-and-wait. more is much faster against peers that delay their ACKs,
+ * but a lost segment is only resent on the retransmission timeout, and
+ * then with all segments after it: on lossy links it can be slower */
+#ifndef UIP_CONF_TCP_SEGS
+#define UIP_CONF_TCP_SEGS        1
+#endif
+
 /* for UDP
  * set UIP_CONF_UDP to 0 to disable UDP (saves aprox. 5kb flash) */
 #define UIP_CONF_UDP             1
@@ -323,6 +323,23 @@
 #define UIP_RECEIVE_WINDOW UIP_CONF_RECEIVE_WINDOW
 #endif
 
+/**
+ * The number of segments a connection may have in flight
+ * (unacknowledged) at the same time.
+ *
+ * With 1, uIP waits for the acknowledgement of each segment before
+ * the next one is sent. With more, the application keeps the data of
+ * every segment until it is acknowledged: see uip_sendwnd(),
+ * uip_acklen and uip_rexmit().
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_SEGS
+#define UIP_TCP_SEGS 1
+#else
+#define UIP_TCP_SEGS UIP_CONF_TCP_SEGS
+#endif
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
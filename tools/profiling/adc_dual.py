@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+"""Decode dual ADC capture buffers (STM32F1 STM32ADC::startDual()).
+
+Input is the raw capture as sent by the board, little endian 32 bit
+words with ADC1 in the low half and ADC2 in the high half of each word,
+e.g. written with Serial.write((uint8 *)words, 4 * count).
+
+In simultaneous mode every word is one sample of two channels and is
+printed as "t adc1 adc2". In fast interleaved mode ADC2 converts half a
+sample period before ADC1, so each word is two consecutive samples of
+one channel, high half first, printed as "t value".
+
+    python adc_dual.py --mode interleaved --rate 1714286 capture.bin
+    python adc_dual.py --self-test
+"""
+
+from __future__ import print_function
+
+import argparse
+import math
+import struct
+import sys
+
+SIMULTANEOUS = "simultaneous"
+INTERLEAVED = "interleaved"
+
+
+def words_from_bytes(data):
+    """Little endian 32 bit words; a trailing partial word is dropped."""
+    n = len(data) // 4
+    return list(struct.unpack("<%dI" % n, data[:4 * n]))
+
+
+def decode(words, mode):
+    """Return (adc1, adc2) sample lists for SIMULTANEOUS, or the time
+    ordered sample list for INTERLEAVED."""
+    if mode == SIMULTANEOUS:
+        return ([w & 0xFFFF for w in words], [w >> 16 for w in words])
+    samples = []
+    for w in words:
+        samples.append(w >> 16)
+        samples.append(w & 0xFFFF)
+    return samples
+
+
+def bad_words(words):
+    """Indices of words with bits set above 12 bits in either half, i.e.
+    misaligned or corrupt data (the ADCs are right aligned)."""
+    return [i for i, w in enumerate(words) if w & 0xF000F000]
+
+
+def encode(adc1, adc2):
+    """Pack two sample lists the way the DMA does, for testing."""
+    return [(a & 0xFFFF) | ((b & 0xFFFF) << 16) for a, b in zip(adc1, adc2)]
+
+
+def self_test():
+    n = 64
+    ref = [int(2048 + 2000 * math.sin(2 * math.pi * k / 32.0))
+           for k in range(2 * n)]
+
+    # interleaved: ADC2 takes the even (older) samples, ADC1 the odd ones
+    words = encode(ref[1::2], ref[0::2])
+    data = struct.pack("<%dI" % len(words), *words)
+    assert words_from_bytes(data + b"\x01\x02") == words
+    assert decode(words, INTERLEAVED) == ref
+    assert not bad_words(words)
+
+    adc1 = ref[:n]
+    adc2 = [4095 - v for v in adc1]
+    assert decode(encode(adc1, adc2), SIMULTANEOUS) == (adc1, adc2)
+
+    assert bad_words([0x0FFF0FFF, 0x0FFF1000, 0x80000000]) == [1, 2]
+    print("adc_dual self test passed")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("file", nargs="?", help="capture file, default stdin")
+    parser.add_argument("--mode", choices=[SIMULTANEOUS, INTERLEAVED],
+                        default=INTERLEAVED)
+    parser.add_argument("--rate", type=float, default=0,
+                        help="sample rate in Hz, adds a time column in us")
+    parser.add_argument("--self-test", action="store_true",
+                        help="decode synthetic buffers and exit")
+    args = parser.parse_args()
+
+    if args.self_test:
+        return self_test()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+    else:
+        data = getattr(sys.stdin, "buffer", sys.stdin).read()
+    words = words_from_bytes(data)
+
+    bad = bad_words(words)
+    if bad:
+        print("warning: %d of %d words out of range, first at word %d"
+              % (len(bad), len(words), bad[0]), file=sys.stderr)
+
+    if args.mode == SIMULTANEOUS:
+        rows = zip(*decode(words, SIMULTANEOUS))
+    else:
+        rows = ((v,) for v in decode(words, INTERLEAVED))
+    for k, row in enumerate(rows):
+        cols = [str(v) for v in row]
+        if args.rate:
+            cols.insert(0, "%.3f" % (k * 1e6 / args.rate))
+        print(" ".join(cols))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
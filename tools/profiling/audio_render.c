@@ -0,0 +1,258 @@
+/*
+ * Host renderer for the AudioOut voice mixer (STM32F1 core,
+ * libmaple/audio_mix.c).
+ *
+ * Renders voices through the same code the DMA interrupt runs, checks
+ * the output (pitch, note lengths, mixing, clipping, silence), times
+ * the mixer, and can write the result to a WAV file to listen to.
+ *
+ *     cc -O2 -I<core> -o audio_render audio_render.c <core>/libmaple/audio_mix.c
+ *     ./audio_render                       checks and benchmark
+ *     ./audio_render -o chord.wav          also write a 2 s chord
+ *     ./audio_render -r 44100 -t 4095      sample rate, output top (DAC)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmaple/audio_mix.h>
+
+#define VOICES          8
+#define BLOCK           128
+
+static uint32 rate = 32000;
+static uint16 top = 2250;
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-44s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+/* Render in half buffer sized calls, like the DMA interrupt */
+static void render(audio_voice *voices, uint16 *out, uint32 count)
+{
+    while (count) {
+        uint16 n = count < BLOCK ? (uint16)count : BLOCK;
+        audio_mix_render(voices, VOICES, out, n, top);
+        out += n;
+        count -= n;
+    }
+}
+
+static uint32 rising_crossings(const uint16 *out, uint32 count)
+{
+    uint32 i, n = 0;
+    for (i = 1; i < count; i++) {
+        if (out[i - 1] < top / 2 && out[i] >= top / 2) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void run_checks(void)
+{
+    audio_voice voices[VOICES];
+    uint32 count = rate;                /* one second */
+    uint16 *a = malloc(count * sizeof(uint16));
+    uint16 *b = malloc(count * sizeof(uint16));
+    uint16 *c = malloc(count * sizeof(uint16));
+    uint32 i, n;
+    int ok;
+
+    memset(voices, 0, sizeof(voices));
+    render(voices, a, count);
+    for (ok = 1, i = 0; i < count; i++) {
+        ok &= a[i] == top / 2;
+    }
+    check(ok, "silence at top / 2");
+
+    audio_voice_start(&voices[0], 1000, rate, 0, 255, audio_sine256, 8);
+    render(voices, a, count);
+    n = rising_crossings(a, count);
+    check(n >= 999 && n <= 1001, "1 kHz sine: 1000 periods per second");
+    {
+        uint16 lo = top, hi = 0;
+        for (i = 0; i < count; i++) {
+            lo = a[i] < lo ? a[i] : lo;
+            hi = a[i] > hi ? a[i] : hi;
+        }
+        check(lo <= top / 50 && hi >= top - top / 50, "full scale sine swing");
+    }
+
+    memset(voices, 0, sizeof(voices));
+    audio_voice_start(&voices[0], 440, rate, rate / 10, 128, audio_sine256, 8);
+    render(voices, a, count);
+    for (n = 0, i = 0; i < count; i++) {
+        if (a[i] != top / 2) {
+            n = i + 1;
+        }
+    }
+    check(n <= rate / 10 && n > rate / 10 - rate / 440 && !voices[0].active,
+          "100 ms note stops after 100 ms");
+
+    /* two voices mix as the sum of each one alone */
+    memset(voices, 0, sizeof(voices));
+    audio_voice_start(&voices[0], 440, rate, 0, 64, audio_sine256, 8);
+    render(voices, a, count);
+    memset(voices, 0, sizeof(voices));
+    audio_voice_start(&voices[3], 659, rate, 0, 64, audio_sine256, 8);
+    render(voices, b, count);
+    memset(voices, 0, sizeof(voices));
+    audio_voice_start(&voices[0], 440, rate, 0, 64, audio_sine256, 8);
+    audio_voice_start(&voices[3], 659, rate, 0, 64, audio_sine256, 8);
+    render(voices, c, count);
+    for (ok = 1, i = 0; i < count; i++) {
+        int sum = (int)a[i] + (int)b[i] - top / 2;
+        ok &= abs(sum - (int)c[i]) <= 2;
+    }
+    check(ok, "mixing is additive");
+
+    memset(voices, 0, sizeof(voices));
+    for (i = 0; i < VOICES; i++) {
+        audio_voice_start(&voices[i], 100 + 50 * i, rate, 0, 255, NULL, 0);
+    }
+    render(voices, a, count);
+    for (ok = 1, i = 0; i < count; i++) {
+        ok &= a[i] <= top;
+    }
+    check(ok, "8 full scale square voices clip in range");
+
+    memset(voices, 0, sizeof(voices));
+    audio_voice_start(&voices[0], 250, rate, 0, 255, NULL, 0);
+    render(voices, a, count);
+    for (ok = 1, i = 0; i < count; i++) {
+        ok &= a[i] < top / 100 || a[i] > top - top / 100;
+    }
+    n = rising_crossings(a, count);
+    check(ok && n >= 249 && n <= 251, "250 Hz square wave");
+
+    free(a);
+    free(b);
+    free(c);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(void)
+{
+    audio_voice voices[VOICES];
+    uint16 buf[BLOCK];
+    uint32 seconds = 20, blocks = seconds * rate / BLOCK, k;
+    int nv;
+
+    printf("\nmixer time per sample (%u Hz, %u sample blocks):\n", rate, BLOCK);
+    for (nv = 1; nv <= VOICES; nv *= 2) {
+        double t0, t;
+        int v;
+        memset(voices, 0, sizeof(voices));
+        for (v = 0; v < nv; v++) {
+            audio_voice_start(&voices[v], 220 + 110 * v, rate, 0, 255 / nv,
+                              audio_sine256, 8);
+        }
+        t0 = now();
+        for (k = 0; k < blocks; k++) {
+            audio_mix_render(voices, VOICES, buf, BLOCK, top);
+        }
+        t = now() - t0;
+        printf("  %d voices: %6.2f ns/sample, %7.0fx real time\n",
+               nv, t * 1e9 / ((double)blocks * BLOCK), seconds / t);
+    }
+}
+
+static void put16(FILE *f, uint32 v)
+{
+    fputc(v & 0xFF, f);
+    fputc((v >> 8) & 0xFF, f);
+}
+
+static void put32(FILE *f, uint32 v)
+{
+    put16(f, v & 0xFFFF);
+    put16(f, v >> 16);
+}
+
+/* A C major chord, notes starting 250 ms apart, as 16 bit PCM */
+static int write_wav(const char *path)
+{
+    static const uint32 notes[] = { 262, 330, 392, 523 };
+    audio_voice voices[VOICES];
+    uint32 count = 2 * rate, i;
+    uint16 *out = malloc(count * sizeof(uint16));
+    FILE *f = fopen(path, "wb");
+
+    if (!f || !out) {
+        perror(path);
+        return 1;
+    }
+    memset(voices, 0, sizeof(voices));
+    for (i = 0; i < 4; i++) {
+        uint32 at = i * rate / 4;
+        render(voices, out + at, rate / 4);
+        audio_voice_start(&voices[i], notes[i], rate, count - at - rate / 4, 60,
+                          audio_sine256, 8);
+    }
+    render(voices, out + rate, count - rate);
+
+    fwrite("RIFF", 1, 4, f);
+    put32(f, 36 + 2 * count);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put32(f, 16);
+    put16(f, 1);                        /* PCM */
+    put16(f, 1);                        /* mono */
+    put32(f, rate);
+    put32(f, 2 * rate);
+    put16(f, 2);
+    put16(f, 16);
+    fwrite("data", 1, 4, f);
+    put32(f, 2 * count);
+    for (i = 0; i < count; i++) {
+        int32 s = ((int32)out[i] - top / 2) * 32767 / (top / 2);
+        put16(f, (uint16)(int16)s);
+    }
+    fclose(f);
+    free(out);
+    printf("\nwrote %s\n", path);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *wav = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            rate = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            top = (uint16)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            wav = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-r rate] [-t top] [-o file.wav]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    run_checks();
+    bench();
+    if (wav && write_wav(wav)) {
+        return 1;
+    }
+    if (failures) {
+        printf("\n%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
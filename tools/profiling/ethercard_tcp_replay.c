@@ -0,0 +1,947 @@
+/*
+ * Host test of the EtherCard TCP connection table (STM32F1
+ * Serasidis_EtherCard_STM library, src/tcp_conn.c), driven by frames.
+ *
+ * The server side is the same loop a sketch runs: each received frame
+ * goes through tcp_conn_input() and tcp_conn_poll(), then an application
+ * step serves the connections (HTTP on port 80: a 3000 byte reply, then
+ * close; echo on port 1883, closed after the peer closes), then
+ * tcp_conn_poll() again, once per millisecond of virtual time.
+ *
+ * Without -r, model TCP clients talk to it over a simulated network:
+ * more clients than connection slots at once, a slow reader that closes
+ * its window, and a second run with frames lost in both directions.
+ * Every client must get its complete reply and both sides must close;
+ * all server frames must carry valid checksums. -w writes the frames of
+ * the lossy run, as seen by the server, to a pcap file.
+ *
+ * With -r, the frames of a pcap file addressed to the server (the
+ * destination of the first SYN) are fed in at their recorded times, and
+ * the frames the server sends are compared with the recorded ones
+ * (flags, sequence numbers relative to the ISNs, window, data). A capture
+ * written by -w is reproduced exactly; -x makes any difference an error.
+ *
+ *     cc -O2 -I<EtherCard>/src -o ethercard_tcp_replay ethercard_tcp_replay.c \
+ *         <EtherCard>/src/tcp_conn.c <EtherCard>/src/inet_chksum.c
+ *     ./ethercard_tcp_replay -w session.pcap
+ *     ./ethercard_tcp_replay -r session.pcap -x [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcp_conn.h"
+#include "inet_chksum.h"
+#include "net.h"
+
+#define FRAME           1518
+#define HTTP_PORT       80
+#define ECHO_PORT       1883
+#define BODY_LEN        3000
+#define ECHO_MSGS       5
+#define ECHO_MSG_LEN    100
+#define CLIENT_RTO      300
+#define TIME_LIMIT      60000
+
+static const char http_head[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+static const char http_req[] = "GET / HTTP/1.0\r\nHost: ethercard\r\n\r\n";
+
+static const uint8_t srv_mac[6] = { 0x74, 0x69, 0x69, 0x2d, 0x30, 0x31 };
+static uint8_t srv_ip[4] = { 192, 168, 1, 203 };
+static uint8_t srv_buf[FRAME];
+
+static int failures, verbose;
+
+static void check(int ok, const char *what)
+{
+    printf("%-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+static void put16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v >> 16); put16(p + 2, v); }
+
+/* ---- frame queues and pcap ---------------------------------------------- */
+
+typedef struct frame {
+    struct frame *next;
+    uint32_t time;
+    uint16_t len;
+    uint8_t data[FRAME];
+} frame;
+
+typedef struct {
+    frame *head, *tail;
+} queue;
+
+static void enqueue(queue *q, const uint8_t *data, uint16_t len, uint32_t time)
+{
+    frame *f = malloc(sizeof(frame));
+    memcpy(f->data, data, len);
+    f->len = len;
+    f->time = time;
+    f->next = NULL;
+    if (q->tail) {
+        q->tail->next = f;
+    } else {
+        q->head = f;
+    }
+    q->tail = f;
+}
+
+static frame *dequeue(queue *q)
+{
+    frame *f = q->head;
+    if (f) {
+        q->head = f->next;
+        if (!q->head) {
+            q->tail = NULL;
+        }
+    }
+    return f;
+}
+
+static FILE *pcap_out;
+
+static void pcap_write(const uint8_t *data, uint16_t len, uint32_t ms)
+{
+    uint32_t rec[4] = { ms / 1000, (ms % 1000) * 1000, len, len };
+    if (pcap_out) {
+        fwrite(rec, sizeof(rec), 1, pcap_out);
+        fwrite(data, len, 1, pcap_out);
+    }
+}
+
+static FILE *pcap_create(const char *path)
+{
+    static const uint32_t hdr[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1 };
+    FILE *f = fopen(path, "wb");
+    if (f) {
+        fwrite(hdr, sizeof(hdr), 1, f);
+    }
+    return f;
+}
+
+/* Read all frames of a pcap file (Ethernet, us or ns timestamps, either byte order) */
+static int pcap_read(const char *path, queue *q)
+{
+    FILE *f = fopen(path, "rb");
+    uint32_t hdr[6], rec[4], t0 = 0;
+    int swap, nsec, n = 0;
+    uint8_t *data = malloc(65536);
+
+    if (!f || fread(hdr, sizeof(hdr), 1, f) != 1) {
+        fprintf(stderr, "%s: can't read\n", path);
+        exit(2);
+    }
+    swap = hdr[0] == 0xd4c3b2a1 || hdr[0] == 0x4d3cb2a1;
+    nsec = hdr[0] == 0xa1b23c4d || hdr[0] == 0x4d3cb2a1;
+#define SW(x) (swap ? __builtin_bswap32(x) : (x))
+    if (SW(hdr[0]) != 0xa1b2c3d4 && SW(hdr[0]) != 0xa1b23c4d) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        exit(2);
+    }
+    if (SW(hdr[5]) != 1) {
+        fprintf(stderr, "%s: link type %u, not Ethernet\n", path, SW(hdr[5]));
+        exit(2);
+    }
+    while (fread(rec, sizeof(rec), 1, f) == 1) {
+        uint32_t len = SW(rec[2]);
+        uint32_t ms = SW(rec[0]) * 1000 + SW(rec[1]) / (nsec ? 1000000 : 1000);
+        if (len > 65536 || fread(data, len, 1, f) != 1) {
+            break;
+        }
+        if (!n++) {
+            t0 = ms;
+        }
+        if (len <= FRAME) {
+            enqueue(q, data, (uint16_t)len, ms - t0);
+        }
+    }
+#undef SW
+    free(data);
+    fclose(f);
+    return n;
+}
+
+/* ---- segment helpers ------------------------------------------------------ */
+
+static int is_tcp(const uint8_t *b, uint16_t len)
+{
+    return len >= 54 && b[ETH_TYPE_H_P] == ETHTYPE_IP_H_V &&
+           b[ETH_TYPE_L_P] == ETHTYPE_IP_L_V && b[IP_HEADER_LEN_VER_P] == 0x45 &&
+           b[IP_PROTO_P] == IP_PROTO_TCP_V;
+}
+
+static uint16_t tcp_dlen(const uint8_t *b)
+{
+    return get16(b + IP_TOTLEN_H_P) - IP_HEADER_LEN - (b[TCP_HEADER_LEN_P] >> 4) * 4;
+}
+
+static const uint8_t *tcp_data(const uint8_t *b)
+{
+    return b + TCP_SRC_PORT_H_P + (b[TCP_HEADER_LEN_P] >> 4) * 4;
+}
+
+static int checksums_ok(const uint8_t *b)
+{
+    uint16_t tcplen = get16(b + IP_TOTLEN_H_P) - IP_HEADER_LEN;
+    return inet_chksum_add(0, b + IP_P, IP_HEADER_LEN) == 0xFFFF &&
+           inet_chksum_add(IP_PROTO_TCP_V + tcplen, b + IP_SRC_P, 8 + tcplen) == 0xFFFF;
+}
+
+static void trace(const char *dir, const uint8_t *b, uint32_t now)
+{
+    uint8_t f = b[TCP_FLAGS_P];
+    if (!verbose) {
+        return;
+    }
+    printf("%6u %s %u.%u.%u.%u:%u %s%s%s%s%s seq %u ack %u wnd %u len %u\n", now, dir,
+           b[dir[0] == '>' ? IP_DST_P : IP_SRC_P], b[(dir[0] == '>' ? IP_DST_P : IP_SRC_P) + 1],
+           b[(dir[0] == '>' ? IP_DST_P : IP_SRC_P) + 2], b[(dir[0] == '>' ? IP_DST_P : IP_SRC_P) + 3],
+           get16(b + (dir[0] == '>' ? TCP_DST_PORT_H_P : TCP_SRC_PORT_H_P)),
+           f & TCP_FLAGS_SYN_V ? "S" : "", f & TCP_FLAGS_ACK_V ? "A" : "",
+           f & TCP_FLAGS_PUSH_V ? "P" : "", f & TCP_FLAGS_FIN_V ? "F" : "",
+           f & TCP_FLAGS_RST_V ? "R" : "", get32(b + TCP_SEQ_H_P),
+           get32(b + TCP_SEQACK_H_P), get16(b + TCP_WIN_SIZE), tcp_dlen(b));
+}
+
+/* ---- the server: same loop and application as the multiServer sketch ----- */
+
+static struct {
+    uint8_t active;
+    uint8_t match;              /* bytes of "\r\n\r\n" seen */
+    uint16_t pos;               /* reply bytes written */
+} app[TCP_CONN_MAX];
+
+static queue srv_out;
+static uint32_t srv_frames, srv_bad;
+
+static void srv_send(uint16_t len)
+{
+    srv_frames++;
+    if (!checksums_ok(srv_buf)) {
+        srv_bad++;
+    }
+    enqueue(&srv_out, srv_buf, len, 0);
+}
+
+static uint8_t reply_byte(uint16_t pos)
+{
+    if (pos < sizeof(http_head) - 1) {
+        return (uint8_t)http_head[pos];
+    }
+    pos -= sizeof(http_head) - 1;
+    return (uint8_t)('a' + pos % 26);
+}
+
+static void app_step(void)
+{
+    uint8_t buf[128];
+    int8_t id;
+    uint8_t i;
+
+    while ((id = tcp_conn_accept(0)) >= 0) {
+        memset(&app[id], 0, sizeof(app[id]));
+        app[id].active = 1;
+    }
+    for (i = 0; i < TCP_CONN_MAX; i++) {
+        uint8_t st = tcp_conn_state(i);
+        uint16_t n, k;
+
+        if (!app[i].active) {
+            continue;
+        }
+        if (tcp_conn_local_port(i) == HTTP_PORT) {
+            while (app[i].match < 4 && tcp_conn_available(i)) {
+                tcp_conn_read(i, buf, 1);
+                app[i].match = buf[0] == "\r\n\r\n"[app[i].match] ? app[i].match + 1 :
+                               buf[0] == '\r';
+            }
+            if (app[i].match == 4) {
+                uint16_t total = sizeof(http_head) - 1 + BODY_LEN;
+                while ((n = tcp_conn_writable(i)) && app[i].pos < total) {
+                    if (n > sizeof(buf)) {
+                        n = sizeof(buf);
+                    }
+                    if (n > total - app[i].pos) {
+                        n = total - app[i].pos;
+                    }
+                    for (k = 0; k < n; k++) {
+                        buf[k] = reply_byte(app[i].pos + k);
+                    }
+                    app[i].pos += tcp_conn_write(i, buf, n);
+                }
+                if (app[i].pos == total) {
+                    tcp_conn_close(i);
+                    app[i].active = 0;
+                    continue;
+                }
+            }
+        } else {
+            n = tcp_conn_available(i);
+            if (n > tcp_conn_writable(i)) {
+                n = tcp_conn_writable(i);
+            }
+            if (n > sizeof(buf)) {
+                n = sizeof(buf);
+            }
+            tcp_conn_write(i, buf, tcp_conn_read(i, buf, n));
+            if (st == TCP_CONN_CLOSE_WAIT && !tcp_conn_available(i)) {
+                tcp_conn_close(i);
+                app[i].active = 0;
+                continue;
+            }
+        }
+        if (st == TCP_CONN_CLOSED) {
+            tcp_conn_close(i);
+            app[i].active = 0;
+        }
+    }
+}
+
+static void srv_init(void)
+{
+    tcp_conn_netif nif = { srv_buf, sizeof(srv_buf), srv_mac, srv_ip, srv_send };
+    tcp_conn_init(&nif);
+    tcp_conn_listen(HTTP_PORT);
+    tcp_conn_listen(ECHO_PORT);
+    memset(app, 0, sizeof(app));
+}
+
+/* What packetLoop() does with a frame, then the sketch's loop() */
+static void srv_input(const uint8_t *data, uint16_t len, uint32_t now)
+{
+    memcpy(srv_buf, data, len);
+    if (tcp_conn_input(len, now)) {
+        tcp_conn_poll(now);
+    }
+}
+
+static void srv_tick(uint32_t now)
+{
+    app_step();
+    tcp_conn_poll(now);
+}
+
+static int srv_idle(void)
+{
+    uint8_t i;
+    for (i = 0; i < TCP_CONN_MAX; i++) {
+        if (tcp_conn_state(i) != TCP_CONN_CLOSED || app[i].active) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---- model clients -------------------------------------------------------- */
+
+enum { C_IDLE, C_SYN_SENT, C_EST };
+
+typedef struct {
+    uint8_t mac[6], ip[4];
+    uint16_t sport, dport;
+    uint16_t wnd_cap;           /* receive buffer */
+    uint16_t drain;             /* bytes the reader takes per ms, 0: all */
+    uint32_t start;
+    int state, rst, ack_due, fin_wanted, fin_sent, fin_acked, peer_fin, bad;
+    uint32_t iss, snd_una, snd_nxt, snd_max, rcv_nxt, timer;
+    uint16_t srv_wnd;
+    uint8_t tx[ECHO_MSGS * ECHO_MSG_LEN];
+    uint16_t tx_len, tx_avail;
+    uint8_t rx[4096];
+    uint32_t rx_len, unread;
+} client;
+
+static queue to_srv;
+static uint32_t loss_pct, lost;
+static uint32_t rng = 1;
+
+static int lose(void)
+{
+    rng = rng * 1103515245 + 12345;
+    if ((rng >> 16) % 100 < loss_pct) {
+        lost++;
+        return 1;
+    }
+    return 0;
+}
+
+static uint16_t cli_window(const client *c)
+{
+    return c->wnd_cap - c->unread;
+}
+
+static void cli_send(client *c, uint32_t seq, uint8_t flags, uint16_t off, uint16_t n, uint32_t now)
+{
+    uint8_t b[FRAME];
+    uint8_t hlen = 20 + ((flags & TCP_FLAGS_SYN_V) ? 4 : 0);
+    uint16_t tcplen = hlen + n;
+
+    memset(b, 0, 54 + 4);
+    memcpy(b + ETH_DST_MAC, srv_mac, 6);
+    memcpy(b + ETH_SRC_MAC, c->mac, 6);
+    b[ETH_TYPE_H_P] = ETHTYPE_IP_H_V;
+    b[IP_P] = 0x45;
+    put16(b + IP_TOTLEN_H_P, IP_HEADER_LEN + tcplen);
+    b[IP_TTL_P] = 64;
+    b[IP_PROTO_P] = IP_PROTO_TCP_V;
+    memcpy(b + IP_SRC_P, c->ip, 4);
+    memcpy(b + IP_DST_P, srv_ip, 4);
+    put16(b + IP_CHECKSUM_P, ~inet_chksum_add(0, b + IP_P, IP_HEADER_LEN));
+    put16(b + TCP_SRC_PORT_H_P, c->sport);
+    put16(b + TCP_DST_PORT_H_P, c->dport);
+    put32(b + TCP_SEQ_H_P, seq);
+    put32(b + TCP_SEQACK_H_P, (flags & TCP_FLAGS_ACK_V) ? c->rcv_nxt : 0);
+    b[TCP_HEADER_LEN_P] = hlen << 2;
+    b[TCP_FLAGS_P] = flags;
+    put16(b + TCP_WIN_SIZE, cli_window(c));
+    if (flags & TCP_FLAGS_SYN_V) {
+        b[TCP_OPTIONS_P] = 2;
+        b[TCP_OPTIONS_P + 1] = 4;
+        put16(b + TCP_OPTIONS_P + 2, 1460);
+    }
+    memcpy(b + TCP_SRC_PORT_H_P + hlen, c->tx + off, n);
+    put16(b + TCP_CHECKSUM_H_P,
+          ~inet_chksum_add(IP_PROTO_TCP_V + tcplen, b + IP_SRC_P, 8 + tcplen));
+    if (flags & TCP_FLAGS_ACK_V) {
+        c->ack_due = 0;
+    }
+    if (!lose()) {
+        enqueue(&to_srv, b, ETH_HEADER_LEN + IP_HEADER_LEN + tcplen, now + 1);
+    }
+}
+
+static void cli_input(client *c, const uint8_t *b, uint32_t now)
+{
+    uint8_t flags = b[TCP_FLAGS_P];
+    uint32_t seq = get32(b + TCP_SEQ_H_P), ack = get32(b + TCP_SEQACK_H_P);
+    uint16_t dlen = tcp_dlen(b);
+
+    if (!checksums_ok(b)) {
+        c->bad++;
+        return;
+    }
+    if (flags & TCP_FLAGS_RST_V) {
+        c->rst = 1;
+        c->state = C_IDLE;
+        return;
+    }
+    if (c->state == C_SYN_SENT) {
+        if ((flags & TCP_FLAGS_SYNACK_V) == TCP_FLAGS_SYNACK_V && ack == c->iss + 1) {
+            c->rcv_nxt = seq + 1;
+            c->snd_una = ack;
+            c->srv_wnd = get16(b + TCP_WIN_SIZE);
+            c->state = C_EST;
+            c->ack_due = 1;
+            c->timer = now;
+        }
+        return;
+    }
+    if (c->state != C_EST) {
+        return;
+    }
+    if (flags & TCP_FLAGS_SYN_V) {
+        c->ack_due = 1;         /* our ACK of the SYN-ACK was lost */
+        return;
+    }
+    if ((int32_t)(ack - c->snd_una) > 0 && (int32_t)(ack - c->snd_max) <= 0) {
+        c->snd_una = ack;
+        if ((int32_t)(c->snd_nxt - ack) < 0) {
+            c->snd_nxt = ack;
+        }
+        c->timer = now;
+        if (c->fin_sent && ack == c->iss + 1 + c->tx_len + 1) {
+            c->fin_acked = 1;
+        }
+    }
+    c->srv_wnd = get16(b + TCP_WIN_SIZE);
+    if (dlen || (flags & TCP_FLAGS_FIN_V)) {
+        if (seq == c->rcv_nxt && !c->peer_fin) {
+            uint16_t n = dlen;
+            if (n > cli_window(c)) {
+                n = cli_window(c);
+            }
+            if (c->rx_len + n <= sizeof(c->rx)) {
+                memcpy(c->rx + c->rx_len, tcp_data(b), n);
+            }
+            c->rx_len += n;
+            c->unread += n;
+            c->rcv_nxt += n;
+            if (n == dlen && (flags & TCP_FLAGS_FIN_V)) {
+                c->rcv_nxt++;
+                c->peer_fin = 1;
+            }
+        }
+        c->ack_due = 1;
+    }
+}
+
+static void cli_step(client *c, uint32_t now)
+{
+    uint16_t before = cli_window(c);
+
+    if (c->state == C_IDLE) {
+        if (now == c->start && !c->rst) {
+            c->iss = 1000000 * (c->sport & 0xFF);
+            c->snd_una = c->iss;
+            c->snd_nxt = c->snd_max = c->iss;
+            c->state = C_SYN_SENT;
+            c->timer = now;
+        } else {
+            return;
+        }
+    }
+    /* the application reads */
+    c->unread -= c->drain && c->drain < c->unread ? c->drain : c->unread;
+    /* window update once it opened by a segment or half the buffer */
+    if (before < 536 && before < c->wnd_cap / 2 &&
+            (cli_window(c) >= 536 || cli_window(c) >= c->wnd_cap / 2)) {
+        c->ack_due = 1;
+    }
+    if (c->dport == HTTP_PORT) {
+        c->fin_wanted = c->peer_fin;
+    } else {
+        uint16_t echoed = (uint16_t)c->rx_len;
+        if (c->tx_avail == echoed && c->tx_avail < c->tx_len) {
+            c->tx_avail += ECHO_MSG_LEN;
+        }
+        c->fin_wanted = echoed == c->tx_len;
+    }
+    /* retransmission */
+    if (c->snd_una != c->snd_max && now - c->timer >= CLIENT_RTO) {
+        c->snd_nxt = c->snd_una;
+        c->fin_sent = 0;
+        c->timer = now;
+    }
+    if (c->state == C_SYN_SENT) {
+        if (c->snd_nxt == c->iss) {
+            cli_send(c, c->iss, TCP_FLAGS_SYN_V, 0, 0, now);
+            c->snd_nxt = c->snd_max = c->iss + 1;
+        }
+        return;
+    }
+    for (;;) {
+        uint16_t off = c->snd_nxt - c->iss - 1;
+        uint16_t n = off < c->tx_avail ? c->tx_avail - off : 0;
+        uint16_t inflight = c->snd_nxt - c->snd_una;
+        if (!n || inflight >= c->srv_wnd || c->fin_sent) {
+            break;
+        }
+        if (n > c->srv_wnd - inflight) {
+            n = c->srv_wnd - inflight;
+        }
+        if (n > 536) {
+            n = 536;
+        }
+        cli_send(c, c->snd_nxt, TCP_FLAGS_PSHACK_V, off, n, now);
+        c->snd_nxt += n;
+    }
+    if (c->fin_wanted && !c->fin_sent && c->snd_nxt == c->iss + 1 + c->tx_len) {
+        cli_send(c, c->snd_nxt, TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V, 0, 0, now);
+        c->snd_nxt++;
+        c->fin_sent = 1;
+    }
+    if ((int32_t)(c->snd_nxt - c->snd_max) > 0) {
+        c->snd_max = c->snd_nxt;
+    }
+    if (c->ack_due) {
+        cli_send(c, c->snd_nxt, TCP_FLAGS_ACK_V, 0, 0, now);
+    }
+}
+
+static int cli_done(const client *c)
+{
+    return c->state == C_EST && c->peer_fin && c->fin_acked;
+}
+
+static int cli_reply_ok(const client *c)
+{
+    uint32_t i;
+    if (c->dport == HTTP_PORT) {
+        if (c->rx_len != sizeof(http_head) - 1 + BODY_LEN) {
+            return 0;
+        }
+        for (i = 0; i < c->rx_len; i++) {
+            if (c->rx[i] != reply_byte((uint16_t)i)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return c->rx_len == c->tx_len && !memcmp(c->rx, c->tx, c->tx_len);
+}
+
+#define CLIENTS 6
+
+static void client_setup(client *c, int n)
+{
+    memset(c, 0, sizeof(*c));
+    c->mac[0] = 0x02;
+    c->mac[5] = (uint8_t)n;
+    c->ip[0] = 192;
+    c->ip[1] = 168;
+    c->ip[2] = 1;
+    c->ip[3] = (uint8_t)(10 + n);
+    c->sport = (uint16_t)(40000 + n);
+    c->wnd_cap = 4096;
+    c->start = 1 + (n % 3);
+    if (n == 1 || n == 4) {
+        int i;
+        c->dport = ECHO_PORT;
+        c->tx_len = ECHO_MSGS * ECHO_MSG_LEN;
+        for (i = 0; i < c->tx_len; i++) {
+            c->tx[i] = (uint8_t)(i * 7 + n);
+        }
+    } else {
+        c->dport = HTTP_PORT;
+        memcpy(c->tx, http_req, sizeof(http_req) - 1);
+        c->tx_len = c->tx_avail = sizeof(http_req) - 1;
+    }
+    if (n == 2) {
+        c->wnd_cap = 400;       /* slow reader: the window closes */
+        c->drain = 1;
+    }
+}
+
+static void session(uint32_t loss, const char *name, const char *wpath)
+{
+    client clients[CLIENTS];
+    uint32_t now, done_at = 0;
+    int i, all, ok;
+    char what[80];
+
+    srv_init();
+    loss_pct = loss;
+    lost = 0;
+    srv_frames = srv_bad = 0;
+    for (i = 0; i < CLIENTS; i++) {
+        client_setup(&clients[i], i);
+    }
+    pcap_out = wpath ? pcap_create(wpath) : NULL;
+
+    for (now = 1; now < TIME_LIMIT; now++) {
+        frame *f;
+
+        while (to_srv.head && to_srv.head->time <= now) {
+            f = dequeue(&to_srv);
+            trace("<", f->data, now);
+            pcap_write(f->data, f->len, now);
+            srv_input(f->data, f->len, now);
+            free(f);
+        }
+        srv_tick(now);
+        while ((f = dequeue(&srv_out))) {
+            trace(">", f->data, now);
+            pcap_write(f->data, f->len, now);
+            if (!lose()) {
+                for (i = 0; i < CLIENTS; i++) {
+                    if (!memcmp(f->data + IP_DST_P, clients[i].ip, 4)) {
+                        cli_input(&clients[i], f->data, now);
+                    }
+                }
+            }
+            free(f);
+        }
+        for (i = 0; i < CLIENTS; i++) {
+            cli_step(&clients[i], now);
+        }
+        for (all = 1, i = 0; i < CLIENTS; i++) {
+            all &= cli_done(&clients[i]);
+        }
+        if (all && srv_idle()) {
+            done_at = now;
+            break;
+        }
+    }
+    while (to_srv.head) {
+        free(dequeue(&to_srv));
+    }
+    if (pcap_out) {
+        fclose(pcap_out);
+    }
+
+    printf("%s: %u ms, %u server frames, %u lost\n", name, done_at, srv_frames, lost);
+    for (ok = 1, i = 0; i < CLIENTS; i++) {
+        ok &= cli_done(&clients[i]) && cli_reply_ok(&clients[i]) && !clients[i].rst;
+        if (verbose && !(cli_done(&clients[i]) && cli_reply_ok(&clients[i]))) {
+            printf("  client %d: state %d rx %u fin %d/%d rst %d\n", i, clients[i].state,
+                   clients[i].rx_len, clients[i].peer_fin, clients[i].fin_acked, clients[i].rst);
+        }
+    }
+    snprintf(what, sizeof(what), "%s: %d clients, %d slots: replies complete", name,
+             CLIENTS, TCP_CONN_MAX);
+    check(ok, what);
+    snprintf(what, sizeof(what), "%s: all connections closed, slots free", name);
+    check(done_at && srv_idle(), what);
+    for (ok = 1, i = 0; i < CLIENTS; i++) {
+        ok &= !clients[i].bad;
+    }
+    snprintf(what, sizeof(what), "%s: server checksums valid", name);
+    check(ok && !srv_bad, what);
+}
+
+static void edge_cases(void)
+{
+    uint8_t b[FRAME];
+    client c;
+    frame *f;
+
+    srv_init();
+    client_setup(&c, 9);
+    c.iss = 5000;
+    c.rcv_nxt = 77;
+
+    /* SYN to a port nobody listens on: left to the rest of the stack */
+    c.dport = 8080;
+    cli_send(&c, c.iss, TCP_FLAGS_SYN_V, 0, 0, 0);
+    f = dequeue(&to_srv);
+    memcpy(srv_buf, f->data, f->len);
+    check(tcp_conn_input(f->len, 1) == 0 && !srv_out.head, "SYN to other port not taken");
+    free(f);
+
+    /* ACK without a connection: reset with seq = ack */
+    c.dport = HTTP_PORT;
+    cli_send(&c, c.iss, TCP_FLAGS_ACK_V, 0, 0, 0);
+    f = dequeue(&to_srv);
+    memcpy(srv_buf, f->data, f->len);
+    check(tcp_conn_input(f->len, 1) == 1, "stray ACK to listening port taken");
+    free(f);
+    f = dequeue(&srv_out);
+    check(f && (f->data[TCP_FLAGS_P] & TCP_FLAGS_RST_V) &&
+          get32(f->data + TCP_SEQ_H_P) == 77 && checksums_ok(f->data),
+          "stray ACK answered by RST, seq = its ack");
+    free(f);
+
+    /* bad checksum: dropped */
+    cli_send(&c, c.iss, TCP_FLAGS_SYN_V, 0, 0, 0);
+    f = dequeue(&to_srv);
+    memcpy(b, f->data, f->len);
+    b[TCP_SEQ_H_P] ^= 1;
+    memcpy(srv_buf, b, f->len);
+    tcp_conn_input(f->len, 1);
+    tcp_conn_poll(1);
+    check(!srv_out.head, "segment with bad checksum dropped");
+    free(f);
+}
+
+/* ---- replay --------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t ip[4];
+    uint16_t port;
+    uint32_t rec_iss, our_iss;
+    int have_rec, have_our;
+} replay_conn;
+
+static replay_conn rconns[64];
+static int nrconns;
+
+static replay_conn *rconn(const uint8_t *ip, uint16_t port)
+{
+    int i;
+    for (i = 0; i < nrconns; i++) {
+        if (rconns[i].port == port && !memcmp(rconns[i].ip, ip, 4)) {
+            return &rconns[i];
+        }
+    }
+    if (nrconns == 64) {
+        return NULL;
+    }
+    memset(&rconns[nrconns], 0, sizeof(rconns[0]));
+    memcpy(rconns[nrconns].ip, ip, 4);
+    rconns[nrconns].port = port;
+    return &rconns[nrconns++];
+}
+
+/* Compare a server frame with the recorded one, sequence numbers relative to the ISN */
+static int same_segment(const uint8_t *ours, const uint8_t *rec)
+{
+    replay_conn *rc = rconn(ours + IP_DST_P, get16(ours + TCP_DST_PORT_H_P));
+    uint32_t d = rc && rc->have_rec && rc->have_our ? rc->our_iss - rc->rec_iss : 0;
+
+    return !memcmp(ours + IP_DST_P, rec + IP_DST_P, 4) &&
+           get16(ours + TCP_DST_PORT_H_P) == get16(rec + TCP_DST_PORT_H_P) &&
+           ours[TCP_FLAGS_P] == rec[TCP_FLAGS_P] &&
+           get32(ours + TCP_SEQ_H_P) - d == get32(rec + TCP_SEQ_H_P) &&
+           (!(ours[TCP_FLAGS_P] & TCP_FLAGS_ACK_V) ||
+            get32(ours + TCP_SEQACK_H_P) == get32(rec + TCP_SEQACK_H_P)) &&
+           get16(ours + TCP_WIN_SIZE) == get16(rec + TCP_WIN_SIZE) &&
+           tcp_dlen(ours) == tcp_dlen(rec) &&
+           !memcmp(tcp_data(ours), tcp_data(rec), tcp_dlen(ours));
+}
+
+static void replay(const char *path, int exact)
+{
+    queue in = { NULL, NULL }, rec = { NULL, NULL };
+    frame *f;
+    uint32_t now = 0, end, frames, fed = 0, recorded = 0, matched = 0, extra = 0;
+    int have_srv = 0;
+
+    frames = pcap_read(path, &in);
+    /* the server: destination of the first SYN */
+    for (f = in.head; f; f = f->next) {
+        if (is_tcp(f->data, f->len) &&
+                (f->data[TCP_FLAGS_P] & (TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V)) == TCP_FLAGS_SYN_V) {
+            memcpy(srv_ip, f->data + IP_DST_P, 4);
+            have_srv = 1;
+            break;
+        }
+    }
+    if (!have_srv) {
+        fprintf(stderr, "%s: no TCP SYN found\n", path);
+        exit(2);
+    }
+    printf("replay %s: %u frames, server %u.%u.%u.%u\n", path, frames,
+           srv_ip[0], srv_ip[1], srv_ip[2], srv_ip[3]);
+    srv_init();
+    for (f = in.head; f; f = f->next) {
+        if (is_tcp(f->data, f->len) &&
+                (f->data[TCP_FLAGS_P] & (TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V)) == TCP_FLAGS_SYN_V &&
+                !memcmp(f->data + IP_DST_P, srv_ip, 4)) {
+            tcp_conn_listen(get16(f->data + TCP_DST_PORT_H_P));
+        }
+    }
+    end = in.tail ? in.tail->time + 1 : 0;
+
+    for (now = 0; now <= end + 100; now++) {
+        while (in.head && in.head->time <= now) {
+            f = dequeue(&in);
+            if (!is_tcp(f->data, f->len)) {
+                free(f);
+                continue;
+            }
+            if (!memcmp(f->data + IP_SRC_P, srv_ip, 4)) {
+                /* a recorded server frame: learn its ISN, keep it to compare */
+                uint8_t fl = f->data[TCP_FLAGS_P];
+                if ((fl & TCP_FLAGS_SYNACK_V) == TCP_FLAGS_SYNACK_V) {
+                    replay_conn *rc = rconn(f->data + IP_DST_P, get16(f->data + TCP_DST_PORT_H_P));
+                    if (rc) {
+                        rc->rec_iss = get32(f->data + TCP_SEQ_H_P);
+                        rc->have_rec = 1;
+                    }
+                }
+                f->next = NULL;
+                if (rec.tail) {
+                    rec.tail->next = f;
+                } else {
+                    rec.head = f;
+                }
+                rec.tail = f;
+                recorded++;
+                continue;
+            }
+            if (!memcmp(f->data + IP_DST_P, srv_ip, 4)) {
+                /* a client frame: its ack refers to the recorded server ISN */
+                replay_conn *rc = rconn(f->data + IP_SRC_P, get16(f->data + TCP_SRC_PORT_H_P));
+                if (rc && rc->have_rec && rc->have_our && rc->rec_iss != rc->our_iss &&
+                        (f->data[TCP_FLAGS_P] & TCP_FLAGS_ACK_V)) {
+                    uint16_t tcplen = get16(f->data + IP_TOTLEN_H_P) - IP_HEADER_LEN;
+                    put32(f->data + TCP_SEQACK_H_P,
+                          get32(f->data + TCP_SEQACK_H_P) - rc->rec_iss + rc->our_iss);
+                    put16(f->data + TCP_CHECKSUM_H_P, 0);
+                    put16(f->data + TCP_CHECKSUM_H_P,
+                          ~inet_chksum_add(IP_PROTO_TCP_V + tcplen, f->data + IP_SRC_P, 8 + tcplen));
+                }
+                trace("<", f->data, now);
+                srv_input(f->data, f->len, now);
+                fed++;
+            }
+            free(f);
+        }
+        srv_tick(now);
+        while ((f = dequeue(&srv_out))) {
+            frame *r = NULL;
+            if ((f->data[TCP_FLAGS_P] & TCP_FLAGS_SYNACK_V) == TCP_FLAGS_SYNACK_V) {
+                replay_conn *rc = rconn(f->data + IP_DST_P, get16(f->data + TCP_DST_PORT_H_P));
+                if (rc) {
+                    rc->our_iss = get32(f->data + TCP_SEQ_H_P);
+                    rc->have_our = 1;
+                }
+            }
+            trace(">", f->data, now);
+            /* the recorded frame may come later in the file: look ahead a little */
+            while (!rec.head && in.head && in.head->time <= now + 50) {
+                frame *g = dequeue(&in);
+                if (is_tcp(g->data, g->len) && !memcmp(g->data + IP_SRC_P, srv_ip, 4)) {
+                    g->next = NULL;
+                    rec.head = rec.tail = g;
+                    recorded++;
+                } else {
+                    /* not ours to compare; put it back in front */
+                    g->next = in.head;
+                    in.head = g;
+                    if (!in.tail) {
+                        in.tail = g;
+                    }
+                    break;
+                }
+            }
+            r = dequeue(&rec);
+            if (r && same_segment(f->data, r->data)) {
+                matched++;
+            } else {
+                extra++;
+                if (verbose) {
+                    printf("       differs from the recorded frame\n");
+                }
+            }
+            free(r);
+            free(f);
+        }
+    }
+    while ((f = dequeue(&rec))) {
+        free(f);
+    }
+    while ((f = dequeue(&in))) {
+        recorded += is_tcp(f->data, f->len) && !memcmp(f->data + IP_SRC_P, srv_ip, 4);
+        free(f);
+    }
+    printf("%u client frames fed, %u server frames recorded, %u reproduced, %u differ\n",
+           fed, recorded, matched, extra + (recorded > matched + extra ? recorded - matched - extra : 0));
+    check(!srv_bad, "replay: server checksums valid");
+    if (exact) {
+        check(matched == recorded && !extra, "replay: server frames reproduced exactly");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *rpath = NULL, *wpath = NULL;
+    int i, exact = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            rpath = argv[++i];
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            wpath = argv[++i];
+        } else if (!strcmp(argv[i], "-x")) {
+            exact = 1;
+        } else if (!strcmp(argv[i], "-v")) {
+            verbose = 1;
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-w out.pcap] [-s seed] [-v] | -r in.pcap [-x] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rpath) {
+        replay(rpath, exact);
+    } else {
+        edge_cases();
+        session(0, "lossless", NULL);
+        session(3, "3% loss", wpath);
+    }
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures != 0;
+}
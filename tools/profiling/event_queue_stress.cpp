@@ -0,0 +1,201 @@
+/*
+ * Host stress test of the STM32F1 lock-free event queue
+ * (libmaple/event_queue.c), with std::thread producers.
+ *
+ * event_queue.c is compiled into this file with the Cortex-M helpers
+ * replaced: __cas32() by a compare and swap, LDREX/STREX by a load and a
+ * compare and swap against the loaded value (a store fails if another
+ * thread wrote in between), DMB by a full fence, the DWT cycle counter
+ * by a nanosecond clock. The threads race much harder than interrupt
+ * handlers on one core, which only preempt each other.
+ *
+ * Several producers post numbered events while one consumer reads them:
+ *
+ *   - without drops (producers retry when the queue is full), every
+ *     event arrives exactly once and in order per producer
+ *   - with drops (a small queue, no retry, bursts of 16 events), the
+ *     events that arrive are in order per producer, posted + dropped
+ *     matches the calls made, received matches posted
+ *
+ * A queue that makes no progress for 2 s fails the test. Reports the
+ * events per second.
+ *
+ *     g++ -O2 -pthread -I<maple> -o event_queue_stress event_queue_stress.cpp
+ *     ./event_queue_stress [producers] [events per producer]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <libmaple/libmaple_types.h>
+
+/* keep the hardware headers out, event_queue.c gets these instead */
+#define _LIBMAPLE_DWT_H_
+#define _CORTEX_M3_ATOMIC_H_
+
+static struct { uint32 CTRL; } dwt_stub = { 1 };
+#define DWT_BASE                (&dwt_stub)
+#define DWT_CTRL_CYCCNTENA      (1U << 0)
+
+static inline void dwt_cyccnt_enable(void) {}
+
+static inline uint32 dwt_cycles(void)
+{
+    return (uint32)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static thread_local uint32_t ldrex_value;
+
+static inline uint32_t __ldrexw(volatile uint32_t *addr)
+{
+    ldrex_value = __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+    return ldrex_value;
+}
+
+static inline uint32_t __strexw(uint32_t value, volatile uint32_t *addr)
+{
+    uint32_t expected = ldrex_value;
+    return !__atomic_compare_exchange_n(addr, &expected, value, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t __cas32(volatile uint32_t *addr, uint32_t oldval, uint32_t newval)
+{
+    __atomic_compare_exchange_n(addr, &oldval, newval, false,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return oldval;
+}
+
+static inline void __dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+extern "C" {
+#include "libmaple/event_queue.c"
+}
+
+static int failures;
+
+static void check(int ok, const char *what, long a, long b)
+{
+    if (!ok) {
+        if (failures < 20)
+            printf("FAIL: %s (%ld, %ld)\n", what, a, b);
+        failures++;
+    }
+}
+
+/* gives the other threads a turn, also on a single core */
+static void relax(void)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+}
+
+/* returns the events per second read by the consumer */
+static double run(int producers, uint32 events, uint32 size, bool retry)
+{
+    std::vector<evq_slot> slots(size);
+    std::vector<uint32> next(producers, 0), got(producers, 0);
+    std::vector<uint32> calls(producers, 0), ok(producers, 0);
+    std::atomic<int> running(producers);
+    std::vector<std::thread> threads;
+    evq q;
+
+    evq_init(&q, size, slots.data());
+    auto t0 = std::chrono::steady_clock::now();
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (uint32 i = 0; i < events; i++) {
+                for (;;) {
+                    calls[p]++;
+                    if (evq_post(&q, p, i)) {
+                        ok[p]++;
+                        break;
+                    }
+                    if (!retry)
+                        break;
+                    relax();
+                }
+                if (!retry && i % 16 == 15)
+                    relax(); // bursts, like interrupts
+            }
+            running--;
+        });
+    }
+
+    /* consumer: in order per producer, no duplicates */
+    uint32 received = 0;
+    auto last = std::chrono::steady_clock::now();
+    evq_event ev;
+    for (;;) {
+        if (evq_get(&q, &ev)) {
+            last = std::chrono::steady_clock::now();
+            int p = (int)ev.id;
+            check(p >= 0 && p < producers, "producer id", p, ev.data);
+            if (p < 0 || p >= producers)
+                continue;
+            check(ev.data >= next[p], "order", p, ev.data);
+            if (retry)
+                check(ev.data == next[p], "lost or duplicated", p, ev.data);
+            next[p] = ev.data + 1;
+            got[p]++;
+            received++;
+        } else if (running == 0 && evq_count(&q) == 0) {
+            break;
+        } else if (std::chrono::steady_clock::now() - last > std::chrono::seconds(2)) {
+            // a claimed slot never became ready, or the producers spin
+            printf("FAIL: stalled, head %u tail %u, %d producers running\n",
+                   (unsigned)q.head, (unsigned)q.tail, (int)running);
+            exit(1);
+        } else {
+            relax();
+        }
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for (auto &t : threads)
+        t.join();
+
+    uint32 total_calls = 0, total_ok = 0;
+    for (int p = 0; p < producers; p++) {
+        total_calls += calls[p];
+        total_ok += ok[p];
+        check(got[p] == ok[p], "received per producer", p, got[p]);
+        if (retry)
+            check(got[p] == events, "all events", p, got[p]);
+    }
+    check(q.posted == total_ok, "posted counter", q.posted, total_ok);
+    check(q.posted + q.dropped == total_calls, "posted + dropped", q.posted + q.dropped, total_calls);
+    check(q.received == received, "received counter", q.received, received);
+    check(q.received == q.posted, "received == posted", q.received, q.posted);
+    printf("%9d %8u %8s %10u %10u %12.0f\n", producers, size, retry ? "retry" : "drop",
+           (unsigned)q.posted, (unsigned)q.dropped, received / s);
+    return received / s;
+}
+
+int main(int argc, char **argv)
+{
+    int producers = (argc > 1) ? atoi(argv[1]) : 4;
+    uint32 events = (argc > 2) ? strtoul(argv[2], NULL, 0) : 200000;
+
+    printf("%9s %8s %8s %10s %10s %12s\n", "producers", "slots", "mode",
+           "posted", "dropped", "events/s");
+    run(1, events, 256, true);
+    run(producers, events, 256, true);
+    run(producers, events, 4, true);
+    run(producers, events, 4, false);
+    run(producers * 2, events / 2, 16, false);
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
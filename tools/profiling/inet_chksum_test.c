@@ -0,0 +1,247 @@
+/*
+ * Host tests and benchmark for the Internet checksum module shared by
+ * EtherCard (STM32F1) and uIP (STM32F4), inet_chksum.c.
+ *
+ * Checks the RFC 1071 and an IPv4 header vector, the word sum against a
+ * byte at a time reference for every start alignment and length up to
+ * 600 bytes, the copying variant (also with src and dst misaligned to
+ * each other), and the RFC 1624 updates against a full recompute. Then
+ * times the word sum, the copying sum and the reference in ns and,
+ * on x86, TSC cycles per byte.
+ *
+ *     cc -O2 -I<uip>/utility -o inet_chksum_test inet_chksum_test.c \
+ *         <uip>/utility/inet_chksum.c
+ *     ./inet_chksum_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "inet_chksum.h"
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failures++;
+    }
+}
+
+/* The 16 bit big endian word loop the drivers used before */
+static uint16_t ref_sum(uint16_t sum, const uint8_t *p, uint16_t len)
+{
+    uint32_t acc = sum;
+
+    while (len > 1) {
+        acc += (uint32_t)(p[0] << 8 | p[1]);
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+        acc += (uint32_t)p[0] << 8;
+    }
+    while (acc >> 16) {
+        acc = (acc & 0xFFFF) + (acc >> 16);
+    }
+    return (uint16_t)acc;
+}
+
+/* One's complement values compare equal when 0x0000 and 0xFFFF are the same */
+static int same(uint16_t a, uint16_t b)
+{
+    return a == b || ((a == 0 || a == 0xFFFF) && (b == 0 || b == 0xFFFF));
+}
+
+static void vectors(void)
+{
+    static const uint8_t rfc1071[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+    static const uint8_t ip[20] = {
+        0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+        0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7,
+    };
+    uint8_t buf[32];
+    uint16_t ck;
+    int i, ok;
+
+    check(inet_chksum_add(0, rfc1071, sizeof(rfc1071)) == 0xddf2,
+          "RFC 1071 example sums to 0xddf2");
+    for (ok = 1, i = 1; i < 8; i++) {
+        memcpy(buf + i, rfc1071, sizeof(rfc1071));
+        ok &= inet_chksum_add(0, buf + i, sizeof(rfc1071)) == 0xddf2;
+    }
+    check(ok, "RFC 1071 example at addresses +1..+7");
+    check(inet_chksum_add(0xddf2, rfc1071, 0) == 0xddf2, "zero length returns sum");
+
+    ck = (uint16_t)~inet_chksum_add(0, ip, sizeof(ip));
+    check(ck == 0xb861, "IPv4 header checksum 0xb861");
+    memcpy(buf + 1, ip, sizeof(ip));
+    buf[11] = ck >> 8;
+    buf[12] = ck & 0xFF;
+    check(inet_chksum_add(0, buf + 1, sizeof(ip)) == 0xFFFF,
+          "IPv4 header with checksum verifies (odd address)");
+}
+
+static void against_reference(uint8_t *pool)
+{
+    uint8_t dst[640];
+    uint16_t len, sum, want;
+    int a, d, ok = 1, okc = 1, okx = 1;
+
+    for (a = 0; a < 8; a++) {
+        for (len = 0; len <= 600; len++) {
+            sum = (uint16_t)(rand() & 0xFFFF);
+            want = ref_sum(sum, pool + a, len);
+            ok &= same(inet_chksum_add(sum, pool + a, len), want);
+
+            memset(dst, 0, sizeof(dst));
+            okc &= same(inet_chksum_copy(sum, dst + a, pool + a, len), want);
+            okc &= !memcmp(dst + a, pool + a, len);
+
+            d = (a + 1 + len) & 7;
+            if (((d ^ a) & 3) == 0) {
+                d ^= 1;
+            }
+            memset(dst, 0, sizeof(dst));
+            okx &= same(inet_chksum_copy(sum, dst + d, pool + a, len), want);
+            okx &= !memcmp(dst + d, pool + a, len);
+        }
+    }
+    check(ok, "word sum == bytewise, alignments 0..7, len 0..600");
+    check(okc, "copying sum, same alignment: sum and data");
+    check(okx, "copying sum, mixed alignment: sum and data");
+
+    /* Carries: long runs of 0xFF, and splitting at even offsets */
+    memset(dst, 0xFF, sizeof(dst));
+    check(inet_chksum_add(0xFFFF, dst + 3, 600) == ref_sum(0xFFFF, dst + 3, 600),
+          "all ones, 600 bytes, odd address");
+    for (ok = 1, len = 0; len <= 600; len += 2) {
+        uint16_t s = inet_chksum_add(0, pool + 1, len);
+        s = inet_chksum_add(s, pool + 1 + len, (uint16_t)(600 - len));
+        ok &= same(s, ref_sum(0, pool + 1, 600));
+    }
+    check(ok, "sum of two parts == sum of the whole");
+}
+
+static void incremental(uint8_t *pool)
+{
+    uint8_t pkt[60];
+    uint16_t ck, old16, new16;
+    uint32_t old32, new32;
+    int i, off, ok16 = 1, ok32 = 1;
+
+    for (i = 0; i < 10000; i++) {
+        memcpy(pkt, pool + (i & 255), sizeof(pkt));
+        pkt[10] = pkt[11] = 0;
+        ck = (uint16_t)~inet_chksum_add(0, pkt, sizeof(pkt));
+
+        off = 2 * (rand() % 30);
+        if (off == 10) {
+            off = 12;
+        }
+        old16 = (uint16_t)(pkt[off] << 8 | pkt[off + 1]);
+        new16 = (uint16_t)rand();
+        if (i & 1) {
+            new16 = (uint16_t)(old16 - 0x0100);      /* TTL decrement */
+        }
+        pkt[off] = new16 >> 8;
+        pkt[off + 1] = new16 & 0xFF;
+        ok16 &= same(inet_chksum_update16(ck, old16, new16),
+                     (uint16_t)~inet_chksum_add(0, pkt, sizeof(pkt)));
+        ck = (uint16_t)~inet_chksum_add(0, pkt, sizeof(pkt));
+
+        off = 24 + 4 * (rand() % 8);
+        old32 = (uint32_t)pkt[off] << 24 | (uint32_t)pkt[off + 1] << 16 |
+                (uint32_t)pkt[off + 2] << 8 | pkt[off + 3];
+        new32 = old32 + (uint32_t)(rand() & 0xFFFF);  /* seq += payload */
+        pkt[off] = new32 >> 24;
+        pkt[off + 1] = (new32 >> 16) & 0xFF;
+        pkt[off + 2] = (new32 >> 8) & 0xFF;
+        pkt[off + 3] = new32 & 0xFF;
+        ok32 &= same(inet_chksum_update32(ck, old32, new32),
+                     (uint16_t)~inet_chksum_add(0, pkt, sizeof(pkt)));
+    }
+    check(ok16, "update16 == recompute (random words, TTL)");
+    check(ok32, "update32 == recompute (seq/ack advance)");
+
+    /* ICMP echo request -> reply: type 8 -> 0 */
+    ck = inet_chksum_update16(0xf7ff, 0x0800, 0x0000);
+    check(same(ck, 0xffff), "echo reply from request checksum 0xf7ff");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile uint16_t sink;
+
+#define BENCH(name, expr) do {                                              \
+        int r;                                                              \
+        double t = now();                                                   \
+        unsigned long long c0 = tsc();                                      \
+        for (r = 0; r < rounds; r++) {                                      \
+            sink = (expr);                                                  \
+        }                                                                   \
+        c0 = tsc() - c0;                                                    \
+        t = now() - t;                                                      \
+        printf("  %-10s %4u bytes: %6.3f ns/byte", name, len,               \
+               t * 1e9 / ((double)rounds * len));                           \
+        if (c0) {                                                           \
+            printf(", %5.3f cycles/byte", (double)c0 / ((double)rounds * len)); \
+        }                                                                   \
+        printf("\n");                                                       \
+    } while (0)
+
+static unsigned long long tsc(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void bench(uint8_t *pool)
+{
+    static const uint16_t lens[] = { 20, 64, 576, 1460 };
+    static uint8_t dst[1536];
+    unsigned i;
+
+    printf("benchmark (host)\n");
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        uint16_t len = lens[i];
+        int rounds = 20000000 / len;
+        BENCH("bytewise", ref_sum(sink, pool + 2, len));
+        BENCH("words", inet_chksum_add(sink, pool + 2, len));
+        BENCH("odd start", inet_chksum_add(sink, pool + 1, len));
+        BENCH("copy", inet_chksum_copy(sink, dst + 2, pool + 2, len));
+    }
+}
+
+int main(void)
+{
+    uint8_t *pool = malloc(2048);
+    int i;
+
+    srand(1624);
+    for (i = 0; i < 2048; i++) {
+        pool[i] = (uint8_t)rand();
+    }
+    vectors();
+    against_reference(pool);
+    incremental(pool);
+    bench(pool);
+    free(pool);
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures != 0;
+}
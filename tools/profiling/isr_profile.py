@@ -0,0 +1,120 @@
+#!/usr/bin/env python
+"""Parse the output of isrProfileDump() (STM32F1 core, ISRProfile.h).
+
+Reads a dump from a file or stdin, e.g. a serial log, and prints the
+interrupt handler statistics and the critical section histogram with
+handler names and times in microseconds. The last complete dump in the
+input is used.
+
+    python isr_profile.py capture.txt
+    python isr_profile.py --port /dev/ttyACM0     (needs pyserial)
+"""
+
+from __future__ import print_function
+
+import argparse
+import sys
+
+# STM32F1 peripheral interrupts, in vector table order (exception 16 + n)
+F1_IRQS = [
+    "wwdg", "pvd", "tamper", "rtc", "flash", "rcc", "exti0", "exti1",
+    "exti2", "exti3", "exti4", "dma1_channel1", "dma1_channel2",
+    "dma1_channel3", "dma1_channel4", "dma1_channel5", "dma1_channel6",
+    "dma1_channel7", "adc", "usb_hp_can_tx", "usb_lp_can_rx0", "can_rx1",
+    "can_sce", "exti9_5", "tim1_brk", "tim1_up", "tim1_trg_com", "tim1_cc",
+    "tim2", "tim3", "tim4", "i2c1_ev", "i2c1_er", "i2c2_ev", "i2c2_er",
+    "spi1", "spi2", "usart1", "usart2", "usart3", "exti15_10", "rtcalarm",
+    "usbwakeup", "tim8_brk", "tim8_up", "tim8_trg_com", "tim8_cc", "adc3",
+    "fsmc", "sdio", "tim5", "spi3", "uart4", "uart5", "tim6", "tim7",
+    "dma2_channel1", "dma2_channel2", "dma2_channel3", "dma2_channel4_5",
+]
+
+
+def exc_name(exc):
+    if exc == 15:
+        return "systick"
+    if 16 <= exc < 16 + len(F1_IRQS):
+        return F1_IRQS[exc - 16]
+    return "exc%d" % exc
+
+
+def parse(lines):
+    """Return (f_cpu, [(exc, count, min, max, total)], {bucket: count}, cs_max)
+    of the last complete dump, or None."""
+    result = None
+    cur = None
+    for line in lines:
+        words = line.strip().split()
+        if not words:
+            continue
+        if words[0] == "isr_profile":
+            f_cpu = 72000000
+            for w in words[1:]:
+                if w.startswith("f_cpu="):
+                    f_cpu = int(w[6:])
+            cur = [f_cpu, [], {}, 0]
+        elif cur is None:
+            continue
+        elif words[0] == "exc" and len(words) == 6:
+            cur[1].append(tuple(int(w) for w in words[1:]))
+        elif words[0] == "cs" and len(words) == 3:
+            cur[2][int(words[1])] = int(words[2])
+        elif words[0] == "cs_max" and len(words) == 2:
+            cur[3] = int(words[1])
+        elif words[0] == "end":
+            result = tuple(cur)
+            cur = None
+    return result
+
+
+def report(dump, out=sys.stdout):
+    f_cpu, excs, hist, cs_max = dump
+    us = 1e6 / f_cpu
+    out.write("%-16s %10s %10s %10s %10s %12s\n" %
+              ("handler", "count", "min us", "avg us", "max us", "total ms"))
+    for exc, count, tmin, tmax, total in sorted(excs, key=lambda e: -e[4]):
+        out.write("%-16s %10d %10.2f %10.2f %10.2f %12.3f\n" %
+                  (exc_name(exc), count, tmin * us, float(total) / count * us,
+                   tmax * us, total * us / 1000))
+
+    out.write("\ninterrupts disabled\n")
+    total = sum(hist.values())
+    for bucket in sorted(hist):
+        lo = (1 << bucket) * us
+        out.write("  >= %10.2f us %10d %6.1f%%\n" %
+                  (lo, hist[bucket], 100.0 * hist[bucket] / total))
+    out.write("  longest %.2f us\n" % (cs_max * us))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("file", nargs="?", help="dump file, default stdin")
+    parser.add_argument("--port", help="read one dump from a serial port")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        ser = serial.Serial(args.port, args.baud, timeout=5)
+        lines = []
+        while True:
+            line = ser.readline().decode("ascii", "replace")
+            if not line:
+                break
+            lines.append(line)
+            if line.strip() == "end" and parse(lines):
+                break
+    elif args.file:
+        with open(args.file) as f:
+            lines = f.readlines()
+    else:
+        lines = sys.stdin.readlines()
+
+    dump = parse(lines)
+    if dump is None:
+        sys.exit("no complete isr_profile dump found")
+    report(dump)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,145 @@
+/*
+ * Host benchmark of the number formatting in the STM32F1 Print class
+ * (cores/maple/Print.cpp): printNumber() through print(int/long/long
+ * long, base) and printFloat() through print(double, digits).
+ *
+ * Each case prints a fixed pseudo-random set of values into a memory
+ * sink and reports the formatted characters per second and the number
+ * of write() calls per value, plus a hash of the text produced. Build it
+ * once against the current Print.cpp and once against an older one (for
+ * example the version before the stack buffer formatting) and run both:
+ * the rates give the before/after speedup, and equal hashes show both
+ * produce the same text.
+ *
+ *     M=<STM32F1>/cores/maple
+ *     g++ -O2 -I$M -I$M/libmaple -o print_bench_new print_bench.cpp $M/Print.cpp
+ *     mkdir old && git show <rev>:STM32F1/cores/maple/Print.cpp > old/Print.cpp
+ *     git show <rev>:STM32F1/cores/maple/Print.h > old/Print.h
+ *     g++ -O2 -Iold -I$M -I$M/libmaple -o print_bench_old print_bench.cpp old/Print.cpp
+ *     ./print_bench_old; ./print_bench_new [seconds per case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Print.h"
+
+#define VALUES          4096
+
+/* collects the text, counts the write calls, folds it into a hash */
+class Sink : public Print {
+public:
+    uint32 chars, calls, hash;
+
+    Sink() : chars(0), calls(0), hash(2166136261u) {}
+
+    size_t write(uint8 ch) {
+        calls++;
+        add(ch);
+        return 1;
+    }
+
+    size_t write(const void *buf, uint32 len) {
+        const uint8 *p = (const uint8 *)buf;
+        calls++;
+        for (uint32 i = 0; i < len; i++)
+            add(p[i]);
+        return len;
+    }
+
+private:
+    void add(uint8 ch) {
+        chars++;
+        hash = (hash ^ ch) * 16777619u;
+    }
+};
+
+static uint64 rng = 88172645463325252ull;
+
+static uint64 rand64(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static unsigned long u32v[VALUES];
+static long s32v[VALUES];
+static unsigned long long u64v[VALUES];
+static long long s64v[VALUES];
+static double dblv[VALUES];
+
+static void make_values(void)
+{
+    for (int i = 0; i < VALUES; i++) {
+        uint64 r = rand64();
+        /* spread over all lengths, not just the 9-10 digit ones */
+        int bits = 1 + (int)(r % 32);
+        u32v[i] = (unsigned long)(rand64() >> (64 - bits));
+        s32v[i] = (i & 1) ? -(long)(u32v[i] >> 1) : (long)(u32v[i] >> 1);
+        bits = 1 + (int)(r % 64);
+        u64v[i] = rand64() >> (64 - bits);
+        s64v[i] = (i & 1) ? -(long long)(u64v[i] >> 1) : (long long)(u64v[i] >> 1);
+        dblv[i] = (double)(long long)(rand64() >> 40) / 1000.0 * ((i & 1) ? -1 : 1);
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+enum { U32_DEC, S32_DEC, U32_HEX, U32_BIN, U64_DEC, S64_DEC, U64_HEX,
+       DBL_2, DBL_6, NCASES };
+
+static const char *const names[NCASES] = {
+    "uint32 DEC", "int32 DEC", "uint32 HEX", "uint32 BIN",
+    "uint64 DEC", "int64 DEC", "uint64 HEX", "double 2", "double 6",
+};
+
+static void run(int c, Sink &s)
+{
+    int i;
+    switch (c) {
+    case U32_DEC: for (i = 0; i < VALUES; i++) s.print(u32v[i]); break;
+    case S32_DEC: for (i = 0; i < VALUES; i++) s.print(s32v[i]); break;
+    case U32_HEX: for (i = 0; i < VALUES; i++) s.print(u32v[i], HEX); break;
+    case U32_BIN: for (i = 0; i < VALUES; i++) s.print(u32v[i], BIN); break;
+    case U64_DEC: for (i = 0; i < VALUES; i++) s.print(u64v[i]); break;
+    case S64_DEC: for (i = 0; i < VALUES; i++) s.print(s64v[i]); break;
+    case U64_HEX: for (i = 0; i < VALUES; i++) s.print(u64v[i], HEX); break;
+    case DBL_2:   for (i = 0; i < VALUES; i++) s.print(dblv[i], 2); break;
+    case DBL_6:   for (i = 0; i < VALUES; i++) s.print(dblv[i], 6); break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double min_s = (argc > 1) ? atof(argv[1]) : 0.2;
+
+    make_values();
+    printf("%-12s %12s %12s %10s\n", "case", "Mchars/s", "writes/val", "hash");
+    for (int c = 0; c < NCASES; c++) {
+        Sink ref;
+        run(c, ref); /* warm up, and the reference counts */
+
+        uint32 rounds = 0;
+        double t0 = now_s(), t;
+        do {
+            Sink s;
+            run(c, s);
+            rounds++;
+            t = now_s() - t0;
+        } while (t < min_s);
+
+        printf("%-12s %12.2f %12.2f %10.8x\n", names[c],
+               (double)ref.chars * rounds / t / 1e6,
+               (double)ref.calls / VALUES, ref.hash);
+    }
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Host tests and benchmark for the STM32F1 ring buffer (libmaple
+ * ring_buffer.c), the byte calls and the zero-copy span API.
+ *
+ * Checks empty and full state (one slot left open), the two windows of
+ * rb_read_spans()/rb_write_spans() and the contiguous counts for every
+ * head/tail position of a small buffer, filling through the write
+ * windows and draining through the read windows across the wrap, and a
+ * randomized run of all the calls against a byte queue model. Then
+ * times moving data through a 256 byte buffer byte by byte
+ * (rb_write_safe/rb_read_safe), in blocks (rb_write_safe_n/rb_read_n)
+ * and through the spans, in MB/s.
+ *
+ *     cc -O2 -I<maple>/libmaple -o ring_buffer_test ring_buffer_test.c \
+ *         <maple>/libmaple/ring_buffer.c
+ *     ./ring_buffer_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring_buffer.h"
+
+#define SMALL           16
+#define BIG             256
+
+RING_BUFFER(small_rb, SMALL);
+RING_BUFFER(big_rb, BIG);
+
+static int failures;
+
+static void check(int ok, const char *what, int a, int b)
+{
+	if (!ok) {
+		if (failures < 20)
+			printf("FAIL: %s (%d, %d)\n", what, a, b);
+		failures++;
+	}
+}
+
+/* sets head and tail directly, as if the buffer had run for a while */
+static void set_ptrs(ring_buffer_t *rb, int head, int tail)
+{
+	rb->ptrs.head = head;
+	rb->ptrs.tail = tail;
+}
+
+static void test_empty_full(void)
+{
+	ring_buffer_t *rb = &small_rb;
+	rb_span_t sp[2];
+	int i, t;
+
+	for (t = 0; t < SMALL; t++) {
+		set_ptrs(rb, t, t);
+		check(rb_is_empty(rb), "empty", t, 0);
+		check(rb_read_available(rb) == 0, "empty read_available", t, 0);
+		check(rb_write_available(rb) == SMALL - 1, "empty write_available", t, 0);
+		check(rb_read_safe(rb) == -1, "read from empty", t, 0);
+		check(rb_read_spans(rb, sp) == 0 && sp[0].len == 0 && sp[1].len == 0,
+		      "empty read spans", t, 0);
+		check(rb_read_contiguous(rb) == 0, "empty read_contiguous", t, 0);
+
+		for (i = 0; i < SMALL - 1; i++)
+			check(rb_write_safe(rb, (uint8_t)(t + i)), "fill", t, i);
+		check(rb_is_full(rb), "full", t, 0);
+		check(!rb_write_safe(rb, 0xee), "write to full", t, 0);
+		check(rb_write_available(rb) == 0, "full write_available", t, 0);
+		check(rb_write_spans(rb, sp) == 0 && sp[0].len == 0 && sp[1].len == 0,
+		      "full write spans", t, 0);
+		check(rb_write_contiguous(rb) == 0, "full write_contiguous", t, 0);
+		check(rb_write_safe_n(rb, (const uint8_t *)"xy", 2) == 0, "write_n to full", t, 0);
+
+		for (i = 0; i < SMALL - 1; i++)
+			check(rb_read_safe(rb) == (uint8_t)(t + i), "drain order", t, i);
+		check(rb_is_empty(rb), "empty after drain", t, 0);
+	}
+}
+
+/* the windows must cover exactly the used/free slots, in order */
+static void test_spans(void)
+{
+	ring_buffer_t *rb = &small_rb;
+	rb_span_t sp[2];
+	int h, t;
+
+	for (t = 0; t < SMALL; t++)
+		for (h = 0; h < SMALL; h++) {
+			int used = (h - t) & (SMALL - 1);
+			int total;
+
+			set_ptrs(rb, h, t);
+			total = rb_read_spans(rb, sp);
+			check(total == used, "read total", h, t);
+			check(sp[0].len + sp[1].len == used, "read windows sum", h, t);
+			check(sp[0].ptr == &rb->buffer[t], "read window 0 start", h, t);
+			check(sp[0].ptr + sp[0].len <= rb->buffer + SMALL, "read window 0 end", h, t);
+			check(sp[1].ptr == rb->buffer, "read window 1 start", h, t);
+			check(sp[1].len == 0 || sp[0].ptr + sp[0].len == rb->buffer + SMALL,
+			      "read wraps only at the end", h, t);
+			check(rb_read_contiguous(rb) == sp[0].len, "read_contiguous", h, t);
+
+			total = rb_write_spans(rb, sp);
+			check(total == SMALL - 1 - used, "write total", h, t);
+			check(sp[0].len + sp[1].len == total, "write windows sum", h, t);
+			check(sp[0].ptr == &rb->buffer[h], "write window 0 start", h, t);
+			check(sp[0].ptr + sp[0].len <= rb->buffer + SMALL, "write window 0 end", h, t);
+			check(sp[1].len == 0 || sp[0].ptr + sp[0].len == rb->buffer + SMALL,
+			      "write wraps only at the end", h, t);
+			check(rb_write_contiguous(rb) == sp[0].len, "write_contiguous", h, t);
+			/* the free windows must never reach the slot before tail */
+			check(sp[1].len == 0 || sp[1].len <= ((t - 1) & (SMALL - 1)),
+			      "write window 1 stops before tail", h, t);
+		}
+}
+
+/* fill through the write windows and drain through the read windows */
+static void test_span_copy(void)
+{
+	ring_buffer_t *rb = &small_rb;
+	uint8_t out[SMALL];
+	rb_span_t sp[2];
+	int t, n, i;
+
+	for (t = 0; t < SMALL; t++)
+		for (n = 0; n < SMALL; n++) {
+			uint8_t seq = (uint8_t)(t * 31 + n);
+			int room;
+
+			set_ptrs(rb, t, t);
+			room = rb_write_spans(rb, sp);
+			check(room == SMALL - 1, "copy room", t, n);
+			for (i = 0; i < n; i++) {
+				if (i < sp[0].len)
+					sp[0].ptr[i] = seq + i;
+				else
+					sp[1].ptr[i - sp[0].len] = seq + i;
+			}
+			rb_write_finish(rb, n);
+			check(rb_read_available(rb) == n, "copy available", t, n);
+
+			memset(out, 0, sizeof(out));
+			check(rb_peek_n(rb, out, SMALL) == (uint32)n, "peek_n count", t, n);
+			check(rb_read_available(rb) == n, "peek_n keeps data", t, n);
+			rb_read_spans(rb, sp);
+			for (i = 0; i < n; i++) {
+				uint8_t c = (i < sp[0].len) ? sp[0].ptr[i] : sp[1].ptr[i - sp[0].len];
+				check(c == (uint8_t)(seq + i), "span data", t, i);
+				check(out[i] == (uint8_t)(seq + i), "peek_n data", t, i);
+			}
+			rb_read_finish(rb, n);
+			check(rb_is_empty(rb), "copy empty", t, n);
+			check(rb->ptrs.tail == ((t + n) & (SMALL - 1)), "tail after finish", t, n);
+		}
+}
+
+/* all calls in random order against a plain byte queue */
+static void test_random(void)
+{
+	ring_buffer_t *rb = &small_rb;
+	uint8_t model[SMALL], buf[SMALL + 4];
+	int mlen = 0, step, i;
+	uint8_t next = 0;
+
+	rb_reset(rb);
+	srand(1);
+	for (step = 0; step < 200000; step++) {
+		int op = rand() % 8, len = rand() % (SMALL + 4), n;
+		rb_span_t sp[2];
+
+		switch (op) {
+		case 0:
+			n = rb_write_safe(rb, next);
+			check(n == (mlen < SMALL - 1), "random write_safe", step, mlen);
+			if (n)
+				model[mlen++] = next++;
+			break;
+		case 1:
+			for (i = 0; i < len; i++)
+				buf[i] = next + i;
+			n = rb_write_safe_n(rb, buf, len);
+			check(n == (len < SMALL - 1 - mlen ? len : SMALL - 1 - mlen),
+			      "random write_safe_n", step, n);
+			for (i = 0; i < n; i++)
+				model[mlen++] = next++;
+			break;
+		case 2:
+			n = rb_write_spans(rb, sp);
+			if (len > n)
+				len = n;
+			for (i = 0; i < len; i++) {
+				uint8_t *p = (i < sp[0].len) ? &sp[0].ptr[i] : &sp[1].ptr[i - sp[0].len];
+				*p = next;
+				model[mlen++] = next++;
+			}
+			rb_write_finish(rb, len);
+			break;
+		case 3:
+			n = rb_read_safe(rb);
+			check(n == (mlen ? model[0] : -1), "random read_safe", step, n);
+			if (mlen)
+				memmove(model, model + 1, --mlen);
+			break;
+		case 4:
+			n = rb_read_n(rb, buf, len);
+			check(n == (len < mlen ? len : mlen), "random read_n", step, n);
+			check(memcmp(buf, model, n) == 0, "random read_n data", step, n);
+			memmove(model, model + n, mlen - n);
+			mlen -= n;
+			break;
+		case 5:
+			n = rb_read_spans(rb, sp);
+			check(n == mlen, "random read spans", step, n);
+			if (len > n)
+				len = n;
+			for (i = 0; i < len; i++) {
+				uint8_t c = (i < sp[0].len) ? sp[0].ptr[i] : sp[1].ptr[i - sp[0].len];
+				check(c == model[i], "random span data", step, i);
+			}
+			rb_read_finish(rb, len);
+			memmove(model, model + len, mlen - len);
+			mlen -= len;
+			break;
+		case 6:
+			n = rb_peek_n(rb, buf, len);
+			check(n == (len < mlen ? len : mlen), "random peek_n", step, n);
+			check(memcmp(buf, model, n) == 0, "random peek_n data", step, n);
+			break;
+		default:
+			n = rb_read_contiguous(rb);
+			if (n && len) {
+				check(*rb_read_ptr(rb) == model[0], "random read_ptr", step, n);
+				check(rb_peek(rb) == model[0], "random peek", step, n);
+			}
+			break;
+		}
+		check(rb_read_available(rb) == mlen, "random available", step, mlen);
+		check(rb_write_available(rb) == SMALL - 1 - mlen, "random free", step, mlen);
+		check(rb_is_empty(rb) == (mlen == 0), "random empty", step, mlen);
+		check(rb_is_full(rb) == (mlen == SMALL - 1), "random full", step, mlen);
+	}
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define BENCH_BYTES     (64u << 20)
+
+static volatile uint32 sink;
+
+/* producer writes chunks of 'chunk' bytes, consumer drains the same */
+static double bench(int mode, int chunk)
+{
+	ring_buffer_t *rb = &big_rb;
+	uint8_t in[BIG], out[BIG];
+	uint32 moved = 0, sum = 0;
+	double t0;
+	int i;
+
+	for (i = 0; i < BIG; i++)
+		in[i] = (uint8_t)i;
+	rb_reset(rb);
+	t0 = now_s();
+	while (moved < BENCH_BYTES) {
+		rb_span_t sp[2];
+		int n;
+
+		switch (mode) {
+		case 0:
+			for (i = 0; i < chunk; i++)
+				rb_write_safe(rb, in[i]);
+			for (i = 0; i < chunk; i++)
+				sum += rb_read_safe(rb);
+			n = chunk;
+			break;
+		case 1:
+			rb_write_safe_n(rb, in, chunk);
+			n = rb_read_n(rb, out, chunk);
+			sum += out[n - 1];
+			break;
+		default:
+			n = rb_write_spans(rb, sp);
+			if (n > chunk)
+				n = chunk;
+			i = (n < sp[0].len) ? n : sp[0].len;
+			memcpy(sp[0].ptr, in, i);
+			memcpy(sp[1].ptr, in + i, n - i);
+			rb_write_finish(rb, n);
+			rb_read_spans(rb, sp);
+			i = (n < sp[0].len) ? n : sp[0].len;
+			memcpy(out, sp[0].ptr, i);
+			memcpy(out + i, sp[1].ptr, n - i);
+			rb_read_finish(rb, n);
+			sum += out[n - 1];
+			break;
+		}
+		moved += n;
+	}
+	sink = sum;
+	return moved / (now_s() - t0) / 1e6;
+}
+
+int main(void)
+{
+	static const char *const names[] = { "byte", "block", "spans" };
+	static const int chunks[] = { 1, 16, 64, 200 };
+	int m, c;
+
+	test_empty_full();
+	test_spans();
+	test_span_copy();
+	test_random();
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n\n");
+
+	printf("%-8s", "chunk");
+	for (c = 0; c < (int)(sizeof(chunks) / sizeof(chunks[0])); c++)
+		printf("%10d", chunks[c]);
+	printf("   (MB/s through a %d byte buffer)\n", BIG);
+	for (m = 0; m < 3; m++) {
+		printf("%-8s", names[m]);
+		for (c = 0; c < (int)(sizeof(chunks) / sizeof(chunks[0])); c++)
+			printf("%10.1f", bench(m, chunks[c]));
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * Host simulation of the ServoMux frame tables (STM32F1 Servo library,
+ * src/utility/servo_frame.c).
+ *
+ * Plays the double buffered tables the way the timer and DMA do: the
+ * compare DMA writes the BSRR words one tick into each period, the
+ * update DMA loads the period two events ahead, the half and complete
+ * transfer interrupts rebuild a half after a width change, a few events
+ * late like a real handler. Checks every
+ * edge of every frame against the pulse widths:
+ *
+ *   - the frames are exactly frame_ticks apart, all pins rise together
+ *   - each pulse is its width long, or delayed by the edge spacing when
+ *     it ends too close to a shorter one
+ *   - a frame never mixes widths from before and after a change
+ *
+ *     cc -I<core> -I<Servo>/src/utility -o servo_frame_sim \
+ *         servo_frame_sim.c <Servo>/src/utility/servo_frame.c
+ *     ./servo_frame_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "servo_frame.h"
+
+#define TICK_HZ         8000000UL
+#define FRAME_TICKS     (20000 * (TICK_HZ / 1000000))
+#define MIN_TICKS       (TICK_HZ / 1000000)
+#define MAX_GAP         8
+#define N               24
+#define MAX_EVENTS      (SERVO_FRAME_LEAD + 1 + N + MAX_GAP)
+#define FRAMES          400
+
+static uint8 pins[N];
+static uint32 widths[N];
+static uint8 work[N];
+static uint16 events;
+static uint16 arr[2 * MAX_EVENTS];
+static uint32 bsrr[SERVO_FRAME_PORTS][2 * MAX_EVENTS];
+
+/* widths of the frames built into each half */
+static uint32 built[2][N];
+static int pending;
+
+static uint32 level[SERVO_FRAME_PORTS];
+static long long rise_at[N];
+static long long frame_start = -1;
+static int frames_seen;
+static int failures;
+
+static void fail(const char *what, int frame, int servo, long long got, long long want)
+{
+    if (failures++ < 20) {
+        printf("FAIL %s: frame %d servo %d: %lld, expected %lld\n",
+               what, frame, servo, got, want);
+    }
+}
+
+static void build(int half)
+{
+    servo_frame frame;
+    int p;
+    frame.frame_ticks = FRAME_TICKS;
+    frame.min_ticks = MIN_TICKS;
+    frame.events = events;
+    frame.arr = arr + half * events;
+    for (p = 0; p < SERVO_FRAME_PORTS; p++) {
+        frame.bsrr[p] = bsrr[p] + half * events;
+    }
+    servo_frame_build(&frame, pins, widths, N, work);
+    memcpy(built[half], widths, sizeof(widths));
+}
+
+/* Reference widths: by increasing width, each distinct width ends at
+ * least MIN_TICKS after the previous one */
+static void expected_widths(const uint32 *w, long long *out)
+{
+    long long last = 0;
+    uint32 prev = 0;
+    int done[N];
+    int i, j;
+
+    memset(done, 0, sizeof(done));
+    for (i = 0; i < N; i++) {
+        int s = -1;
+        for (j = 0; j < N; j++) {
+            if (!done[j] && (s < 0 || w[j] < w[s])) {
+                s = j;
+            }
+        }
+        done[s] = 1;
+        if (w[s] && w[s] != prev) {
+            last = (long long)w[s] < last + MIN_TICKS ? last + MIN_TICKS : w[s];
+            prev = w[s];
+        }
+        out[s] = w[s] ? last : 0;
+    }
+}
+
+static void check_frame(int frame, const long long *measured, const uint32 *w)
+{
+    long long want[N];
+    int i;
+    expected_widths(w, want);
+    for (i = 0; i < N; i++) {
+        if (measured[i] != want[i]) {
+            fail("width", frame, i, measured[i], want[i]);
+        }
+    }
+}
+
+static long long measured[N];
+static uint32 playing[N];     /* widths of the frame being played */
+
+/* Apply the BSRR writes of one event at tick t */
+static void apply(long long t, int index)
+{
+    int p, b;
+    for (p = 0; p < SERVO_FRAME_PORTS; p++) {
+        if (bsrr[p][index] & 0xFFFF) {
+            break;
+        }
+    }
+    if (p < SERVO_FRAME_PORTS) {
+        if (frame_start >= 0) {
+            if (t - frame_start != FRAME_TICKS) {
+                fail("frame", frames_seen, -1, t - frame_start, FRAME_TICKS);
+            }
+            check_frame(frames_seen, measured, playing);
+        }
+        frame_start = t;
+        frames_seen++;
+        memcpy(playing, built[index >= events], sizeof(playing));
+        memset(measured, 0, sizeof(measured));
+    }
+
+    for (p = 0; p < SERVO_FRAME_PORTS; p++) {
+        uint32 set = bsrr[p][index] & 0xFFFF, reset = bsrr[p][index] >> 16;
+        for (b = 0; b < N; b++) {
+            uint32 bit = 1U << (pins[b] & 15);
+            if (pins[b] >> 4 != p) {
+                continue;
+            }
+            if (set & bit) {
+                rise_at[b] = t;
+            }
+            if (reset & bit) {
+                if (!(level[p] & bit)) {
+                    fail("fall while low", frames_seen, b, t, 0);
+                }
+                measured[b] = t - rise_at[b];
+            }
+        }
+        level[p] = (level[p] | set) & ~reset;
+    }
+}
+
+int main(void)
+{
+    uint32 shadow = MIN_TICKS - 1, preload = MIN_TICKS - 1;
+    long long t = 0;
+    int k, i;
+    int changes = 0;
+    int rebuild = -1, delay = 0;
+
+    srand(1);
+    for (i = 0; i < N; i++) {
+        pins[i] = (uint8)((i % 3) * 16 + i / 3);   /* spread over A, B, C */
+        widths[i] = (544 + rand() % 1857) * (TICK_HZ / 1000000);
+    }
+    widths[3] = widths[4];                      /* shared edge */
+    widths[5] = widths[6] + 1;                  /* too close, spaced out */
+    widths[7] = 0;                              /* idle */
+
+    events = servo_frame_events(N, FRAME_TICKS, MIN_TICKS,
+                                2400 * (TICK_HZ / 1000000), MAX_GAP);
+    if (!events) {
+        printf("FAIL frame does not fit\n");
+        return 1;
+    }
+    if (servo_frame_events(N, FRAME_TICKS, MIN_TICKS, 0x10001, MAX_GAP) ||
+        servo_frame_events(N, 20000UL * 72, 2, 2400 * 72, MAX_GAP)) {
+        printf("FAIL oversized frame accepted\n");
+        failures++;
+    }
+    build(0);
+    build(1);
+
+    /* period k: BSRR at tick 1, update at its end loads arr[k] */
+    for (k = 0; frames_seen < FRAMES; k++) {
+        int index = k % (2 * events);
+        apply(t + 1, index);
+        t += shadow + 1;
+        shadow = preload;
+        preload = arr[index];
+
+        /* the interrupt handler runs a few events late */
+        if (rebuild >= 0 && !--delay) {
+            build(rebuild);
+            rebuild = -1;
+        }
+        if (index == events - 1 || index == 2 * events - 1) {
+            if (pending) {
+                rebuild = index == events - 1 ? 0 : 1;
+                delay = 3;
+                pending--;
+            }
+            /* change some widths now and then, between interrupts */
+            if (rand() % 5 == 0) {
+                for (i = 0; i < 4; i++) {
+                    widths[rand() % N] = (544 + rand() % 1857) * (TICK_HZ / 1000000);
+                }
+                widths[7] = 0;
+                pending = 2;
+                changes++;
+            }
+        }
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("servo frame sim passed: %d frames, %d events each, %d width changes\n",
+           frames_seen, events, changes);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Host allocation tests of the STM32F1 String class (cores/maple
+ * WString.cpp and StringPool.cpp).
+ *
+ * A counting allocator is installed with String::setAllocator(), so
+ * every buffer String allocates or frees is seen. Checks the contents
+ * and the number of allocations of construction, concatenation chains
+ * (a + " " + b), repeated += (the buffer grows by half, so O(log n)
+ * allocations), concatenating a string with a part of itself, moves,
+ * and that every buffer is freed again. Then builds 1000 HTTP style
+ * request lines through a StringPool of 16 blocks of 64 bytes, which
+ * must not fall back to the heap.
+ *
+ * Build it once as is and once with the inline small string storage;
+ * the expected counts depend on it:
+ *
+ *     M=<STM32F1>/cores/maple
+ *     cc -O2 -c $M/itoa.c $M/avr/dtostrf.c
+ *     S="$M/WString.cpp $M/StringPool.cpp itoa.o dtostrf.o"
+ *     g++ -O2 -I$M -o string_alloc_test string_alloc_test.cpp $S
+ *     g++ -O2 -I$M -DSTRING_SSO_SIZE=16 -o string_alloc_sso string_alloc_test.cpp $S
+ *     ./string_alloc_test; ./string_alloc_sso
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+#include "WString.h"
+#include "StringPool.h"
+
+static unsigned allocs, frees;
+static long live;
+
+static void *count_alloc(size_t size)
+{
+    allocs++;
+    live++;
+    return malloc(size);
+}
+
+static void count_free(void *ptr)
+{
+    frees++;
+    live--;
+    free(ptr);
+}
+
+static int failures;
+
+static void check(int ok, const char *what, long a, long b)
+{
+    if (!ok) {
+        printf("FAIL: %s (%ld, %ld)\n", what, a, b);
+        failures++;
+    }
+}
+
+static void check_str(const String &s, const char *expect, const char *what)
+{
+    if (strcmp(s.c_str(), expect) != 0 || s.length() != strlen(expect)) {
+        printf("FAIL: %s: \"%s\" (%u), expected \"%s\"\n", what, s.c_str(),
+               s.length(), expect);
+        failures++;
+    }
+}
+
+#if STRING_SSO_SIZE >= 16
+#define SSO(with, without)      (with)
+#else
+#define SSO(with, without)      (without)
+#endif
+
+/* runs a step and checks the number of allocations it made */
+#define STEP(name, expect, code) do {                                   \
+        unsigned before = allocs;                                       \
+        code;                                                           \
+        printf("%-34s %6u\n", name, allocs - before);                   \
+        check(allocs - before == (unsigned)(expect), name,              \
+              allocs - before, expect);                                 \
+    } while (0)
+
+static void test_counts(void)
+{
+    String::setAllocator(count_alloc, count_free);
+    {
+        String a, b, s;
+
+        STEP("String(\"hello\")", SSO(0, 1), a = "hello");
+        STEP("String(\"world\")", SSO(0, 1), b = "world");
+        STEP("a + \" \" + b, 11 chars", SSO(0, 3), s = a + " " + b);
+        check_str(s, "hello world", "a + \" \" + b");
+
+        String l1("a string longer than the"), l2(" inline storage");
+        STEP("l1 + l2, 39 chars", 2, s = l1 + l2);
+        check_str(s, "a string longer than the inline storage", "l1 + l2");
+
+        String t;
+        STEP("1000 x += 'x'", SSO(12, 18), for (int i = 0; i < 1000; i++) t += 'x');
+        check(t.length() == 1000, "+= length", t.length(), 1000);
+
+        String m;
+        STEP("move of a long String", 0, m = std::move(t));
+        check(m.length() == 1000 && t.length() == 0, "move", m.length(), t.length());
+
+        String self("abcdef");
+        self += self;
+        self.concat(self.c_str() + 9);
+        check_str(self, "abcdefabcdefdef", "self concat");
+
+        String num = String("id=") + 42 + ',' + 3.5f;
+        check_str(num, "id=42,3.50", "numbers");
+    }
+    check(live == 0, "buffers not freed", live, allocs - frees);
+    String::setAllocator(NULL, NULL);
+}
+
+static void test_pool(void)
+{
+    static uint32_t pool_mem[16 * 64 / 4];
+    StringPool pool(pool_mem, sizeof(pool_mem), 64);
+    String host("sensor.local");
+
+    pool.install();
+    for (int i = 0; i < 1000; i++) {
+        String line = String("GET /data?id=") + i + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        char expect[64];
+        snprintf(expect, sizeof(expect), "GET /data?id=%d HTTP/1.1\r\nHost: sensor.local\r\n", i);
+        if (strcmp(line.c_str(), expect) != 0) {
+            check(0, "pool line", i, line.length());
+            break;
+        }
+    }
+    printf("%-34s %6u (peak %u blocks)\n", "pool fallbacks, 1000 lines",
+           (unsigned)pool.fallbacks(), (unsigned)pool.peak());
+    check(pool.fallbacks() == 0, "pool fallbacks", pool.fallbacks(), 0);
+    check(pool.used() == 0, "pool blocks in use", pool.used(), 0);
+    String::setAllocator(NULL, NULL);
+}
+
+int main(void)
+{
+    printf("STRING_SSO_SIZE %d, sizeof(String) %u\n\n", STRING_SSO_SIZE,
+           (unsigned)sizeof(String));
+    printf("%-34s %6s\n", "step", "allocs");
+    test_counts();
+    test_pool();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * Host test and scaling benchmark of the STM32F1 software timer wheel
+ * (libmaple/sw_timer.c), driven by a simulated millisecond tick.
+ *
+ * sw_timer.c is compiled into this file with the SysTick, SCB, NVIC and
+ * PRIMASK accesses replaced by stubs: the simulated SysTick raises the
+ * uptime and calls the hook, a pended PendSV runs sw_timer_process(),
+ * sometimes several ticks late to model masked interrupts.
+ *
+ * Checks, starting just before the 32 bit uptime wrap:
+ *
+ *   - one-shot timers fire exactly once, on their expiry tick, also for
+ *     delays beyond the wheel span (re-evaluated on cascade)
+ *   - periodic timers fire every period without drift
+ *   - random start, restart and stop, also from within callbacks
+ *   - sw_timer_idle_ticks() never skips a due timer
+ *   - delays and periods of 2^31 ms and more are clamped, not due at once
+ *
+ * Then times start, stop and the per tick processing with 100 to 100000
+ * running timers, to show that the cost does not grow with the count.
+ *
+ *     cc -O2 -I<maple> -o sw_timer_sim sw_timer_sim.c
+ *     ./sw_timer_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmaple/libmaple_types.h>
+
+/* keep the hardware headers out, sw_timer.c gets these instead */
+#define _LIBMAPLE_SYSTICK_H_
+#define _LIBMAPLE_SCB_H_
+#define _LIBMAPLE_NVIC_H_
+#define _CORTEX_M3_ATOMIC_H_
+
+volatile uint32 systick_uptime_millis;
+void (*systick_sw_timer_hook)(void);
+
+static struct { uint32 ICSR; } scb_stub;
+#define SCB_BASE                (&scb_stub)
+#define SCB_ICSR_PENDSVSET      (1U << 28)
+#define NVIC_PEND_SVC           (-2)
+#define nvic_irq_set_priority(irq, prio)        ((void)(irq), (void)(prio))
+#define ATOMIC_BLOCK(type)      for (int _once = 1; _once; _once = 0)
+
+#include "libmaple/sw_timer.c"
+
+#define N               2000
+#define START           0xFFFF0000u     /* 65 s before the uptime wrap */
+
+typedef struct {
+    sw_timer t;
+    uint32 due;         /* next expected expiry, valid while running */
+    uint32 period;
+    uint32 fired;
+    uint8 running;
+} test_timer;
+
+static test_timer timers[N];
+static int failures;
+
+static void check(int ok, const char *what, long a, long b)
+{
+    if (!ok) {
+        if (failures < 20)
+            printf("FAIL: %s (%ld, %ld)\n", what, a, b);
+        failures++;
+    }
+}
+
+static uint32 rnd(void)
+{
+    static uint32 x = 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* delays from 0 to beyond the wheel span, most of them short */
+static uint32 rnd_delay(void)
+{
+    switch (rnd() % 8) {
+    case 0: return rnd() % 4;
+    case 1: return rnd() % (SW_TIMER_MAX_DELTA + 5000);
+    case 2: return rnd() % 40000;
+    default: return rnd() % 2000;
+    }
+}
+
+static void start(test_timer *tt, uint32 delay, uint32 period)
+{
+    sw_timer_start(&tt->t, delay, period);
+    /* a timer already due fires on the next processed tick */
+    tt->due = systick_uptime_millis + delay;
+    if ((int32)(tt->due - wheel.now) < 1)
+        tt->due = wheel.now + 1;
+    tt->period = period;
+    tt->running = 1;
+}
+
+static void stop(test_timer *tt)
+{
+    sw_timer_stop(&tt->t);
+    tt->running = 0;
+}
+
+static int chaos = 1;
+
+static void expired(void *arg)
+{
+    test_timer *tt = (test_timer *)arg;
+
+    check(tt->running, "callback of a stopped timer", tt - timers, wheel.now);
+    check(wheel.now == tt->due, "expiry tick", (long)(wheel.now - START),
+          (long)(tt->due - START));
+    tt->fired++;
+    if (tt->period) {
+        tt->due += tt->period;
+    } else {
+        tt->running = 0;
+    }
+    /* callbacks may restart or stop themselves and others */
+    switch (chaos ? rnd() % 16 : 16) {
+    case 0:
+        start(tt, rnd_delay(), 0);
+        break;
+    case 1:
+        stop(&timers[rnd() % N]);
+        break;
+    case 2:
+        start(&timers[rnd() % N], rnd_delay(), (rnd() % 4) ? 0 : 1 + rnd() % 500);
+        break;
+    }
+}
+
+static uint32 max_late;
+
+/* one SysTick interrupt; PendSV runs at once or after a few ticks */
+static void tick(void)
+{
+    systick_uptime_millis++;
+    if (systick_sw_timer_hook)
+        systick_sw_timer_hook();
+    if ((scb_stub.ICSR & SCB_ICSR_PENDSVSET) && (rnd() % 8 || max_late++ > 3)) {
+        scb_stub.ICSR = 0;
+        max_late = 0;
+        sw_timer_process(systick_uptime_millis);
+    }
+}
+
+static void check_idle(void)
+{
+    uint32 idle = sw_timer_idle_ticks();
+    int i;
+
+    if (idle == 0 || idle == 0xFFFFFFFF)
+        return;
+    for (i = 0; i < N; i++)
+        if (timers[i].running)
+            check((int32)(timers[i].due - systick_uptime_millis) >= (int32)idle,
+                  "idle ticks skip a due timer", i, idle);
+}
+
+static void test_random(void)
+{
+    uint32 ticks, count;
+    int i;
+
+    systick_uptime_millis = START;
+    for (i = 0; i < N; i++)
+        sw_timer_init(&timers[i].t, expired, &timers[i]);
+    for (i = 0; i < N; i++)
+        start(&timers[i], rnd_delay(), (i % 4) ? 0 : 1 + rnd() % 1000);
+
+    for (ticks = 0; ticks < 3 * SW_TIMER_MAX_DELTA; ticks++) {
+        tick();
+        /* the main loop starts and stops timers too */
+        if (rnd() % 4 == 0) {
+            test_timer *tt = &timers[rnd() % N];
+            if (rnd() % 3)
+                start(tt, rnd_delay(), (rnd() % 8) ? 0 : 1 + rnd() % 300);
+            else
+                stop(tt);
+        }
+        if (ticks % 97 == 0 && !(scb_stub.ICSR & SCB_ICSR_PENDSVSET))
+            check_idle();
+        for (i = 0; i < N; i += 61)
+            check(!timers[i].running ||
+                  (int32)(timers[i].due - wheel.now) > 0, "timer missed", i,
+                  (long)(wheel.now - timers[i].due));
+    }
+    sw_timer_process(systick_uptime_millis);
+    for (i = 0, count = 0; i < N; i++) {
+        check(timers[i].running == sw_timer_is_active(&timers[i].t), "active flag", i, 0);
+        check(!timers[i].running || (int32)(timers[i].due - wheel.now) > 0,
+              "timer missed at the end", i, (long)(wheel.now - timers[i].due));
+        count += timers[i].running;
+    }
+    check(count == sw_timer_count(), "running count", count, sw_timer_count());
+    for (i = 0; i < N; i++)
+        stop(&timers[i]);
+    check(sw_timer_count() == 0, "count after stop", sw_timer_count(), 0);
+}
+
+/* periodic timers keep their phase, however late PendSV runs */
+static void test_periodic(void)
+{
+    static const uint32 periods[] = { 1, 7, 32, 1000, 1025, 40000 };
+    const int np = sizeof(periods) / sizeof(periods[0]);
+    uint32 ticks;
+    int i;
+
+    systick_uptime_millis = START + 12345;
+    for (i = 0; i < np; i++) {
+        sw_timer_init(&timers[i].t, expired, &timers[i]);
+        timers[i].fired = 0;
+        start(&timers[i], periods[i], periods[i]);
+    }
+    chaos = 0;
+    for (ticks = 0; ticks < 200000; ticks++) {
+        systick_uptime_millis++;
+        if (ticks % 5 == 0)
+            sw_timer_process(systick_uptime_millis);
+    }
+    sw_timer_process(systick_uptime_millis);
+    for (i = 0; i < np; i++) {
+        check(timers[i].fired == 200000 / periods[i], "periodic count",
+              periods[i], timers[i].fired);
+    }
+    for (i = 0; i < np; i++)
+        stop(&timers[i]);
+}
+
+static void nop_expired(void *arg)
+{
+    (*(uint32 *)arg)++;
+}
+
+static void test_clamp(void)
+{
+    sw_timer t;
+    uint32 fired = 0, ticks;
+
+    systick_uptime_millis = START;
+    sw_timer_init(&t, nop_expired, &fired);
+    sw_timer_start(&t, 0x80000000u, 0);
+    check(t.expires == (uint32)(START + SW_TIMER_MAX_MS), "clamped expiry", t.expires - START, 0);
+    sw_timer_start(&t, 0xFFFFFFFFu, 0xFFFFFFFFu);
+    check(t.period == SW_TIMER_MAX_MS, "clamped period", t.period, 0);
+    for (ticks = 0; ticks < 2 * SW_TIMER_MAX_DELTA; ticks++) {
+        systick_uptime_millis++;
+        sw_timer_process(systick_uptime_millis);
+    }
+    check(fired == 0 && sw_timer_is_active(&t), "long delay fired early", fired, 0);
+    sw_timer_stop(&t);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void restart_expired(void *arg)
+{
+    /* keep the number of running timers constant */
+    sw_timer_start((sw_timer *)arg, 1 + rnd() % 60000, 0);
+}
+
+static void bench(uint32 n)
+{
+    sw_timer *t = malloc(n * sizeof(*t));
+    uint32 i, ticks = 100000;
+    double t0, t_start, t_tick, t_stop;
+
+    systick_uptime_millis = START;
+    for (i = 0; i < n; i++)
+        sw_timer_init(&t[i], restart_expired, &t[i]);
+    t0 = now_s();
+    for (i = 0; i < n; i++)
+        sw_timer_start(&t[i], 1 + rnd() % 60000, 0);
+    t_start = now_s() - t0;
+
+    t0 = now_s();
+    for (i = 0; i < ticks; i++) {
+        systick_uptime_millis++;
+        sw_timer_process(systick_uptime_millis);
+    }
+    t_tick = now_s() - t0;
+
+    t0 = now_s();
+    for (i = 0; i < n; i++)
+        sw_timer_stop(&t[i]);
+    t_stop = now_s() - t0;
+
+    /* the expiries per tick grow with n, so also show the cost per expiry */
+    printf("%8u %10.1f %10.1f %12.1f %12.1f\n", n,
+           t_start / n * 1e9, t_stop / n * 1e9, t_tick / ticks * 1e9,
+           t_tick / ((double)ticks * n / 30000) * 1e9);
+    free(t);
+}
+
+int main(void)
+{
+    test_random();
+    test_periodic();
+    test_clamp();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n\n");
+
+    printf("%8s %10s %10s %12s %12s\n", "timers", "start ns", "stop ns",
+           "ns/tick", "ns/expiry");
+    bench(100);
+    bench(1000);
+    bench(10000);
+    bench(100000);
+    return 0;
+}
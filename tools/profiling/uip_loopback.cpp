@@ -0,0 +1,664 @@
+/*
+ * Host loopback test of the STM32F4 arduino_uip TCP send path: the
+ * real uip.c, mempool.cpp and inet_chksum.c, an ENC28J60 modelled as its
+ * 8 KB buffer memory, and an in-memory TCP peer.
+ *
+ * The device side does what UIPEthernet::tick() and UIPClient do: a
+ * bulk sender writes a known byte stream into the socket's outgoing
+ * packets (with the room for the headers in front), segments are sent
+ * straight out of them, trimmed as they are acknowledged, and the
+ * connection is closed once everything is acknowledged. A frame is only
+ * read out of the buffer memory when its transmission ends, so a block
+ * freed, moved or rewritten while on the wire shows up as corrupt data.
+ *
+ * The peer connects, checks the checksums and the stream, acknowledges
+ * every second segment or after the delayed ACK time, and answers the
+ * FIN. The link is 10 Mbit/s with a configurable one-way delay and
+ * frame loss in both directions. The simulated throughput is printed;
+ * run it built with the default UIP_CONF_TCP_SEGS=1 (plain uIP
+ * stop-and-wait) and with more segments in flight to compare.
+ *
+ *     U=<arduino_uip>/utility
+ *     g++ -O2 -I$U -DUIP_CONF_TCP_SEGS=4 -o uip_loopback uip_loopback.cpp \
+ *         $U/mempool.cpp -x c $U/uip.c $U/inet_chksum.c
+ *     ./uip_loopback [-n bytes] [-d delay_ms] [-l loss_%] [-a delack_ms]
+ *                    [-w window] [-s seed] [-r runs]
+ */
+
+/* uip.h first: the C library's LITTLE_ENDIAN would turn uIP big endian */
+extern "C" {
+#include "uip.h"
+#include "inet_chksum.h"
+}
+#include "mempool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* private to uip.c */
+#define TCP_FIN         0x01
+#define TCP_SYN         0x02
+#define TCP_ACK         0x10
+#define TCP_OPT_MSS     2
+#define TCP_OPT_MSS_LEN 4
+
+#define PHYH_LEN        (UIP_LLH_LEN+UIP_TCPIP_HLEN)
+#define DATALEN         UIP_TCP_MSS
+#define NUMPACKETS      UIP_SOCKET_NUMPACKETS
+#define PORT            80
+#define FRAME           1518
+#define STEP            100     /* us between two device ticks */
+#define PERIODIC        250000  /* UIP_PERIODIC_TIMER */
+#define CLIENT_TIMER    10000   /* UIP_CLIENT_TIMER */
+
+static unsigned long now;       /* virtual time, us */
+static int failed;
+
+static void fail(const char *what)
+{
+    if (!failed)
+        printf("FAIL at %lu us: %s\n", now, what);
+    failed = 1;
+}
+
+static uint8_t stream_byte(unsigned long i)
+{
+    return (uint8_t)((i * 2654435761UL) >> 13) ^ (uint8_t)i;
+}
+
+/* ---------------------------------------------------------------------
+ * Link: frames in flight in both directions.
+ */
+
+struct frame {
+    unsigned long at;
+    uint16_t len;
+    uint8_t data[FRAME];
+};
+
+#define QLEN 64
+
+struct queue {
+    frame f[QLEN];
+    int n;
+};
+
+static queue to_peer, to_dev;
+static unsigned long delay_us = 1000;
+static int loss_pct;
+static unsigned long lost, frames_out;
+
+static void link_send(queue *q, unsigned long at, const uint8_t *data, uint16_t len)
+{
+    if (loss_pct && rand() % 100 < loss_pct) {
+        lost++;
+        return;
+    }
+    if (q->n == QLEN) {
+        fail("link queue full");
+        return;
+    }
+    frame *f = &q->f[q->n++];
+    f->at = at + delay_us;
+    f->len = len;
+    memcpy(f->data, data, len);
+}
+
+/* the earliest frame due, removed from the queue */
+static bool link_recv(queue *q, frame *out)
+{
+    int best = -1;
+    for (int i = 0; i < q->n; i++)
+        if (q->f[i].at <= now && (best < 0 || q->f[i].at < q->f[best].at))
+            best = i;
+    if (best < 0)
+        return false;
+    *out = q->f[best];
+    q->f[best] = q->f[--q->n];
+    return true;
+}
+
+static unsigned long wire_time(uint16_t len)
+{
+    /* preamble, FCS and interframe gap, 0.8 us a byte */
+    return (len + 8 + 4 + 12) * 8 / 10;
+}
+
+/* ---------------------------------------------------------------------
+ * ENC28J60 model: buffer memory, the pool in it and one transmission
+ * at a time, as Enc28J60Network.
+ */
+
+static uint8_t sram[8192];
+static unsigned long wire_free;
+
+class SimNic : public MemoryPool
+{
+public:
+    static memhandle txPacket;
+    static uint16_t txLen;
+    static unsigned long txEnd;
+
+    static void waitTx()
+    {
+        if (txPacket == NOBLOCK)
+            return;
+        if (now < txEnd)
+            now = txEnd;
+        frames_out++;
+        link_send(&to_peer, txEnd, &sram[blocks[txPacket].begin], txLen);
+        memhandle h = txPacket;
+        txPacket = NOBLOCK;
+        freeBlock(h);
+    }
+
+    static void idle()
+    {
+        if (txPacket != NOBLOCK && now >= txEnd)
+            waitTx();
+    }
+
+    static void sendPacket(memhandle h, uint16_t len)
+    {
+        waitTx();
+        if (len > blocks[h].size)
+            fail("frame longer than its block");
+        unsigned long start = now > wire_free ? now : wire_free;
+        wire_free = txEnd = start + wire_time(len);
+        refBlock(h);
+        txPacket = h;
+        txLen = len;
+    }
+
+    static uint16_t writePacket(memhandle h, memaddress pos, const uint8_t *buf, uint16_t len)
+    {
+        waitTx();
+        if (len > blocks[h].size - pos)
+            len = blocks[h].size - pos;
+        memcpy(&sram[blocks[h].begin + pos], buf, len);
+        return len;
+    }
+
+    static uint16_t chksum(uint16_t sum, memhandle h, memaddress pos, uint16_t len)
+    {
+        waitTx();
+        return inet_chksum_add(sum, &sram[blocks[h].begin + pos], len);
+    }
+
+    static memaddress size(memhandle h) { return blocks[h].size; }
+};
+
+memhandle SimNic::txPacket;
+uint16_t SimNic::txLen;
+unsigned long SimNic::txEnd;
+
+void enc28J60_mempool_block_move_callback(memaddress dest, memaddress src, memaddress len)
+{
+    SimNic::waitTx();
+    memmove(&sram[dest], &sram[src], len);
+}
+
+/* ---------------------------------------------------------------------
+ * UIPEthernet glue: checksums over uip_buf and the packet in the pool.
+ */
+
+static memhandle uip_packet;
+static bool sendpacket;
+
+extern "C" u16_t uip_ipchksum(void)
+{
+    uint16_t sum = inet_chksum_add(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+    return sum == 0 ? 0xffff : htons(sum);
+}
+
+extern "C" u16_t uip_tcpchksum(void)
+{
+    uint16_t len = ((BUF->len[0] << 8) + BUF->len[1]) - UIP_IPH_LEN;
+    uint16_t hdr = (BUF->tcpoffset >> 4) << 2;
+    uint16_t sum = len + UIP_PROTO_TCP;
+    sum = inet_chksum_add(sum, &BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+    sum = inet_chksum_add(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN], hdr);
+    if (hdr < len)
+        sum = SimNic::chksum(sum, uip_packet, UIP_IPH_LEN + UIP_LLH_LEN + hdr, len - hdr);
+    return sum == 0 ? 0xffff : htons(sum);
+}
+
+extern "C" u16_t uip_udpchksum(void) { return 0; }
+extern "C" void uipudp_appcall(void) {}
+
+static void arp_out()
+{
+    /* what uip_arp_out() leaves behind with the peer in the table */
+    memset(uip_buf, 0x02, 12);
+    uip_buf[12] = 0x08;
+    uip_buf[13] = 0x00;
+    uip_len += UIP_LLH_LEN;
+}
+
+static void network_send()
+{
+    if (sendpacket) {
+        SimNic::writePacket(uip_packet, 0, uip_buf, PHYH_LEN);
+        sendpacket = false;
+        SimNic::sendPacket(uip_packet, uip_len);
+    } else {
+        uip_packet = MemoryPool::allocBlock(uip_len);
+        if (uip_packet == NOBLOCK) {
+            fail("no memory for a frame");
+            return;
+        }
+        SimNic::writePacket(uip_packet, 0, uip_buf, uip_len);
+        SimNic::sendPacket(uip_packet, uip_len);
+    }
+    MemoryPool::freeBlock(uip_packet);
+    uip_packet = NOBLOCK;
+}
+
+static void output()
+{
+    if (uip_len == 0)
+        return;
+    arp_out();
+    network_send();
+    /* UIPEthernetClass::fillSendWindow() */
+    for (int i = 1; i < UIP_TCP_SEGS; i++) {
+        uip_process(UIP_POLL_REQUEST);
+        if (uip_len == 0)
+            return;
+        arp_out();
+        network_send();
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * UIPClient: outgoing packets of one socket and the bulk sender.
+ */
+
+static memhandle packets_out[NUMPACKETS];
+static memaddress out_pos;
+static unsigned long written, total;
+static unsigned long client_timer;
+static bool connected, closing, closed;
+static struct uip_conn *conn;
+
+static uint8_t current_block()
+{
+    for (uint8_t i = 1; i < NUMPACKETS; i++)
+        if (packets_out[i] == NOBLOCK)
+            return i - 1;
+    return NUMPACKETS - 1;
+}
+
+static void eat_block()
+{
+    MemoryPool::freeBlock(packets_out[0]);
+    for (uint8_t i = 0; i < NUMPACKETS - 1; i++)
+        packets_out[i] = packets_out[i + 1];
+    packets_out[NUMPACKETS - 1] = NOBLOCK;
+}
+
+/* UIPClient::_write() without blocking */
+static void app_write()
+{
+    uint8_t chunk[256];
+    while (written < total) {
+        uint16_t n = total - written < sizeof(chunk) ? total - written : sizeof(chunk);
+        for (uint16_t i = 0; i < n; i++)
+            chunk[i] = stream_byte(written + i);
+        uint8_t p = current_block();
+        if (packets_out[p] != NOBLOCK &&
+            (out_pos == 0 || out_pos == SimNic::size(packets_out[p]))) {
+            if (p == NUMPACKETS - 1)
+                return;
+            p++;
+        }
+        if (packets_out[p] == NOBLOCK) {
+            packets_out[p] = MemoryPool::allocBlock(PHYH_LEN + DATALEN);
+            if (packets_out[p] == NOBLOCK)
+                return;
+            out_pos = PHYH_LEN;
+        }
+        uint16_t w = SimNic::writePacket(packets_out[p], out_pos, chunk, n);
+        out_pos += w;
+        written += w;
+        client_timer = now + CLIENT_TIMER;
+    }
+}
+
+/* UIPClient::_ackBlocks() */
+static void ack_blocks(uint16_t len)
+{
+    while (len > 0 && packets_out[0] != NOBLOCK) {
+        memaddress size = SimNic::size(packets_out[0]) - PHYH_LEN;
+        if (len < size) {
+            MemoryPool::resizeBlock(packets_out[0], len);
+            return;
+        }
+        len -= size;
+        eat_block();
+    }
+    if (len)
+        fail("acknowledged more than was written");
+}
+
+/* UIPClient::_sendBlock() */
+static uint16_t send_block()
+{
+    uint16_t off = uip_rexmit() ? 0 : uip_conn->len;
+    uint16_t len = 0;
+    bool open = false;
+    uint8_t p;
+
+    for (p = 0; p < NUMPACKETS && packets_out[p] != NOBLOCK; p++) {
+        open = out_pos && (p == NUMPACKETS - 1 || packets_out[p + 1] == NOBLOCK);
+        len = (open ? out_pos : SimNic::size(packets_out[p])) - PHYH_LEN;
+        if (off < len)
+            break;
+        off -= len;
+    }
+    if (p == NUMPACKETS || packets_out[p] == NOBLOCK || off)
+        return 0;
+    off = uip_rexmit() ? uip_conn->len : uip_sendwnd();
+    if (len > off)
+        len = off;
+    if (len == 0)
+        return 0;
+    if (open) {
+        MemoryPool::resizeBlock(packets_out[p], 0, out_pos);
+        out_pos = 0;
+    }
+    if ((uint8_t *)uip_appdata - uip_buf != PHYH_LEN)
+        fail("headers do not fit the room in front of the data");
+    uip_packet = packets_out[p];
+    MemoryPool::refBlock(uip_packet);
+    sendpacket = true;
+    return len;
+}
+
+extern "C" void uipclient_appcall(void)
+{
+    uint16_t send_len = 0;
+
+    if (uip_connected()) {
+        connected = true;
+        conn = uip_conn;
+    }
+    if (uip_closed() || uip_aborted() || uip_timedout()) {
+        if (!closing || uip_aborted() || uip_timedout())
+            fail("connection lost");
+        closed = true;
+        return;
+    }
+    if (uip_acked())
+        ack_blocks(uip_acklen);
+    if ((uip_poll() || uip_rexmit() || uip_acked()) && packets_out[0] != NOBLOCK) {
+        send_len = send_block();
+    } else if (written == total && packets_out[0] == NOBLOCK && !closing) {
+        closing = true;
+        uip_close();
+        return;
+    }
+    uip_send(uip_appdata, send_len);
+}
+
+/* ---------------------------------------------------------------------
+ * The peer.
+ */
+
+static const uint8_t dev_ip[4] = { 192, 168, 1, 2 };
+static const uint8_t peer_ip[4] = { 192, 168, 1, 1 };
+static uint32_t peer_snd, peer_rcv;
+static uint16_t peer_wnd = 4096;
+static unsigned long delack_us = 40000, delack_at;
+static int peer_unacked;
+static unsigned long received, segments, dupacks;
+static unsigned long done_at;
+static bool peer_syn, peer_fin;
+static unsigned long syn_at;
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void peer_send(uint8_t flags)
+{
+    uint8_t f[64];
+    uint16_t optlen = flags & TCP_SYN ? 4 : 0;
+    uint16_t len = 14 + 20 + 20 + optlen;
+
+    memset(f, 0, sizeof(f));
+    memset(f, 0x02, 12);
+    f[12] = 0x08;
+    f[14] = 0x45;
+    f[16] = (len - 14) >> 8; f[17] = len - 14;
+    f[22] = 64;
+    f[23] = UIP_PROTO_TCP;
+    memcpy(&f[26], peer_ip, 4);
+    memcpy(&f[30], dev_ip, 4);
+    uint16_t ck = ~inet_chksum_add(0, &f[14], 20);
+    f[24] = ck >> 8; f[25] = ck;
+    uint8_t *t = &f[34];
+    t[0] = 0x12; t[1] = 0x34;
+    t[2] = PORT >> 8; t[3] = PORT & 0xff;
+    put32(&t[4], peer_snd);
+    put32(&t[8], peer_rcv);
+    t[12] = (5 + optlen / 4) << 4;
+    t[13] = flags;
+    t[14] = peer_wnd >> 8; t[15] = peer_wnd;
+    if (optlen) {
+        t[20] = TCP_OPT_MSS; t[21] = TCP_OPT_MSS_LEN;
+        t[22] = 1460 >> 8; t[23] = 1460 & 0xff;
+    }
+    ck = (len - 34) + UIP_PROTO_TCP;
+    ck = inet_chksum_add(ck, &f[26], 8);
+    ck = ~inet_chksum_add(ck, t, len - 34);
+    t[16] = ck >> 8; t[17] = ck;
+    link_send(&to_dev, now + wire_time(len), f, len);
+    peer_unacked = 0;
+    delack_at = 0;
+}
+
+static void peer_input(const frame *fr)
+{
+    const uint8_t *f = fr->data;
+    uint16_t iplen = (f[16] << 8) + f[17];
+    if (fr->len < 54 || fr->len != 14 + iplen) {
+        fail("bad frame length");
+        return;
+    }
+    if (inet_chksum_add(0, &f[14], 20) != 0xffff)
+        fail("bad IP checksum");
+    const uint8_t *t = &f[34];
+    uint16_t tlen = iplen - 20;
+    uint16_t sum = tlen + UIP_PROTO_TCP;
+    sum = inet_chksum_add(sum, &f[26], 8);
+    if (inet_chksum_add(sum, t, tlen) != 0xffff)
+        fail("bad TCP checksum");
+    uint8_t flags = t[13];
+    uint16_t hlen = (t[12] >> 4) * 4;
+    uint16_t dlen = tlen - hlen;
+    uint32_t seq = get32(&t[4]);
+
+    if (flags & TCP_SYN) {
+        /* the SYN-ACK, maybe once more when our ACK got lost */
+        peer_syn = true;
+        peer_rcv = seq + 1;
+        peer_snd = 1001;
+        peer_send(TCP_ACK);
+        return;
+    }
+    if (dlen) {
+        if (seq != peer_rcv) {
+            dupacks++;
+            peer_send(TCP_ACK);
+            return;
+        }
+        for (uint16_t i = 0; i < dlen; i++)
+            if (t[hlen + i] != stream_byte(received + i)) {
+                fail("stream data corrupt");
+                break;
+            }
+        received += dlen;
+        peer_rcv += dlen;
+        segments++;
+        if (received == total)
+            done_at = now;
+        if (++peer_unacked >= 2)
+            peer_send(TCP_ACK);
+        else if (!delack_at)
+            delack_at = now + delack_us;
+    }
+    if (flags & TCP_FIN) {
+        if (!peer_fin && seq + dlen == peer_rcv) {
+            if (received != total)
+                fail("FIN before the end of the stream");
+            peer_fin = true;
+            peer_rcv++;
+        }
+        /* our FIN goes along with the ACK, again for each FIN resent */
+        if (peer_fin)
+            peer_send(TCP_FIN | TCP_ACK);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * The run.
+ */
+
+static void device_input(const frame *fr)
+{
+    memcpy(uip_buf, fr->data, fr->len < UIP_BUFSIZE ? fr->len : UIP_BUFSIZE);
+    uip_len = fr->len;
+    uip_packet = NOBLOCK;
+    uip_input();
+    if (uip_len > 0) {
+        output();
+    }
+}
+
+static void reset()
+{
+    now = 0;
+    wire_free = 0;
+    failed = 0;
+    to_peer.n = to_dev.n = 0;
+    lost = frames_out = 0;
+    memset(packets_out, 0, sizeof(packets_out));
+    out_pos = 0;
+    written = 0;
+    connected = closing = closed = false;
+    conn = NULL;
+    received = segments = dupacks = 0;
+    done_at = 0;
+    peer_syn = peer_fin = false;
+    peer_unacked = 0;
+    delack_at = 0;
+    syn_at = 0;
+    peer_snd = 1000;
+    SimNic::txPacket = NOBLOCK;
+
+    MemoryPool::init();
+    uip_init();
+    uip_ipaddr_t ip;
+    uip_ipaddr(ip, dev_ip[0], dev_ip[1], dev_ip[2], dev_ip[3]);
+    uip_sethostaddr(ip);
+    uip_ipaddr(ip, 255, 255, 255, 0);
+    uip_setnetmask(ip);
+    uip_listen(HTONS(PORT));
+}
+
+static int run()
+{
+    unsigned long periodic = PERIODIC;
+    unsigned long limit = 600UL * 1000000;
+    frame fr;
+
+    reset();
+
+    while (!(closed && peer_fin) && !failed) {
+        if (now > limit) {
+            fail("timeout");
+            break;
+        }
+        if (!peer_syn && now >= syn_at) {
+            peer_send(TCP_SYN);
+            syn_at = now + 1000000;
+        }
+        while (link_recv(&to_peer, &fr))
+            peer_input(&fr);
+        if (delack_at && now >= delack_at)
+            peer_send(TCP_ACK);
+
+        /* UIPEthernetClass::tick() */
+        SimNic::idle();
+        if (connected && !closing)
+            app_write();
+        if (link_recv(&to_dev, &fr))
+            device_input(&fr);
+        if (now >= periodic) {
+            periodic = now + PERIODIC;
+            for (int i = 0; i < UIP_CONNS; i++) {
+                uip_periodic(i);
+                output();
+            }
+        } else if (conn && now >= client_timer) {
+            uip_poll_conn(conn);
+            output();
+        }
+        now += STEP;
+    }
+    SimNic::waitTx();
+
+    if (!failed && received != total)
+        fail("stream incomplete");
+    for (memhandle h = 1; h <= MEMPOOL_NUM_MEMBLOCKS; h++)
+        if (MemoryPool::blockSize(h))
+            fail("pool block left allocated");
+    double secs = done_at / 1e6;
+    printf("%s segs %d: %lu bytes in %.3f s = %.1f KB/s, %lu segments, "
+           "%lu frames out, %lu lost, %lu dup acks\n",
+           failed ? "FAILED" : "ok", UIP_TCP_SEGS, received, secs,
+           secs > 0 ? received / secs / 1024 : 0.0, segments, frames_out,
+           lost, dupacks);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, runs = 1, errors = 0;
+    unsigned seed = 1;
+
+    total = 262144;
+    while ((opt = getopt(argc, argv, "n:d:l:a:w:s:r:")) != -1) {
+        switch (opt) {
+        case 'n': total = strtoul(optarg, NULL, 0); break;
+        case 'd': delay_us = (unsigned long)(atof(optarg) * 1000); break;
+        case 'l': loss_pct = atoi(optarg); break;
+        case 'a': delack_us = (unsigned long)(atof(optarg) * 1000); break;
+        case 'w': peer_wnd = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'r': runs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n bytes] [-d delay_ms] [-l loss_%%] "
+                    "[-a delack_ms] [-w window] [-s seed] [-r runs]\n", argv[0]);
+            return 2;
+        }
+    }
+    for (int r = 0; r < runs; r++) {
+        srand(seed + r);
+        errors += run();
+    }
+    if (runs > 1)
+        printf("%d of %d runs failed\n", errors, runs);
+    return errors != 0;
+}
@@ -0,0 +1,258 @@
+#!/usr/bin/env python
+"""Throughput and latency of the STM32F1 USB serial (CDC ACM) port.
+
+Runs against a board running a loopback sketch, which sends back every
+byte it receives:
+
+    void setup() { Serial.begin(); }
+    void loop() {
+        static uint8 buf[512];
+        uint32 n = Serial.available();
+        if (n) {
+            n = Serial.read(buf, n < sizeof(buf) ? n : sizeof(buf));
+            Serial.write(buf, n);
+        }
+    }
+
+The throughput test streams a known pattern in blocks while a second
+thread reads the echo, checks every byte and reports the sustained rate
+in each direction (the loopback rate is limited by the slower one). The
+latency test sends one message at a time and times the round trip.
+
+    python usb_cdc_bench.py /dev/ttyACM0
+    python usb_cdc_bench.py --bytes 4000000 --block 4096 /dev/ttyACM0
+    python usb_cdc_bench.py --latency-sizes 1,64,512 --rounds 2000 COM5
+    python usb_cdc_bench.py --self-test
+
+Needs pyserial, except for --self-test.
+"""
+
+from __future__ import print_function
+
+import argparse
+import collections
+import sys
+import threading
+import time
+
+
+def pattern(offset, n):
+    """n bytes of the test stream starting at offset. It repeats only
+    every 64 kB, so a dropped or repeated packet never lines up again."""
+    return bytes(bytearray((i * 7 + (i >> 8)) & 0xFF
+                           for i in range(offset, offset + n)))
+
+
+def first_mismatch(data, offset):
+    """Index in data of the first byte that differs from the pattern."""
+    ref = pattern(offset, len(data))
+    if data == ref:
+        return -1
+    for i, (a, b) in enumerate(zip(bytearray(data), bytearray(ref))):
+        if a != b:
+            return i
+    return -1
+
+
+def percentile(values, p):
+    s = sorted(values)
+    return s[min(len(s) - 1, int(p / 100.0 * len(s)))]
+
+
+class Stream(object):
+    """Running totals of one direction."""
+
+    def __init__(self):
+        self.count = 0
+        self.start = None
+        self.end = None
+
+    def add(self, n):
+        now = time.time()
+        if self.start is None:
+            self.start = now
+        self.count += n
+        self.end = now
+
+    def rate(self):
+        if self.start is None or self.end <= self.start:
+            return 0.0
+        return self.count / (self.end - self.start)
+
+
+def throughput(port, total, block, timeout):
+    """Stream total bytes through the loopback. Returns (tx, rx, error)."""
+    tx = Stream()
+    rx = Stream()
+    result = {"error": None}
+
+    def reader():
+        deadline = time.time() + timeout
+        while rx.count < total:
+            data = port.read(min(65536, total - rx.count))
+            if data:
+                bad = first_mismatch(data, rx.count)
+                if bad >= 0:
+                    result["error"] = "data error at byte %d" % (rx.count + bad)
+                    return
+                rx.add(len(data))
+                deadline = time.time() + timeout
+            elif time.time() > deadline:
+                result["error"] = "timeout after %d bytes" % rx.count
+                return
+
+    t = threading.Thread(target=reader)
+    t.start()
+    sent = 0
+    while sent < total and t.is_alive():
+        n = min(block, total - sent)
+        port.write(pattern(sent, n))
+        sent += n
+        tx.add(n)
+    if hasattr(port, "flush"):
+        port.flush()
+    t.join()
+    return tx, rx, result["error"]
+
+
+def latency(port, size, rounds, timeout):
+    """Round trip times, in seconds, of rounds messages of size bytes."""
+    times = []
+    msg = pattern(0, size)
+    for _ in range(rounds):
+        t0 = time.time()
+        port.write(msg)
+        got = b""
+        while len(got) < size:
+            data = port.read(size - len(got))
+            if not data and time.time() - t0 > timeout:
+                raise IOError("no echo for a %d byte message" % size)
+            got += data
+        times.append(time.time() - t0)
+        if got != msg:
+            raise IOError("bad echo for a %d byte message" % size)
+    return times
+
+
+def report(port, args):
+    tx, rx, error = throughput(port, args.bytes, args.block, args.timeout)
+    print("throughput, %d bytes in %d byte blocks:" % (args.bytes, args.block))
+    print("  host -> device %8.1f kB/s" % (tx.rate() / 1000))
+    print("  loopback       %8.1f kB/s" % (rx.rate() / 1000))
+    if error:
+        print("  FAIL: %s" % error)
+        return 1
+
+    print("\nround trip latency, %d messages:" % args.rounds)
+    print("  %6s %9s %9s %9s %9s" % ("bytes", "min us", "median", "p99", "max"))
+    for size in args.latency_sizes:
+        times = latency(port, size, args.rounds, args.timeout)
+        print("  %6d %9.0f %9.0f %9.0f %9.0f" % (
+            size, min(times) * 1e6, percentile(times, 50) * 1e6,
+            percentile(times, 99) * 1e6, max(times) * 1e6))
+    return 0
+
+
+class FakeLoopback(object):
+    """In process stand in for the board: echoes what is written, in
+    64 byte packets, optionally corrupting one byte."""
+
+    def __init__(self, corrupt_at=-1):
+        self.queue = collections.deque()
+        self.lock = threading.Condition()
+        self.written = 0
+        self.corrupt_at = corrupt_at
+
+    def write(self, data):
+        data = bytearray(data)
+        if 0 <= self.corrupt_at - self.written < len(data):
+            data[self.corrupt_at - self.written] ^= 0x55
+        self.written += len(data)
+        with self.lock:
+            for i in range(0, len(data), 64):
+                self.queue.append(bytes(data[i:i + 64]))
+            self.lock.notify()
+        return len(data)
+
+    def read(self, n):
+        out = b""
+        with self.lock:
+            if not self.queue:
+                self.lock.wait(0.05)
+            while self.queue and len(out) < n:
+                pkt = self.queue.popleft()
+                take = n - len(out)
+                out += pkt[:take]
+                if take < len(pkt):
+                    self.queue.appendleft(pkt[take:])
+        return out
+
+
+def self_test():
+    failures = 0
+
+    def check(ok, what):
+        print("%-44s %s" % (what, "ok" if ok else "FAIL"))
+        return 0 if ok else 1
+
+    failures += check(pattern(1000, 300) == pattern(0, 1300)[1000:],
+                      "pattern is position dependent only")
+    failures += check(first_mismatch(pattern(64, 128), 0) >= 0 and
+                      first_mismatch(pattern(64, 128), 64) < 0,
+                      "a shifted stream is detected")
+
+    tx, rx, error = throughput(FakeLoopback(), 300000, 4096, 2.0)
+    failures += check(error is None and rx.count == 300000 and
+                      tx.rate() > 0 and rx.rate() > 0,
+                      "clean loopback streams all bytes")
+
+    tx, rx, error = throughput(FakeLoopback(corrupt_at=123457), 300000, 4096, 2.0)
+    failures += check(error == "data error at byte 123457",
+                      "corrupt byte is found at its offset")
+
+    times = latency(FakeLoopback(), 100, 50, 1.0)
+    failures += check(len(times) == 50 and min(times) >= 0,
+                      "latency round trips")
+
+    failures += check(percentile(list(range(100)), 50) == 50 and
+                      percentile(list(range(100)), 99) == 99,
+                      "percentiles")
+    if failures:
+        print("\n%d checks failed" % failures)
+    return 1 if failures else 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("port", nargs="?", help="serial port of the board")
+    ap.add_argument("--bytes", type=int, default=1000000,
+                    help="bytes streamed in the throughput test")
+    ap.add_argument("--block", type=int, default=2048,
+                    help="host write size in the throughput test")
+    ap.add_argument("--latency-sizes", default="1,16,64,256",
+                    type=lambda s: [int(v) for v in s.split(",")],
+                    help="comma separated message sizes")
+    ap.add_argument("--rounds", type=int, default=500,
+                    help="messages per latency size")
+    ap.add_argument("--timeout", type=float, default=2.0,
+                    help="seconds without data before giving up")
+    ap.add_argument("--self-test", action="store_true",
+                    help="check the script against an in process loopback")
+    args = ap.parse_args()
+
+    if args.self_test:
+        return self_test()
+    if not args.port:
+        ap.error("a serial port is needed")
+
+    import serial
+    port = serial.Serial(args.port, timeout=0.05, write_timeout=args.timeout)
+    port.reset_input_buffer()
+    try:
+        return report(port, args)
+    finally:
+        port.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
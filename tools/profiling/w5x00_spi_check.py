@@ -0,0 +1,468 @@
+#!/usr/bin/env python
+"""Host check of the SPI framing of the Ethernet_STM W5100/W5200/W5500 drivers.
+
+Builds each driver (STM32F1 code path) against a mock SPI class with a
+model of the chip behind it: the model decodes the frames it is clocked,
+keeps the chip memory and answers reads from it. The harness runs
+register and socket buffer transfers through the driver; this script
+compares every chip select frame, byte for byte, with the frames the
+datasheets specify, checks the data that reached the chip memory and the
+caller's buffers, and that payloads go as bursts (DMA from the driver's
+threshold on) instead of byte at a time.
+
+    python w5x00_spi_check.py             all three chips
+    python w5x00_spi_check.py w5500 -v    one chip, print the frames
+
+Needs a host C++ compiler (c++ or $CXX).
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DRIVERS = os.path.join(HERE, "..", "..", "STM32F1", "libraries",
+                       "Ethernet_STM", "src")
+DMA_MIN = 32
+
+MOCK_SPI_H = r"""
+#ifndef MOCK_SPI_H
+#define MOCK_SPI_H
+#include <stdint.h>
+#include <string.h>
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+#define OUTPUT 1
+#define HIGH 1
+#define LOW 0
+#define PA4 4
+#define MSBFIRST 1
+#define SPI_MODE0 0
+#define SPI_CLOCK_DIV4 4
+#define SPI_CLOCK_DIV8 8
+void delay(unsigned long ms);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int level);
+
+struct SpiStats { unsigned single, burst, dma; };
+extern SpiStats spi_stats;
+uint8_t chip_clock(uint8_t mosi);
+
+class SPIClass {
+public:
+  void begin() {}
+  void setBitOrder(int) {}
+  void setDataMode(int) {}
+  void setClockDivider(int) {}
+  uint8 transfer(uint8 b) { spi_stats.single++; return chip_clock(b); }
+  void transfer(const uint8_t *tx, uint8_t *rx, uint32 n) {
+    spi_stats.burst++;
+    for (uint32 i = 0; i < n; i++) rx[i] = chip_clock(tx[i]);
+  }
+  void write(const void *buf, uint32 n) {
+    spi_stats.burst++;
+    for (uint32 i = 0; i < n; i++) chip_clock(((const uint8_t *)buf)[i]);
+  }
+  void read(uint8 *buf, uint32 n) {
+    spi_stats.burst++;
+    for (uint32 i = 0; i < n; i++) buf[i] = chip_clock(0xFF);
+  }
+  void dmaSend(const void *buf, uint16 n, uint16 flags = 0) {
+    spi_stats.dma++;
+    for (uint16 i = 0; i < n; i++) chip_clock(((const uint8_t *)buf)[i]);
+  }
+  void dmaTransfer(const uint16_t tx, void *buf, uint16 n, uint16 flags = 0) {
+    spi_stats.dma++;
+    for (uint16 i = 0; i < n; i++) ((uint8_t *)buf)[i] = chip_clock((uint8_t)tx);
+  }
+};
+extern SPIClass SPI;
+#endif
+"""
+
+HARNESS = r"""
+#include <stdio.h>
+#include <stdlib.h>
+#include "utility/w5100.h"
+
+SPIClass SPI;
+SpiStats spi_stats;
+static uint8_t mem[32][65536];          /* [block][address]; one block on W5100/W5200 */
+static uint8_t frame[8192];
+static unsigned pos;
+static int cs_low;
+
+void delay(unsigned long) {}
+void pinMode(int, int) {}
+
+/* MISO for the byte at pos of the current frame; writes land in mem */
+uint8_t chip_clock(uint8_t mosi)
+{
+  uint8_t miso = 0;
+  if (!cs_low) {
+    printf("ERR byte clocked with CS high\n");
+    return 0;
+  }
+  frame[pos] = mosi;
+#if defined(W5500_ETHERNET_SHIELD)
+  if (pos >= 3) {
+    uint8_t cb = frame[2], block = cb >> 3;
+    uint16_t a = (uint16_t)((frame[0] << 8 | frame[1]) + pos - 3);
+    if ((block & 3) == 2 || (block & 3) == 3)
+      a &= 2048 - 1;                    /* socket buffers wrap in the chip */
+    if (cb & 0x04) mem[block][a] = mosi; else miso = mem[block][a];
+  }
+#elif defined(W5200_ETHERNET_SHIELD)
+  if (pos >= 4) {
+    uint16_t a = (uint16_t)((frame[0] << 8 | frame[1]) + pos - 4);
+    if (frame[2] & 0x80) mem[0][a] = mosi; else miso = mem[0][a];
+  }
+#else
+  if (pos == 3) {
+    uint16_t a = (uint16_t)(frame[1] << 8 | frame[2]);
+    if (frame[0] == 0xF0) mem[0][a] = mosi;
+    else if (frame[0] == 0x0F) miso = mem[0][a];
+    else printf("ERR bad opcode %02x\n", frame[0]);
+  } else if (pos > 3) {
+    printf("ERR W5100 frame longer than 4 bytes\n");
+  }
+#endif
+  pos++;
+  return miso;
+}
+
+void digitalWrite(int pin, int level)
+{
+  if (pin != PA4) return;
+  if (!level) {
+    if (cs_low) printf("ERR CS already low\n");
+    cs_low = 1;
+    pos = 0;
+  } else if (cs_low) {
+    cs_low = 0;
+    printf("F");
+    for (unsigned i = 0; i < pos; i++) printf(" %02x", frame[i]);
+    printf("\n");
+  }
+}
+
+static void stats(void)
+{
+  printf("S %u %u %u\n", spi_stats.single, spi_stats.burst, spi_stats.dma);
+  memset(&spi_stats, 0, sizeof(spi_stats));
+}
+
+static void dump(const char *tag, const uint8_t *p, unsigned n)
+{
+  printf("%s", tag);
+  for (unsigned i = 0; i < n; i++) printf(" %02x", p[i]);
+  printf("\n");
+}
+
+/* socket register address / block, per chip */
+static uint8_t *sn_reg(uint8_t s, uint16_t reg)
+{
+#if defined(W5500_ETHERNET_SHIELD)
+  return &mem[(s << 2) + 1][reg];
+#elif defined(W5200_ETHERNET_SHIELD)
+  return &mem[0][0x4000 + s * 0x100 + reg];
+#else
+  return &mem[0][0x0400 + s * 0x100 + reg];
+#endif
+}
+
+static uint8_t *rx_mem(uint8_t s, uint16_t off)
+{
+#if defined(W5500_ETHERNET_SHIELD)
+  return &mem[(s << 2) + 3][off & 2047];
+#elif defined(W5200_ETHERNET_SHIELD)
+  return &mem[0][0xC000 + s * 2048 + (off & 2047)];
+#else
+  return &mem[0][0x6000 + s * 2048 + (off & 2047)];
+#endif
+}
+
+static uint8_t *tx_mem(uint8_t s, uint16_t off)
+{
+#if defined(W5500_ETHERNET_SHIELD)
+  return &mem[(s << 2) + 2][off & 2047];
+#elif defined(W5200_ETHERNET_SHIELD)
+  return &mem[0][0x8000 + s * 2048 + (off & 2047)];
+#else
+  return &mem[0][0x4000 + s * 2048 + (off & 2047)];
+#endif
+}
+
+static void set16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+
+int main(int argc, char **argv)
+{
+  static uint8_t data[1200], buf[1200];
+  const uint8_t s = 1;
+  uint16_t ptrs[4] = { 0x07F0, 0x0100, 0x07F8, 0x0400 };
+  uint16_t lens[4] = { 40, 1000, 20, 600 };
+  uint8_t ip[4] = { 192, 168, 1, 177 };
+  unsigned i, k;
+
+  for (i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 7 + 3);
+  printf("B init\n");
+  W5100.init();
+  memset(&spi_stats, 0, sizeof(spi_stats));
+
+  printf("B ip\n");
+  W5100.setIPAddress(ip);
+  stats();
+
+  for (k = 0; k < 2; k++) {
+    printf("B send %u %u\n", ptrs[k], lens[k]);
+    set16(sn_reg(s, 0x24), ptrs[k]);
+    W5100.send_data_processing(s, data, lens[k]);
+    stats();
+    for (i = 0; i < lens[k]; i++) buf[i] = *tx_mem(s, ptrs[k] + i);
+    dump("M", buf, lens[k]);
+  }
+  for (k = 2; k < 4; k++) {
+    printf("B recv %u %u\n", ptrs[k], lens[k]);
+    set16(sn_reg(s, 0x28), ptrs[k]);
+    for (i = 0; i < lens[k]; i++) *rx_mem(s, ptrs[k] + i) = data[i] ^ 0x5A;
+    memset(buf, 0, sizeof(buf));
+    W5100.recv_data_processing(s, buf, lens[k], k == 3);
+    stats();
+    dump("M", buf, lens[k]);
+  }
+  return 0;
+}
+"""
+
+
+def be16(v):
+    return [v >> 8 & 0xFF, v & 0xFF]
+
+
+class W5500(object):
+    name = "w5500"
+    burst = True
+
+    def reg_write(self, addr, data, block=0):
+        return [be16(addr) + [block << 3 | 0x04] + list(data)]
+
+    def sn_write16(self, s, reg, v):
+        return [be16(reg + i) + [(s << 5) + 0x0C, b]
+                for i, b in enumerate(be16(v))]
+
+    def sn_read16(self, s, reg):
+        return [be16(reg + i) + [(s << 5) + 0x08, 0] for i in range(2)]
+
+    def pieces(self, ptr, n):
+        return [n]                      # the chip wraps its buffers itself
+
+    def tx(self, s, ptr, data):
+        return [be16(ptr) + [0x14 + (s << 5)] + list(data)]
+
+    def rx(self, s, ptr, n):
+        return [be16(ptr) + [0x18 + (s << 5)] + [0xFF] * n]
+
+
+class W5200(object):
+    name = "w5200"
+    burst = True
+
+    def frame(self, addr, write, data):
+        n = len(data)
+        return be16(addr) + [(0x80 if write else 0) | (n >> 8 & 0x7F), n & 0xFF] + data
+
+    def reg_write(self, addr, data):
+        return [self.frame(addr, True, list(data))]
+
+    def sn_write16(self, s, reg, v):
+        return [self.frame(0x4000 + s * 0x100 + reg + i, True, [b])
+                for i, b in enumerate(be16(v))]
+
+    def sn_read16(self, s, reg):
+        return [self.frame(0x4000 + s * 0x100 + reg + i, False, [0])
+                for i in range(2)]
+
+    def pieces(self, ptr, n):
+        return [m for _, m in self.split(0, ptr, n)]
+
+    def split(self, base, ptr, n):
+        off = ptr & 2047
+        if off + n > 2048:
+            return [(base + off, 2048 - off), (base, n - (2048 - off))]
+        return [(base + off, n)]
+
+    def tx(self, s, ptr, data):
+        out, done = [], 0
+        for addr, n in self.split(0x8000 + s * 2048, ptr, len(data)):
+            out.append(self.frame(addr, True, list(data[done:done + n])))
+            done += n
+        return out
+
+    def rx(self, s, ptr, n):
+        return [self.frame(addr, False, [0xFF] * m)
+                for addr, m in self.split(0xC000 + s * 2048, ptr, n)]
+
+
+class W5100(W5200):
+    name = "w5100"
+    burst = False
+
+    def frame(self, addr, write, data):
+        return [[0xF0 if write else 0x0F] + be16(addr + i) + [b]
+                for i, b in enumerate(data)]
+
+    def reg_write(self, addr, data):
+        return self.frame(addr, True, list(data))
+
+    def sn_write16(self, s, reg, v):
+        return self.frame(0x0400 + s * 0x100 + reg, True, be16(v))
+
+    def sn_read16(self, s, reg):
+        return self.frame(0x0400 + s * 0x100 + reg, False, [0, 0])
+
+    def tx(self, s, ptr, data):
+        out, done = [], 0
+        for addr, n in self.split(0x4000 + s * 2048, ptr, len(data)):
+            out += self.frame(addr, True, list(data[done:done + n]))
+            done += n
+        return out
+
+    def rx(self, s, ptr, n):
+        out = []
+        for addr, m in self.split(0x6000 + s * 2048, ptr, n):
+            out += self.frame(addr, False, [0] * m)
+        return out
+
+
+CHIPS = {c.name: c for c in (W5100(), W5200(), W5500())}
+DEFINES = {"w5100": "W5100_ETHERNET_SHIELD", "w5200": "W5200_ETHERNET_SHIELD",
+           "w5500": "W5500_ETHERNET_SHIELD"}
+
+
+def build_and_run(chip, tmp):
+    cxx = os.environ.get("CXX", "c++")
+    with open(os.path.join(tmp, "SPI.h"), "w") as f:
+        f.write(MOCK_SPI_H)
+    with open(os.path.join(tmp, "harness.cpp"), "w") as f:
+        f.write(HARNESS)
+    exe = os.path.join(tmp, "harness_" + chip)
+    src = os.path.join(DRIVERS, "utility", chip + ".cpp")
+    cmd = [cxx, "-O1", "-w", "-D__STM32F1__", "-D" + DEFINES[chip],
+           "-I" + tmp, "-I" + DRIVERS, "-o", exe,
+           os.path.join(tmp, "harness.cpp"), src]
+    subprocess.check_call(cmd)
+    return subprocess.check_output([exe]).decode()
+
+
+def parse(output):
+    """Blocks of (name, frames, stats, memory dump)."""
+    blocks, cur = [], None
+    for line in output.splitlines():
+        tag, rest = line[:1], line[2:]
+        if tag == "B":
+            cur = {"name": rest, "frames": [], "stats": None, "mem": None}
+            blocks.append(cur)
+        elif tag == "F":
+            cur["frames"].append([int(v, 16) for v in rest.split()])
+        elif tag == "S":
+            cur["stats"] = [int(v) for v in rest.split()]
+        elif tag == "M":
+            cur["mem"] = [int(v, 16) for v in rest.split()]
+        elif line.startswith("ERR"):
+            raise AssertionError(line)
+    return blocks
+
+
+def expected(chip, name):
+    """Frames the datasheet framing gives for a harness block."""
+    s = 1
+    args = name.split()
+    data = [(i * 7 + 3) & 0xFF for i in range(1200)]
+    if args[0] == "ip":
+        return chip.reg_write(0x000F, [192, 168, 1, 177])
+    ptr, n = int(args[1]), int(args[2])
+    if args[0] == "send":
+        return (chip.sn_read16(s, 0x24) + chip.tx(s, ptr, data[:n]) +
+                chip.sn_write16(s, 0x24, (ptr + n) & 0xFFFF))
+    frames = chip.sn_read16(s, 0x28) + chip.rx(s, ptr, n)
+    if n != 600:                        # the 600 byte receive is a peek
+        frames += chip.sn_write16(s, 0x28, (ptr + n) & 0xFFFF)
+    return frames
+
+
+def mosi_equal(got, want, chip):
+    """Compare frames; MOSI during a read's data phase is don't care."""
+    if len(got) != len(want):
+        return False
+    for g, w in zip(got, want):
+        if len(g) != len(w):
+            return False
+        read = (chip.name == "w5500" and not g[2] & 0x04 or
+                chip.name == "w5200" and not g[2] & 0x80 or
+                chip.name == "w5100" and g[0] == 0x0F)
+        head = {"w5500": 3, "w5200": 4, "w5100": 3}[chip.name]
+        if g[:head] != w[:head] or not read and g != w:
+            return False
+    return True
+
+
+def check_chip(name, verbose):
+    chip = CHIPS[name]
+    tmp = tempfile.mkdtemp()
+    failures = 0
+    try:
+        blocks = parse(build_and_run(name, tmp))
+    finally:
+        shutil.rmtree(tmp)
+
+    def check(ok, what):
+        print("%-6s %-40s %s" % (name, what, "ok" if ok else "FAIL"))
+        return 0 if ok else 1
+
+    data = [(i * 7 + 3) & 0xFF for i in range(1200)]
+    for b in blocks[1:]:
+        want = expected(chip, b["name"])
+        if verbose:
+            for f in b["frames"]:
+                print("    " + " ".join("%02x" % v for v in f[:24]) +
+                      (" ..." if len(f) > 24 else ""))
+        failures += check(mosi_equal(b["frames"], want, chip),
+                          "%s: %d frames byte exact" % (b["name"], len(want)))
+        args = b["name"].split()
+        if args[0] in ("send", "recv"):
+            ptr, n = int(args[1]), int(args[2])
+            ref = data[:n] if args[0] == "send" else [v ^ 0x5A for v in data[:n]]
+            failures += check(b["mem"] == ref, "%s: data intact" % b["name"])
+            single, burst, dma = b["stats"]
+            if chip.burst:
+                ok = single == 0 and dma == sum(
+                    1 for m in chip.pieces(ptr, n) if m >= DMA_MIN)
+            else:
+                ok = single == 0
+            failures += check(ok, "%s: no byte calls, DMA %s" % (
+                b["name"], "used" if dma else "not used"))
+    return failures
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("chips", nargs="*", default=sorted(CHIPS),
+                    help="w5100, w5200 and/or w5500")
+    ap.add_argument("-v", "--verbose", action="store_true",
+                    help="print the frames (first 24 bytes each)")
+    args = ap.parse_args()
+
+    failures = sum(check_chip(c, args.verbose) for c in args.chips)
+    if failures:
+        print("\n%d checks failed" % failures)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())